@@ -0,0 +1,103 @@
+/*
+ * Memory and scan bandwidth of adaptivelist against arraylist, for values
+ * fitting 1, 2 and 4 byte cells. Each list is filled with insert_last,
+ * then scanned with fast_get and with a contains missing every value.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/adaptivelist.h"
+#include "woofi/arraylist.h"
+
+#define COUNT 16000000
+#define SCANS 10
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *container, int range, size_t bytes,
+                         double fill, double get, double scan) {
+    printf("%-12s range=%-10d bytes=%-10zu fill=%.3fs get=%.3fs "
+           "scan=%.3fs (%.2f GB/s)\n", container, range, bytes, fill, get,
+           scan, (double)bytes * SCANS / scan / 1e9);
+}
+
+static void bench_arraylist(int range) {
+    arraylist *list = arraylist_create();
+    double start = bench_seconds();
+    double fill, get, scan;
+    long sum = 0;
+
+    for (int i = 0; i < COUNT; i++) {
+        arraylist_insert_last(list, i % range);
+    }
+    fill = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (size_t i = 0; i < list->count; i++) {
+        sum += arraylist_fast_get(list, i);
+    }
+    get = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (int i = 0; i < SCANS; i++) {
+        sum += arraylist_contains(list, -1);
+    }
+    scan = bench_seconds() - start;
+
+    bench_report("arraylist", range, list->count * sizeof(int), fill, get,
+                 scan);
+    if (sum == 42) {
+        printf("\n");
+    }
+    arraylist_delete(list);
+}
+
+static void bench_adaptivelist(int range) {
+    adaptivelist *list = adaptivelist_create();
+    double start = bench_seconds();
+    double fill, get, scan;
+    long sum = 0;
+
+    for (int i = 0; i < COUNT; i++) {
+        adaptivelist_insert_last(list, i % range);
+    }
+    fill = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (size_t i = 0; i < list->count; i++) {
+        sum += adaptivelist_fast_get(list, i);
+    }
+    get = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (int i = 0; i < SCANS; i++) {
+        sum += adaptivelist_contains(list, -1);
+    }
+    scan = bench_seconds() - start;
+
+    bench_report("adaptivelist", range, list->count * list->width, fill, get,
+                 scan);
+    if (sum == 42) {
+        printf("\n");
+    }
+    adaptivelist_delete(list);
+}
+
+int main() {
+    int ranges[] = { 100, 30000, COUNT };
+
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        bench_arraylist(ranges[i]);
+        bench_adaptivelist(ranges[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
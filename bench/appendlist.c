@@ -0,0 +1,112 @@
+/*
+ * Concurrent producers appending COUNT values in total, for every power
+ * of two threads up to the number of online processors: an arraylist
+ * behind a mutex against appendlist, one value or BATCH values at a time.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/appendlist.h"
+#include "woofi/arraylist.h"
+
+#define COUNT 16000000
+#define BATCH 256
+
+typedef enum {
+    BENCH_LOCKED,
+    BENCH_APPEND,
+    BENCH_RANGE
+} bench_mode;
+
+typedef struct {
+    bench_mode mode;
+    size_t count;
+    arraylist *locked;
+    pthread_mutex_t *lock;
+    appendlist *list;
+} bench_producer;
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *bench_produce(void *arg) {
+    bench_producer *producer = arg;
+    int batch[BATCH];
+
+    for (size_t i = 0; i < producer->count; ) {
+        switch (producer->mode) {
+        case BENCH_LOCKED:
+            pthread_mutex_lock(producer->lock);
+            arraylist_insert_last(producer->locked, i);
+            pthread_mutex_unlock(producer->lock);
+            i++;
+            break;
+        case BENCH_APPEND:
+            appendlist_insert_last(producer->list, i);
+            i++;
+            break;
+        case BENCH_RANGE:
+            for (int j = 0; j < BATCH; j++) {
+                batch[j] = i + j;
+            }
+            appendlist_insert_range(producer->list, batch, BATCH);
+            i += BATCH;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_run(bench_mode mode, const char *name, long threads) {
+    bench_producer *producer = calloc(threads, sizeof(*producer));
+    pthread_t *thread = calloc(threads, sizeof(*thread));
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    arraylist *locked = arraylist_create();
+    appendlist *list = appendlist_create();
+    double start = bench_seconds();
+    double seconds;
+
+    for (long i = 0; i < threads; i++) {
+        producer[i].mode = mode;
+        producer[i].count = COUNT / threads;
+        producer[i].locked = locked;
+        producer[i].lock = &lock;
+        producer[i].list = list;
+        pthread_create(&thread[i], NULL, bench_produce, &producer[i]);
+    }
+    for (long i = 0; i < threads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    seconds = bench_seconds() - start;
+
+    printf("%-16s threads=%-3ld time=%.3fs appends=%.1fM/s\n", name, threads,
+           seconds, COUNT / seconds / 1e6);
+
+    appendlist_delete(list);
+    arraylist_delete(locked);
+    pthread_mutex_destroy(&lock);
+    free(thread);
+    free(producer);
+}
+
+int main() {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (long threads = 1; threads <= online; threads *= 2) {
+        bench_run(BENCH_LOCKED, "mutex+arraylist", threads);
+        bench_run(BENCH_APPEND, "appendlist", threads);
+        bench_run(BENCH_RANGE, "appendlist range", threads);
+    }
+
+    return EXIT_SUCCESS;
+}
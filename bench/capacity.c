@@ -0,0 +1,165 @@
+/*
+ * Bursty workload: every round pushes BURST elements then pops back down
+ * to RESIDENT elements. Reports the number of reallocations and the
+ * resident memory once the burst is over, for each capacity policy.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/arraylist.h"
+#include "woofi/circularqueue.h"
+#include "woofi/stack.h"
+
+#define ROUNDS 20
+#define BURST 4000000
+#define RESIDENT 1000
+
+typedef void (*bench_fn)(const char *name, const capacity_policy *policy);
+
+/**
+ * Resident memory of the process, in KiB
+ * @return the resident memory or -1 if it can't be read
+ */
+static long bench_rss() {
+    long pages = -1;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (statm == NULL) {
+        return -1;
+    }
+    if (fscanf(statm, "%*d %ld", &pages) != 1) {
+        pages = -1;
+    }
+    fclose(statm);
+
+    return pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *container, const char *policy,
+                         size_t reallocs, size_t length, double seconds) {
+    printf("%-14s %-8s reallocs=%-6zu capacity=%-9zu rss=%-7ldKiB time=%.3fs\n"
+           , container, policy, reallocs, length, bench_rss(), seconds);
+}
+
+static void bench_arraylist(const char *name, const capacity_policy *policy) {
+    arraylist *list = arraylist_create();
+    size_t reallocs = 0;
+    size_t length = list->length;
+    double start = bench_seconds();
+
+    arraylist_set_policy(list, policy);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < BURST; i++) {
+            arraylist_insert_last(list, i);
+            reallocs += list->length != length;
+            length = list->length;
+        }
+        while (list->count > RESIDENT) {
+            arraylist_remove_at(list, list->count - 1);
+            reallocs += list->length != length;
+            length = list->length;
+        }
+    }
+
+    bench_report("arraylist", name, reallocs, length,
+                 bench_seconds() - start);
+    arraylist_delete(list);
+}
+
+static void bench_stack(const char *name, const capacity_policy *policy) {
+    stack *stack = stack_create();
+    size_t reallocs = 0;
+    size_t size = stack->size;
+    double start = bench_seconds();
+
+    stack_set_policy(stack, policy);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < BURST; i++) {
+            stack_insert(stack, i);
+            reallocs += stack->size != size;
+            size = stack->size;
+        }
+        while (stack_count(stack) > RESIDENT) {
+            stack_remove(stack);
+            reallocs += stack->size != size;
+            size = stack->size;
+        }
+    }
+
+    bench_report("stack", name, reallocs, size, bench_seconds() - start);
+    stack_delete(stack);
+}
+
+static void bench_circularqueue(const char *name,
+                                const capacity_policy *policy) {
+    circularqueue *queue = circularqueue_create(0);
+    size_t reallocs = 0;
+    size_t size = queue->size;
+    double start = bench_seconds();
+
+    circularqueue_set_policy(queue, policy);
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < BURST; i++) {
+            circularqueue_insert(queue, i);
+            reallocs += queue->size != size;
+            size = queue->size;
+        }
+        while (circularqueue_count(queue) > RESIDENT) {
+            circularqueue_remove(queue);
+            reallocs += queue->size != size;
+            size = queue->size;
+        }
+    }
+
+    bench_report("circularqueue", name, reallocs, size,
+                 bench_seconds() - start);
+    circularqueue_delete(queue);
+}
+
+/**
+ * Run a case in a child process so it starts with a fresh heap
+ */
+static void bench_run(bench_fn fn, const char *name,
+                      const capacity_policy *policy) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        fn(name, policy);
+        fflush(stdout);
+        _exit(0);
+    }
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+}
+
+int main() {
+    const capacity_policy fixed = CAPACITY_POLICY_DEFAULT;
+    const capacity_policy shrink = CAPACITY_POLICY_SHRINK;
+
+    printf("%d rounds of %d pushes down to %d elements, start rss=%ldKiB\n"
+           , ROUNDS, BURST, RESIDENT, bench_rss());
+
+    fflush(stdout);
+
+    bench_run(bench_arraylist, "default", &fixed);
+    bench_run(bench_arraylist, "shrink", &shrink);
+    bench_run(bench_stack, "default", &fixed);
+    bench_run(bench_stack, "shrink", &shrink);
+    bench_run(bench_circularqueue, "default", &fixed);
+    bench_run(bench_circularqueue, "shrink", &shrink);
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * One writer streams COUNT values to CONSUMERS threads which each see all
+ * of them: copied into a circularqueue per consumer under its mutex, or
+ * published once in a disruptor read in place by every consumer.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/circularqueue.h"
+#include "woofi/disruptor.h"
+
+#define COUNT 5000000
+#define CONSUMERS 3
+#define BATCH 256
+#define SLOTS 4096
+
+typedef struct {
+    pthread_mutex_t lock;
+    circularqueue *queue;
+    int closed;
+    long sum;
+} bench_queue;
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *bench_queue_consume(void *arg) {
+    bench_queue *queue = arg;
+    int values[BATCH];
+
+    for (;;) {
+        int count = 0;
+        int closed;
+
+        pthread_mutex_lock(&queue->lock);
+        while (count < BATCH && !circularqueue_is_empty(queue->queue)) {
+            values[count++] = circularqueue_head(queue->queue);
+            circularqueue_remove(queue->queue);
+        }
+        closed = queue->closed;
+        pthread_mutex_unlock(&queue->lock);
+
+        for (int i = 0; i < count; i++) {
+            queue->sum += values[i];
+        }
+        if (count == 0) {
+            if (closed) {
+                return NULL;
+            }
+            sched_yield();
+        }
+    }
+}
+
+static void bench_queues() {
+    bench_queue queue[CONSUMERS];
+    pthread_t thread[CONSUMERS];
+    double start = bench_seconds();
+
+    for (int c = 0; c < CONSUMERS; c++) {
+        pthread_mutex_init(&queue[c].lock, NULL);
+        queue[c].queue = circularqueue_create(SLOTS);
+        queue[c].closed = 0;
+        queue[c].sum = 0;
+        pthread_create(&thread[c], NULL, bench_queue_consume, &queue[c]);
+    }
+
+    for (int i = 0; i < COUNT; ) {
+        for (int c = 0; c < CONSUMERS; c++) {
+            pthread_mutex_lock(&queue[c].lock);
+            /* A full fixed size queue would overwrite its head */
+            while (circularqueue_count(queue[c].queue) + BATCH >= SLOTS) {
+                pthread_mutex_unlock(&queue[c].lock);
+                sched_yield();
+                pthread_mutex_lock(&queue[c].lock);
+            }
+            for (int j = 0; j < BATCH; j++) {
+                circularqueue_insert(queue[c].queue, i + j);
+            }
+            pthread_mutex_unlock(&queue[c].lock);
+        }
+        i += BATCH;
+    }
+    for (int c = 0; c < CONSUMERS; c++) {
+        pthread_mutex_lock(&queue[c].lock);
+        queue[c].closed = 1;
+        pthread_mutex_unlock(&queue[c].lock);
+        pthread_join(thread[c], NULL);
+    }
+
+    printf("%-10s time=%.3fs sum=%ld\n", "queues", bench_seconds() - start,
+           queue[0].sum);
+    for (int c = 0; c < CONSUMERS; c++) {
+        circularqueue_delete(queue[c].queue);
+        pthread_mutex_destroy(&queue[c].lock);
+    }
+}
+
+static void *bench_disruptor_consume(void *arg) {
+    disruptor_consumer *consumer = arg;
+    long sum = 0;
+    uint64_t first;
+    size_t count;
+
+    while ((count = disruptor_wait(consumer, &first))) {
+        for (size_t i = 0; i < count; i++) {
+            sum += *disruptor_slot(consumer->ring, first + i);
+        }
+        disruptor_release(consumer, count);
+    }
+
+    return (void *)sum;
+}
+
+static void bench_disruptor() {
+    disruptor *ring = disruptor_create(SLOTS);
+    pthread_t thread[CONSUMERS];
+    int values[BATCH];
+    void *sum = NULL;
+    double start = bench_seconds();
+
+    for (int c = 0; c < CONSUMERS; c++) {
+        disruptor_consumer *consumer = disruptor_add_consumer(ring, NULL, 0);
+        pthread_create(&thread[c], NULL, bench_disruptor_consume, consumer);
+    }
+
+    for (int i = 0; i < COUNT; i += BATCH) {
+        for (int j = 0; j < BATCH; j++) {
+            values[j] = i + j;
+        }
+        disruptor_publish_range(ring, values, BATCH);
+    }
+    disruptor_close(ring);
+    for (int c = 0; c < CONSUMERS; c++) {
+        pthread_join(thread[c], &sum);
+    }
+
+    printf("%-10s time=%.3fs sum=%ld\n", "disruptor", bench_seconds() - start,
+           (long)sum);
+    disruptor_delete(ring);
+}
+
+int main() {
+    bench_queues();
+    bench_disruptor();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/*
+ * A producer thread submits COUNT values in bursts of BURST to a consumer
+ * thread sleeping in epoll: one pipe write per value against an
+ * eventqueue. Reports the values per second and the wakeups of the
+ * consumer.
+ */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/eventqueue.h"
+
+#define COUNT 2000000
+#define BURST 10000
+#define DRAIN 4096
+
+typedef struct {
+    int pipe[2];
+    eventqueue *queue;
+} bench_channel;
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *bench_produce(void *arg) {
+    bench_channel *channel = arg;
+    struct timespec pause = { 0, 100000 };
+
+    for (int i = 0; i < COUNT; i++) {
+        if (channel->queue) {
+            eventqueue_push(channel->queue, i);
+        }
+        else if (write(channel->pipe[1], &i, sizeof(i)) != sizeof(i)) {
+            break;
+        }
+        /* Let the consumer catch up between bursts */
+        if (i % BURST == BURST - 1) {
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_run(int use_queue) {
+    bench_channel channel = { { -1, -1 }, NULL };
+    struct epoll_event event = { EPOLLIN, { 0 } };
+    int values[DRAIN];
+    long received = 0;
+    long wakeups = 0;
+    long sum = 0;
+    double start;
+    double seconds;
+    pthread_t thread;
+    int fd;
+    int epoll = epoll_create1(0);
+
+    if (use_queue) {
+        channel.queue = eventqueue_create();
+        fd = eventqueue_fd(channel.queue);
+    }
+    else {
+        if (pipe(channel.pipe) == -1) {
+            perror("pipe");
+            return;
+        }
+        fd = channel.pipe[0];
+    }
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+
+    start = bench_seconds();
+    pthread_create(&thread, NULL, bench_produce, &channel);
+    while (received < COUNT) {
+        long count;
+
+        if (epoll_wait(epoll, &event, 1, -1) != 1) {
+            continue;
+        }
+        wakeups++;
+        if (use_queue) {
+            count = eventqueue_drain(channel.queue, values, DRAIN);
+        }
+        else {
+            count = read(fd, values, sizeof(values));
+            count = count > 0 ? count / (long)sizeof(int) : 0;
+        }
+        for (long i = 0; i < count; i++) {
+            sum += values[i];
+        }
+        received += count;
+    }
+    pthread_join(thread, NULL);
+    seconds = bench_seconds() - start;
+
+    printf("%-10s time=%.3fs values=%.2fM/s wakeups=%ld sum=%ld\n",
+           use_queue ? "eventqueue" : "pipe", seconds,
+           COUNT / seconds / 1e6, wakeups, sum);
+
+    close(epoll);
+    if (use_queue) {
+        eventqueue_delete(channel.queue);
+    }
+    else {
+        close(channel.pipe[0]);
+        close(channel.pipe[1]);
+    }
+}
+
+int main() {
+    bench_run(0);
+    bench_run(1);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+/*
+ * Short lived containers: every thread creates an arraylist, a stack and
+ * a circular queue, grows them to VALUES elements and deletes them, ROUNDS
+ * times. Allocations go to libc or to magazine caches, for every power of
+ * two threads up to the number of online processors.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/allocator.h"
+#include "woofi/arraylist.h"
+#include "woofi/circularqueue.h"
+#include "woofi/magazine.h"
+#include "woofi/stack.h"
+
+#define ROUNDS 200000
+#define VALUES 64
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void *bench_work(void *arg) {
+    long rounds = (long)arg;
+
+    for (long i = 0; i < rounds; i++) {
+        arraylist *list = arraylist_create();
+        stack *stack = stack_create();
+        circularqueue *queue = circularqueue_create(8);
+
+        for (int j = 0; j < VALUES; j++) {
+            arraylist_insert_last(list, j);
+            stack_insert(stack, j);
+            circularqueue_insert(queue, j);
+        }
+        circularqueue_delete(queue);
+        stack_delete(stack);
+        arraylist_delete(list);
+    }
+
+    return NULL;
+}
+
+static void bench_run(const char *name, long threads) {
+    pthread_t *thread = calloc(threads, sizeof(*thread));
+    double start = bench_seconds();
+    double seconds;
+
+    for (long i = 0; i < threads; i++) {
+        pthread_create(&thread[i], NULL, bench_work, (void *)(ROUNDS / threads));
+    }
+    for (long i = 0; i < threads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    seconds = bench_seconds() - start;
+
+    printf("%-9s threads=%-3ld time=%.3fs rounds=%.2fM/s\n", name, threads,
+           seconds, ROUNDS / seconds / 1e6);
+
+    free(thread);
+}
+
+int main() {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    magazine_cache *cache = magazine_create();
+    allocator hooks = magazine_allocator(cache);
+
+    for (long threads = 1; threads <= online; threads *= 2) {
+        allocator_set(NULL);
+        bench_run("libc", threads);
+        allocator_set(&hooks);
+        bench_run("magazine", threads);
+    }
+
+    allocator_set(NULL);
+    magazine_delete(cache);
+
+    return EXIT_SUCCESS;
+}
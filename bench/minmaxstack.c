@@ -0,0 +1,92 @@
+/*
+ * Backtracking walk of COUNT steps which asks for the minimum and the
+ * maximum of the current path at each step: scanning the elements of a
+ * stack, or reading the head of a minmaxstack.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/minmaxstack.h"
+#include "woofi/stack.h"
+
+#define COUNT 200000
+#define DEPTH 2000
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_stack(const int *steps) {
+    stack *stack = stack_create();
+    long check = 0;
+    double start = bench_seconds();
+
+    for (int i = 0; i < COUNT; i++) {
+        if (steps[i] < 0 || stack_count(stack) == DEPTH) {
+            stack_remove(stack);
+        }
+        else {
+            stack_insert(stack, steps[i]);
+        }
+        if (!stack_is_empty(stack)) {
+            int minimum = stack_head(stack);
+            int maximum = minimum;
+
+            for (size_t j = 0; j < stack->head; j++) {
+                minimum = stack->element[j] < minimum ? stack->element[j]
+                                                      : minimum;
+                maximum = stack->element[j] > maximum ? stack->element[j]
+                                                      : maximum;
+            }
+            check += minimum + maximum;
+        }
+    }
+
+    printf("%-12s time=%.3fs check=%ld\n", "scan", bench_seconds() - start,
+           check);
+    stack_delete(stack);
+}
+
+static void bench_minmaxstack(const int *steps) {
+    minmaxstack *stack = minmaxstack_create();
+    long check = 0;
+    double start = bench_seconds();
+
+    for (int i = 0; i < COUNT; i++) {
+        if (steps[i] < 0 || minmaxstack_count(stack) == DEPTH) {
+            minmaxstack_remove(stack);
+        }
+        else {
+            minmaxstack_insert(stack, steps[i]);
+        }
+        if (!minmaxstack_is_empty(stack)) {
+            check += minmaxstack_min(stack) + minmaxstack_max(stack);
+        }
+    }
+
+    printf("%-12s time=%.3fs check=%ld\n", "minmaxstack",
+           bench_seconds() - start, check);
+    minmaxstack_delete(stack);
+}
+
+int main() {
+    int *steps = malloc(COUNT * sizeof(*steps));
+
+    /* Slightly more moves forward than back, the path keeps deepening */
+    srand(42);
+    for (int i = 0; i < COUNT; i++) {
+        steps[i] = rand() % 100 < 45 ? -1 : rand() % 100000;
+    }
+
+    bench_stack(steps);
+    bench_minmaxstack(steps);
+
+    free(steps);
+    return EXIT_SUCCESS;
+}
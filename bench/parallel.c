@@ -0,0 +1,112 @@
+/*
+ * Speedup of the parallel arraylist algorithms against their serial
+ * counterparts, for every power of two threads up to the number of
+ * online processors.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/parallel.h"
+
+#define COUNT 20000000
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int bench_compare(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int bench_sum(int a, int b) {
+    return (int)((unsigned int)a + (unsigned int)b);
+}
+
+static int bench_hash(int value) {
+    unsigned int x = value;
+
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    return (int)x;
+}
+
+static void bench_fill(arraylist *list) {
+    srand(42);
+    for (size_t i = 0; i < list->count; i++) {
+        list->element[i] = rand() - RAND_MAX / 2;
+    }
+}
+
+int main() {
+    arraylist *list = arraylist_create();
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    double start, serial_sort, serial_reduce, serial_map;
+    volatile int sink;
+
+    arraylist_reserve(list, COUNT);
+    list->count = COUNT;
+
+    bench_fill(list);
+    start = bench_seconds();
+    qsort(list->element, list->count, sizeof(int), bench_compare);
+    serial_sort = bench_seconds() - start;
+
+    start = bench_seconds();
+    int sum = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        sum = bench_sum(sum, list->element[i]);
+    }
+    sink = sum;
+    serial_reduce = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (size_t i = 0; i < list->count; i++) {
+        list->element[i] = bench_hash(list->element[i]);
+    }
+    serial_map = bench_seconds() - start;
+
+    printf("%d elements, serial: sort(qsort)=%.3fs reduce=%.3fs map=%.3fs\n"
+           , COUNT, serial_sort, serial_reduce, serial_map);
+
+    for (long threads = 1; threads <= (online > 0 ? online : 1); threads *= 2) {
+        threadpool *pool = threadpool_create(threads);
+        double sort, reduce, map;
+
+        bench_fill(list);
+        start = bench_seconds();
+        arraylist_par_sort(list, pool);
+        sort = bench_seconds() - start;
+
+        start = bench_seconds();
+        sink = arraylist_par_reduce(list, pool, bench_sum, 0);
+        reduce = bench_seconds() - start;
+
+        start = bench_seconds();
+        arraylist_par_map(list, pool, bench_hash);
+        map = bench_seconds() - start;
+
+        printf("%3ld threads: sort=%.3fs (x%.1f) reduce=%.3fs (x%.1f) "
+               "map=%.3fs (x%.1f)\n"
+               , threads, sort, serial_sort / sort
+               , reduce, serial_reduce / reduce
+               , map, serial_map / map);
+
+        threadpool_delete(pool);
+    }
+
+    (void)sink;
+    arraylist_delete(list);
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * COUNT values through three CPU bound stages: run one after the other
+ * by a single thread, then as a pipeline with WORKERS threads on the
+ * slowest stage, in order and out of order.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/pipeline.h"
+
+#define COUNT (1 << 21)
+#define BATCH 256
+#define CAPACITY 16
+#define WORKERS 4
+#define ROUNDS 200
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int bench_mix(int value, int rounds) {
+    unsigned x = value;
+
+    for (int i = 0; i < rounds; i++) {
+        x = x * 1103515245u + 12345u;
+    }
+    return (int)(x >> 1);
+}
+
+static size_t bench_light(void *ctx, const int *input, size_t count,
+                          int *output) {
+    (void)ctx;
+
+    for (size_t i = 0; i < count; i++) {
+        output[i] = bench_mix(input[i], ROUNDS / 10);
+    }
+    return count;
+}
+
+static size_t bench_heavy(void *ctx, const int *input, size_t count,
+                          int *output) {
+    (void)ctx;
+
+    for (size_t i = 0; i < count; i++) {
+        output[i] = bench_mix(input[i], ROUNDS);
+    }
+    return count;
+}
+
+static size_t bench_filter(void *ctx, const int *input, size_t count,
+                           int *output) {
+    size_t kept = 0;
+
+    (void)ctx;
+    for (size_t i = 0; i < count; i++) {
+        if (input[i] & 1) {
+            output[kept++] = input[i];
+        }
+    }
+    return kept;
+}
+
+static void bench_serial() {
+    int input[BATCH];
+    int middle[BATCH];
+    int output[BATCH];
+    long sum = 0;
+    double start = bench_seconds();
+
+    for (int i = 0; i < COUNT; i += BATCH) {
+        size_t count;
+
+        for (int j = 0; j < BATCH; j++) {
+            input[j] = i + j;
+        }
+        bench_light(NULL, input, BATCH, middle);
+        bench_heavy(NULL, middle, BATCH, input);
+        count = bench_filter(NULL, input, BATCH, output);
+        for (size_t j = 0; j < count; j++) {
+            sum += output[j];
+        }
+    }
+
+    printf("%-10s time=%.3fs sum=%ld\n", "serial", bench_seconds() - start,
+           sum);
+}
+
+static void bench_pipeline(const char *name, int ordered) {
+    pipeline *pipeline = pipeline_create(BATCH, CAPACITY);
+    pipeline_stage_stats stats;
+    int values[BATCH];
+    long sum = 0;
+    size_t count;
+    double start = bench_seconds();
+
+    pipeline_add_stage(pipeline, bench_light, NULL, 1, ordered);
+    pipeline_add_stage(pipeline, bench_heavy, NULL, WORKERS, ordered);
+    pipeline_add_stage(pipeline, bench_filter, NULL, 1, ordered);
+    if (pipeline_start(pipeline) == -1) {
+        perror("pipeline_start");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Pop as the rings fill up, the output ring must not block the stages */
+    for (int i = 0; i < COUNT; i += BATCH) {
+        for (int j = 0; j < BATCH; j++) {
+            values[j] = i + j;
+        }
+        pipeline_push(pipeline, values, BATCH);
+        if (i >= BATCH * CAPACITY) {
+            count = pipeline_pop(pipeline, values, BATCH);
+            for (size_t j = 0; j < count; j++) {
+                sum += values[j];
+            }
+        }
+    }
+    pipeline_close(pipeline);
+    while ((count = pipeline_pop(pipeline, values, BATCH))) {
+        for (size_t j = 0; j < count; j++) {
+            sum += values[j];
+        }
+    }
+
+    printf("%-10s time=%.3fs sum=%ld\n", name, bench_seconds() - start, sum);
+    for (size_t s = 0; s < 3; s++) {
+        pipeline_stats(pipeline, s, &stats);
+        printf("  stage %zu  in=%llu busy=%.3fs stall=%.3fs depth max=%zu"
+               " mean=%.2f\n", s, (unsigned long long)stats.values_in,
+               stats.busy_seconds, stats.stall_seconds, stats.max_depth,
+               stats.mean_depth);
+    }
+    pipeline_delete(pipeline);
+}
+
+int main() {
+    bench_serial();
+    bench_pipeline("ordered", 1);
+    bench_pipeline("unordered", 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/*
+ * Read heavy workload: readers keep reading a shared object while one
+ * writer replaces it every WRITE_DELAY microseconds and frees the old one
+ * through a rwlock, epoch based reclamation or hazard pointers. Reports
+ * the reads per second of each scheme for 1 to the number of online
+ * processors readers.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/epoch.h"
+#include "woofi/hazard.h"
+
+#define DURATION 0.5
+#define WRITE_DELAY 50
+#define VALUES 16
+
+typedef struct {
+    int value[VALUES];
+} bench_object;
+
+typedef enum {
+    BENCH_RWLOCK,
+    BENCH_EPOCH,
+    BENCH_HAZARD
+} bench_scheme;
+
+typedef struct {
+    bench_scheme scheme;
+    bench_object *shared;
+    pthread_rwlock_t lock;
+    epoch_domain *epoch;
+    hazard_domain *hazard;
+    int stop;
+} bench_state;
+
+typedef struct {
+    bench_state *state;
+    pthread_t thread;
+    unsigned long reads;
+    unsigned long torn;
+} bench_reader;
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static bench_object *bench_object_create(int generation) {
+    bench_object *object = malloc(sizeof(*object));
+
+    for (int i = 0; i < VALUES; i++) {
+        object->value[i] = generation;
+    }
+    return object;
+}
+
+/* Every value of an object is its generation, a mismatch is a torn read */
+static int bench_check(const bench_object *object) {
+    int torn = 0;
+
+    for (int i = 1; i < VALUES; i++) {
+        torn |= object->value[i] != object->value[0];
+    }
+    return torn;
+}
+
+static void *bench_read(void *arg) {
+    bench_reader *reader = arg;
+    bench_state *state = reader->state;
+    epoch_record *epoch = NULL;
+    hazard_record *hazard = NULL;
+
+    if (state->scheme == BENCH_EPOCH) {
+        epoch = epoch_register(state->epoch);
+    } else if (state->scheme == BENCH_HAZARD) {
+        hazard = hazard_register(state->hazard);
+    }
+
+    while (!__atomic_load_n(&state->stop, __ATOMIC_RELAXED)) {
+        const bench_object *object = NULL;
+
+        switch (state->scheme) {
+        case BENCH_RWLOCK:
+            pthread_rwlock_rdlock(&state->lock);
+            reader->torn += bench_check(state->shared);
+            pthread_rwlock_unlock(&state->lock);
+            break;
+        case BENCH_EPOCH:
+            epoch_enter(state->epoch, epoch);
+            object = __atomic_load_n(&state->shared, __ATOMIC_ACQUIRE);
+            reader->torn += bench_check(object);
+            epoch_exit(epoch);
+            break;
+        case BENCH_HAZARD:
+            object = hazard_protect(hazard, 0, (void *const *)&state->shared);
+            reader->torn += bench_check(object);
+            hazard_clear(hazard, 0);
+            break;
+        }
+        reader->reads++;
+    }
+
+    if (epoch) {
+        epoch_unregister(state->epoch, epoch);
+    }
+    if (hazard) {
+        hazard_unregister(state->hazard, hazard);
+    }
+    return NULL;
+}
+
+/**
+ * Replace the shared object until the end of the run
+ * @return the number of writes
+ */
+static unsigned long bench_write(bench_state *state) {
+    struct timespec delay = { 0, WRITE_DELAY * 1000 };
+    epoch_record *epoch = NULL;
+    hazard_record *hazard = NULL;
+    unsigned long writes = 0;
+    double end = bench_seconds() + DURATION;
+
+    if (state->scheme == BENCH_EPOCH) {
+        epoch = epoch_register(state->epoch);
+    } else if (state->scheme == BENCH_HAZARD) {
+        hazard = hazard_register(state->hazard);
+    }
+
+    while (bench_seconds() < end) {
+        bench_object *object = bench_object_create(++writes);
+        bench_object *old = NULL;
+
+        switch (state->scheme) {
+        case BENCH_RWLOCK:
+            pthread_rwlock_wrlock(&state->lock);
+            old = state->shared;
+            state->shared = object;
+            pthread_rwlock_unlock(&state->lock);
+            free(old);
+            break;
+        case BENCH_EPOCH:
+            old = __atomic_exchange_n(&state->shared, object, __ATOMIC_ACQ_REL);
+            epoch_defer(state->epoch, epoch, old, free);
+            break;
+        case BENCH_HAZARD:
+            old = __atomic_exchange_n(&state->shared, object, __ATOMIC_ACQ_REL);
+            hazard_retire(state->hazard, hazard, old, free);
+            break;
+        }
+        nanosleep(&delay, NULL);
+    }
+
+    if (epoch) {
+        epoch_unregister(state->epoch, epoch);
+    }
+    if (hazard) {
+        hazard_unregister(state->hazard, hazard);
+    }
+    return writes;
+}
+
+static void bench_run(bench_scheme scheme, const char *name, long readers) {
+    bench_reader *reader = calloc(readers, sizeof(*reader));
+    bench_state state = { scheme, bench_object_create(0),
+                          PTHREAD_RWLOCK_INITIALIZER, epoch_create(),
+                          hazard_create(), 0 };
+    unsigned long reads = 0;
+    unsigned long torn = 0;
+    unsigned long writes;
+
+    for (long i = 0; i < readers; i++) {
+        reader[i].state = &state;
+        pthread_create(&reader[i].thread, NULL, bench_read, &reader[i]);
+    }
+    writes = bench_write(&state);
+    __atomic_store_n(&state.stop, 1, __ATOMIC_RELAXED);
+    for (long i = 0; i < readers; i++) {
+        pthread_join(reader[i].thread, NULL);
+        reads += reader[i].reads;
+        torn += reader[i].torn;
+    }
+
+    printf("%-7s readers=%-3ld reads=%-8.2fM/s writes=%-6lu torn=%lu\n", name,
+           readers, reads / DURATION / 1e6, writes, torn);
+
+    epoch_delete(state.epoch);
+    hazard_delete(state.hazard);
+    pthread_rwlock_destroy(&state.lock);
+    free(state.shared);
+    free(reader);
+}
+
+int main() {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (long readers = 1; readers <= online; readers *= 2) {
+        bench_run(BENCH_RWLOCK, "rwlock", readers);
+        bench_run(BENCH_EPOCH, "epoch", readers);
+        bench_run(BENCH_HAZARD, "hazard", readers);
+    }
+
+    return EXIT_SUCCESS;
+}
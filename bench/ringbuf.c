@@ -0,0 +1,158 @@
+/*
+ * Receive TOTAL bytes from a child process over a socketpair and parse
+ * them as 32 bit length prefixed messages, reading straight into a
+ * ringbuf with readv and parsing in place, or reading into a temporary
+ * buffer copied in and out of the ring buffer.
+ */
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/ringbuf.h"
+
+#define TOTAL (1L << 30)
+#define CHUNK 65536
+#define MESSAGE 200
+#define RING 262144
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Send messages of MESSAGE bytes, a length followed by a payload
+ */
+static void bench_send(int fd) {
+    unsigned char chunk[CHUNK];
+    uint32_t length = MESSAGE - sizeof(length);
+
+    for (size_t i = 0; i < CHUNK; i += MESSAGE) {
+        memcpy(chunk + i, &length, sizeof(length));
+        memset(chunk + i + sizeof(length), (int)(i / MESSAGE), length);
+    }
+    for (long sent = 0; sent < TOTAL; ) {
+        ssize_t rc = write(fd, chunk, CHUNK - CHUNK % MESSAGE);
+
+        if (rc <= 0) {
+            _exit(EXIT_FAILURE);
+        }
+        sent += rc;
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Parse the complete messages at the head of the ring buffer
+ * @return the number of messages parsed
+ */
+static long bench_parse_inplace(ringbuf *ring, unsigned long *checksum) {
+    long messages = 0;
+
+    for (;;) {
+        struct iovec iov[2];
+        size_t count = ringbuf_peek(ring, iov);
+        uint32_t length;
+        unsigned char *payload;
+
+        if (count < sizeof(length) || iov[0].iov_len < sizeof(length)) {
+            if (count < sizeof(length)) {
+                return messages;
+            }
+            /* The prefix wraps, read it piecewise */
+            memcpy(&length, iov[0].iov_base, iov[0].iov_len);
+            memcpy((char *)&length + iov[0].iov_len, iov[1].iov_base,
+                   sizeof(length) - iov[0].iov_len);
+        }
+        else {
+            memcpy(&length, iov[0].iov_base, sizeof(length));
+        }
+        if (count < sizeof(length) + length) {
+            return messages;
+        }
+
+        /* Sum the first byte of the payload, wherever it is */
+        payload = iov[0].iov_len > sizeof(length)
+            ? (unsigned char *)iov[0].iov_base + sizeof(length)
+            : (unsigned char *)iov[1].iov_base
+                + (sizeof(length) - iov[0].iov_len);
+        *checksum += *payload;
+        ringbuf_consume(ring, sizeof(length) + length);
+        messages++;
+    }
+}
+
+static void bench_run(int copy) {
+    ringbuf *ring = ringbuf_create(RING);
+    unsigned char *buffer = malloc(RING);
+    unsigned long checksum = 0;
+    long messages = 0;
+    long received = 0;
+    double start = bench_seconds();
+    double seconds;
+    int fd[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == -1) {
+        perror("socketpair");
+        return;
+    }
+    if (fork() == 0) {
+        close(fd[0]);
+        bench_send(fd[1]);
+    }
+    close(fd[1]);
+
+    for (;;) {
+        ssize_t rc;
+
+        if (copy) {
+            /* Read into a buffer, copy in, then out for parsing */
+            rc = read(fd[0], buffer, ringbuf_space(ring));
+            if (rc > 0) {
+                ringbuf_write(ring, buffer, rc);
+            }
+            while (ringbuf_count(ring) >= MESSAGE) {
+                uint32_t length;
+
+                ringbuf_read(ring, buffer, MESSAGE);
+                memcpy(&length, buffer, sizeof(length));
+                checksum += buffer[sizeof(length)];
+                messages++;
+            }
+        }
+        else {
+            rc = ringbuf_read_fd(ring, fd[0]);
+            messages += bench_parse_inplace(ring, &checksum);
+        }
+        if (rc <= 0) {
+            break;
+        }
+        received += rc;
+    }
+    close(fd[0]);
+    wait(NULL);
+    seconds = bench_seconds() - start;
+
+    printf("%-8s time=%.3fs throughput=%.0fMB/s messages=%ld checksum=%lu\n",
+           copy ? "copy" : "readv", seconds, received / seconds / 1e6,
+           messages, checksum);
+
+    free(buffer);
+    ringbuf_delete(ring);
+}
+
+int main() {
+    bench_run(1);
+    bench_run(0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/*
+ * Stream COUNT ints from a child process to its parent in batches of
+ * BATCH values, through a pipe and through a shmqueue, and report the
+ * values per second of each.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/shmqueue.h"
+
+#define COUNT 20000000
+#define BATCH 256
+#define SLOTS 65536
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(const char *name, double start, long sum) {
+    double seconds = bench_seconds() - start;
+
+    printf("%-9s time=%.3fs values=%.1fM/s sum=%ld\n", name, seconds,
+           COUNT / seconds / 1e6, sum);
+}
+
+static void bench_pipe() {
+    int batch[BATCH];
+    int fd[2];
+    long sum = 0;
+    double start;
+
+    if (pipe(fd) == -1) {
+        perror("pipe");
+        return;
+    }
+    start = bench_seconds();
+    if (fork() == 0) {
+        close(fd[0]);
+        for (int i = 0; i < COUNT; i += BATCH) {
+            for (int j = 0; j < BATCH; j++) {
+                batch[j] = i + j;
+            }
+            if (write(fd[1], batch, sizeof(batch)) != sizeof(batch)) {
+                _exit(EXIT_FAILURE);
+            }
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    close(fd[1]);
+    for (;;) {
+        ssize_t size = read(fd[0], batch, sizeof(batch));
+
+        if (size <= 0) {
+            break;
+        }
+        for (size_t j = 0; j < size / sizeof(int); j++) {
+            sum += batch[j];
+        }
+    }
+    close(fd[0]);
+    wait(NULL);
+
+    bench_report("pipe", start, sum);
+}
+
+static void bench_shmqueue() {
+    char name[64];
+    int batch[BATCH];
+    long sum = 0;
+    long received = 0;
+    shmqueue *queue = NULL;
+    double start;
+
+    snprintf(name, sizeof(name), "/woofi-bench-%ld", (long)getpid());
+    queue = shmqueue_create(name, SLOTS);
+    if (queue == NULL) {
+        perror("shmqueue_create");
+        return;
+    }
+    start = bench_seconds();
+    if (fork() == 0) {
+        shmqueue *producer = shmqueue_attach(name);
+
+        for (int i = 0; producer && i < COUNT; i += BATCH) {
+            size_t count = 0;
+
+            for (int j = 0; j < BATCH; j++) {
+                batch[j] = i + j;
+            }
+            while (count < BATCH) {
+                count += shmqueue_insert_range(producer, batch + count,
+                                               BATCH - count);
+                if (count < BATCH) {
+                    shmqueue_wait_writable(producer, -1);
+                }
+            }
+        }
+        _exit(producer ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    while (received < COUNT) {
+        size_t count = shmqueue_remove_range(queue, batch, BATCH);
+
+        if (count == 0) {
+            shmqueue_wait_readable(queue, -1);
+        }
+        for (size_t j = 0; j < count; j++) {
+            sum += batch[j];
+        }
+        received += count;
+    }
+    wait(NULL);
+
+    bench_report("shmqueue", start, sum);
+    shmqueue_detach(queue);
+    shmqueue_unlink(name);
+}
+
+int main() {
+    bench_pipe();
+    bench_shmqueue();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/*
+ * Connection timeout workload: LIVE timers with delays up to TIMEOUT
+ * ticks, a third of them cancelled, then the wheel is advanced one tick
+ * at a time until every timer expired. The cost per operation should not
+ * depend on the number of live timers.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/timerwheel.h"
+
+#define TIMEOUT 60000
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_expire(void *ctx, timerwheel_timer timer) {
+    size_t *expired = ctx;
+
+    (*expired)++;
+    (void)timer;
+}
+
+static void bench_run(size_t live) {
+    timerwheel *wheel = timerwheel_create(0);
+    timerwheel_timer *timers = malloc(live * sizeof(*timers));
+    size_t expired = 0;
+    size_t cancelled = 0;
+    double start, schedule, cancel, advance;
+
+    if (wheel == NULL || timers == NULL) {
+        perror("bench_run");
+        exit(1);
+    }
+
+    srand(42);
+    start = bench_seconds();
+    for (size_t i = 0; i < live; i++) {
+        timers[i] = timerwheel_schedule(wheel, 1 + rand() % TIMEOUT,
+                                        bench_expire, &expired);
+    }
+    schedule = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (size_t i = 0; i < live; i += 3) {
+        cancelled += timerwheel_cancel(wheel, timers[i]);
+    }
+    cancel = bench_seconds() - start;
+
+    start = bench_seconds();
+    for (uint64_t tick = 1; tick <= TIMEOUT; tick++) {
+        timerwheel_advance(wheel, tick);
+    }
+    advance = bench_seconds() - start;
+
+    printf("%8zu live: schedule=%5.1fns cancel=%5.1fns "
+           "expire=%5.1fns/timer (%zu expired, %.1fus/tick)\n"
+           , live, schedule * 1e9 / live, cancel * 1e9 / cancelled
+           , advance * 1e9 / expired, expired, advance * 1e6 / TIMEOUT);
+
+    free(timers);
+    timerwheel_delete(wheel);
+}
+
+int main() {
+    for (size_t live = 1000000; live <= 8000000; live *= 2) {
+        bench_run(live);
+    }
+
+    return 0;
+}
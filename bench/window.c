@@ -0,0 +1,88 @@
+/*
+ * Rolling minimum, maximum and sum over the last LENGTH of COUNT samples:
+ * rescanning a circularqueue on every tick, or with a window.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "woofi/circularqueue.h"
+#include "woofi/window.h"
+
+#define COUNT 200000
+#define LENGTH 1000
+
+static double bench_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_rescan(const int *samples) {
+    circularqueue *queue = circularqueue_create(LENGTH + 1);
+    long check = 0;
+    double start = bench_seconds();
+
+    for (int i = 0; i < COUNT; i++) {
+        int minimum;
+        int maximum;
+        long sum = 0;
+
+        if (circularqueue_count(queue) == LENGTH) {
+            circularqueue_remove(queue);
+        }
+        circularqueue_insert(queue, samples[i]);
+
+        /* The elements wrap at most once */
+        minimum = maximum = circularqueue_head(queue);
+        for (size_t j = queue->head; j != queue->tail; j++) {
+            if (j == queue->size) {
+                j = 0;
+                if (queue->tail == 0) {
+                    break;
+                }
+            }
+            minimum = queue->element[j] < minimum ? queue->element[j] : minimum;
+            maximum = queue->element[j] > maximum ? queue->element[j] : maximum;
+            sum += queue->element[j];
+        }
+        check += minimum + maximum + sum;
+    }
+
+    printf("%-8s time=%.3fs check=%ld\n", "rescan", bench_seconds() - start,
+           check);
+    circularqueue_delete(queue);
+}
+
+static void bench_window(const int *samples) {
+    window *window = window_create_count(LENGTH);
+    long check = 0;
+    double start = bench_seconds();
+
+    for (int i = 0; i < COUNT; i++) {
+        window_push(window, samples[i], 0);
+        check += window_min(window) + window_max(window) + window_sum(window);
+    }
+
+    printf("%-8s time=%.3fs check=%ld\n", "window", bench_seconds() - start,
+           check);
+    window_delete(window);
+}
+
+int main() {
+    int *samples = malloc(COUNT * sizeof(*samples));
+
+    srand(42);
+    for (int i = 0; i < COUNT; i++) {
+        samples[i] = rand() % 100000;
+    }
+
+    bench_rescan(samples);
+    bench_window(samples);
+
+    free(samples);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+#ifndef WOOFI_ADAPTIVELIST_H
+#define WOOFI_ADAPTIVELIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "woofi/arraylist.h"
+#include "woofi/capacity.h"
+
+/**
+ * Array list of ints stored in cells of the smallest signed width holding
+ * every value inserted so far: 1 byte, then 2, then 4. Inserting a value
+ * which does not fit widens the whole array once.
+ */
+typedef struct {
+    size_t length;
+    size_t count;
+    size_t width; /* bytes per cell */
+    void *cell;
+    capacity_policy policy;
+} adaptivelist;
+
+/**
+ * Create a new adaptive list, with 1 byte cells
+ * Must be free with adaptivelist_delete
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+adaptivelist *adaptivelist_create();
+
+/**
+ * Free all used memory by the list
+ * @param list a non null pointer to a list
+ */
+void adaptivelist_delete(adaptivelist *list);
+
+/**
+ * Create an adaptive list holding the values of a list, with the cell
+ * width of its widest value
+ * Must be free with adaptivelist_delete
+ * @param list a non null pointer to a list
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+adaptivelist *adaptivelist_from_arraylist(const arraylist *list);
+
+/**
+ * Create an array list holding the values of the list
+ * Must be free with arraylist_delete
+ * @param list a non null pointer to a list
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *adaptivelist_to_arraylist(const adaptivelist *list);
+
+/**
+ * Replace the capacity policy of the list
+ * @param list a non null pointer to a list
+ * @param policy the policy to copy, @see capacity_policy_valid
+ * @return 0 if the policy was changed
+ *        -1 on error, if the policy is invalid (errno is set to EINVAL)
+ */
+int adaptivelist_set_policy(adaptivelist *list, const capacity_policy *policy);
+
+/**
+ * Make sure the list can hold length elements of the current width
+ * without reallocating
+ * @param list a non null pointer to a list
+ * @param length the capacity to reserve
+ * @return 0 if the list can hold length elements
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int adaptivelist_reserve(adaptivelist *list, size_t length);
+
+/**
+ * Release the unused capacity of the list and narrow its cells to the
+ * widest value left
+ * @param list a non null pointer to a list
+ * @return 0 if the list was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int adaptivelist_shrink_to_fit(adaptivelist *list);
+
+/**
+ * Compute the memory used by the cells of the list
+ * @param list a non null pointer to a list
+ * @return the size in bytes
+ */
+size_t adaptivelist_size_in_bytes(const adaptivelist *list);
+
+/**
+ * Check if the list is empty
+ * @param list a non null pointer to a list
+ * @return 1 if the list is empty
+ *         0 otherwise
+ */
+int adaptivelist_is_empty(const adaptivelist *list);
+
+/**
+ * Insert a value at the begining of the list
+ * @param list a non null pointer to a list
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int adaptivelist_insert_front(adaptivelist *list, int value);
+
+/**
+ * Insert a value at the end of the list
+ * @param list a non null pointer to a list
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int adaptivelist_insert_last(adaptivelist *list, int value);
+
+/**
+ * Insert a value at index, or at the end if index is past it
+ * @param list a non null pointer to a list
+ * @param index the index of the new value
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int adaptivelist_insert_at(adaptivelist *list, size_t index, int value);
+
+/**
+ * Remove the first occurrence of a value
+ * @param list a non null pointer to a list
+ * @param value the value to remove
+ * @return 1 if the value was removed
+ *         0 if it was not in the list
+ */
+int adaptivelist_remove_value(adaptivelist *list, int value);
+
+/**
+ * Remove the value at index, or the last one if index is past it
+ * @param list a non null pointer to a list
+ * @param index the index of the value to remove
+ * @return 1 if a value was removed
+ *         0 if the list is empty
+ */
+int adaptivelist_remove_at(adaptivelist *list, size_t index);
+
+/**
+ * Check if the list contains the value, a value wider than the cells
+ * is rejected without scanning.
+ * @param list a non null pointer to a list
+ * @param value the value to search on the list
+ * @return 0 if the value is not in list
+ *         1 if the value is in list
+ */
+int adaptivelist_contains(const adaptivelist *list, int value);
+
+/**
+ * Get the value at specified index in the list.
+ * The index value MUST be valid (>= 0 AND < size)
+ * @param list a non null pointer to a list
+ * @param index the index of the requested element
+ * @return the value of requested element
+ */
+int adaptivelist_fast_get(const adaptivelist *list, size_t index);
+
+/**
+ * Get the value at specified index in the list.
+ * @param list a non null pointer to a list
+ * @param index the index of the requested element
+ * @param found a pointer to store the result of the search (if
+ *  the element was found)
+ * @return the value of requested element
+ */
+int adaptivelist_get(const adaptivelist *list, size_t index, int *found);
+
+/**
+ * Count the number of element in list and return it
+ * @param list a non null pointer to a list
+ * @return the number of elements on the list
+ */
+size_t adaptivelist_count(const adaptivelist *list);
+
+#endif
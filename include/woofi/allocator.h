@@ -0,0 +1,73 @@
+#ifndef WOOFI_ALLOCATOR_H
+#define WOOFI_ALLOCATOR_H
+
+#include <stddef.h>
+
+/*
+ * Allocation hooks of the containers. arraylist, stack, circularqueue and
+ * dynamicList get their headers, nodes and element buffers through them.
+ * Every call carries the size of the block, so an allocator may sort
+ * blocks by size class without a header in front of them.
+ */
+typedef struct {
+    /* Return a block of size bytes or NULL, setting errno */
+    void *(*allocate)(void *context, size_t size);
+    /*
+     * Resize a block of old_size bytes, it is left untouched on error.
+     * A block which could not be shrunk may be kept and given back later
+     * with the smaller size.
+     */
+    void *(*reallocate)(void *context, void *ptr, size_t old_size,
+                        size_t size);
+    /* Give back a block of size bytes, ptr may be NULL */
+    void (*release)(void *context, void *ptr, size_t size);
+    void *context;
+} allocator;
+
+/**
+ * Install the allocator used by the containers, libc's when NULL.
+ * It must be set before any container is created, or once they are all
+ * deleted, as blocks are given back to the allocator in use.
+ * @param hooks a pointer to the hooks, copied
+ */
+void allocator_set(const allocator *hooks);
+
+/**
+ * Get the allocator used by the containers
+ * @return a non null pointer to the hooks in use
+ */
+const allocator *allocator_get();
+
+/**
+ * Allocate a block through the hooks
+ * @param size the size of the block
+ * @return a pointer to the block or NULL on error (see errno)
+ */
+void *allocator_malloc(size_t size);
+
+/**
+ * Allocate a zeroed array through the hooks
+ * @param count the number of elements
+ * @param size the size of an element
+ * @return a pointer to the block or NULL on error (see errno)
+ */
+void *allocator_calloc(size_t count, size_t size);
+
+/**
+ * Resize a block through the hooks
+ * @param ptr the block, may be NULL
+ * @param old_size the size it was allocated with
+ * @param size the new size
+ * @return a pointer to the block or NULL on error (see errno), ptr is
+ *  then still valid
+ */
+void *allocator_realloc(void *ptr, size_t old_size, size_t size);
+
+/**
+ * Give back a block through the hooks
+ * @param ptr the block, may be NULL
+ * @param size the size it was allocated or last resized with
+ */
+void allocator_free(void *ptr, size_t size);
+
+#endif
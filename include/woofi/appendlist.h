@@ -0,0 +1,105 @@
+#ifndef WOOFI_APPENDLIST_H
+#define WOOFI_APPENDLIST_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "woofi/arraylist.h"
+
+/*
+ * Append only list of ints shared by concurrent producers. Slots are
+ * reserved with a single fetch_add and live in segments which never
+ * move: segment k holds APPENDLIST_FIRST << k slots and is allocated by
+ * the first producer reaching it.
+ */
+#define APPENDLIST_FIRST_BITS 6
+#define APPENDLIST_FIRST (1 << APPENDLIST_FIRST_BITS)
+#define APPENDLIST_SEGMENTS (64 - APPENDLIST_FIRST_BITS)
+
+typedef struct {
+    size_t reserved; /* slots handed out */
+    size_t written;  /* slots whose producer is done */
+    int *segment[APPENDLIST_SEGMENTS];
+} appendlist;
+
+/**
+ * Create a new empty list
+ * Must be free with appendlist_delete
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+appendlist *appendlist_create();
+
+/**
+ * Free all used memory by the list, no producer may still append
+ * @param list a non null pointer to a list
+ */
+void appendlist_delete(appendlist *list);
+
+/**
+ * Append a value, safe to call from any number of threads
+ * @param list a non null pointer to a list
+ * @param value the value to append
+ * @return the index of the value
+ *        -1 on error, if it failed to allocate a segment (see errno),
+ *           the slot then reads as 0
+ */
+ssize_t appendlist_insert_last(appendlist *list, int value);
+
+/**
+ * Append count values in consecutive slots reserved at once, safe to
+ * call from any number of threads
+ * @param list a non null pointer to a list
+ * @param values the values to append
+ * @param count the number of values
+ * @return the index of the first value
+ *        -1 on error, if it failed to allocate a segment (see errno),
+ *           the slots then read as 0
+ */
+ssize_t appendlist_insert_range(appendlist *list, const int *values,
+                                size_t count);
+
+/**
+ * Count the slots handed out, some may still be written by their
+ * producer and read as 0
+ * @param list a non null pointer to a list
+ * @return the number of elements on the list
+ */
+size_t appendlist_count(const appendlist *list);
+
+/**
+ * Count the slots whose producer returned. Once it equals
+ * appendlist_count, every value is visible to the caller.
+ * @param list a non null pointer to a list
+ * @return the number of written slots
+ */
+size_t appendlist_written(const appendlist *list);
+
+/**
+ * Get the value at specified index in the list, without locking.
+ * The index MUST have been written, @see appendlist_written
+ * @param list a non null pointer to a list
+ * @param index the index of the requested element
+ * @return the value of requested element, 0 if its segment failed to
+ *  allocate
+ */
+int appendlist_fast_get(const appendlist *list, size_t index);
+
+/**
+ * Get the value at specified index in the list, without locking.
+ * @param list a non null pointer to a list
+ * @param index the index of the requested element
+ * @param found a pointer to store the result of the search (if
+ *  the element was found)
+ * @return the value of requested element, 0 if it is not written yet
+ */
+int appendlist_get(const appendlist *list, size_t index, int *found);
+
+/**
+ * Create an array list of the values of the list
+ * Must be free with arraylist_delete
+ * @param list a non null pointer to a list
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *appendlist_to_arraylist(const appendlist *list);
+
+#endif
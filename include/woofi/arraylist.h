@@ -1,3 +1,8 @@
+#ifndef WOOFI_ARRAYLIST_H
+#define WOOFI_ARRAYLIST_H
+
+#include "woofi/capacity.h"
+#include "woofi/textio.h"
 
 #define INITIALI_ARRAYLIST_SIZE 100
 
@@ -5,6 +10,8 @@ typedef struct {
     size_t length;
     size_t count;
     int *element;
+    struct mappedlist *mapping;
+    capacity_policy policy;
 } arraylist;
 
 /**
@@ -20,6 +27,33 @@ arraylist *arraylist_create();
  */
 void arraylist_delete(arraylist *list);
 
+/**
+ * Change how the list grows and shrinks.
+ * Lists are created with CAPACITY_POLICY_DEFAULT
+ * @param list a non null pointer to a list
+ * @param policy a non null pointer to the policy to copy
+ * @return 0 if the policy was changed
+ *        -1 if the policy is not valid (errno is set to EINVAL)
+ */
+int arraylist_set_policy(arraylist *list, const capacity_policy *policy);
+
+/**
+ * Make sure the list can hold at least length elements without growing
+ * @param list a non null pointer to a list
+ * @param length the number of elements to hold
+ * @return 0 if the list is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int arraylist_reserve(arraylist *list, size_t length);
+
+/**
+ * Release the memory not used by the elements of the list
+ * @param list a non null pointer to a list
+ * @return 0 if the list was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int arraylist_shrink_to_fit(arraylist *list);
+
 /**
  * Check if the list is empty or not
  * @param list a non null pointer to a list
@@ -34,6 +68,37 @@ int arraylist_is_empty(const arraylist *list);
  */
 void arraylist_print(const arraylist *list);
 
+/**
+ * Write the list to a file descriptor, by chunks of TEXTIO_BUFFER_SIZE
+ * @param list a non null pointer to a list
+ * @param fd the file descriptor to write to
+ * @param format the output format
+ * @return 0 if the list was written
+ *        -1 on error (see errno)
+ */
+int arraylist_write(const arraylist *list, int fd, textio_format format);
+
+/**
+ * Write the list to a stdio stream, by chunks of TEXTIO_BUFFER_SIZE
+ * @param list a non null pointer to a list
+ * @param file a non null pointer to the stream to write to
+ * @param format the output format
+ * @return 0 if the list was written
+ *        -1 on error (see errno)
+ */
+int arraylist_fwrite(const arraylist *list, FILE *file, textio_format format);
+
+/**
+ * Append every integer read from a file descriptor until end of file,
+ * in any format written by arraylist_write
+ * @param list a non null pointer to a list
+ * @param fd the file descriptor to read from
+ * @return the number of values appended
+ *        -1 on error (see errno), values parsed before the error may
+ *        already be in the list
+ */
+ssize_t arraylist_read_ints(arraylist *list, int fd);
+
 /**
  * Insert element at the start of the list
  * @param list a non null pointer to a list
@@ -115,3 +180,4 @@ int arraylist_get(const arraylist *list, size_t index, int *found);
  */
 int arraylist_count(const arraylist *list);
 
+#endif
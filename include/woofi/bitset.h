@@ -0,0 +1,167 @@
+#ifndef WOOFI_BITSET_H
+#define WOOFI_BITSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "woofi/arraylist.h"
+
+/* Returned by bitset_next_set when no bit is set */
+#define BITSET_NONE ((size_t)-1)
+
+/**
+ * Set of non negative integers, one bit each, stored in 64 bit words.
+ * Bits past the last word are clear; setting one grows the set.
+ */
+typedef struct {
+    size_t size;
+    uint64_t *word;
+} bitset;
+
+typedef enum {
+    BITSET_AND,
+    BITSET_OR,
+    BITSET_XOR,
+    BITSET_ANDNOT
+} bitset_op;
+
+/**
+ * Combine count words of a and b into dst and count the bits set in the
+ * result. Uses AVX2 when the processor has it.
+ * Shared by the containers built on bitmaps.
+ * @param dst where to store the result, can be a or b, NULL to only count
+ * @param a the left operands
+ * @param b the right operands
+ * @param count the number of words
+ * @param op the operation, BITSET_ANDNOT being a & ~b
+ * @return the number of bits set in the result
+ */
+size_t bitset_words_op(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+                       size_t count, bitset_op op);
+
+/**
+ * Count the bits set in count words. Uses AVX2 when the processor has it.
+ * @param word the words
+ * @param count the number of words
+ * @return the number of bits set
+ */
+size_t bitset_words_popcount(const uint64_t *word, size_t count);
+
+/**
+ * Create a new empty bitset
+ * Must be free with bitset_delete
+ * @param bits the number of bits to allocate upfront
+ * @return A pointer to an allocated bitset or NULL on error (see errno)
+ */
+bitset *bitset_create(size_t bits);
+
+/**
+ * Free all used memory by the bitset
+ * @param bitset a non null pointer to a bitset
+ */
+void bitset_delete(bitset *bitset);
+
+/**
+ * Make sure bits below bits can be set without growing
+ * @param bitset a non null pointer to a bitset
+ * @param bits the number of bits
+ * @return 0 if the bitset is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int bitset_reserve(bitset *bitset, size_t bits);
+
+/**
+ * Release the trailing words without any bit set
+ * @param bitset a non null pointer to a bitset
+ * @return 0 if the bitset was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int bitset_shrink_to_fit(bitset *bitset);
+
+/**
+ * Set a bit, growing the bitset if needed
+ * @param bitset a non null pointer to a bitset
+ * @param index the bit to set
+ * @return 0 if the bit was set
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int bitset_set(bitset *bitset, size_t index);
+
+/**
+ * Clear a bit
+ * @param bitset a non null pointer to a bitset
+ * @param index the bit to clear
+ */
+void bitset_clear(bitset *bitset, size_t index);
+
+/**
+ * Check a bit
+ * @param bitset a non null pointer to a bitset
+ * @param index the bit to check
+ * @return 1 if the bit is set
+ *         0 otherwise
+ */
+int bitset_test(const bitset *bitset, size_t index);
+
+/**
+ * Count the bits set
+ * @param bitset a non null pointer to a bitset
+ * @return the number of bits set
+ */
+size_t bitset_count(const bitset *bitset);
+
+/**
+ * Count the bits set below index
+ * @param bitset a non null pointer to a bitset
+ * @param index the first bit not counted
+ * @return the number of bits set in [0, index)
+ */
+size_t bitset_rank(const bitset *bitset, size_t index);
+
+/**
+ * Find the first bit set from index
+ * @param bitset a non null pointer to a bitset
+ * @param index the first bit to check
+ * @return the index of the bit or BITSET_NONE
+ */
+size_t bitset_next_set(const bitset *bitset, size_t index);
+
+/**
+ * Replace dst by dst op src, in place
+ * @param dst a non null pointer to the bitset to change
+ * @param src a non null pointer to the other operand
+ * @param op the operation, BITSET_ANDNOT removing the bits of src
+ * @return the number of bits set in dst
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+ssize_t bitset_combine(bitset *dst, const bitset *src, bitset_op op);
+
+/**
+ * Count the bits set in a op b without computing it
+ * @param a a non null pointer to the left operand
+ * @param b a non null pointer to the right operand
+ * @param op the operation
+ * @return the number of bits set in a op b
+ */
+size_t bitset_combine_count(const bitset *a, const bitset *b, bitset_op op);
+
+/**
+ * Create a bitset with the bits of the values of a list set
+ * Must be free with bitset_delete
+ * @param list a non null pointer to a list of non negative values
+ * @return A pointer to an allocated bitset or NULL on error, if a value
+ *         is negative (errno is set to EINVAL) or it failed to allocate
+ *         requested memory (see errno)
+ */
+bitset *bitset_from_arraylist(const arraylist *list);
+
+/**
+ * Create a list of the bits set, in ascending order
+ * Must be free with arraylist_delete
+ * @param bitset a non null pointer to a bitset without bits above INT_MAX
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *bitset_to_arraylist(const bitset *bitset);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef WOOFI_CAPACITY_H
+#define WOOFI_CAPACITY_H
+
+#include <stddef.h>
+
+/**
+ * How a container resizes its storage.
+ * Automatic shrinking only happens once the occupancy falls under
+ * shrink_below percent and leaves the container shrink_to percent full,
+ * so a container oscillating around a size does not resize on every
+ * insert and remove.
+ */
+typedef struct {
+    unsigned int growth;       /* capacity after growing, in percent of the
+                                * old capacity, above 100 */
+    unsigned int shrink_below; /* occupancy in percent under which the
+                                * container shrinks, 0 to never shrink */
+    unsigned int shrink_to;    /* occupancy in percent after shrinking,
+                                * above shrink_below and up to 100 */
+    size_t minimum;            /* capacity under which it never shrinks */
+} capacity_policy;
+
+/* Grow by 1.5x and never shrink */
+#define CAPACITY_POLICY_DEFAULT { 150, 0, 0, 0 }
+
+/* Grow by 2x, shrink to half full when under a quarter full */
+#define CAPACITY_POLICY_SHRINK { 200, 25, 50, 100 }
+
+/**
+ * Check that the values of a policy make sense
+ * @param policy a non null pointer to a policy
+ * @return 1 if the policy can be used
+ *         0 otherwise
+ */
+int capacity_policy_valid(const capacity_policy *policy);
+
+/**
+ * Compute the capacity of a container that must grow
+ * @param policy a non null pointer to a policy
+ * @param length the current capacity
+ * @param needed the minimum capacity needed
+ * @return the new capacity, at least needed and above length
+ */
+size_t capacity_grow(const capacity_policy *policy, size_t length,
+                     size_t needed);
+
+/**
+ * Compute the capacity of a container after it lost elements
+ * @param policy a non null pointer to a policy
+ * @param length the current capacity
+ * @param needed the capacity needed to hold the elements left
+ * @return the new capacity, length if the container should not shrink
+ */
+size_t capacity_shrink(const capacity_policy *policy, size_t length,
+                       size_t needed);
+
+#endif
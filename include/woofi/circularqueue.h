@@ -1,3 +1,8 @@
+#ifndef WOOFI_CIRCULARQUEUE_H
+#define WOOFI_CIRCULARQUEUE_H
+
+#include "woofi/capacity.h"
+#include "woofi/textio.h"
 
 typedef struct {
     int *element;
@@ -5,6 +10,7 @@ typedef struct {
     size_t tail;
     size_t size;
     size_t requested_size;
+    capacity_policy policy;
 } circularqueue;
 
 /**
@@ -20,6 +26,35 @@ circularqueue *circularqueue_create(size_t size);
  */
 void circularqueue_delete(circularqueue *queue);
 
+/**
+ * Change how the queue grows and shrinks.
+ * Only queues created with a size of 0 grow or shrink automatically.
+ * Queues are created with CAPACITY_POLICY_DEFAULT
+ * @param queue a non null pointer to a queue
+ * @param policy a non null pointer to the policy to copy
+ * @return 0 if the policy was changed
+ *        -1 if the policy is not valid (errno is set to EINVAL)
+ */
+int circularqueue_set_policy(circularqueue *queue,
+                             const capacity_policy *policy);
+
+/**
+ * Make sure the queue can hold at least count elements without growing
+ * @param queue a non null pointer to a queue
+ * @param count the number of elements to hold
+ * @return 0 if the queue is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int circularqueue_reserve(circularqueue *queue, size_t count);
+
+/**
+ * Release the memory not used by the elements of the queue
+ * @param queue a non null pointer to a queue
+ * @return 0 if the queue was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int circularqueue_shrink_to_fit(circularqueue *queue);
+
 /**
  * Check if the queue is empty or not
  * @param queue a non null pointer to a queue
@@ -34,6 +69,30 @@ int circularqueue_is_empty(const circularqueue *queue);
  */
 void circularqueue_print(const circularqueue *queue);
 
+/**
+ * Write the queue to a file descriptor, from head to tail, by chunks of
+ * TEXTIO_BUFFER_SIZE
+ * @param queue a non null pointer to a queue
+ * @param fd the file descriptor to write to
+ * @param format the output format
+ * @return 0 if the queue was written
+ *        -1 on error (see errno)
+ */
+int circularqueue_write(const circularqueue *queue, int fd,
+                        textio_format format);
+
+/**
+ * Write the queue to a stdio stream, from head to tail, by chunks of
+ * TEXTIO_BUFFER_SIZE
+ * @param queue a non null pointer to a queue
+ * @param file a non null pointer to the stream to write to
+ * @param format the output format
+ * @return 0 if the queue was written
+ *        -1 on error (see errno)
+ */
+int circularqueue_fwrite(const circularqueue *queue, FILE *file,
+                         textio_format format);
+
 /**
  * Insert element at the end of the queue
  * @param queue a non null pointer to a queue
@@ -65,3 +124,5 @@ size_t circularqueue_count(const circularqueue *queue);
  * @return the head of the file
  */
 int circularqueue_head(const circularqueue *queue);
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef WOOFI_DISRUPTOR_H
+#define WOOFI_DISRUPTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Multicast ring of ints in the style of the LMAX disruptor: one writer
+ * and any number of consumers which all see every value, in place.
+ * Positions are free running sequences. The writer publishes a cursor;
+ * each consumer publishes how far it read and reads up to its barrier,
+ * the cursor or the slowest of the consumers it depends on, so stages
+ * of a pipeline work on the same slots without copying. The writer
+ * never laps the slowest consumer.
+ * Waits spin, then yield the processor.
+ * Programs using it must be linked with -lpthread.
+ */
+#define DISRUPTOR_CACHE_LINE 64
+/* Checks of a barrier before yielding the processor */
+#define DISRUPTOR_SPINS 100
+
+struct disruptor;
+
+/**
+ * A consumer, its sequence is alone on its cache line
+ */
+typedef struct disruptor_consumer {
+    uint64_t sequence; /* values read and released */
+    uint64_t cached_barrier;
+    struct disruptor *ring;
+    struct disruptor_consumer **dependency;
+    size_t dependencies;
+} __attribute__((aligned(DISRUPTOR_CACHE_LINE))) disruptor_consumer;
+
+typedef struct disruptor {
+    uint64_t cursor __attribute__((aligned(DISRUPTOR_CACHE_LINE)));
+    int closed;
+
+    /* Only used by the writer */
+    uint64_t claimed __attribute__((aligned(DISRUPTOR_CACHE_LINE)));
+    uint64_t cached_gate;
+    int *element;
+    size_t size;
+    size_t mask;
+    disruptor_consumer **consumer;
+    size_t consumers;
+} disruptor;
+
+/**
+ * Create a new empty ring
+ * Must be free with disruptor_delete
+ * @param size the number of slots, rounded up to a power of two
+ * @return A pointer to an allocated ring or NULL on error (see errno)
+ */
+disruptor *disruptor_create(size_t size);
+
+/**
+ * Free the ring and its consumers, no thread may use them anymore
+ * @param ring a non null pointer to a ring
+ */
+void disruptor_delete(disruptor *ring);
+
+/**
+ * Add a consumer, before the writer publishes. It reads a slot once
+ * every dependency released it, or once it is published without any.
+ * @param ring a non null pointer to a ring
+ * @param dependency the consumers of an earlier stage, may be NULL
+ * @param dependencies the number of dependencies
+ * @return A pointer to a consumer or NULL on error (see errno)
+ */
+disruptor_consumer *disruptor_add_consumer(disruptor *ring,
+                                           disruptor_consumer *const *dependency,
+                                           size_t dependencies);
+
+/**
+ * Get the slot of a sequence, to write a claimed slot or read an
+ * available one
+ * @param ring a non null pointer to a ring
+ * @param sequence the sequence
+ * @return a pointer to the slot
+ */
+int *disruptor_slot(const disruptor *ring, uint64_t sequence);
+
+/**
+ * Claim up to count free slots, from the writer
+ * @param ring a non null pointer to a ring
+ * @param count the number of slots wanted
+ * @param first a pointer to store the sequence of the first slot
+ * @return the number of slots claimed, 0 if every consumer lags a full
+ *  ring behind
+ */
+size_t disruptor_try_claim(disruptor *ring, size_t count, uint64_t *first);
+
+/**
+ * Claim count free slots, waiting for the slowest consumer
+ * @param ring a non null pointer to a ring
+ * @param count the number of slots, at most the size of the ring
+ * @return the sequence of the first slot
+ */
+uint64_t disruptor_claim(disruptor *ring, size_t count);
+
+/**
+ * Make every claimed slot visible to the consumers
+ * @param ring a non null pointer to a ring
+ */
+void disruptor_publish(disruptor *ring);
+
+/**
+ * Claim, write and publish values, waiting for free slots
+ * @param ring a non null pointer to a ring
+ * @param values the values to write
+ * @param count the number of values
+ */
+void disruptor_publish_range(disruptor *ring, const int *values,
+                             size_t count);
+
+/**
+ * Tell the consumers nothing more will be published, from the writer
+ * @param ring a non null pointer to a ring
+ */
+void disruptor_close(disruptor *ring);
+
+/**
+ * Count the slots the consumer can read from its sequence, without
+ * waiting
+ * @param consumer a non null pointer to a consumer
+ * @param first a pointer to store the sequence of the first slot
+ * @return the number of readable slots
+ */
+size_t disruptor_available(disruptor_consumer *consumer, uint64_t *first);
+
+/**
+ * Wait until the consumer can read a slot
+ * @param consumer a non null pointer to a consumer
+ * @param first a pointer to store the sequence of the first slot
+ * @return the number of readable slots, 0 once the ring is closed and
+ *  every slot read
+ */
+size_t disruptor_wait(disruptor_consumer *consumer, uint64_t *first);
+
+/**
+ * Hand read slots to the dependent consumers and the writer
+ * @param consumer a non null pointer to a consumer
+ * @param count the number of slots read, at most the available ones
+ */
+void disruptor_release(disruptor_consumer *consumer, size_t count);
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef WOOFI_EPOCH_H
+#define WOOFI_EPOCH_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Epoch based reclamation. Readers pin the global epoch while they hold
+ * pointers to shared objects; writers retire the objects they unlinked,
+ * which are freed once the epoch moved twice past their retirement, as
+ * no reader can still see them then.
+ * Programs using it must be linked with -lpthread.
+ */
+#define EPOCH_CACHE_LINE 64
+/* Objects deferred together, freed in one go */
+#define EPOCH_BAG_SIZE 64
+
+/* Called to free a retired object */
+typedef void (*epoch_free_fn)(void *ptr);
+
+typedef struct {
+    void *ptr;
+    epoch_free_fn fn;
+} epoch_deferred;
+
+/**
+ * Batch of retired objects, tagged with the epoch it was sealed in
+ */
+typedef struct epoch_bag {
+    uint64_t epoch;
+    size_t count;
+    struct epoch_bag *next;
+    epoch_deferred item[EPOCH_BAG_SIZE];
+} epoch_bag;
+
+/**
+ * Per thread state, alone on its cache line so pinning only writes to
+ * memory owned by the reader
+ */
+typedef struct epoch_record {
+    uint64_t state;  /* pinned epoch * 2 + 1, 0 when not pinned */
+    size_t depth;    /* nested epoch_enter, only used by the owner */
+    epoch_bag *bag;  /* objects deferred by the owner, not sealed yet */
+    int used;
+    struct epoch_record *next;
+} __attribute__((aligned(EPOCH_CACHE_LINE))) epoch_record;
+
+typedef struct {
+    uint64_t epoch;
+    pthread_mutex_t lock;
+    epoch_record *records;
+    epoch_bag *shared;  /* objects retired without a record */
+    epoch_bag *sealed;
+    size_t pending;     /* objects in sealed bags */
+} epoch_domain;
+
+/**
+ * Create a new reclamation domain
+ * Must be free with epoch_delete
+ * @return A pointer to an allocated domain or NULL on error (see errno)
+ */
+epoch_domain *epoch_create();
+
+/**
+ * Free the domain and every object still retired.
+ * No thread may be pinned anymore.
+ * @param domain a non null pointer to a domain
+ */
+void epoch_delete(epoch_domain *domain);
+
+/**
+ * Get a record for the calling thread, reusing an unregistered one
+ * @param domain a non null pointer to a domain
+ * @return A pointer to a record or NULL on error (see errno)
+ */
+epoch_record *epoch_register(epoch_domain *domain);
+
+/**
+ * Give a record back, it must not be pinned. Its deferred objects are
+ * handed to the domain.
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to a record of the domain
+ */
+void epoch_unregister(epoch_domain *domain, epoch_record *record);
+
+/**
+ * Pin the current epoch. Calls can be nested.
+ * Only stores to the record, no shared cache line is written.
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to the record of the calling thread
+ */
+void epoch_enter(epoch_domain *domain, epoch_record *record);
+
+/**
+ * Unpin the epoch once every epoch_enter is matched
+ * @param record a non null pointer to the record of the calling thread
+ */
+void epoch_exit(epoch_record *record);
+
+/**
+ * Hand an unlinked object to the domain, fn(ptr) is called once no
+ * reader can still see it. Takes the domain lock, see epoch_defer.
+ * @param domain a non null pointer to a domain
+ * @param ptr the object to free
+ * @param fn the function freeing it
+ * @return 0 if the object was retired
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int epoch_retire(epoch_domain *domain, void *ptr, epoch_free_fn fn);
+
+/**
+ * Defer freeing an unlinked object without taking the domain lock: the
+ * object goes to the bag of the record, which is sealed and handed to
+ * the domain once full, reclaiming at the same time.
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to the record of the calling thread
+ * @param ptr the object to free
+ * @param fn the function freeing it
+ * @return 0 if the object was deferred
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int epoch_defer(epoch_domain *domain, epoch_record *record, void *ptr,
+                epoch_free_fn fn);
+
+/**
+ * Hand the objects deferred by a record to the domain without waiting
+ * for its bag to fill
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to the record of the calling thread
+ */
+void epoch_flush(epoch_domain *domain, epoch_record *record);
+
+/**
+ * Move the epoch forward if every pinned reader saw the current one, and
+ * free the objects retired two epochs ago or earlier. Never waits.
+ * @param domain a non null pointer to a domain
+ * @return the number of freed objects
+ */
+size_t epoch_reclaim(epoch_domain *domain);
+
+/**
+ * Wait until every object retired before the call is freed, objects
+ * deferred in the bag of a record must be flushed first
+ * The calling thread must not be pinned.
+ * @param domain a non null pointer to a domain
+ */
+void epoch_synchronize(epoch_domain *domain);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef WOOFI_EVENTQUEUE_H
+#define WOOFI_EVENTQUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "woofi/circularqueue.h"
+
+/*
+ * Queue of ints shared by threads whose consumer sleeps in an event loop.
+ * The queue exposes an eventfd which is readable exactly while the queue
+ * holds values: only the push finding the queue empty writes to it, so a
+ * burst of pushes costs one wakeup, and the drain emptying the queue
+ * clears it.
+ * Linux only. Programs using it must be linked with -lpthread.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    circularqueue *queue;
+    int fd;
+    int signaled;   /* the eventfd is readable */
+    size_t signals; /* writes to the eventfd */
+} eventqueue;
+
+/**
+ * Create a new empty queue and its eventfd
+ * Must be free with eventqueue_delete
+ * @return A pointer to an allocated queue or NULL on error (see errno)
+ */
+eventqueue *eventqueue_create();
+
+/**
+ * Close the eventfd and free all used memory by the queue
+ * @param queue a non null pointer to a queue
+ */
+void eventqueue_delete(eventqueue *queue);
+
+/**
+ * Get the file descriptor to poll, readable while the queue holds values.
+ * It must only be read through eventqueue_drain.
+ * @param queue a non null pointer to a queue
+ * @return the file descriptor
+ */
+int eventqueue_fd(const eventqueue *queue);
+
+/**
+ * Insert a value at the tail of the queue, from any thread
+ * @param queue a non null pointer to a queue
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int eventqueue_push(eventqueue *queue, int value);
+
+/**
+ * Insert values at the tail of the queue under a single lock, from any
+ * thread
+ * @param queue a non null pointer to a queue
+ * @param values the values to insert
+ * @param count the number of values
+ * @return the number of values inserted, less than count on error (see
+ *  errno)
+ */
+size_t eventqueue_push_range(eventqueue *queue, const int *values,
+                             size_t count);
+
+/**
+ * Remove up to count values from the head of the queue under a single
+ * lock. The eventfd is cleared once the queue is empty.
+ * @param queue a non null pointer to a queue
+ * @param values a buffer of count values
+ * @param count the maximum number of values to remove
+ * @return the number of values removed
+ */
+size_t eventqueue_drain(eventqueue *queue, int *values, size_t count);
+
+/**
+ * Wait until the queue holds values, for callers without an event loop
+ * @param queue a non null pointer to a queue
+ * @param timeout the maximum time to wait in milliseconds, forever if
+ *  negative
+ * @return 1 if the queue holds values
+ *         0 if the timeout expired
+ *        -1 on error (see errno)
+ */
+int eventqueue_wait(eventqueue *queue, int timeout);
+
+/**
+ * Count the values in the queue
+ * @param queue a non null pointer to a queue
+ * @return the number of values in the queue
+ */
+size_t eventqueue_count(eventqueue *queue);
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef WOOFI_HAZARD_H
+#define WOOFI_HAZARD_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "woofi/epoch.h"
+
+/*
+ * Hazard pointers. A reader publishes each shared pointer it is about to
+ * use in one of the slots of its record; a retired object is freed by
+ * its retiring thread once it is in no slot. Unlike epochs, a stalled
+ * reader only holds back the objects it protects.
+ * Programs using it must be linked with -lpthread.
+ */
+#define HAZARD_SLOTS 4
+/* Objects retired by a thread before it scans the slots */
+#define HAZARD_SCAN_THRESHOLD 64
+
+/**
+ * Per thread state, the slots are alone on their cache line
+ */
+typedef struct hazard_record {
+    void *slot[HAZARD_SLOTS];
+    epoch_deferred *retired; /* only used by the owner */
+    size_t count;
+    size_t size;
+    int used;
+    struct hazard_record *next;
+} __attribute__((aligned(EPOCH_CACHE_LINE))) hazard_record;
+
+typedef struct {
+    pthread_mutex_t lock;
+    hazard_record *records;
+    size_t records_count;
+} hazard_domain;
+
+/**
+ * Create a new hazard pointer domain
+ * Must be free with hazard_delete
+ * @return A pointer to an allocated domain or NULL on error (see errno)
+ */
+hazard_domain *hazard_create();
+
+/**
+ * Free the domain and every object still retired.
+ * No thread may protect a pointer anymore.
+ * @param domain a non null pointer to a domain
+ */
+void hazard_delete(hazard_domain *domain);
+
+/**
+ * Get a record for the calling thread, reusing an unregistered one
+ * @param domain a non null pointer to a domain
+ * @return A pointer to a record or NULL on error (see errno)
+ */
+hazard_record *hazard_register(hazard_domain *domain);
+
+/**
+ * Clear the slots of a record and give it back. Objects it retired and
+ * which are still protected stay with the record until it is reused or
+ * the domain deleted.
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to a record of the domain
+ */
+void hazard_unregister(hazard_domain *domain, hazard_record *record);
+
+/**
+ * Load a shared pointer and publish it in a slot, until the pointer is
+ * known to have been still shared once published
+ * @param record a non null pointer to the record of the calling thread
+ * @param slot the slot to use, below HAZARD_SLOTS
+ * @param source the shared pointer
+ * @return the protected pointer, usable until the slot is cleared
+ */
+void *hazard_protect(hazard_record *record, size_t slot, void *const *source);
+
+/**
+ * Stop protecting the pointer of a slot
+ * @param record a non null pointer to the record of the calling thread
+ * @param slot the slot to clear
+ */
+void hazard_clear(hazard_record *record, size_t slot);
+
+/**
+ * Hand an unlinked object to the record, fn(ptr) is called once no slot
+ * holds it. Slots are scanned every HAZARD_SCAN_THRESHOLD retirements.
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to the record of the calling thread
+ * @param ptr the object to free
+ * @param fn the function freeing it
+ * @return 0 if the object was retired
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int hazard_retire(hazard_domain *domain, hazard_record *record, void *ptr,
+                  epoch_free_fn fn);
+
+/**
+ * Free the objects retired by a record which no slot holds
+ * @param domain a non null pointer to a domain
+ * @param record a non null pointer to the record of the calling thread
+ * @return the number of freed objects
+ */
+size_t hazard_scan(hazard_domain *domain, hazard_record *record);
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef WOOFI_HEAP_H
+#define WOOFI_HEAP_H
+
+#include <stddef.h>
+
+#include "woofi/capacity.h"
+
+#define INITIAL_HEAP_SIZE 100
+#define HEAP_DEFAULT_ARITY 4
+
+/* Position of an id which is not in the heap */
+#define HEAP_NO_POSITION ((size_t)-1)
+
+/**
+ * Min-heap of ints stored as an implicit d-ary tree: the children of the
+ * element at i are at arity * i + 1 to arity * i + arity. Children are
+ * contiguous, so a level of a sift down reads at most two cache lines, and
+ * a 4-ary heap is half as deep as a binary one.
+ *
+ * An indexed heap also tags every element with an id below ids, so the
+ * value of an id can be decreased in O(log n) through position.
+ */
+typedef struct {
+    size_t size;
+    size_t count;
+    unsigned int arity;
+    int *element;
+    size_t ids;
+    size_t *id;       /* id of the element at each position */
+    size_t *position; /* position of each id or HEAP_NO_POSITION */
+    capacity_policy policy;
+} heap;
+
+/**
+ * Create a new empty heap
+ * Must be free with heap_delete
+ * @param arity the number of children of a node, 0 for HEAP_DEFAULT_ARITY
+ * @return A pointer to an allocated heap or NULL on error (see errno)
+ */
+heap *heap_create(unsigned int arity);
+
+/**
+ * Create a new empty indexed heap, see heap_push_id
+ * Must be free with heap_delete
+ * @param arity the number of children of a node, 0 for HEAP_DEFAULT_ARITY
+ * @param ids the number of ids, ids are in [0, ids)
+ * @return A pointer to an allocated heap or NULL on error (see errno)
+ */
+heap *heap_create_indexed(unsigned int arity, size_t ids);
+
+/**
+ * Free all used memory by the heap
+ * @param heap a non null pointer to a heap
+ */
+void heap_delete(heap *heap);
+
+/**
+ * Change how the heap grows and shrinks.
+ * Heaps are created with CAPACITY_POLICY_DEFAULT
+ * @param heap a non null pointer to a heap
+ * @param policy a non null pointer to the policy to copy
+ * @return 0 if the policy was changed
+ *        -1 if the policy is not valid (errno is set to EINVAL)
+ */
+int heap_set_policy(heap *heap, const capacity_policy *policy);
+
+/**
+ * Make sure the heap can hold at least size elements without growing
+ * @param heap a non null pointer to a heap
+ * @param size the number of elements to hold
+ * @return 0 if the heap is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int heap_reserve(heap *heap, size_t size);
+
+/**
+ * Release the memory not used by the elements of the heap
+ * @param heap a non null pointer to a heap
+ * @return 0 if the heap was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int heap_shrink_to_fit(heap *heap);
+
+/**
+ * Check if the heap is empty or not
+ * @param heap a non null pointer to a heap
+ * @return 0 if the heap is not empty
+ *         1 if it's empty
+ */
+int heap_is_empty(const heap *heap);
+
+/**
+ * Count the number of elements in the heap
+ * @param heap a non null pointer to a heap
+ * @return the number of elements in the heap
+ */
+size_t heap_count(const heap *heap);
+
+/**
+ * Replace the content of a heap which is not indexed by values, in O(n)
+ * @param heap a non null pointer to a heap
+ * @param values the values to put in the heap
+ * @param count the number of values
+ * @return 0 if the heap was built
+ *        -1 on error, if it failed to allocate requested memory or the
+ *           heap is indexed (see errno)
+ */
+int heap_heapify(heap *heap, const int *values, size_t count);
+
+/**
+ * Insert a value in a heap which is not indexed
+ * @param heap a non null pointer to a heap
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if it failed to allocate requested memory or the
+ *           heap is indexed (see errno)
+ */
+int heap_push(heap *heap, int value);
+
+/**
+ * Return the smallest value of a non empty heap
+ * @param heap a non null pointer to a heap
+ * @return the smallest value
+ */
+int heap_peek(const heap *heap);
+
+/**
+ * Remove the smallest value of the heap
+ * @param heap a non null pointer to a heap
+ * @param value where to store the removed value, can be NULL
+ * @return 1 if a value was removed
+ *         0 if the heap is empty
+ */
+int heap_pop(heap *heap, int *value);
+
+/**
+ * Insert a value tagged with an id in an indexed heap
+ * @param heap a non null pointer to an indexed heap
+ * @param id the id of the value, not in the heap yet
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 on error, if the id is not valid (errno is set to EINVAL) or
+ *           it failed to allocate requested memory (see errno)
+ */
+int heap_push_id(heap *heap, size_t id, int value);
+
+/**
+ * Check if an id is in an indexed heap
+ * @param heap a non null pointer to an indexed heap
+ * @param id the id to look for
+ * @return 1 if the id is in the heap
+ *         0 otherwise
+ */
+int heap_contains_id(const heap *heap, size_t id);
+
+/**
+ * Lower the value of an id in an indexed heap
+ * @param heap a non null pointer to an indexed heap
+ * @param id the id of the value, in the heap
+ * @param value the new value, not above the current one
+ * @return 0 if the value was changed
+ *        -1 if the id is not in the heap or the value is greater than the
+ *           current one (errno is set to EINVAL)
+ */
+int heap_decrease_key(heap *heap, size_t id, int value);
+
+/**
+ * Remove the smallest value of an indexed heap
+ * @param heap a non null pointer to an indexed heap
+ * @param id where to store the id of the removed value, can be NULL
+ * @param value where to store the removed value, can be NULL
+ * @return 1 if a value was removed
+ *         0 if the heap is empty
+ */
+int heap_pop_id(heap *heap, size_t *id, int *value);
+
+#endif
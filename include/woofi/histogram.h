@@ -0,0 +1,136 @@
+#ifndef WOOFI_HISTOGRAM_H
+#define WOOFI_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Values are bucketed by power of two, each power being split in
+ * 2^HISTOGRAM_SUB_BUCKET_BITS linear sub-buckets. A recorded value is
+ * therefore reported with a relative error of at most 1 / 2^BITS (~3%).
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKET_COUNT \
+    ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKET_COUNT)
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t bucket[HISTOGRAM_BUCKET_COUNT];
+} histogram;
+
+/**
+ * Container operations that can be timed when the library is built
+ * with WITH_HISTOGRAM
+ */
+typedef enum {
+    HISTOGRAM_ARRAYLIST_INSERT_FRONT,
+    HISTOGRAM_ARRAYLIST_INSERT_LAST,
+    HISTOGRAM_ARRAYLIST_INSERT_AT,
+    HISTOGRAM_ARRAYLIST_REMOVE_VALUE,
+    HISTOGRAM_ARRAYLIST_REMOVE_AT,
+    HISTOGRAM_CIRCULARQUEUE_INSERT,
+    HISTOGRAM_CIRCULARQUEUE_REMOVE,
+    HISTOGRAM_STACK_INSERT,
+    HISTOGRAM_STACK_REMOVE,
+    HISTOGRAM_HEAP_PUSH,
+    HISTOGRAM_HEAP_POP,
+    HISTOGRAM_OP_COUNT
+} histogram_op;
+
+/**
+ * Create a new empty histogram.
+ * Must be free with histogram_delete
+ * @return A pointer to an allocated histogram or NULL on error (see errno)
+ */
+histogram *histogram_create();
+
+/**
+ * Free all used memory by the histogram
+ * @param histogram a non null pointer to a histogram
+ */
+void histogram_delete(histogram *histogram);
+
+/**
+ * Forget every recorded value
+ * @param histogram a non null pointer to a histogram
+ */
+void histogram_reset(histogram *histogram);
+
+/**
+ * Record a value (usually a duration, see histogram_clock)
+ * @param histogram a non null pointer to a histogram
+ * @param value the value to record
+ */
+void histogram_record(histogram *histogram, uint64_t value);
+
+/**
+ * Add every value recorded in src to dst.
+ * Histograms are not thread safe: record in one histogram per thread and
+ * merge them once the threads are done.
+ * @param dst a non null pointer to the histogram receiving the values
+ * @param src a non null pointer to the histogram to merge
+ */
+void histogram_merge(histogram *dst, const histogram *src);
+
+/**
+ * Get the value under which the requested percentage of values fall
+ * @param histogram a non null pointer to a histogram
+ * @param percentile the requested percentile, between 0 and 100
+ * @return the highest value equivalent to the percentile bucket, never
+ *         above the maximum recorded value. 0 if the histogram is empty
+ */
+uint64_t histogram_percentile(const histogram *histogram, double percentile);
+
+/**
+ * Get the mean of the recorded values
+ * @param histogram a non null pointer to a histogram
+ * @return the mean, 0 if the histogram is empty
+ */
+double histogram_mean(const histogram *histogram);
+
+/**
+ * Print the histogram summary on STDOUT at format
+ * count=N min=X p50=X p99=X p99.9=X max=X
+ * @param histogram a non null pointer to a histogram
+ */
+void histogram_print(const histogram *histogram);
+
+/**
+ * Read the timestamp counter used to time operations.
+ * Uses rdtsc (cycles) when built with WOOFI_HISTOGRAM_RDTSC on x86,
+ * CLOCK_MONOTONIC (nanoseconds) otherwise.
+ * @return the current timestamp
+ */
+uint64_t histogram_clock();
+
+/**
+ * Record the latency of an operation in a histogram for the calling
+ * thread. Only has an effect when the library is built with WITH_HISTOGRAM.
+ * @param op the operation to time
+ * @param histogram the histogram receiving the timings or NULL to stop
+ */
+void histogram_attach(histogram_op op, histogram *histogram);
+
+/**
+ * Get the histogram attached to an operation for the calling thread
+ * @param op the timed operation
+ * @return the attached histogram or NULL
+ */
+histogram *histogram_attached(histogram_op op);
+
+#ifdef WITH_HISTOGRAM
+# define HISTOGRAM_START(op) \
+    histogram *histogram_hook = histogram_attached(op); \
+    uint64_t histogram_start = histogram_hook ? histogram_clock() : 0
+# define HISTOGRAM_STOP() \
+    if (histogram_hook) \
+	histogram_record(histogram_hook, histogram_clock() - histogram_start)
+#else
+# define HISTOGRAM_START(op) (void)0
+# define HISTOGRAM_STOP() (void)0
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef WOOFI_MAGAZINE_H
+#define WOOFI_MAGAZINE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "woofi/allocator.h"
+
+/*
+ * Magazine caches in front of malloc, for the small blocks containers
+ * allocate over and over: headers, list nodes and element buffers.
+ * Blocks are sorted in power of two size classes. Each thread keeps two
+ * magazines of MAGAZINE_ROUNDS blocks per class and allocates and frees
+ * without locking; only when both are empty, or both full, it swaps a
+ * whole magazine with the depot of the class under its lock.
+ * Programs using it must be linked with -lpthread.
+ */
+#define MAGAZINE_MIN_SIZE 16
+#define MAGAZINE_MAX_SIZE 4096
+#define MAGAZINE_CLASSES 9
+#define MAGAZINE_ROUNDS 32
+/* Full magazines kept by a depot, the blocks of others go back to libc */
+#define MAGAZINE_DEPOT_LIMIT 16
+
+typedef struct magazine {
+    size_t count;
+    struct magazine *next;
+    void *round[MAGAZINE_ROUNDS];
+} magazine;
+
+/**
+ * Magazines shared by the threads for a size class
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    magazine *full;
+    magazine *empty;
+    size_t full_count;
+    size_t exchanges; /* magazines swapped with threads */
+} magazine_depot;
+
+/**
+ * Per thread state, only used by its thread
+ */
+typedef struct {
+    struct magazine_cache *cache;
+    struct {
+        magazine *loaded;
+        magazine *previous;
+    } slot[MAGAZINE_CLASSES];
+} magazine_thread;
+
+typedef struct magazine_cache {
+    pthread_key_t key;
+    magazine_depot depot[MAGAZINE_CLASSES];
+} magazine_cache;
+
+/**
+ * Create a new cache
+ * Must be free with magazine_delete
+ * @return A pointer to an allocated cache or NULL on error (see errno)
+ */
+magazine_cache *magazine_create();
+
+/**
+ * Free the cache and every cached block. The magazines of the calling
+ * thread are flushed; other threads must have exited or flushed theirs.
+ * @param cache a non null pointer to a cache
+ */
+void magazine_delete(magazine_cache *cache);
+
+/**
+ * Allocate a block from the magazines of the calling thread, blocks
+ * above MAGAZINE_MAX_SIZE come from malloc
+ * @param cache a non null pointer to a cache
+ * @param size the size of the block
+ * @return a pointer to the block or NULL on error (see errno)
+ */
+void *magazine_alloc(magazine_cache *cache, size_t size);
+
+/**
+ * Give back a block to the magazines of the calling thread, whichever
+ * thread allocated it
+ * @param cache a non null pointer to a cache
+ * @param ptr the block, may be NULL
+ * @param size the size it was allocated with
+ */
+void magazine_free(magazine_cache *cache, void *ptr, size_t size);
+
+/**
+ * Resize a block, in place when the size class does not change
+ * @param cache a non null pointer to a cache
+ * @param ptr the block, may be NULL
+ * @param old_size the size it was allocated with
+ * @param size the new size
+ * @return a pointer to the block or NULL on error (see errno), ptr is
+ *  then still valid
+ */
+void *magazine_realloc(magazine_cache *cache, void *ptr, size_t old_size,
+                       size_t size);
+
+/**
+ * Hand the magazines of the calling thread back to the depots. Done when
+ * a thread exits.
+ * @param cache a non null pointer to a cache
+ */
+void magazine_flush(magazine_cache *cache);
+
+/**
+ * Get hooks allocating from the cache, to install with allocator_set
+ * @param cache a non null pointer to a cache
+ * @return the hooks
+ */
+allocator magazine_allocator(magazine_cache *cache);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef WOOFI_MAPPEDLIST_H
+#define WOOFI_MAPPEDLIST_H
+
+#include <stdint.h>
+
+#include "woofi/arraylist.h"
+
+#define MAPPEDLIST_MAGIC 0x4c464f57 /* "WOFL" */
+#define MAPPEDLIST_VERSION 1
+/* Elements start one cache line after the start of the file */
+#define MAPPEDLIST_HEADER_SIZE 64
+
+/**
+ * Header at the start of a mapped list file.
+ * count is only updated on mappedlist_sync and when the list is closed.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t element_size;
+    uint64_t count;
+    uint64_t length;
+} mappedlist_header;
+
+struct mappedlist {
+    int fd;
+    mappedlist_header *header;
+    size_t size;
+};
+
+/**
+ * Open an array list stored in a file, creating the file if needed.
+ * The file is mapped in memory and pages are only read when accessed, so
+ * opening does not depend on the size of the list. Every arraylist_*
+ * function can be used on the returned list.
+ * Must be free with arraylist_delete or mappedlist_close
+ * @param path the path of the file backing the list
+ * @return A pointer to an array list or NULL on error (see errno), EINVAL
+ *         if the file is not a mapped list
+ */
+arraylist *mappedlist_open(const char *path);
+
+/**
+ * Write the list count in the file header and flush the mapping to disk
+ * @param list a non null pointer to a list opened with mappedlist_open
+ * @return 0 if the list was written
+ *        -1 on error (see errno)
+ */
+int mappedlist_sync(arraylist *list);
+
+/**
+ * Sync, unmap and close the file backing the list, then free the list
+ * @param list a non null pointer to a list opened with mappedlist_open
+ */
+void mappedlist_close(arraylist *list);
+
+/**
+ * Change the capacity of the file backing the list.
+ * Used by the list when it needs to grow.
+ * @param list a non null pointer to a list opened with mappedlist_open
+ * @param length the new capacity, in elements
+ * @return 0 if the file was resized and remapped
+ *        -1 on error, the list is left unchanged (see errno)
+ */
+int mappedlist_resize(arraylist *list, size_t length);
+
+#endif
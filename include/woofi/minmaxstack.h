@@ -0,0 +1,128 @@
+#ifndef WOOFI_MINMAXSTACK_H
+#define WOOFI_MINMAXSTACK_H
+
+#include <stdint.h>
+
+#include "woofi/capacity.h"
+
+/*
+ * Stack of ints which knows its minimum, maximum and sum at every depth.
+ * Each entry stores its value with the aggregates of the entries from
+ * the bottom up to it, so removing the head restores the previous ones
+ * and every query reads the head entry only.
+ */
+typedef struct {
+    int64_t sum;
+    int value;
+    int min;
+    int max;
+} minmaxstack_entry;
+
+typedef struct {
+    size_t size;
+    size_t head;
+    minmaxstack_entry *element;
+    capacity_policy policy;
+} minmaxstack;
+
+/**
+ * Create a new stack
+ * Must be free with minmaxstack_delete
+ * @return A pointer to an allocated stack or NULL on error (see errno)
+ */
+minmaxstack *minmaxstack_create();
+
+/**
+ * Free all used memory by the stack
+ * @param stack a non null pointer to a stack
+ */
+void minmaxstack_delete(minmaxstack *stack);
+
+/**
+ * Change how the stack grows and shrinks.
+ * Stacks are created with CAPACITY_POLICY_DEFAULT
+ * @param stack a non null pointer to a stack
+ * @param policy a non null pointer to the policy to copy
+ * @return 0 if the policy was changed
+ *        -1 if the policy is not valid (errno is set to EINVAL)
+ */
+int minmaxstack_set_policy(minmaxstack *stack, const capacity_policy *policy);
+
+/**
+ * Make sure the stack can hold at least size elements without growing
+ * @param stack a non null pointer to a stack
+ * @param size the number of elements to hold
+ * @return 0 if the stack is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int minmaxstack_reserve(minmaxstack *stack, size_t size);
+
+/**
+ * Release the memory not used by the elements of the stack
+ * @param stack a non null pointer to a stack
+ * @return 0 if the stack was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int minmaxstack_shrink_to_fit(minmaxstack *stack);
+
+/**
+ * Check if the stack is empty or not
+ * @param stack a non null pointer to a stack
+ * @return 0 if the stack is not empty
+ *         1 if it's empty
+ */
+int minmaxstack_is_empty(const minmaxstack *stack);
+
+/**
+ * Count the number of element in the stack
+ * @param stack a non null pointer to a stack
+ * @return the number of elements on the stack
+ */
+size_t minmaxstack_count(const minmaxstack *stack);
+
+/**
+ * Insert element at the head of the stack, like stack_insert
+ * @param stack a non null pointer to a stack
+ * @param value the value to be added to the stack
+ * @return 1 if the element was added to the stack
+ *         0 on error, if it failed to allocate requested memory (see errno)
+ */
+int minmaxstack_insert(minmaxstack *stack, int value);
+
+/**
+ * Remove value at the head of the stack
+ * @param stack a non null pointer to a stack
+ * @return 1 if the element was deleted
+ *         0 if the stack is empty
+ */
+int minmaxstack_remove(minmaxstack *stack);
+
+/**
+ * Return the head of the stack
+ * @param stack a non null pointer to a non empty stack
+ * @return the head of the stack
+ */
+int minmaxstack_head(const minmaxstack *stack);
+
+/**
+ * Return the smallest element of the stack
+ * @param stack a non null pointer to a non empty stack
+ * @return the minimum
+ */
+int minmaxstack_min(const minmaxstack *stack);
+
+/**
+ * Return the largest element of the stack
+ * @param stack a non null pointer to a non empty stack
+ * @return the maximum
+ */
+int minmaxstack_max(const minmaxstack *stack);
+
+/**
+ * Return the sum of the elements of the stack
+ * @param stack a non null pointer to a stack
+ * @return the sum, 0 if the stack is empty
+ */
+int64_t minmaxstack_sum(const minmaxstack *stack);
+
+#endif
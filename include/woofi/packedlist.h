@@ -0,0 +1,106 @@
+#ifndef WOOFI_PACKEDLIST_H
+#define WOOFI_PACKEDLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "woofi/arraylist.h"
+
+/*
+ * Read only compressed copy of a list of ints. Values are cut in blocks of
+ * PACKEDLIST_BLOCK values, each stored on the fewest bits needed either
+ * by its distance to the block minimum (frame of reference) or, for
+ * sorted blocks, by its distance to the previous value (delta).
+ * Each block packs its values in 4 interleaved lanes of 32 bits words,
+ * value i going to lane i % 4, so that 4 values unpack at once with SSE2.
+ */
+#define PACKEDLIST_BLOCK 128
+
+/**
+ * Skip index entry, one per block
+ */
+typedef struct {
+    int minimum;
+    int maximum;
+    uint32_t offset; /* first word of the block */
+    uint8_t bits;    /* bits per packed value, 0 to 32 */
+    uint8_t delta;   /* values are deltas from the previous one */
+    uint8_t sorted;
+} packedlist_block;
+
+typedef struct {
+    size_t count;
+    size_t blocks;
+    int sorted; /* the whole list is sorted */
+    packedlist_block *block;
+    uint32_t *word;
+} packedlist;
+
+/**
+ * Create a compressed copy of a list
+ * Must be free with packedlist_delete
+ * @param list a non null pointer to a list
+ * @return A pointer to an allocated packed list or NULL on error (see errno)
+ */
+packedlist *packedlist_from_arraylist(const arraylist *list);
+
+/**
+ * Free all used memory by the packed list
+ * @param list a non null pointer to a packed list
+ */
+void packedlist_delete(packedlist *list);
+
+/**
+ * Count the number of element in list and return it
+ * @param list a non null pointer to a packed list
+ * @return the number of elements on the list
+ */
+size_t packedlist_count(const packedlist *list);
+
+/**
+ * Compute the memory used by the packed values and the skip index
+ * @param list a non null pointer to a packed list
+ * @return the size in bytes
+ */
+size_t packedlist_size_in_bytes(const packedlist *list);
+
+/**
+ * Decompress a block
+ * @param list a non null pointer to a packed list
+ * @param block the index of the block, below list->blocks
+ * @param out room for PACKEDLIST_BLOCK values
+ * @return the number of values of the block
+ */
+size_t packedlist_decode(const packedlist *list, size_t block, int *out);
+
+/**
+ * Get the value at specified index in the list, unpacking only what
+ * is needed.
+ * @param list a non null pointer to a packed list
+ * @param index the index of the requested element
+ * @param found a pointer to store the result of the search (if
+ *  the element was found)
+ * @return the value of requested element
+ */
+int packedlist_get(const packedlist *list, size_t index, int *found);
+
+/**
+ * Check if the list contains the value. The skip index leaves out the
+ * blocks which cannot hold it, a binary search on it is used when the
+ * list is sorted.
+ * @param list a non null pointer to a packed list
+ * @param value the value to search on the list
+ * @return 0 if the value is not in list
+ *         1 if the value is in list
+ */
+int packedlist_contains(const packedlist *list, int value);
+
+/**
+ * Create a list of the values of the packed list
+ * Must be free with arraylist_delete
+ * @param list a non null pointer to a packed list
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *packedlist_to_arraylist(const packedlist *list);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef WOOFI_PARALLEL_H
+#define WOOFI_PARALLEL_H
+
+#include "woofi/arraylist.h"
+#include "woofi/threadpool.h"
+
+/*
+ * The elements are split in a few chunks per thread. Chunk boundaries
+ * fall on cache line boundaries so two threads never write the same line.
+ */
+#define PARALLEL_CHUNKS_PER_THREAD 4
+#define PARALLEL_CACHE_LINE 64
+/* Lists smaller than this are processed by the calling thread only */
+#define PARALLEL_MIN_COUNT 8192
+
+typedef int (*parallel_reduce_fn)(int a, int b);
+typedef int (*parallel_map_fn)(int value);
+typedef void (*parallel_for_each_fn)(void *ctx, size_t index, int value);
+
+/**
+ * Sort the list in ascending order: every chunk is radix sorted, then
+ * the chunks are merged pairwise, each merge being split between threads
+ * @param list a non null pointer to a list
+ * @param pool a non null pointer to a pool
+ * @return 0 if the list was sorted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int arraylist_par_sort(arraylist *list, threadpool *pool);
+
+/**
+ * Combine every element of the list with an associative function
+ * @param list a non null pointer to a list
+ * @param pool a non null pointer to a pool
+ * @param reduce an associative function
+ * @param identity the identity value of reduce (0 for a sum)
+ * @return the reduced value, identity if the list is empty
+ */
+int arraylist_par_reduce(const arraylist *list, threadpool *pool,
+                         parallel_reduce_fn reduce, int identity);
+
+/**
+ * Replace every element of the list by map(element)
+ * @param list a non null pointer to a list
+ * @param pool a non null pointer to a pool
+ * @param map the function to apply
+ */
+void arraylist_par_map(arraylist *list, threadpool *pool,
+                       parallel_map_fn map);
+
+/**
+ * Call fn(ctx, index, element) for every element of the list, in no
+ * particular order and from several threads at once
+ * @param list a non null pointer to a list
+ * @param pool a non null pointer to a pool
+ * @param fn the function to call
+ * @param ctx passed to fn
+ */
+void arraylist_par_for_each(const arraylist *list, threadpool *pool,
+                            parallel_for_each_fn fn, void *ctx);
+
+#endif
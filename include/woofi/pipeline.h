@@ -0,0 +1,193 @@
+#ifndef WOOFI_PIPELINE_H
+#define WOOFI_PIPELINE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Chain of stages processing batches of ints, each stage run by its own
+ * worker threads. The caller pushes values in, the stages hand batches
+ * to each other through bounded rings and the caller pops the values
+ * out of the last ring. A full ring blocks the stage feeding it, so a
+ * slow stage holds back the stages before it down to pipeline_push.
+ * Programs using it must be linked with -lpthread.
+ */
+
+/**
+ * Process a batch, called concurrently by the workers of a stage
+ * @param ctx the context given with the stage
+ * @param input the values of the batch
+ * @param count the number of values
+ * @param output a buffer of the batch size of the pipeline
+ * @return the number of values written to output, 0 to drop the batch
+ */
+typedef size_t (*pipeline_fn)(void *ctx, const int *input, size_t count,
+                              int *output);
+
+typedef struct pipeline_batch {
+    struct pipeline_batch *next; /* in the free batches */
+    uint64_t ticket;             /* order of the batch in its ring */
+    size_t count;
+    int value[];
+} pipeline_batch;
+
+/**
+ * Bounded ring of batches between two stages, for any number of
+ * threads on both sides
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pipeline_batch **slot;
+    size_t size;
+    size_t head;
+    size_t count;
+    uint64_t popped;   /* tickets handed to the consumers */
+    uint64_t pushed;   /* next ticket accepted by an ordered ring */
+    size_t producers;  /* threads still pushing */
+    int ordered;
+    int aborted;
+    uint64_t pushes;
+    uint64_t depth_sum;
+    size_t max_depth;
+} pipeline_ring;
+
+/**
+ * Activity of a stage, updated by its workers
+ */
+typedef struct {
+    uint64_t batches;
+    uint64_t values_in;
+    uint64_t values_out;
+    uint64_t busy_ns;  /* in the stage function, summed over workers */
+    uint64_t stall_ns; /* blocked on a full output ring */
+} pipeline_counters;
+
+typedef struct {
+    struct pipeline *pipeline;
+    pipeline_fn fn;
+    void *ctx;
+    size_t workers;
+    int ordered;
+    pthread_t *thread;
+    size_t started;
+    pipeline_ring *input;
+    pipeline_ring *output;
+    pipeline_counters counters;
+} pipeline_stage;
+
+/**
+ * Metrics of a stage, from pipeline_stats
+ */
+typedef struct {
+    uint64_t batches;
+    uint64_t values_in;
+    uint64_t values_out;
+    double busy_seconds;
+    double stall_seconds;
+    double values_per_second; /* values in over the time since start */
+    size_t depth;             /* batches waiting in the input ring */
+    size_t max_depth;
+    double mean_depth;        /* input ring depth after each push */
+} pipeline_stage_stats;
+
+typedef struct pipeline {
+    size_t batch;
+    size_t capacity;
+    pipeline_stage *stage;
+    size_t stages;
+    pipeline_ring *ring; /* stages + 1 rings */
+    int running;
+    int closed;
+    struct timespec start;
+    pthread_mutex_t pool_lock;
+    pipeline_batch *pool;
+    pipeline_batch *pending;  /* values pushed, not sent yet */
+    pipeline_batch *draining; /* values popped, not returned yet */
+    size_t drained;
+} pipeline;
+
+/**
+ * Create a new pipeline without stages
+ * Must be free with pipeline_delete
+ * @param batch the number of values per batch
+ * @param capacity the number of batches each ring holds
+ * @return A pointer to an allocated pipeline or NULL on error (see errno)
+ */
+pipeline *pipeline_create(size_t batch, size_t capacity);
+
+/**
+ * Close the pipeline if needed, discard the values not popped, wait for
+ * the workers and free all used memory
+ * @param pipeline a non null pointer to a pipeline
+ */
+void pipeline_delete(pipeline *pipeline);
+
+/**
+ * Add a stage after the last one, before pipeline_start
+ * @param pipeline a non null pointer to a pipeline
+ * @param fn the function processing each batch
+ * @param ctx passed to fn
+ * @param workers the number of threads running the stage, at least 1
+ * @param ordered 1 to send the batches to the next stage in the order
+ *  the stage received them, 0 as soon as they are processed
+ * @return 0 if the stage was added
+ *        -1 on error (see errno), EINVAL if the pipeline runs
+ */
+int pipeline_add_stage(pipeline *pipeline, pipeline_fn fn, void *ctx,
+                       size_t workers, int ordered);
+
+/**
+ * Start the workers of every stage
+ * @param pipeline a non null pointer to a pipeline
+ * @return 0 if the pipeline runs
+ *        -1 on error (see errno), the pipeline can only be deleted
+ */
+int pipeline_start(pipeline *pipeline);
+
+/**
+ * Feed values to the first stage, from a single thread. Blocks while
+ * the first ring is full.
+ * @param pipeline a non null pointer to a running pipeline
+ * @param values the values
+ * @param count the number of values
+ * @return 0 if the values were queued
+ *        -1 on error (see errno)
+ */
+int pipeline_push(pipeline *pipeline, const int *values, size_t count);
+
+/**
+ * Send the values pushed and not sent yet, and tell the first stage no
+ * more values come. The stages stop once they processed everything.
+ * @param pipeline a non null pointer to a running pipeline
+ * @return 0 if the pipeline was closed
+ *        -1 on error (see errno)
+ */
+int pipeline_close(pipeline *pipeline);
+
+/**
+ * Take values out of the last stage, from a single thread. Blocks until
+ * a batch comes out.
+ * @param pipeline a non null pointer to a running pipeline
+ * @param values a buffer of count values
+ * @param count the maximum number of values
+ * @return the number of values taken, 0 once the pipeline is closed
+ *  and every value was taken
+ */
+size_t pipeline_pop(pipeline *pipeline, int *values, size_t count);
+
+/**
+ * Get the metrics of a stage, while it runs or once it stopped
+ * @param pipeline a non null pointer to a pipeline
+ * @param stage the index of the stage
+ * @param stats a non null pointer to store the metrics
+ * @return 0 if the metrics were stored
+ *        -1 if there is no such stage, errno is set to EINVAL
+ */
+int pipeline_stats(pipeline *pipeline, size_t stage,
+                   pipeline_stage_stats *stats);
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef WOOFI_PVECTOR_H
+#define WOOFI_PVECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "woofi/arraylist.h"
+
+/*
+ * Persistent vector of ints: a trie of PVECTOR_WIDTH way nodes whose
+ * leaves hold the values, plus a tail leaf holding the last values so
+ * most pushes touch a single node. Updates copy the path to the changed
+ * leaf and share every other node with the previous version, nodes being
+ * reference counted so versions can be dropped in any order.
+ *
+ * A version never changes once created and can be read from any thread.
+ * A transient is a private version edited in place: the nodes it created
+ * are reused by later edits instead of being copied again, until it is
+ * made persistent.
+ */
+#define PVECTOR_BITS 5
+#define PVECTOR_WIDTH (1 << PVECTOR_BITS)
+
+typedef struct pvector_node {
+    size_t refs;
+    uint64_t edit; /* transient which may edit the node in place */
+    union {
+        struct pvector_node *child[PVECTOR_WIDTH];
+        int value[PVECTOR_WIDTH];
+    } slot;
+} pvector_node;
+
+typedef struct {
+    size_t count;
+    unsigned shift; /* bits of the index consumed above the leaves */
+    pvector_node *root;
+    pvector_node *tail;
+    uint64_t edit; /* 0 unless the vector is a transient */
+} pvector;
+
+/**
+ * Called for each value of a vector, in index order
+ * @return 0 to continue, any other value stops the iteration
+ */
+typedef int (*pvector_fn)(void *ctx, int value);
+
+/**
+ * Create a new empty vector
+ * Must be free with pvector_delete
+ * @return A pointer to an allocated vector or NULL on error (see errno)
+ */
+pvector *pvector_create();
+
+/**
+ * Drop a version, nodes shared with other versions are kept
+ * @param vector a non null pointer to a vector
+ */
+void pvector_delete(pvector *vector);
+
+/**
+ * Create a vector holding the values of a list, using a transient
+ * Must be free with pvector_delete
+ * @param list a non null pointer to a list
+ * @return A pointer to an allocated vector or NULL on error (see errno)
+ */
+pvector *pvector_from_arraylist(const arraylist *list);
+
+/**
+ * Create a list of the values of the vector
+ * Must be free with arraylist_delete
+ * @param vector a non null pointer to a vector
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *pvector_to_arraylist(const pvector *vector);
+
+/**
+ * Take another reference to the same version, in O(1), to hand to a
+ * reader. Both must be free with pvector_delete.
+ * @param vector a non null pointer to a persistent vector
+ * @return A pointer to an allocated vector or NULL on error (see errno)
+ */
+pvector *pvector_snapshot(const pvector *vector);
+
+/**
+ * Count the number of element in the vector and return it
+ * @param vector a non null pointer to a vector
+ * @return the number of elements of the vector
+ */
+size_t pvector_count(const pvector *vector);
+
+/**
+ * Get the value at specified index in the vector.
+ * The index value MUST be valid (>= 0 AND < count)
+ * @param vector a non null pointer to a vector
+ * @param index the index of the requested element
+ * @return the value of requested element
+ */
+int pvector_fast_get(const pvector *vector, size_t index);
+
+/**
+ * Get the value at specified index in the vector.
+ * @param vector a non null pointer to a vector
+ * @param index the index of the requested element
+ * @param found a pointer to store the result of the search (if
+ *  the element was found)
+ * @return the value of requested element
+ */
+int pvector_get(const pvector *vector, size_t index, int *found);
+
+/**
+ * Call fn(ctx, value) for every value of the vector, in index order
+ * @param vector a non null pointer to a vector
+ * @param fn the function to call
+ * @param ctx passed to fn
+ * @return 0 if every value was visited
+ *         the value returned by fn if it stopped the iteration
+ */
+int pvector_for_each(const pvector *vector, pvector_fn fn, void *ctx);
+
+/**
+ * Create a new version with value appended
+ * Must be free with pvector_delete
+ * @param vector a non null pointer to a persistent vector
+ * @param value the value to append
+ * @return A pointer to an allocated vector or NULL on error (see errno)
+ */
+pvector *pvector_push(const pvector *vector, int value);
+
+/**
+ * Create a new version with the value at index replaced
+ * Must be free with pvector_delete
+ * @param vector a non null pointer to a persistent vector
+ * @param index the index of the value to replace, below the count
+ * @param value the new value
+ * @return A pointer to an allocated vector or NULL on error, if index
+ *         is out of range (errno is set to EINVAL) or it failed to
+ *         allocate requested memory (see errno)
+ */
+pvector *pvector_set(const pvector *vector, size_t index, int value);
+
+/**
+ * Create a new version without the last value
+ * Must be free with pvector_delete
+ * @param vector a non null pointer to a persistent vector
+ * @return A pointer to an allocated vector or NULL on error (see errno)
+ */
+pvector *pvector_pop(const pvector *vector);
+
+/**
+ * Create a transient sharing the nodes of a version, for a batch of
+ * edits. Must be made persistent before being shared, and free with
+ * pvector_delete.
+ * @param vector a non null pointer to a persistent vector
+ * @return A pointer to an allocated transient or NULL on error (see errno)
+ */
+pvector *pvector_transient(const pvector *vector);
+
+/**
+ * Freeze a transient in place, it can no longer be edited
+ * @param vector a non null pointer to a transient
+ */
+void pvector_persistent(pvector *vector);
+
+/**
+ * Append a value to a transient
+ * @param vector a non null pointer to a transient
+ * @param value the value to append
+ * @return 0 if the value was appended
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int pvector_transient_push(pvector *vector, int value);
+
+/**
+ * Replace the value at index in a transient
+ * @param vector a non null pointer to a transient
+ * @param index the index of the value to replace
+ * @param value the new value
+ * @return 0 if the value was replaced
+ *        -1 on error, if index is out of range (errno is set to EINVAL)
+ *           or it failed to allocate requested memory (see errno)
+ */
+int pvector_transient_set(pvector *vector, size_t index, int value);
+
+/**
+ * Remove the last value of a transient
+ * @param vector a non null pointer to a transient
+ * @return 1 if a value was removed
+ *         0 if the vector is empty
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int pvector_transient_pop(pvector *vector);
+
+#endif
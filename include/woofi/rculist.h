@@ -0,0 +1,115 @@
+#ifndef WOOFI_RCULIST_H
+#define WOOFI_RCULIST_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "woofi/arraylist.h"
+#include "woofi/epoch.h"
+
+/**
+ * Immutable array of values, replaced as a whole by writers
+ */
+typedef struct {
+    size_t count;
+    int element[];
+} rculist_version;
+
+/**
+ * Read mostly list: readers load the current version without any lock
+ * or shared write, writers copy it, publish the copy and retire the old
+ * version to an epoch domain which frees it once no reader sees it.
+ * Writers are serialized by a mutex.
+ */
+typedef struct {
+    rculist_version *current;
+    epoch_domain *domain;
+    pthread_mutex_t lock;
+} rculist;
+
+/**
+ * Create a new empty list
+ * Must be free with rculist_delete
+ * @param domain a non null pointer to the domain readers pin
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+rculist *rculist_create(epoch_domain *domain);
+
+/**
+ * Free the list, retired versions are left to the domain.
+ * No reader may use the list anymore.
+ * @param list a non null pointer to a list
+ */
+void rculist_delete(rculist *list);
+
+/**
+ * Get the current version, valid until the reader calls epoch_exit
+ * Must be called between epoch_enter and epoch_exit.
+ * @param list a non null pointer to a list
+ * @return a non null pointer to the current version
+ */
+const rculist_version *rculist_read(const rculist *list);
+
+/**
+ * Get the value at specified index in the current version
+ * @param list a non null pointer to a list
+ * @param record a non null pointer to the record of the calling thread
+ * @param index the index of the requested element
+ * @param found a pointer to store the result of the search (if
+ *  the element was found)
+ * @return the value of requested element
+ */
+int rculist_get(const rculist *list, epoch_record *record, size_t index,
+                int *found);
+
+/**
+ * Check if the current version contains the value
+ * @param list a non null pointer to a list
+ * @param record a non null pointer to the record of the calling thread
+ * @param value the value to search on the list
+ * @return 0 if the value is not in list
+ *         1 if the value is in list
+ */
+int rculist_contains(const rculist *list, epoch_record *record, int value);
+
+/**
+ * Replace every value of the list by the values of an array list
+ * @param list a non null pointer to a list
+ * @param values a non null pointer to the values to publish
+ * @return 0 if the values were published
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int rculist_publish(rculist *list, const arraylist *values);
+
+/**
+ * Publish a version with value appended
+ * @param list a non null pointer to a list
+ * @param value the value to append
+ * @return 0 if the value was appended
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int rculist_insert_last(rculist *list, int value);
+
+/**
+ * Publish a version with the value at index replaced
+ * @param list a non null pointer to a list
+ * @param index the index of the value to replace
+ * @param value the new value
+ * @return 0 if the value was replaced
+ *        -1 on error, if index is out of range (errno is set to EINVAL)
+ *           or it failed to allocate requested memory (see errno)
+ */
+int rculist_set(rculist *list, size_t index, int value);
+
+/**
+ * Publish a version without the value at index, or the last one if
+ * index is past it
+ * @param list a non null pointer to a list
+ * @param index the index of the value to remove
+ * @return 1 if a value was removed
+ *         0 if the list is empty
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int rculist_remove_at(rculist *list, size_t index);
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef WOOFI_RINGBUF_H
+#define WOOFI_RINGBUF_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Ring buffer of bytes for socket I/O, laid out like circularqueue: data
+ * lives from head to tail, wrapping at size, and one byte always stays
+ * free between the tail and the head. The used and the free bytes are
+ * each at most two segments, handed to readv/writev or to the caller as
+ * iovecs so data is parsed and produced in place.
+ */
+typedef struct {
+    unsigned char *element;
+    size_t head;
+    size_t tail;
+    size_t size;
+} ringbuf;
+
+/**
+ * Create a new empty ring buffer
+ * Must be free with ringbuf_delete
+ * @param capacity the number of bytes it can hold
+ * @return A pointer to an allocated ring buffer or NULL on error (see errno)
+ */
+ringbuf *ringbuf_create(size_t capacity);
+
+/**
+ * Free all used memory by the ring buffer
+ * @param ring a non null pointer to a ring buffer
+ */
+void ringbuf_delete(ringbuf *ring);
+
+/**
+ * Count the bytes in the ring buffer
+ * @param ring a non null pointer to a ring buffer
+ * @return the number of bytes which can be read
+ */
+size_t ringbuf_count(const ringbuf *ring);
+
+/**
+ * Count the free bytes of the ring buffer
+ * @param ring a non null pointer to a ring buffer
+ * @return the number of bytes which can be written
+ */
+size_t ringbuf_space(const ringbuf *ring);
+
+/**
+ * Check if the ring buffer is empty
+ * @param ring a non null pointer to a ring buffer
+ * @return 1 if the ring buffer is empty
+ *         0 otherwise
+ */
+int ringbuf_is_empty(const ringbuf *ring);
+
+/**
+ * Copy bytes at the tail of the ring buffer, as many as fit
+ * @param ring a non null pointer to a ring buffer
+ * @param data the bytes to copy
+ * @param count the number of bytes
+ * @return the number of bytes copied
+ */
+size_t ringbuf_write(ringbuf *ring, const void *data, size_t count);
+
+/**
+ * Copy and remove bytes from the head of the ring buffer
+ * @param ring a non null pointer to a ring buffer
+ * @param data a buffer of count bytes
+ * @param count the maximum number of bytes to copy
+ * @return the number of bytes copied
+ */
+size_t ringbuf_read(ringbuf *ring, void *data, size_t count);
+
+/**
+ * Get the used bytes, from the head, without removing them
+ * @param ring a non null pointer to a ring buffer
+ * @param iov two iovecs set to the segments, the second one may be empty
+ * @return the number of bytes in the segments
+ */
+size_t ringbuf_peek(const ringbuf *ring, struct iovec iov[2]);
+
+/**
+ * Remove bytes from the head, once parsed from ringbuf_peek. The head
+ * goes back to the start of the storage when the ring buffer empties.
+ * @param ring a non null pointer to a ring buffer
+ * @param count the number of bytes, at most ringbuf_count
+ */
+void ringbuf_consume(ringbuf *ring, size_t count);
+
+/**
+ * Get the free bytes, from the tail, to write in place
+ * @param ring a non null pointer to a ring buffer
+ * @param iov two iovecs set to the segments, the second one may be empty
+ * @return the number of bytes in the segments
+ */
+size_t ringbuf_reserve(ringbuf *ring, struct iovec iov[2]);
+
+/**
+ * Add bytes written in the segments of ringbuf_reserve at the tail
+ * @param ring a non null pointer to a ring buffer
+ * @param count the number of bytes, at most ringbuf_space
+ */
+void ringbuf_commit(ringbuf *ring, size_t count);
+
+/**
+ * Read from a file descriptor into the free bytes with a single readv
+ * @param ring a non null pointer to a ring buffer
+ * @param fd the file descriptor to read from
+ * @return the number of bytes read, 0 at end of file
+ *        -1 on error (see errno), ENOBUFS if the ring buffer is full
+ */
+ssize_t ringbuf_read_fd(ringbuf *ring, int fd);
+
+/**
+ * Write the used bytes to a file descriptor with a single writev and
+ * remove the bytes written
+ * @param ring a non null pointer to a ring buffer
+ * @param fd the file descriptor to write to
+ * @return the number of bytes written
+ *        -1 on error (see errno)
+ */
+ssize_t ringbuf_write_fd(ringbuf *ring, int fd);
+
+#endif
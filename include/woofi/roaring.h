@@ -0,0 +1,171 @@
+#ifndef WOOFI_ROARING_H
+#define WOOFI_ROARING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "woofi/arraylist.h"
+
+/*
+ * Compressed set of 32 bits values. Values are grouped by their high 16
+ * bits in containers, each holding the low 16 bits of its values in the
+ * smallest of three encodings:
+ * - a sorted array of values, up to ROARING_ARRAY_MAX values
+ * - a bitmap of 65536 bits
+ * - a sorted array of runs of consecutive values
+ */
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITMAP_WORDS 1024
+
+typedef enum {
+    ROARING_ARRAY = 1,
+    ROARING_BITMAP = 2,
+    ROARING_RUN = 3
+} roaring_type;
+
+/* Values from start to start + length, both included */
+typedef struct {
+    uint16_t start;
+    uint16_t length;
+} roaring_run;
+
+typedef struct {
+    uint16_t key;
+    uint16_t type;
+    uint32_t cardinality;
+    uint32_t length;   /* values of an array, runs of a run container */
+    uint32_t capacity; /* allocated values or runs */
+    union {
+        uint16_t *array;
+        uint64_t *bitmap;
+        roaring_run *run;
+    } data;
+} roaring_container;
+
+/**
+ * Containers are sorted by key
+ */
+typedef struct {
+    size_t count;
+    size_t size;
+    roaring_container *container;
+} roaring;
+
+/**
+ * Called for each value of a set, in ascending order
+ * @return 0 to continue, any other value stops the iteration
+ */
+typedef int (*roaring_fn)(void *ctx, uint32_t value);
+
+/**
+ * Create a new empty set
+ * Must be free with roaring_delete
+ * @return A pointer to an allocated set or NULL on error (see errno)
+ */
+roaring *roaring_create();
+
+/**
+ * Free all used memory by the set
+ * @param set a non null pointer to a set
+ */
+void roaring_delete(roaring *set);
+
+/**
+ * Create a set holding the values of a list, which does not need to be
+ * sorted. Each container gets its smallest encoding, runs included.
+ * Must be free with roaring_delete
+ * @param list a non null pointer to a list of non negative values
+ * @return A pointer to an allocated set or NULL on error, if a value
+ *         is negative (errno is set to EINVAL) or it failed to allocate
+ *         requested memory (see errno)
+ */
+roaring *roaring_from_arraylist(const arraylist *list);
+
+/**
+ * Create a list of the values of the set, in ascending order
+ * Must be free with arraylist_delete
+ * @param set a non null pointer to a set without values above INT_MAX
+ * @return A pointer to an allocated list or NULL on error (see errno)
+ */
+arraylist *roaring_to_arraylist(const roaring *set);
+
+/**
+ * Add a value to the set. Adding to a run container decodes it, see
+ * roaring_optimize.
+ * @param set a non null pointer to a set
+ * @param value the value to add
+ * @return 0 if the value is in the set
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int roaring_add(roaring *set, uint32_t value);
+
+/**
+ * Remove a value from the set
+ * @param set a non null pointer to a set
+ * @param value the value to remove
+ * @return 1 if the value was removed
+ *         0 if it was not in the set
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int roaring_remove(roaring *set, uint32_t value);
+
+/**
+ * Check if a value is in the set
+ * @param set a non null pointer to a set
+ * @param value the value to look for
+ * @return 1 if the value is in the set
+ *         0 otherwise
+ */
+int roaring_contains(const roaring *set, uint32_t value);
+
+/**
+ * Count the values of the set
+ * @param set a non null pointer to a set
+ * @return the number of values
+ */
+uint64_t roaring_cardinality(const roaring *set);
+
+/**
+ * Compute the memory used by the containers
+ * @param set a non null pointer to a set
+ * @return the size in bytes
+ */
+size_t roaring_size_in_bytes(const roaring *set);
+
+/**
+ * Re-encode as runs the containers for which runs are smaller
+ * @param set a non null pointer to a set
+ * @return 0 if the set was optimized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int roaring_optimize(roaring *set);
+
+/**
+ * Create the union of two sets
+ * Must be free with roaring_delete
+ * @param a a non null pointer to a set
+ * @param b a non null pointer to a set
+ * @return A pointer to an allocated set or NULL on error (see errno)
+ */
+roaring *roaring_or(const roaring *a, const roaring *b);
+
+/**
+ * Create the intersection of two sets
+ * Must be free with roaring_delete
+ * @param a a non null pointer to a set
+ * @param b a non null pointer to a set
+ * @return A pointer to an allocated set or NULL on error (see errno)
+ */
+roaring *roaring_and(const roaring *a, const roaring *b);
+
+/**
+ * Call fn(ctx, value) for every value of the set, in ascending order
+ * @param set a non null pointer to a set
+ * @param fn the function to call
+ * @param ctx passed to fn
+ * @return 0 if every value was visited
+ *         the value returned by fn if it stopped the iteration
+ */
+int roaring_for_each(const roaring *set, roaring_fn fn, void *ctx);
+
+#endif
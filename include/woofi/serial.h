@@ -0,0 +1,152 @@
+#ifndef WOOFI_SERIAL_H
+#define WOOFI_SERIAL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "woofi/arraylist.h"
+#include "woofi/circularqueue.h"
+#include "woofi/roaring.h"
+#include "woofi/stack.h"
+
+#define SERIAL_MAGIC 0x53464f57 /* "WOFS" */
+#define SERIAL_VERSION 1
+
+typedef enum {
+    SERIAL_ARRAYLIST = 1,
+    SERIAL_STACK = 2,
+    SERIAL_CIRCULARQUEUE = 3,
+    SERIAL_ROARING = 4
+} serial_type;
+
+/**
+ * Header written before the elements of a container.
+ * Integers, header included, are written in host byte order: a stream
+ * written on a host of the other endianness is rejected by the readers.
+ * The elements are followed by the 64 bits Fletcher checksum of the
+ * header and the elements.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint64_t count;
+    uint64_t capacity;
+} serial_header;
+
+/**
+ * Write callback, with the same contract as write(2). Writing nothing
+ * fails the write with EIO.
+ */
+typedef ssize_t (*serial_write_fn)(void *ctx, const void *buffer, size_t size);
+
+/**
+ * Read callback, with the same contract as read(2)
+ */
+typedef ssize_t (*serial_read_fn)(void *ctx, void *buffer, size_t size);
+
+/**
+ * Where the containers are written: the write callback if not NULL,
+ * the file descriptor otherwise
+ */
+typedef struct {
+    int fd;
+    serial_write_fn write;
+    void *ctx;
+} serial_sink;
+
+/**
+ * Where the containers are read from: the read callback if not NULL,
+ * the file descriptor otherwise
+ */
+typedef struct {
+    int fd;
+    serial_read_fn read;
+    void *ctx;
+} serial_source;
+
+/**
+ * Write the list to the sink
+ * @param sink a non null pointer to a sink
+ * @param list a non null pointer to a list
+ * @return 0 if the list was written
+ *        -1 on error (see errno)
+ */
+int serial_write_arraylist(const serial_sink *sink, const arraylist *list);
+
+/**
+ * Write the stack to the sink
+ * @param sink a non null pointer to a sink
+ * @param stack a non null pointer to a stack
+ * @return 0 if the stack was written
+ *        -1 on error (see errno)
+ */
+int serial_write_stack(const serial_sink *sink, const stack *stack);
+
+/**
+ * Write the queue to the sink, from head to tail, as at most two
+ * contiguous segments
+ * @param sink a non null pointer to a sink
+ * @param queue a non null pointer to a queue
+ * @return 0 if the queue was written
+ *        -1 on error (see errno)
+ */
+int serial_write_circularqueue(const serial_sink *sink,
+                               const circularqueue *queue);
+
+/**
+ * Write the set to the sink. Every container is written with its
+ * encoding as a key, type, cardinality and length word followed by its
+ * data, padded to 32 bits. The header counts the 32 bits words after it
+ * and the containers.
+ * @param sink a non null pointer to a sink
+ * @param set a non null pointer to a set
+ * @return 0 if the set was written
+ *        -1 on error (see errno)
+ */
+int serial_write_roaring(const serial_sink *sink, const roaring *set);
+
+/**
+ * Read a list written by serial_write_arraylist.
+ * The elements are read directly in the storage of the new list.
+ * Must be free with arraylist_delete
+ * @param source a non null pointer to a source
+ * @return A pointer to an allocated list or NULL on error (see errno),
+ *         EINVAL if the stream does not hold a list, EBADMSG if it is
+ *         truncated or its checksum does not match
+ */
+arraylist *serial_read_arraylist(const serial_source *source);
+
+/**
+ * Read a stack written by serial_write_stack.
+ * Must be free with stack_delete
+ * @param source a non null pointer to a source
+ * @return A pointer to an allocated stack or NULL on error (see errno),
+ *         EINVAL if the stream does not hold a stack, EBADMSG if it is
+ *         truncated or its checksum does not match
+ */
+stack *serial_read_stack(const serial_source *source);
+
+/**
+ * Read a queue written by serial_write_circularqueue.
+ * The queue keeps the size it was created with.
+ * Must be free with circularqueue_delete
+ * @param source a non null pointer to a source
+ * @return A pointer to an allocated queue or NULL on error (see errno),
+ *         EINVAL if the stream does not hold a queue, EBADMSG if it is
+ *         truncated or its checksum does not match
+ */
+circularqueue *serial_read_circularqueue(const serial_source *source);
+
+/**
+ * Read a set written by serial_write_roaring.
+ * Must be free with roaring_delete
+ * @param source a non null pointer to a source
+ * @return A pointer to an allocated set or NULL on error (see errno),
+ *         EINVAL if the stream does not hold a set, EBADMSG if it is
+ *         truncated, its containers are malformed or its checksum does
+ *         not match
+ */
+roaring *serial_read_roaring(const serial_source *source);
+
+#endif
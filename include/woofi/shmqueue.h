@@ -0,0 +1,149 @@
+#ifndef WOOFI_SHMQUEUE_H
+#define WOOFI_SHMQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Circular queue of ints in a named POSIX shared memory segment, for one
+ * producer and one consumer which may live in different processes.
+ * The segment only holds positions, never pointers, so every process
+ * can map it anywhere. Positions are free running counters updated with
+ * atomics: inserting and removing take no syscall unless the other side
+ * sleeps in shmqueue_wait_*, which is woken through a futex.
+ * Linux only. Programs using it may need to be linked with -lrt.
+ */
+#define SHMQUEUE_MAGIC 0x51464f57 /* "WOFQ" */
+#define SHMQUEUE_VERSION 1
+#define SHMQUEUE_CACHE_LINE 64
+
+/**
+ * Header at the start of the segment, elements follow it. The consumer
+ * and the producer positions are on their own cache line.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t element_size;
+    uint64_t size; /* slots, a power of two */
+
+    uint64_t head __attribute__((aligned(SHMQUEUE_CACHE_LINE)));
+    uint32_t writable;         /* futex bumped for a waiting producer */
+    uint32_t producer_waiting;
+
+    uint64_t tail __attribute__((aligned(SHMQUEUE_CACHE_LINE)));
+    uint32_t readable;         /* futex bumped for a waiting consumer */
+    uint32_t consumer_waiting;
+} shmqueue_header;
+
+/**
+ * A process' handle on a queue. The positions of the other side are
+ * cached to read its cache line only when the queue looks full or empty.
+ */
+typedef struct {
+    shmqueue_header *header;
+    int *element;
+    size_t mask;
+    size_t length; /* bytes mapped */
+    uint64_t cached_head;
+    uint64_t cached_tail;
+} shmqueue;
+
+/**
+ * Create a shared memory segment holding an empty queue and attach it
+ * Must be free with shmqueue_detach, the segment with shmqueue_unlink
+ * @param name the name of the segment, as for shm_open
+ * @param size the number of slots, rounded up to a power of two
+ * @return A pointer to an attached queue or NULL on error (see errno),
+ *         EEXIST if the segment exists
+ */
+shmqueue *shmqueue_create(const char *name, size_t size);
+
+/**
+ * Attach a queue created by another process, or by this one
+ * Must be free with shmqueue_detach
+ * @param name the name of the segment
+ * @return A pointer to an attached queue or NULL on error (see errno),
+ *         EINVAL if the segment is not a queue
+ */
+shmqueue *shmqueue_attach(const char *name);
+
+/**
+ * Unmap the queue and free the handle, the segment stays
+ * @param queue a non null pointer to a queue
+ */
+void shmqueue_detach(shmqueue *queue);
+
+/**
+ * Remove the name of a segment, it is freed once every process detached
+ * @param name the name of the segment
+ * @return 0 if the segment was removed
+ *        -1 on error (see errno)
+ */
+int shmqueue_unlink(const char *name);
+
+/**
+ * Insert a value at the tail of the queue, only from the producer
+ * @param queue a non null pointer to a queue
+ * @param value the value to insert
+ * @return 0 if the value was inserted
+ *        -1 if the queue is full, errno is set to EAGAIN
+ */
+int shmqueue_insert(shmqueue *queue, int value);
+
+/**
+ * Insert as many values as there are free slots, only from the producer
+ * @param queue a non null pointer to a queue
+ * @param values the values to insert
+ * @param count the number of values
+ * @return the number of values inserted
+ */
+size_t shmqueue_insert_range(shmqueue *queue, const int *values,
+                             size_t count);
+
+/**
+ * Remove the value at the head of the queue, only from the consumer
+ * @param queue a non null pointer to a queue
+ * @param value a non null pointer to store the value
+ * @return 0 if a value was removed
+ *        -1 if the queue is empty, errno is set to EAGAIN
+ */
+int shmqueue_remove(shmqueue *queue, int *value);
+
+/**
+ * Remove up to count values, only from the consumer
+ * @param queue a non null pointer to a queue
+ * @param values a buffer of count values
+ * @param count the maximum number of values to remove
+ * @return the number of values removed
+ */
+size_t shmqueue_remove_range(shmqueue *queue, int *values, size_t count);
+
+/**
+ * Sleep until the queue holds a value, only from the consumer
+ * @param queue a non null pointer to a queue
+ * @param timeout the maximum time to wait in milliseconds, forever if
+ *  negative
+ * @return 0 if the queue is not empty
+ *        -1 on error (see errno), ETIMEDOUT or EINTR
+ */
+int shmqueue_wait_readable(shmqueue *queue, int timeout);
+
+/**
+ * Sleep until the queue has a free slot, only from the producer
+ * @param queue a non null pointer to a queue
+ * @param timeout the maximum time to wait in milliseconds, forever if
+ *  negative
+ * @return 0 if the queue is not full
+ *        -1 on error (see errno), ETIMEDOUT or EINTR
+ */
+int shmqueue_wait_writable(shmqueue *queue, int timeout);
+
+/**
+ * Count the values in the queue, from any process
+ * @param queue a non null pointer to a queue
+ * @return the number of values in the queue
+ */
+size_t shmqueue_count(const shmqueue *queue);
+
+#endif
@@ -1,9 +1,16 @@
+#ifndef WOOFI_STACK_H
+#define WOOFI_STACK_H
+
+#include "woofi/capacity.h"
+#include "woofi/textio.h"
+
 #define INITIAL_STACK_SIZE 100
 
 typedef struct {
     size_t size;
     size_t head;
     int *element;
+    capacity_policy policy;
 } stack;
 
 /**
@@ -19,6 +26,33 @@ stack *stack_create();
  */
 void stack_delete(stack *stack);
 
+/**
+ * Change how the stack grows and shrinks.
+ * Stacks are created with CAPACITY_POLICY_DEFAULT
+ * @param stack a non null pointer to a stack
+ * @param policy a non null pointer to the policy to copy
+ * @return 0 if the policy was changed
+ *        -1 if the policy is not valid (errno is set to EINVAL)
+ */
+int stack_set_policy(stack *stack, const capacity_policy *policy);
+
+/**
+ * Make sure the stack can hold at least size elements without growing
+ * @param stack a non null pointer to a stack
+ * @param size the number of elements to hold
+ * @return 0 if the stack is large enough
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int stack_reserve(stack *stack, size_t size);
+
+/**
+ * Release the memory not used by the elements of the stack
+ * @param stack a non null pointer to a stack
+ * @return 0 if the stack was shrunk
+ *        -1 on error, if it failed to reallocate memory (see errno)
+ */
+int stack_shrink_to_fit(stack *stack);
+
 /**
  * Check if the stack is empty or not
  * @param stack a non null pointer to a stack
@@ -28,11 +62,33 @@ void stack_delete(stack *stack);
 int stack_is_empty(const stack *stack);
 
 /**
- * Print the stack on STDOUT at format [X,Y,Z]
+ * Print the stack on STDOUT at format [X,Y,Z], from bottom to head
  * @param stack a non null pointer to a stack
  */
 void stack_print(const stack *stack);
 
+/**
+ * Write the stack to a file descriptor, from bottom to head, by chunks of
+ * TEXTIO_BUFFER_SIZE
+ * @param stack a non null pointer to a stack
+ * @param fd the file descriptor to write to
+ * @param format the output format
+ * @return 0 if the stack was written
+ *        -1 on error (see errno)
+ */
+int stack_write(const stack *stack, int fd, textio_format format);
+
+/**
+ * Write the stack to a stdio stream, from bottom to head, by chunks of
+ * TEXTIO_BUFFER_SIZE
+ * @param stack a non null pointer to a stack
+ * @param file a non null pointer to the stream to write to
+ * @param format the output format
+ * @return 0 if the stack was written
+ *        -1 on error (see errno)
+ */
+int stack_fwrite(const stack *stack, FILE *file, textio_format format);
+
 /**
  * Insert element at the head of the stack
  * @param stack a non null pointer to a stack
@@ -60,7 +116,9 @@ size_t stack_count(const stack *stack);
 
 /**
  * Return the head of the stack
- * @param stack a non null pointer to a stack
+ * @param stack a non null pointer to a non empty stack
  * @return the head of the stack
  */
 int stack_head(const stack *stack);
+
+#endif
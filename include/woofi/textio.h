@@ -0,0 +1,61 @@
+#ifndef WOOFI_TEXTIO_H
+#define WOOFI_TEXTIO_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Output is written, and input read, by chunks of this size */
+#define TEXTIO_BUFFER_SIZE 65536
+
+typedef enum {
+    TEXTIO_LIST,  /* [X, Y, Z, ] followed by a new line, as *_print */
+    TEXTIO_LINES, /* one value per line */
+    TEXTIO_CSV    /* X,Y,Z followed by a new line */
+} textio_format;
+
+/**
+ * Called by textio_read_ints for every batch of parsed values
+ * @return 0 to continue parsing
+ *        -1 to stop, the error is returned by textio_read_ints
+ */
+typedef int (*textio_emit_fn)(void *ctx, const int *values, size_t count);
+
+/**
+ * Format values made of up to two segments and write them to a file
+ * descriptor, one write per TEXTIO_BUFFER_SIZE chunk
+ * @param fd the file descriptor to write to
+ * @param format the output format
+ * @param first the first segment of values
+ * @param first_count the number of values in the first segment
+ * @param second the second segment, may be NULL if second_count is 0
+ * @param second_count the number of values in the second segment
+ * @return 0 if the values were written
+ *        -1 on error (see errno)
+ */
+int textio_write_ints(int fd, textio_format format,
+                      const int *first, size_t first_count,
+                      const int *second, size_t second_count);
+
+/**
+ * Same as textio_write_ints but to a stdio stream, one fwrite per chunk
+ * @param file a non null pointer to the stream to write to
+ * @return 0 if the values were written
+ *        -1 on error (see errno)
+ */
+int textio_fwrite_ints(FILE *file, textio_format format,
+                       const int *first, size_t first_count,
+                       const int *second, size_t second_count);
+
+/**
+ * Parse every decimal integer read from a file descriptor until end of
+ * file. Anything else than digits and a leading '-' separates values, so
+ * every textio_format can be read back.
+ * @param fd the file descriptor to read from
+ * @param emit called with the values, by batches
+ * @param ctx passed to emit
+ * @return the number of values parsed
+ *        -1 on error (see errno), ERANGE if a value does not fit an int
+ */
+ssize_t textio_read_ints(int fd, textio_emit_fn emit, void *ctx);
+
+#endif
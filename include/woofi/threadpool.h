@@ -0,0 +1,134 @@
+#ifndef WOOFI_THREADPOOL_H
+#define WOOFI_THREADPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * Task run by the pool, index is given by the submitter
+ */
+typedef void (*threadpool_fn)(void *ctx, size_t index);
+
+typedef struct {
+    threadpool_fn fn;
+    void *ctx;
+    size_t index;
+} threadpool_task;
+
+/**
+ * Set of tasks that can be waited for together.
+ * Must be zero initialized before the first submission.
+ */
+typedef struct {
+    size_t pending;
+} threadpool_group;
+
+typedef struct {
+    threadpool_task task;
+    threadpool_group *group;
+} threadpool_entry;
+
+/**
+ * Circular queue of tasks. The owner pushes and pops at the tail,
+ * other threads steal from the head.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    threadpool_entry *entry;
+    size_t size;
+    size_t head;
+    size_t tail;
+    size_t count;
+} threadpool_queue;
+
+/**
+ * Fixed set of worker threads scheduling tasks.
+ * Every worker owns a local queue; queue 0 is the global injection queue
+ * used by threads outside the pool. Idle workers take tasks from their
+ * own queue, then from the injection queue, then steal from the others.
+ * Programs using it must be linked with -lpthread.
+ */
+typedef struct {
+    pthread_t *threads;
+    size_t size;
+    threadpool_queue *queue;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    size_t queued;
+    size_t idle;
+    size_t started;
+    int stop;
+    threadpool_group group;
+} threadpool;
+
+/**
+ * Create a new thread pool.
+ * The threads waiting for a group take part in running the tasks, so
+ * size - 1 threads are started.
+ * Must be free with threadpool_delete
+ * @param size the number of threads running tasks, 0 for the number of
+ *        online processors
+ * @return A pointer to an allocated pool or NULL on error (see errno)
+ */
+threadpool *threadpool_create(size_t size);
+
+/**
+ * Stop the threads and free all used memory by the pool.
+ * Tasks still queued are run before the threads stop.
+ * @param pool a non null pointer to a pool
+ */
+void threadpool_delete(threadpool *pool);
+
+/**
+ * Get the number of threads running tasks, the caller included
+ * @param pool a non null pointer to a pool
+ * @return the number of threads
+ */
+size_t threadpool_size(const threadpool *pool);
+
+/**
+ * Queue fn(ctx, 0) on the pool. A task submitted from a worker goes to
+ * its local queue, from any other thread to the injection queue.
+ * @param pool a non null pointer to a pool
+ * @param group the group of the task, NULL for the pool's own group
+ * @param fn the task to run
+ * @param ctx passed to fn
+ * @return 0 if the task was queued
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+int threadpool_submit(threadpool *pool, threadpool_group *group,
+                      threadpool_fn fn, void *ctx);
+
+/**
+ * Queue several tasks at once, taking the queue lock and waking the
+ * workers only once
+ * @param pool a non null pointer to a pool
+ * @param group the group of the tasks, NULL for the pool's own group
+ * @param tasks a non null pointer to count tasks
+ * @param count the number of tasks
+ * @return 0 if every task was queued
+ *        -1 on error, no task was queued (see errno)
+ */
+int threadpool_submit_batch(threadpool *pool, threadpool_group *group,
+                            const threadpool_task *tasks, size_t count);
+
+/**
+ * Run queued tasks until every task of the group returned.
+ * Can be called from a task.
+ * @param pool a non null pointer to a pool
+ * @param group the group to wait for, NULL for the pool's own group
+ */
+void threadpool_wait(threadpool *pool, threadpool_group *group);
+
+/**
+ * Run fn(ctx, index) for every index in [0, count) on the pool and wait
+ * for all of them to return. Can be called from a task.
+ * @param pool a non null pointer to a pool
+ * @param fn the task to run
+ * @param ctx passed to fn
+ * @param count the number of tasks
+ */
+void threadpool_run(threadpool *pool, threadpool_fn fn, void *ctx,
+                    size_t count);
+
+#endif
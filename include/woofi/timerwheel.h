@@ -0,0 +1,110 @@
+#ifndef WOOFI_TIMERWHEEL_H
+#define WOOFI_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "woofi/circularqueue.h"
+
+/*
+ * Hierarchical hashed timer wheel. Level l has TIMERWHEEL_SLOTS slots of
+ * TIMERWHEEL_SLOTS^l ticks each; a timer sits in the lowest level whose
+ * span holds its deadline and moves down a level each time the wheel
+ * reaches its slot. Deadlines further than TIMERWHEEL_RANGE ticks go in
+ * the top level and are placed again when reached.
+ */
+#define TIMERWHEEL_BITS 8
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_BITS)
+#define TIMERWHEEL_LEVELS 4
+#define TIMERWHEEL_RANGE \
+    ((uint64_t)1 << (TIMERWHEEL_BITS * TIMERWHEEL_LEVELS))
+
+/* Handle of a timer, 0 is never a valid handle */
+typedef uint64_t timerwheel_timer;
+
+/**
+ * Called when a timer expires, the timer is no longer pending
+ */
+typedef void (*timerwheel_fn)(void *ctx, timerwheel_timer timer);
+
+typedef struct {
+    uint64_t deadline;
+    timerwheel_fn fn;
+    void *ctx;
+    uint32_t generation;
+    int next_free;
+    int state;
+} timerwheel_entry;
+
+/**
+ * Slots are circular queues of indexes in the timer table, created on
+ * first use. A cancelled timer stays in its slot until the wheel reaches
+ * it, so cancel does not search the slot.
+ */
+typedef struct {
+    uint64_t now;
+    size_t count;
+    size_t queued;
+    timerwheel_entry *timer;
+    size_t size;
+    size_t used;
+    int free;
+    circularqueue *slot[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+    uint64_t occupied[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS / 64];
+} timerwheel;
+
+/**
+ * Create a new timer wheel
+ * Must be free with timerwheel_delete
+ * @param now the current tick
+ * @return A pointer to an allocated wheel or NULL on error (see errno)
+ */
+timerwheel *timerwheel_create(uint64_t now);
+
+/**
+ * Free all used memory by the wheel, pending timers never expire
+ * @param wheel a non null pointer to a wheel
+ */
+void timerwheel_delete(timerwheel *wheel);
+
+/**
+ * Count the pending timers of the wheel
+ * @param wheel a non null pointer to a wheel
+ * @return the number of pending timers
+ */
+size_t timerwheel_count(const timerwheel *wheel);
+
+/**
+ * Schedule fn(ctx, timer) to be called once the wheel reaches
+ * now + delay, in O(1)
+ * @param wheel a non null pointer to a wheel
+ * @param delay the number of ticks to wait, 0 is handled as 1
+ * @param fn the function to call
+ * @param ctx passed to fn
+ * @return the handle of the timer
+ *         0 on error, if it failed to allocate requested memory (see errno)
+ */
+timerwheel_timer timerwheel_schedule(timerwheel *wheel, uint64_t delay,
+                                     timerwheel_fn fn, void *ctx);
+
+/**
+ * Cancel a pending timer, in O(1)
+ * @param wheel a non null pointer to a wheel
+ * @param timer the handle returned by timerwheel_schedule
+ * @return 1 if the timer was cancelled
+ *         0 if it already expired or was cancelled
+ */
+int timerwheel_cancel(timerwheel *wheel, timerwheel_timer timer);
+
+/**
+ * Move the wheel to the tick now and call every timer expiring up to it,
+ * the timers of a tick being expired together. Ticks reaching only empty
+ * slots are skipped using a bitmap of the used slots.
+ * Callbacks can schedule and cancel timers but not advance the wheel.
+ * @param wheel a non null pointer to a wheel
+ * @param now the new current tick, earlier ticks are ignored
+ * @return the number of expired timers
+ */
+size_t timerwheel_advance(timerwheel *wheel, uint64_t now);
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef WOOFI_WINDOW_H
+#define WOOFI_WINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Sliding window of int samples with its sum, mean, variance, minimum and
+ * maximum, either over the last N samples or over the samples of the
+ * last span of time. Samples are numbered by free running sequences and
+ * kept in a ring, like circularqueue. Two monotonic queues of sequences
+ * follow the minimum and the maximum: a new sample drops the samples
+ * it dominates from their tails and the window drops its oldest sample
+ * from their heads, so every sample enters and leaves each queue once.
+ * Pushing and evicting are amortized O(1), queries are O(1). The sums
+ * are integers, exact for windows of less than 2^32 samples, so the
+ * variance does not drift however long the window streams.
+ */
+#define WINDOW_MIN_CAPACITY 16
+
+typedef struct {
+    int value;
+    uint64_t time;
+} window_sample;
+
+typedef struct {
+    window_sample *sample;
+    uint64_t *min_queue;  /* sequences of increasing values */
+    uint64_t *max_queue;  /* sequences of decreasing values */
+    size_t capacity;      /* a power of two */
+    size_t mask;
+    uint64_t first;       /* sequence of the oldest sample */
+    uint64_t next;        /* sequence of the next sample */
+    uint64_t min_head;
+    uint64_t min_tail;
+    uint64_t max_head;
+    uint64_t max_tail;
+    size_t length;        /* samples of a count window, 0 for a time window */
+    uint64_t span;        /* time covered by a time window */
+    int64_t sum;
+    unsigned __int128 sum_squares;
+} window;
+
+/**
+ * Create a window over the last length samples
+ * Must be free with window_delete
+ * @param length the number of samples, at least 1
+ * @return A pointer to an allocated window or NULL on error (see errno)
+ */
+window *window_create_count(size_t length);
+
+/**
+ * Create a window over the samples of the last span of time, a sample
+ * pushed at time t leaves it once the time reaches t + span
+ * Must be free with window_delete
+ * @param span the time covered, in any unit, at least 1
+ * @return A pointer to an allocated window or NULL on error (see errno)
+ */
+window *window_create_time(uint64_t span);
+
+/**
+ * Free all used memory by the window
+ * @param window a non null pointer to a window
+ */
+void window_delete(window *window);
+
+/**
+ * Add a sample, evicting the oldest one from a full count window or the
+ * samples which are too old from a time window
+ * @param window a non null pointer to a window
+ * @param value the value of the sample
+ * @param time the time of the sample, never below the previous one,
+ *  ignored by count windows
+ * @return 0 if the sample was added
+ *        -1 on error (see errno), EINVAL if the time went backwards
+ */
+int window_push(window *window, int value, uint64_t time);
+
+/**
+ * Evict the samples of a time window which are too old at a given time,
+ * when no sample was pushed for a while
+ * @param window a non null pointer to a window
+ * @param now the current time, never below the time of the last sample
+ * @return the number of samples evicted
+ */
+size_t window_evict(window *window, uint64_t now);
+
+/**
+ * Evict every sample
+ * @param window a non null pointer to a window
+ */
+void window_clear(window *window);
+
+/**
+ * Count the samples in the window
+ * @param window a non null pointer to a window
+ * @return the number of samples
+ */
+size_t window_count(const window *window);
+
+/**
+ * Check if the window is empty or not
+ * @param window a non null pointer to a window
+ * @return 0 if the window is not empty
+ *         1 if it's empty
+ */
+int window_is_empty(const window *window);
+
+/**
+ * Get the smallest value of the window
+ * @param window a non null pointer to a non empty window
+ * @return the minimum
+ */
+int window_min(const window *window);
+
+/**
+ * Get the largest value of the window
+ * @param window a non null pointer to a non empty window
+ * @return the maximum
+ */
+int window_max(const window *window);
+
+/**
+ * Get the sum of the values of the window
+ * @param window a non null pointer to a window
+ * @return the sum, 0 if the window is empty
+ */
+int64_t window_sum(const window *window);
+
+/**
+ * Get the mean of the values of the window
+ * @param window a non null pointer to a window
+ * @return the mean, 0 if the window is empty
+ */
+double window_mean(const window *window);
+
+/**
+ * Get the population variance of the values of the window
+ * @param window a non null pointer to a window
+ * @return the variance, 0 if the window is empty
+ */
+double window_variance(const window *window);
+
+#endif
@@ -0,0 +1,573 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/adaptivelist.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#if defined(__SSE2__) && !defined(WOOFI_NO_SSE2)
+# define ADAPTIVELIST_SSE2
+# include <emmintrin.h>
+#endif
+
+#define ADAPTIVELIST_INITIAL_LENGTH 100
+
+static const capacity_policy adaptivelist_policy = CAPACITY_POLICY_DEFAULT;
+
+/**
+ * Smallest cell width holding value
+ */
+static inline size_t adaptivelist_width(int value) {
+    if (value >= INT8_MIN && value <= INT8_MAX) {
+        return sizeof(int8_t);
+    }
+    if (value >= INT16_MIN && value <= INT16_MAX) {
+        return sizeof(int16_t);
+    }
+    return sizeof(int32_t);
+}
+
+static inline int adaptivelist_load(const void *cell, size_t width,
+                                    size_t index) {
+    switch (width) {
+    case sizeof(int8_t):
+        return ((const int8_t *)cell)[index];
+    case sizeof(int16_t):
+        return ((const int16_t *)cell)[index];
+    default:
+        return ((const int32_t *)cell)[index];
+    }
+}
+
+static inline void adaptivelist_store(void *cell, size_t width, size_t index,
+                                      int value) {
+    switch (width) {
+    case sizeof(int8_t):
+        ((int8_t *)cell)[index] = value;
+        break;
+    case sizeof(int16_t):
+        ((int16_t *)cell)[index] = value;
+        break;
+    default:
+        ((int32_t *)cell)[index] = value;
+        break;
+    }
+}
+
+/**
+ * Change the capacity and the cell width of the list. Values are moved
+ * in place, from the last one when widening and from the first one when
+ * narrowing, so no cell is overwritten before it is read.
+ * @param list a non null pointer to a list
+ * @param length the new capacity, at least the number of elements
+ * @param width the new cell width, holding every value
+ * @return 0 if list was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int adaptivelist_resize(adaptivelist *list, size_t length,
+                               size_t width) {
+    void *cell = NULL;
+
+    if (width < list->width) {
+        for (size_t i = 0; i < list->count; i++) {
+            adaptivelist_store(list->cell, width, i,
+                               adaptivelist_load(list->cell, list->width, i));
+        }
+        list->width = width;
+    }
+
+    cell = realloc(list->cell, length * width);
+    if (cell == NULL) {
+        return -1;
+    }
+    list->cell = cell;
+    list->length = length;
+
+    if (width > list->width) {
+        for (size_t i = list->count; i > 0; i--) {
+            adaptivelist_store(cell, width, i - 1,
+                               adaptivelist_load(cell, list->width, i - 1));
+        }
+        list->width = width;
+    }
+
+    return 0;
+}
+
+/**
+ * Make room for one more value, widening the cells if value needs it
+ * @param list a non null pointer to a list
+ * @param value the value about to be inserted
+ * @return 0 if the value can be stored
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int adaptivelist_prepare(adaptivelist *list, int value) {
+    size_t width = adaptivelist_width(value);
+    size_t length = list->length;
+
+    if (list->count == list->length) {
+        length = capacity_grow(&list->policy, list->length, list->count + 1);
+    }
+    if (width <= list->width && length == list->length) {
+        return 0;
+    }
+
+    return adaptivelist_resize(list, length,
+                               width > list->width ? width : list->width);
+}
+
+/**
+ * Shrink the list if its capacity policy asks for it after a removal.
+ * Failing to shrink leaves the list as it was.
+ * @param list a non null pointer to a list
+ */
+static void adaptivelist_autoshrink(adaptivelist *list) {
+    size_t length = capacity_shrink(&list->policy, list->length, list->count);
+
+    if (length < list->length) {
+        adaptivelist_resize(list, length, list->width);
+    }
+}
+
+adaptivelist *adaptivelist_create() {
+    adaptivelist *list = NULL;
+
+    list = malloc(sizeof(*list));
+    if (list == NULL) {
+        return NULL;
+    }
+
+    list->count = 0;
+    list->length = ADAPTIVELIST_INITIAL_LENGTH;
+    list->width = sizeof(int8_t);
+    list->policy = adaptivelist_policy;
+    list->cell = malloc(list->length * list->width);
+    if (list->cell == NULL) {
+        free(list);
+        return NULL;
+    }
+
+    return list;
+}
+
+void adaptivelist_delete(adaptivelist *list) {
+    assert(list);
+
+    free(list->cell);
+    free(list);
+}
+
+adaptivelist *adaptivelist_from_arraylist(const arraylist *list) {
+    adaptivelist *result = NULL;
+    size_t width = sizeof(int8_t);
+
+    assert(list);
+
+    for (size_t i = 0; i < list->count && width < sizeof(int32_t); i++) {
+        size_t needed = adaptivelist_width(list->element[i]);
+
+        if (needed > width) {
+            width = needed;
+        }
+    }
+
+    result = adaptivelist_create();
+    if (result == NULL) {
+        return NULL;
+    }
+    if (list->count > result->length || width > result->width) {
+        size_t length = list->count > result->length ? list->count
+                                                     : result->length;
+
+        if (adaptivelist_resize(result, length, width) == -1) {
+            int error = errno;
+            adaptivelist_delete(result);
+            errno = error;
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        adaptivelist_store(result->cell, width, i, list->element[i]);
+    }
+    result->count = list->count;
+
+    return result;
+}
+
+arraylist *adaptivelist_to_arraylist(const adaptivelist *list) {
+    arraylist *result = NULL;
+
+    assert(list);
+
+    result = arraylist_create();
+    if (result == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(result, list->count) == -1) {
+        int error = errno;
+        arraylist_delete(result);
+        errno = error;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        result->element[i] = adaptivelist_load(list->cell, list->width, i);
+    }
+    result->count = list->count;
+
+    return result;
+}
+
+int adaptivelist_set_policy(adaptivelist *list, const capacity_policy *policy) {
+    assert(list);
+
+    if (!capacity_policy_valid(policy)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    list->policy = *policy;
+
+    return 0;
+}
+
+int adaptivelist_reserve(adaptivelist *list, size_t length) {
+    assert(list);
+
+    if (length <= list->length) {
+        return 0;
+    }
+
+    return adaptivelist_resize(list, length, list->width);
+}
+
+int adaptivelist_shrink_to_fit(adaptivelist *list) {
+    size_t width = sizeof(int8_t);
+    size_t length;
+
+    assert(list);
+
+    for (size_t i = 0; i < list->count && width < list->width; i++) {
+        size_t needed = adaptivelist_width(
+            adaptivelist_load(list->cell, list->width, i));
+
+        if (needed > width) {
+            width = needed;
+        }
+    }
+
+    length = list->count ? list->count : 1;
+    if (length >= list->length && width == list->width) {
+        return 0;
+    }
+
+    return adaptivelist_resize(list, length, width);
+}
+
+size_t adaptivelist_size_in_bytes(const adaptivelist *list) {
+    assert(list);
+
+    return list->length * list->width;
+}
+
+int adaptivelist_is_empty(const adaptivelist *list) {
+    assert(list);
+
+    return list->count == 0;
+}
+
+int adaptivelist_insert_front(adaptivelist *list, int value) {
+    return adaptivelist_insert_at(list, 0, value);
+}
+
+int adaptivelist_insert_last(adaptivelist *list, int value) {
+    assert(list);
+
+    if (adaptivelist_prepare(list, value) == -1) {
+        return -1;
+    }
+
+    adaptivelist_store(list->cell, list->width, list->count, value);
+    list->count++;
+
+    return 0;
+}
+
+int adaptivelist_insert_at(adaptivelist *list, size_t index, int value) {
+    char *cell;
+
+    assert(list);
+
+    if (adaptivelist_prepare(list, value) == -1) {
+        return -1;
+    }
+
+    if (index > list->count) {
+        index = list->count;
+    }
+    cell = list->cell;
+    memmove(cell + (index + 1) * list->width, cell + index * list->width,
+            (list->count - index) * list->width);
+
+    adaptivelist_store(list->cell, list->width, index, value);
+    list->count++;
+
+    return 0;
+}
+
+#ifdef ADAPTIVELIST_SSE2
+/*
+ * Compare 16 bytes of cells at once, so narrower cells scan more values
+ * per load. The tail is left to the scalar loop.
+ * @return the index of the value or the number of cells compared
+ */
+static size_t adaptivelist_find_sse2(const adaptivelist *list, int value) {
+    const char *cell = list->cell;
+    size_t bytes = list->count * list->width;
+    size_t offset = 0;
+    __m128i needle;
+
+    switch (list->width) {
+    case sizeof(int8_t):
+        needle = _mm_set1_epi8((char)value);
+        break;
+    case sizeof(int16_t):
+        needle = _mm_set1_epi16((short)value);
+        break;
+    default:
+        needle = _mm_set1_epi32(value);
+        break;
+    }
+
+    for (; offset + sizeof(__m128i) <= bytes; offset += sizeof(__m128i)) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(cell + offset));
+        __m128i equal;
+        int mask;
+
+        switch (list->width) {
+        case sizeof(int8_t):
+            equal = _mm_cmpeq_epi8(block, needle);
+            break;
+        case sizeof(int16_t):
+            equal = _mm_cmpeq_epi16(block, needle);
+            break;
+        default:
+            equal = _mm_cmpeq_epi32(block, needle);
+            break;
+        }
+
+        mask = _mm_movemask_epi8(equal);
+        if (mask) {
+            return (offset + __builtin_ctz(mask)) / list->width;
+        }
+    }
+
+    return offset / list->width;
+}
+#endif
+
+/**
+ * Find the first occurrence of a value, cells being compared at their
+ * own width
+ * @return the index of the value or list->count if it is not in list
+ */
+static size_t adaptivelist_find(const adaptivelist *list, int value) {
+    size_t i = 0;
+
+    if (adaptivelist_width(value) > list->width) {
+        return list->count;
+    }
+
+#ifdef ADAPTIVELIST_SSE2
+    i = adaptivelist_find_sse2(list, value);
+#endif
+    while (i < list->count
+           && adaptivelist_load(list->cell, list->width, i) != value) {
+        i++;
+    }
+
+    return i;
+}
+
+int adaptivelist_remove_value(adaptivelist *list, int value) {
+    assert(list);
+
+    size_t index = adaptivelist_find(list, value);
+    if (index == list->count) {
+        return 0;
+    }
+
+    return adaptivelist_remove_at(list, index);
+}
+
+int adaptivelist_remove_at(adaptivelist *list, size_t index) {
+    char *cell;
+
+    assert(list);
+
+    if (adaptivelist_is_empty(list)) {
+        return 0;
+    }
+
+    if (index >= list->count) {
+        index = list->count - 1;
+    }
+    cell = list->cell;
+    memmove(cell + index * list->width, cell + (index + 1) * list->width,
+            (list->count - index - 1) * list->width);
+
+    list->count--;
+    adaptivelist_autoshrink(list);
+
+    return 1;
+}
+
+int adaptivelist_contains(const adaptivelist *list, int value) {
+    assert(list);
+
+    return adaptivelist_find(list, value) < list->count;
+}
+
+int adaptivelist_fast_get(const adaptivelist *list, size_t index) {
+    assert(list);
+    assert(index < list->count);
+
+    return adaptivelist_load(list->cell, list->width, index);
+}
+
+int adaptivelist_get(const adaptivelist *list, size_t index, int *found) {
+    assert(list);
+
+    if (index >= list->count) {
+        if (found) {
+            *found = 0;
+        }
+        return 0;
+    }
+
+    if (found) {
+        *found = 1;
+    }
+
+    return adaptivelist_load(list->cell, list->width, index);
+}
+
+size_t adaptivelist_count(const adaptivelist *list) {
+    assert(list);
+
+    return list->count;
+}
+
+#ifdef WITH_TEST
+Test(Adaptivelist, widen) {
+    adaptivelist *list = adaptivelist_create();
+    int found = 0;
+
+    cr_assert(list);
+    cr_assert(list->width == 1);
+    for (int i = 0; i < 300; i++) {
+        cr_assert(adaptivelist_insert_last(list, i % 100 - 50) == 0);
+    }
+    cr_assert(list->width == 1);
+    cr_assert(adaptivelist_size_in_bytes(list) == list->length);
+
+    cr_assert(adaptivelist_insert_last(list, -129) == 0);
+    cr_assert(list->width == 2);
+    cr_assert(adaptivelist_insert_front(list, 40000) == 0);
+    cr_assert(list->width == 4);
+    cr_assert(adaptivelist_insert_at(list, 5, INT_MIN) == 0);
+
+    cr_assert(adaptivelist_count(list) == 303);
+    cr_assert(adaptivelist_fast_get(list, 0) == 40000);
+    cr_assert(adaptivelist_fast_get(list, 1) == -50);
+    cr_assert(adaptivelist_fast_get(list, 5) == INT_MIN);
+    cr_assert(adaptivelist_fast_get(list, 6) == -46);
+    cr_assert(adaptivelist_fast_get(list, 302) == -129);
+    cr_assert(adaptivelist_get(list, 303, &found) == 0);
+    cr_assert_not(found);
+
+    adaptivelist_delete(list);
+}
+
+Test(Adaptivelist, remove_narrow) {
+    adaptivelist *list = adaptivelist_create();
+
+    for (int i = 0; i < 10; i++) {
+        adaptivelist_insert_last(list, i);
+    }
+    adaptivelist_insert_last(list, 1000);
+    cr_assert(list->width == 2);
+
+    /* A value wider than the cells can't be there */
+    cr_assert_not(adaptivelist_contains(list, 100000));
+    cr_assert(adaptivelist_contains(list, 1000));
+    cr_assert(adaptivelist_remove_value(list, 1000) == 1);
+    cr_assert(adaptivelist_remove_value(list, 1000) == 0);
+    cr_assert(adaptivelist_remove_at(list, 0) == 1);
+    cr_assert(adaptivelist_fast_get(list, 0) == 1);
+
+    cr_assert(adaptivelist_shrink_to_fit(list) == 0);
+    cr_assert(list->width == 1);
+    cr_assert(list->length == 9);
+    for (int i = 0; i < 9; i++) {
+        cr_assert(adaptivelist_fast_get(list, i) == i + 1);
+    }
+    cr_assert(adaptivelist_contains(list, 9));
+    cr_assert_not(adaptivelist_contains(list, -1));
+
+    adaptivelist_delete(list);
+}
+
+Test(Adaptivelist, contains_widths) {
+    int values[] = { -7, -3000, -100000 };
+
+    for (size_t w = 0; w < sizeof(values) / sizeof(values[0]); w++) {
+        adaptivelist *list = adaptivelist_create();
+
+        adaptivelist_insert_last(list, values[w]);
+        for (int i = 0; i < 1000; i++) {
+            adaptivelist_insert_last(list, i % 100);
+        }
+        cr_assert(list->width == 1u << w);
+        for (int i = 0; i < 100; i++) {
+            cr_assert(adaptivelist_contains(list, i));
+        }
+        cr_assert_not(adaptivelist_contains(list, 100));
+        cr_assert_not(adaptivelist_contains(list, values[w] + 1));
+        cr_assert(adaptivelist_remove_value(list, 99) == 1);
+        cr_assert(adaptivelist_fast_get(list, 100) == 0);
+        cr_assert(adaptivelist_remove_value(list, 0) == 1);
+        cr_assert(adaptivelist_fast_get(list, 0) == values[w]);
+        cr_assert(adaptivelist_fast_get(list, 1) == 1);
+
+        adaptivelist_delete(list);
+    }
+}
+
+Test(Adaptivelist, arraylist) {
+    arraylist *list = arraylist_create();
+
+    for (int i = 0; i < 1000; i++) {
+        arraylist_insert_last(list, i * 30 - 15000);
+    }
+
+    adaptivelist *adaptive = adaptivelist_from_arraylist(list);
+    cr_assert(adaptive);
+    cr_assert(adaptive->width == 2);
+    cr_assert(adaptivelist_count(adaptive) == 1000);
+
+    arraylist *copy = adaptivelist_to_arraylist(adaptive);
+    cr_assert(copy->count == list->count);
+    cr_assert(memcmp(copy->element, list->element,
+                     list->count * sizeof(int)) == 0);
+
+    arraylist_delete(copy);
+    adaptivelist_delete(adaptive);
+    arraylist_delete(list);
+}
+#endif
@@ -0,0 +1,135 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/allocator.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static void *allocator_libc_allocate(void *context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void *allocator_libc_reallocate(void *context, void *ptr,
+                                       size_t old_size, size_t size) {
+    (void)context;
+    (void)old_size;
+    return realloc(ptr, size);
+}
+
+static void allocator_libc_release(void *context, void *ptr, size_t size) {
+    (void)context;
+    (void)size;
+    free(ptr);
+}
+
+static const allocator allocator_libc = {
+    allocator_libc_allocate,
+    allocator_libc_reallocate,
+    allocator_libc_release,
+    NULL
+};
+
+static allocator allocator_current = {
+    allocator_libc_allocate,
+    allocator_libc_reallocate,
+    allocator_libc_release,
+    NULL
+};
+
+void allocator_set(const allocator *hooks) {
+    if (hooks == NULL) {
+        hooks = &allocator_libc;
+    }
+
+    assert(hooks->allocate && hooks->reallocate && hooks->release);
+    allocator_current = *hooks;
+}
+
+const allocator *allocator_get() {
+    return &allocator_current;
+}
+
+void *allocator_malloc(size_t size) {
+    return allocator_current.allocate(allocator_current.context, size);
+}
+
+void *allocator_calloc(size_t count, size_t size) {
+    void *ptr = NULL;
+
+    if (size && count > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ptr = allocator_malloc(count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+void *allocator_realloc(void *ptr, size_t old_size, size_t size) {
+    return allocator_current.reallocate(allocator_current.context, ptr,
+                                        old_size, size);
+}
+
+void allocator_free(void *ptr, size_t size) {
+    allocator_current.release(allocator_current.context, ptr, size);
+}
+
+#ifdef WITH_TEST
+typedef struct {
+    size_t allocated;
+    size_t released;
+} allocator_test_count;
+
+static void *allocator_test_allocate(void *context, size_t size) {
+    ((allocator_test_count *)context)->allocated += size;
+    return malloc(size);
+}
+
+static void *allocator_test_reallocate(void *context, void *ptr,
+                                       size_t old_size, size_t size) {
+    ((allocator_test_count *)context)->allocated += size;
+    ((allocator_test_count *)context)->released += old_size;
+    return realloc(ptr, size);
+}
+
+static void allocator_test_release(void *context, void *ptr, size_t size) {
+    if (ptr) {
+        ((allocator_test_count *)context)->released += size;
+    }
+    free(ptr);
+}
+
+Test(Allocator, hooks) {
+    allocator_test_count count = { 0, 0 };
+    allocator hooks = { allocator_test_allocate, allocator_test_reallocate,
+                        allocator_test_release, &count };
+    int *block = NULL;
+
+    allocator_set(&hooks);
+    cr_assert(allocator_get()->context == &count);
+
+    block = allocator_calloc(4, sizeof(int));
+    cr_assert(block);
+    cr_assert(block[0] == 0 && block[3] == 0);
+    block = allocator_realloc(block, 4 * sizeof(int), 8 * sizeof(int));
+    cr_assert(block);
+    allocator_free(block, 8 * sizeof(int));
+    cr_assert(count.allocated == 12 * sizeof(int));
+    cr_assert(count.released == count.allocated);
+
+    cr_assert(allocator_calloc(SIZE_MAX / 2, 4) == NULL);
+    cr_assert(errno == ENOMEM);
+
+    allocator_set(NULL);
+    cr_assert(allocator_get()->context == NULL);
+}
+#endif
@@ -0,0 +1,274 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "woofi/appendlist.h"
+#ifdef WITH_TEST
+# include <pthread.h>
+# include <string.h>
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Find the segment holding index and the offset of index in it.
+ * Shifting the indexes by APPENDLIST_FIRST makes segment k start at
+ * (APPENDLIST_FIRST << k), so k comes from the highest bit set.
+ */
+static inline size_t appendlist_locate(size_t index, size_t *offset) {
+    size_t shifted = index + APPENDLIST_FIRST;
+    size_t k = 63 - __builtin_clzll(shifted) - APPENDLIST_FIRST_BITS;
+
+    *offset = shifted - ((size_t)APPENDLIST_FIRST << k);
+    return k;
+}
+
+/**
+ * Get a segment, allocating it if no producer did yet. Concurrent
+ * producers race to install theirs, the losers free their copy.
+ * @return the segment or NULL on error (see errno)
+ */
+static int *appendlist_segment(appendlist *list, size_t k) {
+    int *segment = __atomic_load_n(&list->segment[k], __ATOMIC_ACQUIRE);
+    int *expected = NULL;
+
+    if (segment) {
+        return segment;
+    }
+
+    segment = calloc((size_t)APPENDLIST_FIRST << k, sizeof(*segment));
+    if (segment == NULL) {
+        return NULL;
+    }
+    if (!__atomic_compare_exchange_n(&list->segment[k], &expected, segment,
+                                     0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(segment);
+        return expected;
+    }
+
+    return segment;
+}
+
+appendlist *appendlist_create() {
+    return calloc(1, sizeof(appendlist));
+}
+
+void appendlist_delete(appendlist *list) {
+    assert(list);
+
+    for (size_t k = 0; k < APPENDLIST_SEGMENTS; k++) {
+        free(list->segment[k]);
+    }
+    free(list);
+}
+
+ssize_t appendlist_insert_last(appendlist *list, int value) {
+    return appendlist_insert_range(list, &value, 1);
+}
+
+ssize_t appendlist_insert_range(appendlist *list, const int *values,
+                                size_t count) {
+    size_t first;
+    size_t done = 0;
+    int rc = 0;
+
+    assert(list);
+    assert(values || count == 0);
+
+    first = __atomic_fetch_add(&list->reserved, count, __ATOMIC_RELAXED);
+
+    /* Values are stored one atomic int at a time so readers never race */
+    while (done < count) {
+        size_t offset;
+        size_t k = appendlist_locate(first + done, &offset);
+        size_t length = ((size_t)APPENDLIST_FIRST << k) - offset;
+        int *segment = appendlist_segment(list, k);
+
+        if (length > count - done) {
+            length = count - done;
+        }
+        if (segment == NULL) {
+            rc = -1;
+        }
+        for (size_t i = 0; segment && i < length; i++) {
+            __atomic_store_n(&segment[offset + i], values[done + i],
+                             __ATOMIC_RELAXED);
+        }
+        done += length;
+    }
+
+    __atomic_fetch_add(&list->written, count, __ATOMIC_RELEASE);
+
+    return rc == -1 ? -1 : (ssize_t)first;
+}
+
+size_t appendlist_count(const appendlist *list) {
+    assert(list);
+
+    return __atomic_load_n(&list->reserved, __ATOMIC_RELAXED);
+}
+
+size_t appendlist_written(const appendlist *list) {
+    assert(list);
+
+    return __atomic_load_n(&list->written, __ATOMIC_ACQUIRE);
+}
+
+int appendlist_fast_get(const appendlist *list, size_t index) {
+    const int *segment = NULL;
+    size_t offset;
+    size_t k;
+
+    assert(list);
+    assert(index < appendlist_count(list));
+
+    /* A failed allocation leaves the segment of written slots NULL */
+    k = appendlist_locate(index, &offset);
+    segment = __atomic_load_n(&list->segment[k], __ATOMIC_ACQUIRE);
+
+    return segment ? __atomic_load_n(&segment[offset], __ATOMIC_RELAXED) : 0;
+}
+
+int appendlist_get(const appendlist *list, size_t index, int *found) {
+    const int *segment = NULL;
+    size_t offset;
+    size_t k;
+
+    assert(list);
+
+    if (index >= appendlist_count(list)) {
+        if (found) {
+            *found = 0;
+        }
+        return 0;
+    }
+
+    k = appendlist_locate(index, &offset);
+    segment = __atomic_load_n(&list->segment[k], __ATOMIC_ACQUIRE);
+    if (found) {
+        *found = segment != NULL;
+    }
+
+    return segment ? __atomic_load_n(&segment[offset], __ATOMIC_RELAXED) : 0;
+}
+
+arraylist *appendlist_to_arraylist(const appendlist *list) {
+    arraylist *result = NULL;
+    size_t count;
+
+    assert(list);
+
+    count = appendlist_count(list);
+    result = arraylist_create();
+    if (result == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(result, count) == -1) {
+        int error = errno;
+        arraylist_delete(result);
+        errno = error;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        result->element[i] = appendlist_get(list, i, NULL);
+    }
+    result->count = count;
+
+    return result;
+}
+
+#ifdef WITH_TEST
+Test(Appendlist, segments) {
+    appendlist *list = appendlist_create();
+    int values[1000];
+    int found = 0;
+
+    cr_assert(list);
+    for (int i = 0; i < 100; i++) {
+        cr_assert(appendlist_insert_last(list, i) == i);
+    }
+    /* A range across several segments */
+    for (int i = 0; i < 1000; i++) {
+        values[i] = 100 + i;
+    }
+    cr_assert(appendlist_insert_range(list, values, 1000) == 100);
+    cr_assert(appendlist_insert_range(list, values, 0) == 1100);
+
+    cr_assert(appendlist_count(list) == 1100);
+    cr_assert(appendlist_written(list) == 1100);
+    for (int i = 0; i < 1100; i++) {
+        cr_assert(appendlist_fast_get(list, i) == i);
+    }
+    cr_assert(list->segment[4] != NULL);
+    cr_assert(list->segment[5] == NULL);
+    cr_assert(appendlist_get(list, 1099, &found) == 1099);
+    cr_assert(found);
+    appendlist_get(list, 1100, &found);
+    cr_assert_not(found);
+
+    /* Slots whose segment failed to allocate are written as 0 */
+    list->reserved = list->written = 2500;
+    cr_assert(appendlist_fast_get(list, 2499) == 0);
+    cr_assert(appendlist_get(list, 2499, &found) == 0);
+    cr_assert_not(found);
+    list->reserved = list->written = 1100;
+
+    arraylist *copy = appendlist_to_arraylist(list);
+    cr_assert(copy->count == 1100);
+    cr_assert(copy->element[1099] == 1099);
+
+    arraylist_delete(copy);
+    appendlist_delete(list);
+}
+
+#define APPENDLIST_TEST_THREADS 4
+#define APPENDLIST_TEST_VALUES 50000
+
+static void *appendlist_test_producer(void *arg) {
+    appendlist *list = ((void **)arg)[0];
+    int id = (int)(size_t)((void **)arg)[1];
+    int range[10];
+
+    for (int i = 0; i < APPENDLIST_TEST_VALUES; i += 20) {
+        for (int j = 0; j < 10; j++) {
+            appendlist_insert_last(list, id * APPENDLIST_TEST_VALUES + i + j);
+            range[j] = id * APPENDLIST_TEST_VALUES + i + 10 + j;
+        }
+        appendlist_insert_range(list, range, 10);
+    }
+
+    return NULL;
+}
+
+static int appendlist_test_compare(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+Test(Appendlist, concurrent_producers) {
+    appendlist *list = appendlist_create();
+    pthread_t thread[APPENDLIST_TEST_THREADS];
+    void *args[APPENDLIST_TEST_THREADS][2];
+
+    for (size_t i = 0; i < APPENDLIST_TEST_THREADS; i++) {
+        args[i][0] = list;
+        args[i][1] = (void *)i;
+        cr_assert(pthread_create(&thread[i], NULL, appendlist_test_producer,
+                                 args[i]) == 0);
+    }
+    for (size_t i = 0; i < APPENDLIST_TEST_THREADS; i++) {
+        pthread_join(thread[i], NULL);
+    }
+
+    /* Every value is there exactly once */
+    arraylist *copy = appendlist_to_arraylist(list);
+    cr_assert(copy->count == APPENDLIST_TEST_THREADS * APPENDLIST_TEST_VALUES);
+    cr_assert(appendlist_written(list) == copy->count);
+    qsort(copy->element, copy->count, sizeof(int), appendlist_test_compare);
+    for (size_t i = 0; i < copy->count; i++) {
+        cr_assert(copy->element[i] == (int)i);
+    }
+
+    arraylist_delete(copy);
+    appendlist_delete(list);
+}
+#endif
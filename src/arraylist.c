@@ -1,29 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <iso646.h>
+#include <unistd.h>
 
+#include "woofi/allocator.h"
 #include "woofi/arraylist.h"
+#include "woofi/histogram.h"
+#include "woofi/mappedlist.h"
 #ifdef WITH_TEST
 # include <criterion/criterion.h>
 #endif
 
+static const capacity_policy arraylist_default_policy = CAPACITY_POLICY_DEFAULT;
+
 arraylist *arraylist_create() {
     arraylist *new_list = NULL;
 
-    new_list = malloc(sizeof(*new_list));
+    new_list = allocator_malloc(sizeof(*new_list));
     if (new_list == NULL) {
 	return NULL;
     }
 
     new_list->count = 0;
     new_list->length = INITIALI_ARRAYLIST_SIZE;
-    new_list->element = calloc(new_list->length, sizeof(*(new_list->element)));
+    new_list->mapping = NULL;
+    new_list->policy = arraylist_default_policy;
+    new_list->element = allocator_calloc(new_list->length, sizeof(*(new_list->element)));
     return new_list;
 }
 
 /**
- * Expand the list passed in argument to half of it's size
+ * Change the capacity of the list
+ * @param list a non null pointer to a list
+ * @param length the new capacity, at least the number of elements
+ * @return 0 if list was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int arraylist_resize(arraylist *list, size_t length) {
+    if (list->mapping) {
+	return mappedlist_resize(list, length);
+    }
+
+    int *new_elements = allocator_realloc(list->element,
+					  list->length * sizeof(*(list->element)),
+					  length * sizeof(*(list->element)));
+    if (new_elements == NULL) {
+	return -1;
+    }
+
+    list->element = new_elements;
+    list->length = length;
+
+    return 0;
+}
+
+/**
+ * Expand the list passed in argument following its capacity policy
  * @param list a non null pointer to a list
  * @return 0 if list has grow
  *        -1 on error, if it failed to allocate requested memory (see errno)
@@ -33,22 +69,65 @@ static int arraylist_grow(arraylist *list) {
 	return -1;
     }
 
-    list->length += list->length / 2;
-    int *new_elements = realloc(list->element, list->length * sizeof(*(list->element)));
-    if (new_elements == NULL) {
-	return -1;
+    return arraylist_resize(list, capacity_grow(&list->policy, list->length,
+						list->count + 1));
+}
+
+/**
+ * Shrink the list if its capacity policy asks for it after a removal.
+ * Failing to shrink leaves the list as it was.
+ * @param list a non null pointer to a list
+ */
+static void arraylist_autoshrink(arraylist *list) {
+    size_t length = capacity_shrink(&list->policy, list->length, list->count);
+
+    if (length < list->length) {
+	arraylist_resize(list, length);
     }
-    else {
-        list->element = new_elements;
+}
+
+int arraylist_set_policy(arraylist *list, const capacity_policy *policy) {
+    assert(list);
+
+    if (!capacity_policy_valid(policy)) {
+	errno = EINVAL;
+	return -1;
     }
 
+    list->policy = *policy;
+
     return 0;
 }
 
+int arraylist_reserve(arraylist *list, size_t length) {
+    assert(list);
+
+    if (length <= list->length) {
+	return 0;
+    }
+
+    return arraylist_resize(list, length);
+}
+
+int arraylist_shrink_to_fit(arraylist *list) {
+    assert(list);
+
+    size_t length = list->count ? list->count : 1;
+    if (length >= list->length) {
+	return 0;
+    }
+
+    return arraylist_resize(list, length);
+}
+
 void arraylist_delete(arraylist *list) {
     assert(list);
-    free(list->element);
-    free(list);
+    if (list->mapping) {
+	mappedlist_close(list);
+	return;
+    }
+    allocator_free(list->element, list->length * sizeof(*(list->element)));
+    allocator_free(list, sizeof(*list));
 }
 
 int arraylist_is_empty(const arraylist *list) {
@@ -57,23 +136,53 @@ int arraylist_is_empty(const arraylist *list) {
 }
 
 void arraylist_print(const arraylist *list) {
+    arraylist_fwrite(list, stdout, TEXTIO_LIST);
+}
 
-    // FIXME: Assert
-    printf("[");
-    for (size_t i = 0; i < list->count; ++i) {
-	printf("%d, ", list->element[i]);
+int arraylist_write(const arraylist *list, int fd, textio_format format) {
+    assert(list);
+
+    return textio_write_ints(fd, format, list->element, list->count, NULL, 0);
+}
+
+int arraylist_fwrite(const arraylist *list, FILE *file, textio_format format) {
+    assert(list);
+
+    return textio_fwrite_ints(file, format, list->element, list->count,
+			      NULL, 0);
+}
+
+/**
+ * Append a batch of values parsed by arraylist_read_ints
+ * @return 0 if the values were added to the list
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int arraylist_append(void *list, const int *values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+	if (arraylist_insert_last(list, values[i]) == -1) {
+	    return -1;
+	}
     }
-    printf("]\n");
+
+    return 0;
+}
+
+ssize_t arraylist_read_ints(arraylist *list, int fd) {
+    assert(list);
+
+    return textio_read_ints(fd, arraylist_append, list);
 }
 
 int arraylist_insert_front(arraylist *list, int value) {
     int error;
 
     assert(list);
+    HISTOGRAM_START(HISTOGRAM_ARRAYLIST_INSERT_FRONT);
 
     if (list->count == list->length) {
 	error = arraylist_grow(list);
 	if (error == -1) {
+	    HISTOGRAM_STOP();
 	    return -1;
 	}
     }
@@ -85,6 +194,7 @@ int arraylist_insert_front(arraylist *list, int value) {
     list->count++;
     list->element[0] = value;
 
+    HISTOGRAM_STOP();
     return 0;
 }
 
@@ -92,10 +202,12 @@ int arraylist_insert_last(arraylist *list, int value) {
     int error;
 
     assert(list);
+    HISTOGRAM_START(HISTOGRAM_ARRAYLIST_INSERT_LAST);
 
     if (list->count == list->length) {
 	error = arraylist_grow(list);
 	if (error == -1) {
+	    HISTOGRAM_STOP();
 	    return -1;
 	}
     }
@@ -103,6 +215,7 @@ int arraylist_insert_last(arraylist *list, int value) {
     list->element[list->count] = value;
     list->count++;
 
+    HISTOGRAM_STOP();
     return 0;
 }
 
@@ -110,10 +223,12 @@ int arraylist_insert_at(arraylist *list, size_t index, int value) {
     int error;
 
     assert(list);
+    HISTOGRAM_START(HISTOGRAM_ARRAYLIST_INSERT_AT);
 
     if (list->count == list->length) {
 	error = arraylist_grow(list);
 	if (error == -1) {
+	    HISTOGRAM_STOP();
 	    return -1;
 	}
     }
@@ -128,6 +243,7 @@ int arraylist_insert_at(arraylist *list, size_t index, int value) {
     list->count++;
     list->element[index] = value;
 
+    HISTOGRAM_STOP();
     return 0;
 }
 
@@ -135,8 +251,9 @@ int arraylist_remove_value(arraylist *list, int value) {
     size_t i = 0;
 
     assert(list);
+    HISTOGRAM_START(HISTOGRAM_ARRAYLIST_REMOVE_VALUE);
 
-    while (list->element[i] != value && i < list->count) {
+    while (i < list->count && list->element[i] != value) {
 	i++;
     }
 
@@ -145,16 +262,21 @@ int arraylist_remove_value(arraylist *list, int value) {
 	for (;i < list->count; i++) {
 	    list->element[i] = list->element[i + 1];
 	}
+	arraylist_autoshrink(list);
+	HISTOGRAM_STOP();
 	return 1;
     }
 
+    HISTOGRAM_STOP();
     return 0;
 }
 
 int arraylist_remove_at(arraylist *list, size_t index) {
     assert(list);
+    HISTOGRAM_START(HISTOGRAM_ARRAYLIST_REMOVE_AT);
 
     if (arraylist_is_empty(list)){
+	HISTOGRAM_STOP();
 	return 0;
     }
 
@@ -162,12 +284,14 @@ int arraylist_remove_at(arraylist *list, size_t index) {
 	index = list->count - 1;
     }
 
-    for (size_t i = index; i < list->count; ++i) {
+    for (size_t i = index; i + 1 < list->count; ++i) {
 	list->element[i] = list->element[i + 1];
     }
 
     list->count--;
+    arraylist_autoshrink(list);
 
+    HISTOGRAM_STOP();
     return 1;
 }
 
@@ -564,4 +688,77 @@ Test(ArrayList, get) {
     arraylist_delete(list);
 }
 
+Test(ArrayList, write_read_ints) {
+    FILE *file = tmpfile();
+    arraylist *list = arraylist_create();
+    arraylist *copy = arraylist_create();
+
+    for (int i = -500; i < 500; i++) {
+	arraylist_insert_last(list, i * 1000);
+    }
+
+    cr_assert(arraylist_fwrite(list, file, TEXTIO_LIST) == 0);
+    fflush(file);
+    cr_assert(arraylist_write(list, fileno(file), TEXTIO_CSV) == 0);
+    lseek(fileno(file), 0, SEEK_SET);
+
+    cr_assert(arraylist_read_ints(copy, fileno(file)) == 2000);
+    for (size_t i = 0; i < 2000; i++) {
+	cr_assert(arraylist_fast_get(copy, i) == arraylist_fast_get(list, i % 1000));
+    }
+
+    arraylist_delete(copy);
+    arraylist_delete(list);
+    fclose(file);
+}
+
+Test(ArrayList, reserve_shrink_to_fit) {
+    arraylist *list = arraylist_create();
+
+    cr_assert(arraylist_reserve(list, 10) == 0);
+    cr_assert(list->length == 100);
+    cr_assert(arraylist_reserve(list, 1000) == 0);
+    cr_assert(list->length == 1000);
+
+    arraylist_insert_last(list, 42);
+    arraylist_insert_last(list, 24);
+    cr_assert(arraylist_shrink_to_fit(list) == 0);
+    cr_assert(list->length == 2);
+    cr_assert(arraylist_fast_get(list, 1) == 24);
+
+    arraylist_remove_at(list, 0);
+    arraylist_remove_at(list, 0);
+    cr_assert(arraylist_shrink_to_fit(list) == 0);
+    cr_assert(list->length == 1);
+    cr_assert(arraylist_insert_last(list, 12) == 0);
+    cr_assert(arraylist_insert_last(list, 6) == 0);
+    cr_assert(list->length == 2);
+
+    arraylist_delete(list);
+}
+
+Test(ArrayList, policy) {
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+    capacity_policy invalid = { 50, 0, 0, 0 };
+    arraylist *list = arraylist_create();
+
+    cr_assert(arraylist_set_policy(list, &invalid) == -1);
+    cr_assert(errno == EINVAL);
+    cr_assert(arraylist_set_policy(list, &policy) == 0);
+
+    for (int i = 0; i < 1000; i++) {
+	arraylist_insert_last(list, i);
+    }
+    cr_assert(list->length == 1600);
+
+    while (arraylist_count(list) > 10) {
+	arraylist_remove_at(list, 0);
+    }
+    cr_assert(list->length == 100);
+    cr_assert(arraylist_fast_get(list, 0) == 990);
+    cr_assert(arraylist_fast_get(list, 9) == 999);
+
+    arraylist_delete(list);
+}
+
 #endif
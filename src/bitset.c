@@ -0,0 +1,548 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/bitset.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+    && !defined(WOOFI_NO_AVX2)
+# define BITSET_AVX2
+# include <immintrin.h>
+#endif
+
+#define BITSET_WORD_BITS 64
+
+static const capacity_policy bitset_policy = CAPACITY_POLICY_DEFAULT;
+
+static inline uint64_t bitset_apply(uint64_t a, uint64_t b, bitset_op op) {
+    switch (op) {
+    case BITSET_AND:
+        return a & b;
+    case BITSET_OR:
+        return a | b;
+    case BITSET_XOR:
+        return a ^ b;
+    default:
+        return a & ~b;
+    }
+}
+
+static size_t bitset_words_op_scalar(uint64_t *dst, const uint64_t *a,
+                                     const uint64_t *b, size_t count,
+                                     bitset_op op) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t word = bitset_apply(a[i], b[i], op);
+
+        if (dst) {
+            dst[i] = word;
+        }
+        total += __builtin_popcountll(word);
+    }
+
+    return total;
+}
+
+#ifdef BITSET_AVX2
+/*
+ * Population count of 256 bit vectors: each nibble is looked up in a
+ * 16 entry table with vpshufb, and the byte counts are summed in 64 bit
+ * lanes with vpsadbw.
+ */
+__attribute__((target("avx2"), always_inline))
+static inline __m256i bitset_avx2_popcount(__m256i value) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(value, nibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(value, 4), nibble);
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, low),
+                                    _mm256_shuffle_epi8(table, high));
+
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+/* Inlined for every constant op so the loop has no branch on it */
+__attribute__((target("avx2"), always_inline))
+static inline size_t bitset_avx2_kernel(uint64_t *dst, const uint64_t *a,
+                                        const uint64_t *b, size_t count,
+                                        bitset_op op) {
+    __m256i total = _mm256_setzero_si256();
+    uint64_t lanes[4];
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i word;
+
+        switch (op) {
+        case BITSET_AND:
+            word = _mm256_and_si256(x, y);
+            break;
+        case BITSET_OR:
+            word = _mm256_or_si256(x, y);
+            break;
+        case BITSET_XOR:
+            word = _mm256_xor_si256(x, y);
+            break;
+        default:
+            word = _mm256_andnot_si256(y, x);
+            break;
+        }
+
+        if (dst) {
+            _mm256_storeu_si256((__m256i *)(dst + i), word);
+        }
+        total = _mm256_add_epi64(total, bitset_avx2_popcount(word));
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, total);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+        + bitset_words_op_scalar(dst ? dst + i : NULL, a + i, b + i,
+                                 count - i, op);
+}
+
+__attribute__((target("avx2")))
+static size_t bitset_words_op_avx2(uint64_t *dst, const uint64_t *a,
+                                   const uint64_t *b, size_t count,
+                                   bitset_op op) {
+    switch (op) {
+    case BITSET_AND:
+        return bitset_avx2_kernel(dst, a, b, count, BITSET_AND);
+    case BITSET_OR:
+        return bitset_avx2_kernel(dst, a, b, count, BITSET_OR);
+    case BITSET_XOR:
+        return bitset_avx2_kernel(dst, a, b, count, BITSET_XOR);
+    default:
+        return bitset_avx2_kernel(dst, a, b, count, BITSET_ANDNOT);
+    }
+}
+#endif
+
+size_t bitset_words_op(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+                       size_t count, bitset_op op) {
+    assert(a || count == 0);
+    assert(b || count == 0);
+
+#ifdef BITSET_AVX2
+    /* Short runs do not pay for a vector loop */
+    if (count >= 8 && __builtin_cpu_supports("avx2")) {
+        return bitset_words_op_avx2(dst, a, b, count, op);
+    }
+#endif
+
+    return bitset_words_op_scalar(dst, a, b, count, op);
+}
+
+size_t bitset_words_popcount(const uint64_t *word, size_t count) {
+    return bitset_words_op(NULL, word, word, count, BITSET_OR);
+}
+
+bitset *bitset_create(size_t bits) {
+    bitset *bitset = NULL;
+
+    bitset = calloc(1, sizeof(*bitset));
+    if (bitset == NULL) {
+        return NULL;
+    }
+
+    if (bitset_reserve(bitset, bits) != 0) {
+        free(bitset);
+        return NULL;
+    }
+
+    return bitset;
+}
+
+void bitset_delete(bitset *bitset) {
+    assert(bitset);
+
+    free(bitset->word);
+    free(bitset);
+}
+
+/**
+ * Change the number of words of the bitset, new words are clear
+ * @param bitset a non null pointer to a bitset
+ * @param size the new number of words
+ * @return 0 if the bitset was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int bitset_resize(bitset *bitset, size_t size) {
+    uint64_t *word = NULL;
+
+    if (size > SIZE_MAX / sizeof(*word)) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    word = realloc(bitset->word, (size ? size : 1) * sizeof(*word));
+    if (word == NULL) {
+        return -1;
+    }
+
+    if (size > bitset->size) {
+        memset(word + bitset->size, 0, (size - bitset->size) * sizeof(*word));
+    }
+    bitset->word = word;
+    bitset->size = size;
+
+    return 0;
+}
+
+int bitset_reserve(bitset *bitset, size_t bits) {
+    size_t size = bits / BITSET_WORD_BITS + (bits % BITSET_WORD_BITS != 0);
+
+    assert(bitset);
+
+    if (size <= bitset->size && bitset->word) {
+        return 0;
+    }
+
+    return bitset_resize(bitset, size);
+}
+
+int bitset_shrink_to_fit(bitset *bitset) {
+    size_t size = 0;
+
+    assert(bitset);
+
+    size = bitset->size;
+    while (size > 0 && bitset->word[size - 1] == 0) {
+        size--;
+    }
+    if (size == bitset->size) {
+        return 0;
+    }
+
+    return bitset_resize(bitset, size);
+}
+
+int bitset_set(bitset *bitset, size_t index) {
+    size_t word = index / BITSET_WORD_BITS;
+
+    assert(bitset);
+
+    if (word >= bitset->size
+        && bitset_resize(bitset, capacity_grow(&bitset_policy, bitset->size,
+                                               word + 1)) != 0) {
+        return -1;
+    }
+
+    bitset->word[word] |= (uint64_t)1 << (index % BITSET_WORD_BITS);
+
+    return 0;
+}
+
+void bitset_clear(bitset *bitset, size_t index) {
+    size_t word = index / BITSET_WORD_BITS;
+
+    assert(bitset);
+
+    if (word < bitset->size) {
+        bitset->word[word] &= ~((uint64_t)1 << (index % BITSET_WORD_BITS));
+    }
+}
+
+int bitset_test(const bitset *bitset, size_t index) {
+    size_t word = index / BITSET_WORD_BITS;
+
+    assert(bitset);
+
+    return word < bitset->size
+        && (bitset->word[word] >> (index % BITSET_WORD_BITS) & 1);
+}
+
+size_t bitset_count(const bitset *bitset) {
+    assert(bitset);
+
+    return bitset_words_popcount(bitset->word, bitset->size);
+}
+
+size_t bitset_rank(const bitset *bitset, size_t index) {
+    size_t word = index / BITSET_WORD_BITS;
+    size_t rank = 0;
+
+    assert(bitset);
+
+    if (word >= bitset->size) {
+        return bitset_count(bitset);
+    }
+
+    rank = bitset_words_popcount(bitset->word, word);
+    if (index % BITSET_WORD_BITS) {
+        uint64_t mask = ~(uint64_t)0 >> (BITSET_WORD_BITS
+                                         - index % BITSET_WORD_BITS);
+        rank += __builtin_popcountll(bitset->word[word] & mask);
+    }
+
+    return rank;
+}
+
+size_t bitset_next_set(const bitset *bitset, size_t index) {
+    size_t word = index / BITSET_WORD_BITS;
+    uint64_t bits = 0;
+
+    assert(bitset);
+
+    if (word >= bitset->size) {
+        return BITSET_NONE;
+    }
+
+    bits = bitset->word[word] & (~(uint64_t)0 << (index % BITSET_WORD_BITS));
+    while (bits == 0) {
+        if (++word == bitset->size) {
+            return BITSET_NONE;
+        }
+        bits = bitset->word[word];
+    }
+
+    return word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+}
+
+ssize_t bitset_combine(bitset *dst, const bitset *src, bitset_op op) {
+    size_t common = 0;
+    size_t total = 0;
+
+    assert(dst);
+    assert(src);
+
+    if ((op == BITSET_OR || op == BITSET_XOR) && src->size > dst->size
+        && bitset_resize(dst, src->size) != 0) {
+        return -1;
+    }
+
+    common = dst->size < src->size ? dst->size : src->size;
+    total = bitset_words_op(dst->word, dst->word, src->word, common, op);
+
+    /* Past the end of src, AND clears dst while the others keep it */
+    if (op == BITSET_AND) {
+        memset(dst->word + common, 0,
+               (dst->size - common) * sizeof(*(dst->word)));
+    } else {
+        total += bitset_words_popcount(dst->word + common,
+                                       dst->size - common);
+    }
+
+    return total;
+}
+
+size_t bitset_combine_count(const bitset *a, const bitset *b, bitset_op op) {
+    size_t common = 0;
+    size_t total = 0;
+
+    assert(a);
+    assert(b);
+
+    common = a->size < b->size ? a->size : b->size;
+    total = bitset_words_op(NULL, a->word, b->word, common, op);
+
+    if (op == BITSET_OR || op == BITSET_XOR) {
+        total += bitset_words_popcount(a->word + common, a->size - common);
+        total += bitset_words_popcount(b->word + common, b->size - common);
+    } else if (op == BITSET_ANDNOT) {
+        total += bitset_words_popcount(a->word + common, a->size - common);
+    }
+
+    return total;
+}
+
+bitset *bitset_from_arraylist(const arraylist *list) {
+    bitset *bitset = NULL;
+    int max = 0;
+
+    assert(list);
+
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->element[i] < 0) {
+            errno = EINVAL;
+            return NULL;
+        }
+        if (list->element[i] > max) {
+            max = list->element[i];
+        }
+    }
+
+    bitset = bitset_create(list->count ? (size_t)max + 1 : 0);
+    if (bitset == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        size_t value = list->element[i];
+
+        bitset->word[value / BITSET_WORD_BITS] |=
+            (uint64_t)1 << (value % BITSET_WORD_BITS);
+    }
+
+    return bitset;
+}
+
+arraylist *bitset_to_arraylist(const bitset *bitset) {
+    arraylist *list = NULL;
+    size_t count = 0;
+
+    assert(bitset);
+
+    count = bitset_count(bitset);
+    if (count && bitset_next_set(bitset, (size_t)INT_MAX + 1)
+                 != BITSET_NONE) {
+        errno = ERANGE;
+        return NULL;
+    }
+
+    list = arraylist_create();
+    if (list == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(list, count) != 0) {
+        arraylist_delete(list);
+        return NULL;
+    }
+
+    for (size_t word = 0; word < bitset->size; word++) {
+        uint64_t bits = bitset->word[word];
+
+        /* Clear the lowest bit set until none is left */
+        while (bits) {
+            list->element[list->count++] =
+                word * BITSET_WORD_BITS + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+
+    return list;
+}
+
+#ifdef WITH_TEST
+Test(Bitset, set_test) {
+    bitset *bitset = bitset_create(0);
+
+    cr_assert(bitset);
+    cr_assert_not(bitset_test(bitset, 0));
+    cr_assert_not(bitset_test(bitset, 100000));
+    cr_assert(bitset_next_set(bitset, 0) == BITSET_NONE);
+
+    cr_assert(bitset_set(bitset, 3) == 0);
+    cr_assert(bitset_set(bitset, 64) == 0);
+    cr_assert(bitset_set(bitset, 10000) == 0);
+    cr_assert(bitset_test(bitset, 3));
+    cr_assert(bitset_test(bitset, 64));
+    cr_assert(bitset_test(bitset, 10000));
+    cr_assert_not(bitset_test(bitset, 63));
+    cr_assert(bitset_count(bitset) == 3);
+
+    cr_assert(bitset_rank(bitset, 0) == 0);
+    cr_assert(bitset_rank(bitset, 4) == 1);
+    cr_assert(bitset_rank(bitset, 64) == 1);
+    cr_assert(bitset_rank(bitset, 65) == 2);
+    cr_assert(bitset_rank(bitset, 1000000) == 3);
+
+    cr_assert(bitset_next_set(bitset, 0) == 3);
+    cr_assert(bitset_next_set(bitset, 4) == 64);
+    cr_assert(bitset_next_set(bitset, 65) == 10000);
+    cr_assert(bitset_next_set(bitset, 10001) == BITSET_NONE);
+
+    bitset_clear(bitset, 10000);
+    bitset_clear(bitset, 1000000);
+    cr_assert_not(bitset_test(bitset, 10000));
+    cr_assert(bitset_shrink_to_fit(bitset) == 0);
+    cr_assert(bitset->size == 2);
+
+    bitset_delete(bitset);
+}
+
+Test(Bitset, words_op) {
+    uint64_t a[37];
+    uint64_t b[37];
+    uint64_t dst[37];
+    uint64_t seed = 7;
+
+    for (size_t i = 0; i < 37; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        a[i] = seed;
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        b[i] = seed;
+    }
+
+    for (int op = BITSET_AND; op <= BITSET_ANDNOT; op++) {
+        for (size_t count = 0; count <= 37; count++) {
+            size_t expected = bitset_words_op_scalar(NULL, a, b, count, op);
+
+            cr_assert(bitset_words_op(dst, a, b, count, op) == expected);
+            for (size_t i = 0; i < count; i++) {
+                cr_assert(dst[i] == bitset_apply(a[i], b[i], op));
+            }
+        }
+    }
+}
+
+Test(Bitset, combine) {
+    bitset *a = bitset_create(0);
+    bitset *b = bitset_create(0);
+
+    for (size_t i = 0; i < 3000; i += 3) {
+        cr_assert(bitset_set(a, i) == 0);
+    }
+    for (size_t i = 0; i < 6000; i += 5) {
+        cr_assert(bitset_set(b, i) == 0);
+    }
+
+    cr_assert(bitset_combine_count(a, b, BITSET_AND) == 200);
+    cr_assert(bitset_combine_count(a, b, BITSET_OR) == 1000 + 1200 - 200);
+    cr_assert(bitset_combine_count(a, b, BITSET_XOR) == 1000 + 1200 - 400);
+    cr_assert(bitset_combine_count(a, b, BITSET_ANDNOT) == 800);
+    cr_assert(bitset_combine_count(b, a, BITSET_ANDNOT) == 1000);
+
+    cr_assert(bitset_combine(a, b, BITSET_OR) == 2000);
+    cr_assert(bitset_test(a, 5995));
+    cr_assert(bitset_combine(a, b, BITSET_ANDNOT) == 800);
+    cr_assert(bitset_test(a, 3) && !bitset_test(a, 15));
+    cr_assert(bitset_combine(a, b, BITSET_XOR) == 2000);
+    cr_assert(bitset_combine(a, b, BITSET_AND) == 1200);
+    cr_assert(bitset_count(a) == 1200);
+
+    bitset_delete(a);
+    bitset_delete(b);
+}
+
+Test(Bitset, arraylist) {
+    arraylist *list = arraylist_create();
+    arraylist *back = NULL;
+    bitset *bitset = NULL;
+
+    arraylist_insert_last(list, 700);
+    arraylist_insert_last(list, 5);
+    arraylist_insert_last(list, 64);
+    arraylist_insert_last(list, 5);
+
+    bitset = bitset_from_arraylist(list);
+    cr_assert(bitset);
+    cr_assert(bitset_count(bitset) == 3);
+
+    back = bitset_to_arraylist(bitset);
+    cr_assert(back);
+    cr_assert(arraylist_count(back) == 3);
+    cr_assert(back->element[0] == 5);
+    cr_assert(back->element[1] == 64);
+    cr_assert(back->element[2] == 700);
+
+    arraylist_insert_last(list, -1);
+    cr_assert(bitset_from_arraylist(list) == NULL);
+    cr_assert(errno == EINVAL);
+
+    arraylist_delete(back);
+    arraylist_delete(list);
+    bitset_delete(bitset);
+}
+#endif
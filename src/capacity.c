@@ -0,0 +1,107 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "woofi/capacity.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+int capacity_policy_valid(const capacity_policy *policy) {
+    assert(policy);
+
+    if (policy->growth <= 100) {
+        return 0;
+    }
+
+    if (policy->shrink_below != 0
+        && (policy->shrink_to <= policy->shrink_below
+            || policy->shrink_to > 100)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+size_t capacity_grow(const capacity_policy *policy, size_t length,
+                     size_t needed) {
+    assert(policy);
+
+    size_t grown = length > SIZE_MAX / policy->growth
+        ? SIZE_MAX : length * policy->growth / 100;
+
+    if (grown <= length) {
+        grown = length + 1;
+    }
+    if (grown < needed) {
+        grown = needed;
+    }
+
+    return grown;
+}
+
+size_t capacity_shrink(const capacity_policy *policy, size_t length,
+                       size_t needed) {
+    assert(policy);
+
+    if (policy->shrink_below == 0 || length <= policy->minimum) {
+        return length;
+    }
+
+    /* length * shrink_below / 100 without overflowing */
+    size_t threshold = length / 100 * policy->shrink_below
+        + length % 100 * policy->shrink_below / 100;
+    if (needed >= threshold) {
+        return length;
+    }
+
+    size_t shrunk = needed / policy->shrink_to * 100
+        + needed % policy->shrink_to * 100 / policy->shrink_to;
+    if (shrunk < needed) {
+        shrunk = needed;
+    }
+    if (shrunk < policy->minimum) {
+        shrunk = policy->minimum;
+    }
+    if (shrunk == 0) {
+        shrunk = 1;
+    }
+
+    return shrunk < length ? shrunk : length;
+}
+
+#ifdef WITH_TEST
+Test(Capacity, valid) {
+    capacity_policy fixed = CAPACITY_POLICY_DEFAULT;
+    capacity_policy shrink = CAPACITY_POLICY_SHRINK;
+    capacity_policy flat = { 100, 0, 0, 0 };
+    capacity_policy thrash = { 150, 50, 40, 0 };
+
+    cr_assert(capacity_policy_valid(&fixed));
+    cr_assert(capacity_policy_valid(&shrink));
+    cr_assert_not(capacity_policy_valid(&flat));
+    cr_assert_not(capacity_policy_valid(&thrash));
+}
+
+Test(Capacity, grow) {
+    capacity_policy policy = CAPACITY_POLICY_DEFAULT;
+
+    cr_assert(capacity_grow(&policy, 100, 101) == 150);
+    cr_assert(capacity_grow(&policy, 150, 151) == 225);
+    cr_assert(capacity_grow(&policy, 1, 2) == 2);
+    cr_assert(capacity_grow(&policy, 0, 1) == 1);
+    cr_assert(capacity_grow(&policy, 100, 1000) == 1000);
+}
+
+Test(Capacity, shrink) {
+    capacity_policy fixed = CAPACITY_POLICY_DEFAULT;
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+
+    cr_assert(capacity_shrink(&fixed, 1000, 0) == 1000);
+
+    cr_assert(capacity_shrink(&policy, 1000, 250) == 1000);
+    cr_assert(capacity_shrink(&policy, 1000, 249) == 498);
+    cr_assert(capacity_shrink(&policy, 1000, 10) == 100);
+    cr_assert(capacity_shrink(&policy, 100, 0) == 100);
+}
+#endif
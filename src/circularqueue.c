@@ -1,16 +1,22 @@
 #include <stdio.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "woofi/allocator.h"
 #include "woofi/circularqueue.h"
+#include "woofi/histogram.h"
 #ifdef WITH_TEST
 # include <criterion/criterion.h>
 #endif
 
+static const capacity_policy circularqueue_default_policy = CAPACITY_POLICY_DEFAULT;
+
 circularqueue *circularqueue_create(size_t size) {
     circularqueue *queue = NULL;
 
-    queue = malloc(sizeof(*queue));
+    queue = allocator_malloc(sizeof(*queue));
     if(queue == NULL) {
 	return NULL;
     }
@@ -22,7 +28,8 @@ circularqueue *circularqueue_create(size_t size) {
     queue->size = size;
     queue->head = 0;
     queue->tail = 0;
-    queue->element = calloc(queue->size, sizeof(*(queue->element)));
+    queue->policy = circularqueue_default_policy;
+    queue->element = allocator_calloc(queue->size, sizeof(*(queue->element)));
 
     return queue;
 }
@@ -30,8 +37,67 @@ circularqueue *circularqueue_create(size_t size) {
 void circularqueue_delete(circularqueue *queue) {
     assert(queue);
 
-    free(queue->element);
-    free(queue);
+    allocator_free(queue->element, queue->size * sizeof(*(queue->element)));
+    allocator_free(queue, sizeof(*queue));
+}
+
+/**
+ * Change the number of slots of the queue, keeping its elements in order.
+ * When the queue wraps, the segment from the head to the end of the
+ * storage is moved to the new end of the storage.
+ * @param queue a non null pointer to a queue
+ * @param size the new number of slots, above the number of elements
+ * @return 0 if the queue was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int circularqueue_resize(circularqueue *queue, size_t size) {
+    size_t count = circularqueue_count(queue);
+    size_t end = queue->size - queue->head;
+    int *new_elements;
+
+    assert(size > count);
+
+    if (size < queue->size) {
+        if (queue->tail < queue->head) {
+            memmove(queue->element + size - end, queue->element + queue->head,
+                    end * sizeof(*(queue->element)));
+            queue->head = size - end;
+        }
+        else if (queue->tail > size) {
+            memmove(queue->element, queue->element + queue->head,
+                    count * sizeof(*(queue->element)));
+            queue->head = 0;
+            queue->tail = count;
+        }
+
+        /* Keep the larger storage if it can't be shrunk */
+        new_elements = allocator_realloc(queue->element,
+                                         queue->size * sizeof(*(queue->element)),
+                                         size * sizeof(*(queue->element)));
+        if (new_elements != NULL) {
+            queue->element = new_elements;
+        }
+        queue->size = size;
+
+        return 0;
+    }
+
+    new_elements = allocator_realloc(queue->element,
+                                     queue->size * sizeof(*(queue->element)),
+                                     size * sizeof(*(queue->element)));
+    if (new_elements == NULL) {
+        return -1;
+    }
+    queue->element = new_elements;
+
+    if (queue->tail < queue->head) {
+        memmove(queue->element + size - end, queue->element + queue->head,
+                end * sizeof(*(queue->element)));
+        queue->head = size - end;
+    }
+    queue->size = size;
+
+    return 0;
 }
 
 static int circularqueue_grow(circularqueue *queue) {
@@ -39,29 +105,45 @@ static int circularqueue_grow(circularqueue *queue) {
         return -1;
     }
 
-    int add = queue->size / 2;
-    int tempo = queue->element[queue->head];
+    return circularqueue_resize(queue, capacity_grow(&queue->policy,
+                                                     queue->size,
+                                                     queue->size + 1));
+}
 
-    queue->size = queue->size + add;
+int circularqueue_set_policy(circularqueue *queue,
+                             const capacity_policy *policy) {
+    assert(queue);
 
-    int *new_elements = realloc(queue->element, queue->size* sizeof(*(queue->element)));
-    if (new_elements == NULL) {
+    if (!capacity_policy_valid(policy)) {
+        errno = EINVAL;
         return -1;
     }
-    else {
-        queue->element = new_elements;
+
+    queue->policy = *policy;
+
+    return 0;
+}
+
+int circularqueue_reserve(circularqueue *queue, size_t count) {
+    assert(queue);
+
+    /* One slot always stays free between the tail and the head */
+    if (count + 1 <= queue->size) {
+        return 0;
     }
 
-    if(queue->tail < queue->head) {
-        for (int i = 1; i <= add; ++i) {
-            queue->element[queue->head + i] = tempo;
-            tempo = queue->element[queue->head + i];
-        }
+    return circularqueue_resize(queue, count + 1);
+}
 
-        queue->head += add;
+int circularqueue_shrink_to_fit(circularqueue *queue) {
+    assert(queue);
+
+    size_t size = circularqueue_count(queue) + 1;
+    if (size >= queue->size) {
+        return 0;
     }
 
-    return 0;
+    return circularqueue_resize(queue, size);
 }
 
 int circularqueue_is_empty(const circularqueue *queue) {
@@ -71,21 +153,43 @@ int circularqueue_is_empty(const circularqueue *queue) {
 }
 
 void circularqueue_print(const circularqueue *queue) {
+    circularqueue_fwrite(queue, stdout, TEXTIO_LIST);
+}
+
+int circularqueue_write(const circularqueue *queue, int fd,
+                        textio_format format) {
     assert(queue);
 
-    printf("[");
-    for (size_t i = queue->head; i != queue->tail; ++i) {
-	if (i == queue->size) {
-	    i = 0;
-	}
-	printf("%d, ", queue->element[i]);
+    if (queue->tail < queue->head) {
+        return textio_write_ints(fd, format,
+                                 queue->element + queue->head,
+                                 queue->size - queue->head,
+                                 queue->element, queue->tail);
     }
-    printf("]\n");
+
+    return textio_write_ints(fd, format, queue->element + queue->head,
+                             queue->tail - queue->head, NULL, 0);
+}
+
+int circularqueue_fwrite(const circularqueue *queue, FILE *file,
+                         textio_format format) {
+    assert(queue);
+
+    if (queue->tail < queue->head) {
+        return textio_fwrite_ints(file, format,
+                                  queue->element + queue->head,
+                                  queue->size - queue->head,
+                                  queue->element, queue->tail);
+    }
+
+    return textio_fwrite_ints(file, format, queue->element + queue->head,
+                              queue->tail - queue->head, NULL, 0);
 }
 
 
 int circularqueue_insert(circularqueue *queue, int value) {
     assert(queue);
+    HISTOGRAM_START(HISTOGRAM_CIRCULARQUEUE_INSERT);
 
     int rc = 0;
 
@@ -97,12 +201,14 @@ int circularqueue_insert(circularqueue *queue, int value) {
         if (queue->tail + 1 == queue->head) {
             rc = circularqueue_grow(queue);
             if(rc == -1) {
+                HISTOGRAM_STOP();
                 return 0;
             }
         }
         else if (queue->tail == queue->size - 1 && queue->head == 0) {
             rc = circularqueue_grow(queue);
             if(rc == -1) {
+                HISTOGRAM_STOP();
                 return 0;
             }
         }
@@ -111,21 +217,38 @@ int circularqueue_insert(circularqueue *queue, int value) {
     queue->element[queue->tail] = value;
     queue->tail++;
 
+    HISTOGRAM_STOP();
     return 1;
 }
 
 int circularqueue_remove(circularqueue *queue) {
     assert(queue);
+    HISTOGRAM_START(HISTOGRAM_CIRCULARQUEUE_REMOVE);
 
     if(circularqueue_is_empty(queue)) {
+        HISTOGRAM_STOP();
         return 0;
     }
     queue->head++;
 
-    if (queue->head >= queue->size) {
+    /* The tail only wraps on the next insert, it may still be at size */
+    if (queue->head == queue->tail) {
+        queue->head = 0;
+        queue->tail = 0;
+    }
+    else if (queue->head >= queue->size) {
 	queue->head = 0;
     }
 
+    if (queue->requested_size == 0) {
+        size_t size = capacity_shrink(&queue->policy, queue->size,
+                                      circularqueue_count(queue) + 1);
+        if (size < queue->size) {
+            circularqueue_resize(queue, size);
+        }
+    }
+
+    HISTOGRAM_STOP();
     return 1;
 }
 
@@ -216,6 +339,29 @@ Test(CircularQueue, pushPop10000) {
     circularqueue_delete(queue);
 }
 
+Test(CircularQueue, fwrite_wrapped) {
+    char out[32] = { 0 };
+    FILE *file = tmpfile();
+    circularqueue *queue = circularqueue_create(4);
+
+    circularqueue_insert(queue, 1);
+    circularqueue_insert(queue, 2);
+    circularqueue_insert(queue, 3);
+    circularqueue_remove(queue);
+    circularqueue_remove(queue);
+    circularqueue_insert(queue, 4);
+    circularqueue_insert(queue, 5);
+    cr_assert(queue->tail < queue->head);
+
+    cr_assert(circularqueue_fwrite(queue, file, TEXTIO_LINES) == 0);
+    rewind(file);
+    cr_assert(fread(out, 1, sizeof(out) - 1, file) == 6);
+    cr_assert(strcmp(out, "3\n4\n5\n") == 0);
+
+    circularqueue_delete(queue);
+    fclose(file);
+}
+
 Test(CircularQueue, countOverflow) {
     int rc = 0;
     size_t count = 0;
@@ -287,4 +433,82 @@ Test(CircularQueue, grow_head_after) {
     circularqueue_delete(queue);
 }
 
+Test(CircularQueue, reserve_wrapped) {
+    circularqueue *queue = circularqueue_create(0);
+
+    for (int i = 0; i < 90; i++) {
+        circularqueue_insert(queue, i);
+    }
+    for (int i = 0; i < 80; i++) {
+        circularqueue_remove(queue);
+    }
+    for (int i = 90; i < 120; i++) {
+        circularqueue_insert(queue, i);
+    }
+    cr_assert(queue->tail < queue->head);
+
+    cr_assert(circularqueue_reserve(queue, 500) == 0);
+    cr_assert(queue->size == 501);
+    cr_assert(circularqueue_count(queue) == 40);
+    cr_assert(circularqueue_shrink_to_fit(queue) == 0);
+    cr_assert(queue->size == 41);
+    cr_assert(circularqueue_count(queue) == 40);
+
+    for (int i = 80; i < 120; i++) {
+        cr_assert(circularqueue_head(queue) == i);
+        circularqueue_remove(queue);
+    }
+    cr_assert(circularqueue_is_empty(queue));
+
+    circularqueue_delete(queue);
+}
+
+Test(CircularQueue, policy) {
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+    circularqueue *queue = circularqueue_create(0);
+
+    cr_assert(circularqueue_set_policy(queue, &policy) == 0);
+    for (int i = 0; i < 1000; i++) {
+        circularqueue_insert(queue, i);
+    }
+    cr_assert(queue->size >= 1000);
+    for (int i = 0; i < 990; i++) {
+        cr_assert(circularqueue_head(queue) == i);
+        circularqueue_remove(queue);
+    }
+    cr_assert(queue->size == 100);
+    for (int i = 990; i < 1000; i++) {
+        cr_assert(circularqueue_head(queue) == i);
+        circularqueue_remove(queue);
+    }
+
+    circularqueue_delete(queue);
+}
+
+Test(CircularQueue, drain_at_end) {
+    circularqueue *queue = circularqueue_create(0);
+
+    /* Leave the tail at the end of the storage and catch up with it */
+    for (int i = 0; i < 6; i++) {
+        circularqueue_insert(queue, i);
+    }
+    for (int i = 0; i < 5; i++) {
+        circularqueue_remove(queue);
+    }
+    while (queue->tail != queue->size) {
+        circularqueue_insert(queue, 42);
+    }
+    for (size_t count = circularqueue_count(queue); count; count--) {
+        circularqueue_remove(queue);
+    }
+    cr_assert(circularqueue_is_empty(queue));
+    cr_assert(circularqueue_count(queue) == 0);
+
+    circularqueue_insert(queue, 7);
+    cr_assert(circularqueue_count(queue) == 1);
+    cr_assert(circularqueue_head(queue) == 7);
+
+    circularqueue_delete(queue);
+}
+
 #endif
@@ -0,0 +1,379 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/disruptor.h"
+#ifdef WITH_TEST
+# include <pthread.h>
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Spin a while, then give the processor to the thread being waited for
+ */
+static void disruptor_pause(unsigned *spins) {
+    if (*spins < DISRUPTOR_SPINS) {
+        (*spins)++;
+    }
+    else {
+        sched_yield();
+    }
+}
+
+/**
+ * Find the sequence of the slowest consumer, the writer must stay a
+ * ring behind it
+ */
+static uint64_t disruptor_gate(const disruptor *ring) {
+    uint64_t gate = ring->claimed;
+
+    for (size_t i = 0; i < ring->consumers; i++) {
+        uint64_t sequence = __atomic_load_n(&ring->consumer[i]->sequence,
+                                            __ATOMIC_ACQUIRE);
+        if (sequence < gate) {
+            gate = sequence;
+        }
+    }
+
+    return gate;
+}
+
+/**
+ * Find how far a consumer may read: the cursor, or the slowest of the
+ * consumers it depends on
+ */
+static uint64_t disruptor_barrier(const disruptor_consumer *consumer) {
+    uint64_t barrier;
+
+    if (consumer->dependencies == 0) {
+        return __atomic_load_n(&consumer->ring->cursor, __ATOMIC_ACQUIRE);
+    }
+
+    barrier = __atomic_load_n(&consumer->dependency[0]->sequence,
+                              __ATOMIC_ACQUIRE);
+    for (size_t i = 1; i < consumer->dependencies; i++) {
+        uint64_t sequence = __atomic_load_n(&consumer->dependency[i]->sequence,
+                                            __ATOMIC_ACQUIRE);
+        if (sequence < barrier) {
+            barrier = sequence;
+        }
+    }
+
+    return barrier;
+}
+
+disruptor *disruptor_create(size_t size) {
+    disruptor *ring = NULL;
+    size_t slots = 1;
+    int error;
+
+    if (size == 0 || size > SIZE_MAX / sizeof(int) / 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+    while (slots < size) {
+        slots <<= 1;
+    }
+
+    error = posix_memalign((void **)&ring, DISRUPTOR_CACHE_LINE,
+                           sizeof(*ring));
+    if (error) {
+        errno = error;
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+
+    ring->element = calloc(slots, sizeof(*ring->element));
+    if (ring->element == NULL) {
+        free(ring);
+        errno = ENOMEM;
+        return NULL;
+    }
+    ring->size = slots;
+    ring->mask = slots - 1;
+
+    return ring;
+}
+
+void disruptor_delete(disruptor *ring) {
+    assert(ring);
+
+    for (size_t i = 0; i < ring->consumers; i++) {
+        free(ring->consumer[i]->dependency);
+        free(ring->consumer[i]);
+    }
+    free(ring->consumer);
+    free(ring->element);
+    free(ring);
+}
+
+disruptor_consumer *disruptor_add_consumer(disruptor *ring,
+                                           disruptor_consumer *const *dependency,
+                                           size_t dependencies) {
+    disruptor_consumer *consumer = NULL;
+    disruptor_consumer **consumers = NULL;
+    int error;
+
+    assert(ring);
+    assert(dependency || dependencies == 0);
+
+    consumers = realloc(ring->consumer,
+                        (ring->consumers + 1) * sizeof(*ring->consumer));
+    if (consumers == NULL) {
+        return NULL;
+    }
+    ring->consumer = consumers;
+
+    error = posix_memalign((void **)&consumer, DISRUPTOR_CACHE_LINE,
+                           sizeof(*consumer));
+    if (error) {
+        errno = error;
+        return NULL;
+    }
+    memset(consumer, 0, sizeof(*consumer));
+
+    if (dependencies) {
+        consumer->dependency = malloc(dependencies * sizeof(*dependency));
+        if (consumer->dependency == NULL) {
+            free(consumer);
+            errno = ENOMEM;
+            return NULL;
+        }
+        for (size_t i = 0; i < dependencies; i++) {
+            assert(dependency[i]->ring == ring);
+            consumer->dependency[i] = dependency[i];
+        }
+    }
+    consumer->dependencies = dependencies;
+    consumer->ring = ring;
+    consumer->sequence = __atomic_load_n(&ring->cursor, __ATOMIC_RELAXED);
+    consumer->cached_barrier = consumer->sequence;
+
+    ring->consumer[ring->consumers++] = consumer;
+
+    return consumer;
+}
+
+int *disruptor_slot(const disruptor *ring, uint64_t sequence) {
+    assert(ring);
+
+    return ring->element + (sequence & ring->mask);
+}
+
+size_t disruptor_try_claim(disruptor *ring, size_t count, uint64_t *first) {
+    size_t free_slots;
+
+    assert(ring);
+    assert(first);
+
+    if (ring->claimed + count - ring->cached_gate > ring->size) {
+        ring->cached_gate = disruptor_gate(ring);
+    }
+    free_slots = ring->size - (ring->claimed - ring->cached_gate);
+    if (count > free_slots) {
+        count = free_slots;
+    }
+
+    *first = ring->claimed;
+    ring->claimed += count;
+
+    return count;
+}
+
+uint64_t disruptor_claim(disruptor *ring, size_t count) {
+    unsigned spins = 0;
+    uint64_t first;
+
+    assert(ring);
+    assert(count <= ring->size);
+
+    while (ring->claimed + count - ring->cached_gate > ring->size) {
+        ring->cached_gate = disruptor_gate(ring);
+        if (ring->claimed + count - ring->cached_gate > ring->size) {
+            disruptor_pause(&spins);
+        }
+    }
+
+    first = ring->claimed;
+    ring->claimed += count;
+
+    return first;
+}
+
+void disruptor_publish(disruptor *ring) {
+    assert(ring);
+
+    __atomic_store_n(&ring->cursor, ring->claimed, __ATOMIC_RELEASE);
+}
+
+void disruptor_publish_range(disruptor *ring, const int *values,
+                             size_t count) {
+    assert(ring);
+    assert(values || count == 0);
+
+    while (count) {
+        size_t batch = count < ring->size ? count : ring->size;
+        uint64_t first = disruptor_claim(ring, batch);
+        size_t offset = first & ring->mask;
+        size_t end = ring->size - offset < batch ? ring->size - offset : batch;
+
+        memcpy(ring->element + offset, values, end * sizeof(int));
+        memcpy(ring->element, values + end, (batch - end) * sizeof(int));
+        disruptor_publish(ring);
+
+        values += batch;
+        count -= batch;
+    }
+}
+
+void disruptor_close(disruptor *ring) {
+    assert(ring);
+
+    disruptor_publish(ring);
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+}
+
+size_t disruptor_available(disruptor_consumer *consumer, uint64_t *first) {
+    uint64_t sequence;
+
+    assert(consumer);
+    assert(first);
+
+    sequence = __atomic_load_n(&consumer->sequence, __ATOMIC_RELAXED);
+    if (consumer->cached_barrier == sequence) {
+        consumer->cached_barrier = disruptor_barrier(consumer);
+    }
+
+    *first = sequence;
+    return consumer->cached_barrier - sequence;
+}
+
+size_t disruptor_wait(disruptor_consumer *consumer, uint64_t *first) {
+    unsigned spins = 0;
+
+    for (;;) {
+        size_t count = disruptor_available(consumer, first);
+
+        if (count) {
+            return count;
+        }
+        /* Every slot was published before closing, and will be released */
+        if (__atomic_load_n(&consumer->ring->closed, __ATOMIC_ACQUIRE)
+            && *first == __atomic_load_n(&consumer->ring->cursor,
+                                         __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+        disruptor_pause(&spins);
+    }
+}
+
+void disruptor_release(disruptor_consumer *consumer, size_t count) {
+    uint64_t sequence;
+
+    assert(consumer);
+
+    sequence = __atomic_load_n(&consumer->sequence, __ATOMIC_RELAXED);
+    assert(sequence + count <= consumer->cached_barrier);
+    __atomic_store_n(&consumer->sequence, sequence + count, __ATOMIC_RELEASE);
+}
+
+#ifdef WITH_TEST
+Test(Disruptor, barriers) {
+    disruptor *ring = disruptor_create(6);
+    disruptor_consumer *first_stage[2];
+    disruptor_consumer *second_stage = NULL;
+    int values[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    uint64_t first;
+
+    cr_assert(ring);
+    cr_assert(ring->size == 8);
+    first_stage[0] = disruptor_add_consumer(ring, NULL, 0);
+    first_stage[1] = disruptor_add_consumer(ring, NULL, 0);
+    second_stage = disruptor_add_consumer(ring, first_stage, 2);
+    cr_assert(first_stage[0] && first_stage[1] && second_stage);
+
+    disruptor_publish_range(ring, values, 6);
+    cr_assert(disruptor_available(first_stage[0], &first) == 6);
+    cr_assert(first == 0);
+    cr_assert(*disruptor_slot(ring, first + 5) == 5);
+    cr_assert(disruptor_available(second_stage, &first) == 0);
+
+    /* The second stage follows the slowest of the first one */
+    disruptor_release(first_stage[0], 6);
+    cr_assert(disruptor_available(first_stage[1], &first) == 6);
+    disruptor_release(first_stage[1], 2);
+    cr_assert(disruptor_available(second_stage, &first) == 2);
+    disruptor_release(second_stage, 2);
+
+    /* The writer stays a ring behind the second stage */
+    cr_assert(disruptor_try_claim(ring, 8, &first) == 4);
+    cr_assert(first == 6);
+    for (int i = 0; i < 4; i++) {
+        *disruptor_slot(ring, first + i) = 6 + i;
+    }
+    disruptor_publish(ring);
+    cr_assert(*disruptor_slot(ring, 8) == 8);
+    cr_assert(disruptor_try_claim(ring, 1, &first) == 0);
+    cr_assert(disruptor_available(first_stage[0], &first) == 4);
+
+    disruptor_delete(ring);
+}
+
+#define DISRUPTOR_TEST_VALUES 100000
+
+static void *disruptor_test_consume(void *arg) {
+    disruptor_consumer *consumer = arg;
+    uint64_t expected = 0;
+    uint64_t first;
+    size_t count;
+
+    while ((count = disruptor_wait(consumer, &first))) {
+        for (size_t i = 0; i < count; i++) {
+            if (*disruptor_slot(consumer->ring, first + i)
+                != (int)(expected + i)) {
+                return arg;
+            }
+        }
+        expected += count;
+        disruptor_release(consumer, count);
+    }
+
+    return expected == DISRUPTOR_TEST_VALUES ? NULL : arg;
+}
+
+Test(Disruptor, pipeline) {
+    disruptor *ring = disruptor_create(64);
+    disruptor_consumer *consumer[3];
+    pthread_t thread[3];
+    int values[50];
+
+    consumer[0] = disruptor_add_consumer(ring, NULL, 0);
+    consumer[1] = disruptor_add_consumer(ring, NULL, 0);
+    consumer[2] = disruptor_add_consumer(ring, consumer, 2);
+    for (size_t i = 0; i < 3; i++) {
+        cr_assert(pthread_create(&thread[i], NULL, disruptor_test_consume,
+                                 consumer[i]) == 0);
+    }
+
+    for (int i = 0; i < DISRUPTOR_TEST_VALUES; i += 50) {
+        for (int j = 0; j < 50; j++) {
+            values[j] = i + j;
+        }
+        disruptor_publish_range(ring, values, 50);
+    }
+    disruptor_close(ring);
+
+    for (size_t i = 0; i < 3; i++) {
+        void *result = consumer[i];
+
+        pthread_join(thread[i], &result);
+        cr_assert(result == NULL);
+    }
+
+    disruptor_delete(ring);
+}
+#endif
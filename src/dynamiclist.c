@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include "woofi/allocator.h"
+
 struct dynamicList {
 	struct dynamicList *next;
 	int element;
@@ -34,7 +36,7 @@ void dynamicList_print(struct dynamicList *my_list) {
 struct dynamicList *dynamicList_create(int value) {
 	struct dynamicList *new_list = NULL;
 
-	new_list = calloc(1, sizeof(struct dynamicList));
+	new_list = allocator_calloc(1, sizeof(struct dynamicList));
 	if (new_list == NULL) {
 		return NULL;
 	}
@@ -130,13 +132,13 @@ struct dynamicList *dynamicList_remove_value(struct dynamicList *my_list, int va
 	if (my_list->element == value) {
 		head = my_list->next;
 
-		free(my_list);
+		allocator_free(my_list, sizeof(struct dynamicList));
 	}
 	else {
 		while(my_list != NULL) {
 			if(my_list->element == value) {
 				previous->next = my_list->next;
-	            free(my_list);
+	            allocator_free(my_list, sizeof(struct dynamicList));
 				break;
 			}
 
@@ -162,18 +164,18 @@ struct dynamicList *dynamicList_remove_at(struct dynamicList *my_list, int index
 			if (i == 0) {
 				head = my_list->next;
 
-				free(my_list);
+				allocator_free(my_list, sizeof(struct dynamicList));
 			}
 			else {
 				previous->next = my_list->next;
-	            free(my_list);
+	            allocator_free(my_list, sizeof(struct dynamicList));
 			}
 
 			break;
 		}
 		else if (my_list->next == NULL) {
 			previous->next  = NULL;
-			free(my_list);
+			allocator_free(my_list, sizeof(struct dynamicList));
 
 			break;
 		}
@@ -227,10 +229,10 @@ void dynamicList_delete(struct dynamicList *my_list) {
 		previous = my_list;
 		my_list = my_list->next;
 
-		free(previous);
+		allocator_free(previous, sizeof(struct dynamicList));
 	}
 
-	free(my_list);
+	allocator_free(my_list, sizeof(struct dynamicList));
 }
 
 int main(void) {
@@ -0,0 +1,361 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/epoch.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Call the free function of every object of a list of bags, and free
+ * the bags
+ * @return the number of freed objects
+ */
+static size_t epoch_bags_free(epoch_bag *bag) {
+    size_t freed = 0;
+
+    while (bag) {
+        epoch_bag *next = bag->next;
+
+        for (size_t i = 0; i < bag->count; i++) {
+            bag->item[i].fn(bag->item[i].ptr);
+        }
+        freed += bag->count;
+        free(bag);
+        bag = next;
+    }
+
+    return freed;
+}
+
+/**
+ * Tag a bag with the current epoch, which is at least the epoch each of
+ * its objects was retired in, and queue it for reclamation.
+ * The domain lock must be held.
+ */
+static void epoch_seal(epoch_domain *domain, epoch_bag *bag) {
+    bag->epoch = __atomic_load_n(&domain->epoch, __ATOMIC_RELAXED);
+    bag->next = domain->sealed;
+    domain->sealed = bag;
+    domain->pending += bag->count;
+}
+
+epoch_domain *epoch_create() {
+    epoch_domain *domain = calloc(1, sizeof(*domain));
+    int error;
+
+    if (domain == NULL) {
+        return NULL;
+    }
+
+    error = pthread_mutex_init(&domain->lock, NULL);
+    if (error) {
+        free(domain);
+        errno = error;
+        return NULL;
+    }
+    domain->epoch = 1;
+
+    return domain;
+}
+
+void epoch_delete(epoch_domain *domain) {
+    assert(domain);
+
+    epoch_bags_free(domain->sealed);
+    epoch_bags_free(domain->shared);
+    while (domain->records) {
+        epoch_record *record = domain->records;
+
+        assert(record->state == 0);
+        domain->records = record->next;
+        epoch_bags_free(record->bag);
+        free(record);
+    }
+
+    pthread_mutex_destroy(&domain->lock);
+    free(domain);
+}
+
+epoch_record *epoch_register(epoch_domain *domain) {
+    epoch_record *record = NULL;
+    int error;
+
+    assert(domain);
+
+    pthread_mutex_lock(&domain->lock);
+    for (record = domain->records; record; record = record->next) {
+        if (!record->used) {
+            record->used = 1;
+            pthread_mutex_unlock(&domain->lock);
+            return record;
+        }
+    }
+
+    error = posix_memalign((void **)&record, EPOCH_CACHE_LINE,
+                           sizeof(*record));
+    if (error) {
+        pthread_mutex_unlock(&domain->lock);
+        errno = error;
+        return NULL;
+    }
+    memset(record, 0, sizeof(*record));
+    record->used = 1;
+    record->next = domain->records;
+    domain->records = record;
+    pthread_mutex_unlock(&domain->lock);
+
+    return record;
+}
+
+void epoch_unregister(epoch_domain *domain, epoch_record *record) {
+    assert(domain);
+    assert(record);
+    assert(record->depth == 0);
+
+    pthread_mutex_lock(&domain->lock);
+    if (record->bag) {
+        epoch_seal(domain, record->bag);
+        record->bag = NULL;
+    }
+    record->used = 0;
+    pthread_mutex_unlock(&domain->lock);
+}
+
+void epoch_enter(epoch_domain *domain, epoch_record *record) {
+    uint64_t epoch;
+
+    if (record->depth++) {
+        return;
+    }
+
+    /*
+     * The sequentially consistent store is ordered before the reads of
+     * shared pointers, so a reclaimer either sees the reader pinned or
+     * the reader sees the objects unlinked.
+     */
+    epoch = __atomic_load_n(&domain->epoch, __ATOMIC_RELAXED);
+    __atomic_store_n(&record->state, epoch * 2 + 1, __ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_record *record) {
+    assert(record->depth > 0);
+
+    if (--record->depth == 0) {
+        __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+    }
+}
+
+int epoch_retire(epoch_domain *domain, void *ptr, epoch_free_fn fn) {
+    assert(domain);
+    assert(fn);
+
+    pthread_mutex_lock(&domain->lock);
+    if (domain->shared && domain->shared->count == EPOCH_BAG_SIZE) {
+        epoch_seal(domain, domain->shared);
+        domain->shared = NULL;
+    }
+    if (domain->shared == NULL) {
+        domain->shared = malloc(sizeof(*(domain->shared)));
+        if (domain->shared == NULL) {
+            pthread_mutex_unlock(&domain->lock);
+            return -1;
+        }
+        domain->shared->count = 0;
+        domain->shared->next = NULL;
+    }
+    domain->shared->item[domain->shared->count].ptr = ptr;
+    domain->shared->item[domain->shared->count].fn = fn;
+    domain->shared->count++;
+    pthread_mutex_unlock(&domain->lock);
+
+    return 0;
+}
+
+int epoch_defer(epoch_domain *domain, epoch_record *record, void *ptr,
+                epoch_free_fn fn) {
+    epoch_bag *bag = record->bag;
+
+    assert(domain);
+    assert(fn);
+
+    if (bag == NULL) {
+        bag = malloc(sizeof(*bag));
+        if (bag == NULL) {
+            return -1;
+        }
+        bag->count = 0;
+        bag->next = NULL;
+        record->bag = bag;
+    }
+
+    bag->item[bag->count].ptr = ptr;
+    bag->item[bag->count].fn = fn;
+    if (++bag->count == EPOCH_BAG_SIZE) {
+        epoch_flush(domain, record);
+        epoch_reclaim(domain);
+    }
+
+    return 0;
+}
+
+void epoch_flush(epoch_domain *domain, epoch_record *record) {
+    assert(domain);
+    assert(record);
+
+    if (record->bag == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&domain->lock);
+    epoch_seal(domain, record->bag);
+    pthread_mutex_unlock(&domain->lock);
+    record->bag = NULL;
+}
+
+/**
+ * Move the epoch forward if no reader is pinned on an older one.
+ * The domain lock must be held.
+ * @return the current epoch
+ */
+static uint64_t epoch_try_advance(epoch_domain *domain) {
+    uint64_t epoch = __atomic_load_n(&domain->epoch, __ATOMIC_SEQ_CST);
+
+    for (epoch_record *record = domain->records; record;
+         record = record->next) {
+        uint64_t state = __atomic_load_n(&record->state, __ATOMIC_SEQ_CST);
+
+        if (state && state >> 1 != epoch) {
+            return epoch;
+        }
+    }
+
+    __atomic_store_n(&domain->epoch, epoch + 1, __ATOMIC_RELEASE);
+    return epoch + 1;
+}
+
+size_t epoch_reclaim(epoch_domain *domain) {
+    epoch_bag *ready = NULL;
+    epoch_bag **link = NULL;
+    uint64_t epoch;
+
+    assert(domain);
+
+    pthread_mutex_lock(&domain->lock);
+    if (domain->shared) {
+        epoch_seal(domain, domain->shared);
+        domain->shared = NULL;
+    }
+    epoch = epoch_try_advance(domain);
+
+    /* Readers pinned on epoch - 1 may still see objects sealed then */
+    link = &domain->sealed;
+    while (*link) {
+        epoch_bag *bag = *link;
+
+        if (bag->epoch + 2 <= epoch) {
+            *link = bag->next;
+            bag->next = ready;
+            ready = bag;
+            domain->pending -= bag->count;
+        } else {
+            link = &bag->next;
+        }
+    }
+    pthread_mutex_unlock(&domain->lock);
+
+    return epoch_bags_free(ready);
+}
+
+void epoch_synchronize(epoch_domain *domain) {
+    uint64_t target;
+
+    assert(domain);
+
+    /* Seals the shared bag first, so it is tagged with an epoch <= target */
+    epoch_reclaim(domain);
+    target = __atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE) + 2;
+    for (;;) {
+        epoch_reclaim(domain);
+        if (__atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE) >= target) {
+            break;
+        }
+        sched_yield();
+    }
+    /* Objects retired in the last epoch are freed with the new one */
+    epoch_reclaim(domain);
+}
+
+#ifdef WITH_TEST
+static void epoch_test_free(void *ptr) {
+    (*(int *)ptr)++;
+}
+
+Test(Epoch, pinned_reader_delays_free) {
+    epoch_domain *domain = epoch_create();
+    epoch_record *reader = epoch_register(domain);
+    int freed = 0;
+
+    cr_assert(domain);
+    cr_assert(reader);
+
+    epoch_enter(domain, reader);
+    epoch_enter(domain, reader);
+    cr_assert(epoch_retire(domain, &freed, epoch_test_free) == 0);
+    for (int i = 0; i < 10; i++) {
+        epoch_reclaim(domain);
+    }
+    cr_assert(freed == 0);
+
+    epoch_exit(reader);
+    epoch_reclaim(domain);
+    cr_assert(freed == 0);
+    epoch_exit(reader);
+
+    epoch_synchronize(domain);
+    cr_assert(freed == 1);
+    cr_assert(domain->pending == 0);
+
+    /* Unregistered records are reused */
+    epoch_unregister(domain, reader);
+    cr_assert(epoch_register(domain) == reader);
+
+    cr_assert(epoch_retire(domain, &freed, epoch_test_free) == 0);
+    epoch_delete(domain);
+    cr_assert(freed == 2);
+}
+
+Test(Epoch, defer_batches) {
+    epoch_domain *domain = epoch_create();
+    epoch_record *record = epoch_register(domain);
+    int freed = 0;
+
+    /* Deferred objects stay with the record until its bag is full */
+    for (int i = 0; i < EPOCH_BAG_SIZE - 1; i++) {
+        cr_assert(epoch_defer(domain, record, &freed, epoch_test_free) == 0);
+    }
+    cr_assert(domain->pending == 0);
+    cr_assert(epoch_defer(domain, record, &freed, epoch_test_free) == 0);
+    cr_assert(record->bag == NULL);
+    cr_assert(domain->pending == EPOCH_BAG_SIZE);
+
+    cr_assert(epoch_defer(domain, record, &freed, epoch_test_free) == 0);
+    epoch_flush(domain, record);
+    epoch_synchronize(domain);
+    cr_assert(freed == EPOCH_BAG_SIZE + 1);
+
+    /* Unregistering hands the bag over */
+    cr_assert(epoch_defer(domain, record, &freed, epoch_test_free) == 0);
+    epoch_unregister(domain, record);
+    cr_assert(domain->pending == 1);
+    epoch_synchronize(domain);
+    cr_assert(freed == EPOCH_BAG_SIZE + 2);
+
+    epoch_delete(domain);
+}
+#endif
@@ -0,0 +1,203 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "woofi/eventqueue.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+eventqueue *eventqueue_create() {
+    eventqueue *queue = calloc(1, sizeof(*queue));
+    int error;
+
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    /* A requested size of 0 lets the queue grow */
+    queue->queue = circularqueue_create(0);
+    if (queue->queue == NULL || queue->queue->element == NULL) {
+        goto error;
+    }
+    queue->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->fd == -1) {
+        goto error;
+    }
+    error = pthread_mutex_init(&queue->lock, NULL);
+    if (error) {
+        close(queue->fd);
+        errno = error;
+        goto error;
+    }
+
+    return queue;
+
+error:
+    error = errno;
+    if (queue->queue) {
+        circularqueue_delete(queue->queue);
+    }
+    free(queue);
+    errno = error;
+    return NULL;
+}
+
+void eventqueue_delete(eventqueue *queue) {
+    assert(queue);
+
+    close(queue->fd);
+    pthread_mutex_destroy(&queue->lock);
+    circularqueue_delete(queue->queue);
+    free(queue);
+}
+
+int eventqueue_fd(const eventqueue *queue) {
+    assert(queue);
+
+    return queue->fd;
+}
+
+size_t eventqueue_push_range(eventqueue *queue, const int *values,
+                             size_t count) {
+    size_t pushed = 0;
+
+    assert(queue);
+    assert(values || count == 0);
+
+    pthread_mutex_lock(&queue->lock);
+    while (pushed < count && circularqueue_insert(queue->queue,
+                                                  values[pushed])) {
+        pushed++;
+    }
+
+    /*
+     * Written under the lock so the eventfd is readable exactly while
+     * signaled is set, a drain can't clear it between the two
+     */
+    if (pushed && !queue->signaled) {
+        uint64_t one = 1;
+
+        if (write(queue->fd, &one, sizeof(one)) == sizeof(one)) {
+            queue->signaled = 1;
+            queue->signals++;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    if (pushed < count) {
+        errno = ENOMEM;
+    }
+
+    return pushed;
+}
+
+int eventqueue_push(eventqueue *queue, int value) {
+    return eventqueue_push_range(queue, &value, 1) == 1 ? 0 : -1;
+}
+
+size_t eventqueue_drain(eventqueue *queue, int *values, size_t count) {
+    size_t drained = 0;
+
+    assert(queue);
+    assert(values || count == 0);
+
+    pthread_mutex_lock(&queue->lock);
+    while (drained < count && !circularqueue_is_empty(queue->queue)) {
+        values[drained++] = circularqueue_head(queue->queue);
+        circularqueue_remove(queue->queue);
+    }
+
+    if (queue->signaled && circularqueue_is_empty(queue->queue)) {
+        uint64_t value;
+
+        if (read(queue->fd, &value, sizeof(value)) == sizeof(value)) {
+            queue->signaled = 0;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return drained;
+}
+
+int eventqueue_wait(eventqueue *queue, int timeout) {
+    struct pollfd pollfd;
+    int rc;
+
+    assert(queue);
+
+    pollfd.fd = queue->fd;
+    pollfd.events = POLLIN;
+    rc = poll(&pollfd, 1, timeout);
+
+    return rc > 0 ? 1 : rc;
+}
+
+size_t eventqueue_count(eventqueue *queue) {
+    size_t count;
+
+    assert(queue);
+
+    pthread_mutex_lock(&queue->lock);
+    count = circularqueue_count(queue->queue);
+    pthread_mutex_unlock(&queue->lock);
+
+    return count;
+}
+
+#ifdef WITH_TEST
+#define EVENTQUEUE_TEST_BURST 10000
+
+static void *eventqueue_test_producer(void *arg) {
+    for (int i = 0; i < EVENTQUEUE_TEST_BURST; i++) {
+        if (eventqueue_push(arg, i) == -1) {
+            return arg;
+        }
+    }
+
+    return NULL;
+}
+
+Test(Eventqueue, coalesce) {
+    eventqueue *queue = eventqueue_create();
+    int *values = calloc(EVENTQUEUE_TEST_BURST, sizeof(int));
+    void *result = NULL;
+    pthread_t thread;
+
+    cr_assert(queue);
+    cr_assert(eventqueue_wait(queue, 0) == 0);
+
+    /* A burst is one wakeup and one drain */
+    cr_assert(pthread_create(&thread, NULL, eventqueue_test_producer,
+                             queue) == 0);
+    pthread_join(thread, &result);
+    cr_assert(result == NULL);
+    cr_assert(queue->signals == 1);
+    cr_assert(eventqueue_wait(queue, -1) == 1);
+    cr_assert(eventqueue_count(queue) == EVENTQUEUE_TEST_BURST);
+    cr_assert(eventqueue_drain(queue, values, EVENTQUEUE_TEST_BURST)
+              == EVENTQUEUE_TEST_BURST);
+    for (int i = 0; i < EVENTQUEUE_TEST_BURST; i++) {
+        cr_assert(values[i] == i);
+    }
+    cr_assert(eventqueue_wait(queue, 0) == 0);
+
+    /* A partial drain leaves the eventfd readable */
+    cr_assert(eventqueue_push_range(queue, values, 10) == 10);
+    cr_assert(eventqueue_drain(queue, values, 4) == 4);
+    cr_assert(eventqueue_wait(queue, 0) == 1);
+    cr_assert(eventqueue_drain(queue, values, 10) == 6);
+    cr_assert(values[5] == 9);
+    cr_assert(eventqueue_wait(queue, 0) == 0);
+    cr_assert(queue->signals == 2);
+
+    free(values);
+    eventqueue_delete(queue);
+}
+#endif
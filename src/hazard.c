@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/hazard.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+hazard_domain *hazard_create() {
+    hazard_domain *domain = calloc(1, sizeof(*domain));
+    int error;
+
+    if (domain == NULL) {
+        return NULL;
+    }
+
+    error = pthread_mutex_init(&domain->lock, NULL);
+    if (error) {
+        free(domain);
+        errno = error;
+        return NULL;
+    }
+
+    return domain;
+}
+
+void hazard_delete(hazard_domain *domain) {
+    assert(domain);
+
+    while (domain->records) {
+        hazard_record *record = domain->records;
+
+        domain->records = record->next;
+        for (size_t i = 0; i < record->count; i++) {
+            record->retired[i].fn(record->retired[i].ptr);
+        }
+        free(record->retired);
+        free(record);
+    }
+
+    pthread_mutex_destroy(&domain->lock);
+    free(domain);
+}
+
+hazard_record *hazard_register(hazard_domain *domain) {
+    hazard_record *record = NULL;
+    int error;
+
+    assert(domain);
+
+    pthread_mutex_lock(&domain->lock);
+    for (record = domain->records; record; record = record->next) {
+        if (!record->used) {
+            record->used = 1;
+            pthread_mutex_unlock(&domain->lock);
+            return record;
+        }
+    }
+
+    error = posix_memalign((void **)&record, EPOCH_CACHE_LINE,
+                           sizeof(*record));
+    if (error) {
+        pthread_mutex_unlock(&domain->lock);
+        errno = error;
+        return NULL;
+    }
+    memset(record, 0, sizeof(*record));
+    record->used = 1;
+    record->next = domain->records;
+    domain->records = record;
+    domain->records_count++;
+    pthread_mutex_unlock(&domain->lock);
+
+    return record;
+}
+
+void hazard_unregister(hazard_domain *domain, hazard_record *record) {
+    assert(domain);
+    assert(record);
+
+    for (size_t i = 0; i < HAZARD_SLOTS; i++) {
+        hazard_clear(record, i);
+    }
+    hazard_scan(domain, record);
+
+    pthread_mutex_lock(&domain->lock);
+    record->used = 0;
+    pthread_mutex_unlock(&domain->lock);
+}
+
+void *hazard_protect(hazard_record *record, size_t slot, void *const *source) {
+    void *ptr = __atomic_load_n(source, __ATOMIC_ACQUIRE);
+
+    assert(slot < HAZARD_SLOTS);
+
+    /*
+     * Once published, the pointer can't be freed if it was still shared:
+     * a scan after the unlink is ordered after the store.
+     */
+    for (;;) {
+        void *again = NULL;
+
+        __atomic_store_n(&record->slot[slot], ptr, __ATOMIC_SEQ_CST);
+        again = __atomic_load_n(source, __ATOMIC_SEQ_CST);
+        if (again == ptr) {
+            return ptr;
+        }
+        ptr = again;
+    }
+}
+
+void hazard_clear(hazard_record *record, size_t slot) {
+    assert(slot < HAZARD_SLOTS);
+
+    __atomic_store_n(&record->slot[slot], NULL, __ATOMIC_RELEASE);
+}
+
+int hazard_retire(hazard_domain *domain, hazard_record *record, void *ptr,
+                  epoch_free_fn fn) {
+    assert(domain);
+    assert(record);
+    assert(fn);
+
+    if (record->count == record->size) {
+        size_t size = record->size ? record->size * 2 : HAZARD_SCAN_THRESHOLD;
+        epoch_deferred *retired = realloc(record->retired,
+                                          size * sizeof(*retired));
+
+        if (retired == NULL) {
+            return -1;
+        }
+        record->retired = retired;
+        record->size = size;
+    }
+
+    record->retired[record->count].ptr = ptr;
+    record->retired[record->count].fn = fn;
+    record->count++;
+    if (record->count % HAZARD_SCAN_THRESHOLD == 0) {
+        hazard_scan(domain, record);
+    }
+
+    return 0;
+}
+
+static int hazard_compare(const void *a, const void *b) {
+    uintptr_t left = (uintptr_t)*(void *const *)a;
+    uintptr_t right = (uintptr_t)*(void *const *)b;
+
+    return (left > right) - (left < right);
+}
+
+size_t hazard_scan(hazard_domain *domain, hazard_record *record) {
+    void **hazards = NULL;
+    size_t count = 0;
+    size_t kept = 0;
+
+    assert(domain);
+    assert(record);
+
+    if (record->count == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&domain->lock);
+    hazards = malloc(domain->records_count * HAZARD_SLOTS * sizeof(*hazards));
+    if (hazards == NULL) {
+        pthread_mutex_unlock(&domain->lock);
+        return 0;
+    }
+    for (hazard_record *other = domain->records; other; other = other->next) {
+        for (size_t i = 0; i < HAZARD_SLOTS; i++) {
+            void *ptr = __atomic_load_n(&other->slot[i], __ATOMIC_SEQ_CST);
+
+            if (ptr) {
+                hazards[count++] = ptr;
+            }
+        }
+    }
+    pthread_mutex_unlock(&domain->lock);
+
+    qsort(hazards, count, sizeof(*hazards), hazard_compare);
+    for (size_t i = 0; i < record->count; i++) {
+        epoch_deferred item = record->retired[i];
+
+        if (bsearch(&item.ptr, hazards, count, sizeof(*hazards),
+                    hazard_compare)) {
+            record->retired[kept++] = item;
+        } else {
+            item.fn(item.ptr);
+        }
+    }
+    free(hazards);
+
+    count = record->count - kept;
+    record->count = kept;
+
+    return count;
+}
+
+#ifdef WITH_TEST
+static void hazard_test_free(void *ptr) {
+    (*(int *)ptr)++;
+}
+
+Test(Hazard, protect_retire) {
+    hazard_domain *domain = hazard_create();
+    hazard_record *reader = hazard_register(domain);
+    hazard_record *writer = hazard_register(domain);
+    int objects[2] = { 0, 0 };
+    void *shared = &objects[0];
+
+    cr_assert(domain);
+    cr_assert(reader);
+    cr_assert(hazard_protect(reader, 1, &shared) == &objects[0]);
+
+    /* Unlinked but still protected */
+    shared = &objects[1];
+    cr_assert(hazard_retire(domain, writer, &objects[0],
+                            hazard_test_free) == 0);
+    cr_assert(hazard_scan(domain, writer) == 0);
+    cr_assert(objects[0] == 0);
+
+    hazard_clear(reader, 1);
+    cr_assert(hazard_scan(domain, writer) == 1);
+    cr_assert(objects[0] == 1);
+
+    /* Scans happen by themselves every HAZARD_SCAN_THRESHOLD */
+    for (int i = 0; i < HAZARD_SCAN_THRESHOLD; i++) {
+        cr_assert(hazard_retire(domain, writer, &objects[1],
+                                hazard_test_free) == 0);
+    }
+    cr_assert(objects[1] == HAZARD_SCAN_THRESHOLD);
+    cr_assert(writer->count == 0);
+
+    hazard_unregister(domain, reader);
+    cr_assert(hazard_register(domain) == reader);
+    cr_assert(hazard_retire(domain, reader, &objects[0],
+                            hazard_test_free) == 0);
+    hazard_delete(domain);
+    cr_assert(objects[0] == 2);
+}
+#endif
@@ -0,0 +1,488 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "woofi/heap.h"
+#include "woofi/histogram.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static const capacity_policy heap_default_policy = CAPACITY_POLICY_DEFAULT;
+
+heap *heap_create(unsigned int arity) {
+    heap *heap = NULL;
+
+    heap = calloc(1, sizeof(*heap));
+    if (heap == NULL) {
+        return NULL;
+    }
+
+    heap->size = INITIAL_HEAP_SIZE;
+    heap->arity = arity ? arity : HEAP_DEFAULT_ARITY;
+    heap->policy = heap_default_policy;
+    heap->element = malloc(heap->size * sizeof(*(heap->element)));
+    if (heap->element == NULL) {
+        free(heap);
+        return NULL;
+    }
+
+    return heap;
+}
+
+heap *heap_create_indexed(unsigned int arity, size_t ids) {
+    heap *heap = heap_create(arity);
+
+    if (heap == NULL) {
+        return NULL;
+    }
+
+    if (ids > SIZE_MAX / sizeof(*(heap->position))) {
+        heap_delete(heap);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    heap->ids = ids;
+    heap->id = malloc(heap->size * sizeof(*(heap->id)));
+    heap->position = malloc((ids ? ids : 1) * sizeof(*(heap->position)));
+    if (heap->id == NULL || heap->position == NULL) {
+        heap_delete(heap);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < ids; i++) {
+        heap->position[i] = HEAP_NO_POSITION;
+    }
+
+    return heap;
+}
+
+void heap_delete(heap *heap) {
+    assert(heap);
+
+    free(heap->position);
+    free(heap->id);
+    free(heap->element);
+    free(heap);
+}
+
+/**
+ * Change the capacity of the heap
+ * @param heap a non null pointer to a heap
+ * @param size the new capacity, at least the number of elements
+ * @return 0 if the heap was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int heap_resize(heap *heap, size_t size) {
+    int *new_elements = NULL;
+
+    if (size > SIZE_MAX / sizeof(*(heap->id))) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    new_elements = realloc(heap->element, size * sizeof(*(heap->element)));
+    if (new_elements == NULL) {
+        return -1;
+    }
+    heap->element = new_elements;
+
+    if (heap->id) {
+        size_t *new_ids = realloc(heap->id, size * sizeof(*(heap->id)));
+        if (new_ids == NULL) {
+            /* Keep both arrays the same size */
+            if (size < heap->size) {
+                heap->size = size;
+            }
+            return -1;
+        }
+        heap->id = new_ids;
+    }
+
+    heap->size = size;
+
+    return 0;
+}
+
+static int heap_grow(heap *heap) {
+    return heap_resize(heap, capacity_grow(&heap->policy, heap->size,
+                                           heap->count + 1));
+}
+
+int heap_set_policy(heap *heap, const capacity_policy *policy) {
+    assert(heap);
+
+    if (!capacity_policy_valid(policy)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    heap->policy = *policy;
+
+    return 0;
+}
+
+int heap_reserve(heap *heap, size_t size) {
+    assert(heap);
+
+    if (size <= heap->size) {
+        return 0;
+    }
+
+    return heap_resize(heap, size);
+}
+
+int heap_shrink_to_fit(heap *heap) {
+    assert(heap);
+
+    size_t size = heap->count ? heap->count : 1;
+    if (size >= heap->size) {
+        return 0;
+    }
+
+    return heap_resize(heap, size);
+}
+
+int heap_is_empty(const heap *heap) {
+    assert(heap);
+
+    return heap->count == 0;
+}
+
+size_t heap_count(const heap *heap) {
+    assert(heap);
+
+    return heap->count;
+}
+
+/**
+ * Store a value and its id at a position
+ */
+static inline void heap_place(heap *heap, size_t at, int value, size_t id) {
+    heap->element[at] = value;
+    if (heap->id) {
+        heap->id[at] = id;
+        heap->position[id] = at;
+    }
+}
+
+static inline size_t heap_id_at(const heap *heap, size_t at) {
+    return heap->id ? heap->id[at] : 0;
+}
+
+/**
+ * Move the hole at position at towards the root until value fits in it.
+ * Parents are moved down instead of swapped.
+ */
+static void heap_sift_up(heap *heap, size_t at, int value, size_t id) {
+    while (at > 0) {
+        size_t parent = (at - 1) / heap->arity;
+
+        if (heap->element[parent] <= value) {
+            break;
+        }
+        heap_place(heap, at, heap->element[parent], heap_id_at(heap, parent));
+        at = parent;
+    }
+
+    heap_place(heap, at, value, id);
+}
+
+/**
+ * Move the hole at position at towards the leaves until value fits in it
+ */
+static void heap_sift_down(heap *heap, size_t at, int value, size_t id) {
+    size_t arity = heap->arity;
+
+    while (heap->count >= 2 && at <= (heap->count - 2) / arity) {
+        size_t first = at * arity + 1;
+        size_t last = heap->count - first < arity ? heap->count : first + arity;
+        size_t smallest = first;
+
+        for (size_t child = first + 1; child < last; child++) {
+            if (heap->element[child] < heap->element[smallest]) {
+                smallest = child;
+            }
+        }
+        if (heap->element[smallest] >= value) {
+            break;
+        }
+
+        heap_place(heap, at, heap->element[smallest],
+                   heap_id_at(heap, smallest));
+        at = smallest;
+    }
+
+    heap_place(heap, at, value, id);
+}
+
+int heap_heapify(heap *heap, const int *values, size_t count) {
+    assert(heap);
+    assert(values || count == 0);
+
+    if (heap->id) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (heap_reserve(heap, count) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        heap->element[i] = values[i];
+    }
+    heap->count = count;
+
+    /* Sift down every inner node, from the last one to the root */
+    if (count >= 2) {
+        for (size_t i = (count - 2) / heap->arity + 1; i-- > 0;) {
+            heap_sift_down(heap, i, heap->element[i], 0);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Insert a value with its id, the id being valid
+ */
+static int heap_insert(heap *heap, int value, size_t id) {
+    HISTOGRAM_START(HISTOGRAM_HEAP_PUSH);
+
+    if (heap->count == heap->size && heap_grow(heap) != 0) {
+        HISTOGRAM_STOP();
+        return -1;
+    }
+
+    heap->count++;
+    heap_sift_up(heap, heap->count - 1, value, id);
+
+    HISTOGRAM_STOP();
+    return 0;
+}
+
+/**
+ * Remove the root, the heap being non empty
+ */
+static void heap_remove_root(heap *heap, size_t *id, int *value) {
+    HISTOGRAM_START(HISTOGRAM_HEAP_POP);
+
+    if (value) {
+        *value = heap->element[0];
+    }
+    if (heap->id) {
+        if (id) {
+            *id = heap->id[0];
+        }
+        heap->position[heap->id[0]] = HEAP_NO_POSITION;
+    }
+
+    heap->count--;
+    if (heap->count > 0) {
+        heap_sift_down(heap, 0, heap->element[heap->count],
+                       heap_id_at(heap, heap->count));
+    }
+
+    size_t size = capacity_shrink(&heap->policy, heap->size, heap->count);
+    if (size < heap->size) {
+        heap_resize(heap, size);
+    }
+
+    HISTOGRAM_STOP();
+}
+
+int heap_push(heap *heap, int value) {
+    assert(heap);
+
+    if (heap->id) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return heap_insert(heap, value, 0);
+}
+
+int heap_peek(const heap *heap) {
+    assert(heap);
+    assert(heap->count > 0);
+
+    return heap->element[0];
+}
+
+int heap_pop(heap *heap, int *value) {
+    assert(heap);
+
+    if (heap->count == 0) {
+        return 0;
+    }
+
+    heap_remove_root(heap, NULL, value);
+
+    return 1;
+}
+
+int heap_push_id(heap *heap, size_t id, int value) {
+    assert(heap);
+
+    if (heap->id == NULL || id >= heap->ids
+        || heap->position[id] != HEAP_NO_POSITION) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return heap_insert(heap, value, id);
+}
+
+int heap_contains_id(const heap *heap, size_t id) {
+    assert(heap);
+
+    return heap->id != NULL && id < heap->ids
+        && heap->position[id] != HEAP_NO_POSITION;
+}
+
+int heap_decrease_key(heap *heap, size_t id, int value) {
+    assert(heap);
+
+    if (!heap_contains_id(heap, id)
+        || value > heap->element[heap->position[id]]) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    heap_sift_up(heap, heap->position[id], value, id);
+
+    return 0;
+}
+
+int heap_pop_id(heap *heap, size_t *id, int *value) {
+    assert(heap);
+    assert(heap->id);
+
+    if (heap->count == 0) {
+        return 0;
+    }
+
+    heap_remove_root(heap, id, value);
+
+    return 1;
+}
+
+#ifdef WITH_TEST
+Test(Heap, push_pop) {
+    int value = 0;
+    heap *heap = heap_create(0);
+
+    cr_assert(heap);
+    cr_assert(heap->arity == HEAP_DEFAULT_ARITY);
+    cr_assert(heap_is_empty(heap));
+    cr_assert_not(heap_pop(heap, &value));
+
+    for (int i = 0; i < 1000; i++) {
+        cr_assert(heap_push(heap, (i * 7919) % 1000 - 500) == 0);
+    }
+    cr_assert(heap_count(heap) == 1000);
+    cr_assert(heap_peek(heap) == -500);
+
+    for (int i = 0; i < 1000; i++) {
+        cr_assert(heap_pop(heap, &value));
+        cr_assert(value == i - 500);
+    }
+    cr_assert(heap_is_empty(heap));
+
+    heap_delete(heap);
+}
+
+Test(Heap, heapify) {
+    int values[500];
+    int value = 0;
+    int previous = 0;
+
+    for (unsigned int arity = 2; arity <= 8; arity++) {
+        heap *heap = heap_create(arity);
+
+        for (int i = 0; i < 500; i++) {
+            values[i] = (i * 7919) % 251;
+        }
+        cr_assert(heap_heapify(heap, values, 500) == 0);
+        cr_assert(heap_count(heap) == 500);
+
+        previous = -1;
+        while (heap_pop(heap, &value)) {
+            cr_assert(value >= previous);
+            previous = value;
+        }
+
+        cr_assert(heap_heapify(heap, values, 1) == 0);
+        cr_assert(heap_peek(heap) == values[0]);
+        cr_assert(heap_heapify(heap, NULL, 0) == 0);
+        cr_assert(heap_is_empty(heap));
+
+        heap_delete(heap);
+    }
+}
+
+Test(Heap, decrease_key) {
+    size_t id = 0;
+    int value = 0;
+    heap *heap = heap_create_indexed(4, 100);
+
+    cr_assert(heap);
+    cr_assert(heap_push(heap, 1) == -1);
+    cr_assert(errno == EINVAL);
+
+    for (size_t i = 0; i < 100; i++) {
+        cr_assert(heap_push_id(heap, i, 1000 + (int)i) == 0);
+    }
+    cr_assert(heap_push_id(heap, 5, 0) == -1);
+    cr_assert(heap_push_id(heap, 100, 0) == -1);
+
+    cr_assert(heap_decrease_key(heap, 42, 10) == 0);
+    cr_assert(heap_decrease_key(heap, 42, 11) == -1);
+    cr_assert(heap_decrease_key(heap, 99, 5) == 0);
+
+    cr_assert(heap_pop_id(heap, &id, &value));
+    cr_assert(id == 99 && value == 5);
+    cr_assert_not(heap_contains_id(heap, 99));
+    cr_assert(heap_decrease_key(heap, 99, 0) == -1);
+
+    cr_assert(heap_pop_id(heap, &id, &value));
+    cr_assert(id == 42 && value == 10);
+
+    for (size_t i = 0; i < 98; i++) {
+        cr_assert(heap_pop_id(heap, &id, NULL));
+        cr_assert(id == (i < 42 ? i : i + 1));
+        cr_assert(heap->position[id] == HEAP_NO_POSITION);
+    }
+    cr_assert_not(heap_pop_id(heap, &id, &value));
+
+    /* Ids can be pushed again once popped */
+    cr_assert(heap_push_id(heap, 42, 3) == 0);
+    cr_assert(heap_contains_id(heap, 42));
+
+    heap_delete(heap);
+}
+
+Test(Heap, policy) {
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+    heap *heap = heap_create(0);
+
+    cr_assert(heap_set_policy(heap, &policy) == 0);
+    for (int i = 0; i < 10000; i++) {
+        cr_assert(heap_push(heap, i) == 0);
+    }
+    for (int i = 0; i < 9990; i++) {
+        cr_assert(heap_pop(heap, NULL));
+    }
+    cr_assert(heap->size < 1000);
+    cr_assert(heap_peek(heap) == 9990);
+
+    cr_assert(heap_shrink_to_fit(heap) == 0);
+    cr_assert(heap->size == 10);
+    cr_assert(heap_reserve(heap, 500) == 0);
+    cr_assert(heap->size == 500);
+
+    heap_delete(heap);
+}
+#endif
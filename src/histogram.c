@@ -0,0 +1,280 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "woofi/histogram.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static __thread histogram *histogram_hooks[HISTOGRAM_OP_COUNT];
+
+histogram *histogram_create() {
+    histogram *histogram = NULL;
+
+    histogram = malloc(sizeof(*histogram));
+    if (histogram == NULL) {
+	return NULL;
+    }
+
+    histogram_reset(histogram);
+
+    return histogram;
+}
+
+void histogram_delete(histogram *histogram) {
+    assert(histogram);
+
+    free(histogram);
+}
+
+void histogram_reset(histogram *histogram) {
+    assert(histogram);
+
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->min = UINT64_MAX;
+}
+
+/**
+ * Find the bucket of a value.
+ * Values below HISTOGRAM_SUB_BUCKET_COUNT have their own bucket, the others
+ * are indexed by their highest bit then by the next SUB_BUCKET_BITS bits.
+ * @param value the value to index
+ * @return the index of the bucket
+ */
+static size_t histogram_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKET_COUNT) {
+	return value;
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    size_t mantissa = value >> shift;
+
+    return (shift + 1) * HISTOGRAM_SUB_BUCKET_COUNT
+	+ mantissa - HISTOGRAM_SUB_BUCKET_COUNT;
+}
+
+/**
+ * Highest value that would be recorded in a bucket
+ * @param index the index of the bucket
+ * @return the upper bound of the bucket
+ */
+static uint64_t histogram_highest(size_t index) {
+    if (index < HISTOGRAM_SUB_BUCKET_COUNT) {
+	return index;
+    }
+
+    int shift = index / HISTOGRAM_SUB_BUCKET_COUNT - 1;
+    uint64_t mantissa = index % HISTOGRAM_SUB_BUCKET_COUNT
+	+ HISTOGRAM_SUB_BUCKET_COUNT;
+
+    return (mantissa << shift) + ((UINT64_C(1) << shift) - 1);
+}
+
+void histogram_record(histogram *histogram, uint64_t value) {
+    assert(histogram);
+
+    histogram->bucket[histogram_index(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value < histogram->min) {
+	histogram->min = value;
+    }
+    if (value > histogram->max) {
+	histogram->max = value;
+    }
+}
+
+void histogram_merge(histogram *dst, const histogram *src) {
+    assert(dst);
+    assert(src);
+
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+	dst->bucket[i] += src->bucket[i];
+    }
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+	dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+	dst->max = src->max;
+    }
+}
+
+uint64_t histogram_percentile(const histogram *histogram, double percentile) {
+    assert(histogram);
+
+    if (histogram->count == 0) {
+	return 0;
+    }
+    if (percentile >= 100.0) {
+	return histogram->max;
+    }
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+    if (target == 0) {
+	target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+	seen += histogram->bucket[i];
+	if (seen >= target) {
+	    uint64_t value = histogram_highest(i);
+	    return value < histogram->max ? value : histogram->max;
+	}
+    }
+
+    return histogram->max;
+}
+
+double histogram_mean(const histogram *histogram) {
+    assert(histogram);
+
+    if (histogram->count == 0) {
+	return 0;
+    }
+
+    return (double)histogram->sum / histogram->count;
+}
+
+void histogram_print(const histogram *histogram) {
+    assert(histogram);
+
+    printf("count=%llu min=%llu p50=%llu p99=%llu p99.9=%llu max=%llu\n",
+	   (unsigned long long)histogram->count,
+	   (unsigned long long)(histogram->count ? histogram->min : 0),
+	   (unsigned long long)histogram_percentile(histogram, 50.0),
+	   (unsigned long long)histogram_percentile(histogram, 99.0),
+	   (unsigned long long)histogram_percentile(histogram, 99.9),
+	   (unsigned long long)histogram->max);
+}
+
+uint64_t histogram_clock() {
+#if defined(WOOFI_HISTOGRAM_RDTSC) && (defined(__x86_64__) || defined(__i386__))
+    uint32_t low, high;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t)high << 32) | low;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+}
+
+void histogram_attach(histogram_op op, histogram *histogram) {
+    assert(op < HISTOGRAM_OP_COUNT);
+
+    histogram_hooks[op] = histogram;
+}
+
+histogram *histogram_attached(histogram_op op) {
+    return histogram_hooks[op];
+}
+
+#ifdef WITH_TEST
+Test(Histogram, create) {
+    histogram *histogram = histogram_create();
+
+    cr_assert(histogram);
+    cr_assert(histogram->count == 0);
+    cr_assert(histogram_percentile(histogram, 50.0) == 0);
+    cr_assert(histogram_mean(histogram) == 0);
+
+    histogram_delete(histogram);
+}
+
+Test(Histogram, index) {
+    for (uint64_t value = 0; value < 100000; value += 7) {
+	size_t index = histogram_index(value);
+	cr_assert(histogram_highest(index) >= value);
+	cr_assert(index == 0 || histogram_highest(index - 1) < value);
+    }
+
+    cr_assert(histogram_index(UINT64_MAX) == HISTOGRAM_BUCKET_COUNT - 1);
+    cr_assert(histogram_highest(HISTOGRAM_BUCKET_COUNT - 1) == UINT64_MAX);
+}
+
+Test(Histogram, percentile) {
+    histogram *histogram = histogram_create();
+
+    for (uint64_t i = 1; i <= 1000; i++) {
+	histogram_record(histogram, i);
+    }
+
+    cr_assert(histogram->count == 1000);
+    cr_assert(histogram->min == 1);
+    cr_assert(histogram->max == 1000);
+    cr_assert(histogram_mean(histogram) == 500.5);
+
+    uint64_t p50 = histogram_percentile(histogram, 50.0);
+    uint64_t p99 = histogram_percentile(histogram, 99.0);
+    cr_assert(p50 >= 500 && p50 <= 500 + 500 / HISTOGRAM_SUB_BUCKET_COUNT);
+    cr_assert(p99 >= 990 && p99 <= 1000);
+    cr_assert(histogram_percentile(histogram, 100.0) == 1000);
+
+    histogram_delete(histogram);
+}
+
+Test(Histogram, merge) {
+    histogram *a = histogram_create();
+    histogram *b = histogram_create();
+
+    for (uint64_t i = 0; i < 100; i++) {
+	histogram_record(a, 10);
+	histogram_record(b, 1000000);
+    }
+    histogram_merge(a, b);
+
+    cr_assert(a->count == 200);
+    cr_assert(a->min == 10);
+    cr_assert(a->max == 1000000);
+    cr_assert(histogram_percentile(a, 50.0) == 10);
+    cr_assert(histogram_percentile(a, 99.0) == 1000000);
+
+    histogram_delete(a);
+    histogram_delete(b);
+}
+
+Test(Histogram, attach) {
+    histogram *histogram = histogram_create();
+
+    cr_assert(histogram_attached(HISTOGRAM_STACK_INSERT) == NULL);
+    histogram_attach(HISTOGRAM_STACK_INSERT, histogram);
+    cr_assert(histogram_attached(HISTOGRAM_STACK_INSERT) == histogram);
+    histogram_attach(HISTOGRAM_STACK_INSERT, NULL);
+    cr_assert(histogram_attached(HISTOGRAM_STACK_INSERT) == NULL);
+
+    histogram_delete(histogram);
+}
+
+#ifdef WITH_HISTOGRAM
+# include "woofi/stack.h"
+
+Test(Histogram, hook) {
+    histogram *histogram = histogram_create();
+    stack *stack = stack_create();
+
+    histogram_attach(HISTOGRAM_STACK_INSERT, histogram);
+    for (int i = 0; i < 1000; i++) {
+	stack_insert(stack, i);
+    }
+    histogram_attach(HISTOGRAM_STACK_INSERT, NULL);
+    stack_insert(stack, 42);
+
+    cr_assert(histogram->count == 1000);
+
+    stack_delete(stack);
+    histogram_delete(histogram);
+}
+#endif
+#endif
@@ -0,0 +1,480 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/magazine.h"
+#ifdef WITH_TEST
+# include "woofi/arraylist.h"
+# include "woofi/stack.h"
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Get the size class of a block, MAGAZINE_MIN_SIZE << class bytes
+ */
+static inline size_t magazine_class(size_t size) {
+    if (size <= MAGAZINE_MIN_SIZE) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(size - 1) - __builtin_ctz(MAGAZINE_MIN_SIZE);
+}
+
+static inline size_t magazine_class_size(size_t class) {
+    return (size_t)MAGAZINE_MIN_SIZE << class;
+}
+
+/**
+ * Give the blocks of a magazine back to libc
+ */
+static void magazine_drain(magazine *magazine) {
+    for (size_t i = 0; i < magazine->count; i++) {
+        free(magazine->round[i]);
+    }
+    magazine->count = 0;
+}
+
+/**
+ * Hand the magazines of a thread back to the depots and free its state.
+ * Full magazines are kept while the depot has room, others are drained.
+ */
+static void magazine_thread_flush(magazine_thread *thread) {
+    magazine_cache *cache = thread->cache;
+
+    for (size_t class = 0; class < MAGAZINE_CLASSES; class++) {
+        magazine_depot *depot = &cache->depot[class];
+        magazine *magazine[2] = { thread->slot[class].loaded,
+                                  thread->slot[class].previous };
+
+        pthread_mutex_lock(&depot->lock);
+        for (size_t i = 0; i < 2; i++) {
+            if (magazine[i] == NULL) {
+                continue;
+            }
+            if (magazine[i]->count == MAGAZINE_ROUNDS
+                && depot->full_count < MAGAZINE_DEPOT_LIMIT) {
+                magazine[i]->next = depot->full;
+                depot->full = magazine[i];
+                depot->full_count++;
+            }
+            else {
+                magazine_drain(magazine[i]);
+                magazine[i]->next = depot->empty;
+                depot->empty = magazine[i];
+            }
+        }
+        pthread_mutex_unlock(&depot->lock);
+    }
+
+    free(thread);
+}
+
+static void magazine_thread_exit(void *arg) {
+    magazine_thread_flush(arg);
+}
+
+/**
+ * Get the state of the calling thread, creating it on first use
+ * @return the state or NULL on error (see errno)
+ */
+static magazine_thread *magazine_thread_get(magazine_cache *cache) {
+    magazine_thread *thread = pthread_getspecific(cache->key);
+    int error;
+
+    if (thread) {
+        return thread;
+    }
+
+    thread = calloc(1, sizeof(*thread));
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->cache = cache;
+    error = pthread_setspecific(cache->key, thread);
+    if (error) {
+        free(thread);
+        errno = error;
+        return NULL;
+    }
+
+    return thread;
+}
+
+/**
+ * Swap the loaded and previous magazines of a class, both empty or
+ * missing, for a full one of the depot. The previous one goes to the
+ * depot and the loaded one becomes the previous one.
+ * @return 0 if the loaded magazine is full
+ *        -1 if the depot had no full magazine
+ */
+static int magazine_refill(magazine_thread *thread, size_t class) {
+    magazine_depot *depot = &thread->cache->depot[class];
+    magazine *full = NULL;
+
+    pthread_mutex_lock(&depot->lock);
+    full = depot->full;
+    if (full) {
+        depot->full = full->next;
+        depot->full_count--;
+        if (thread->slot[class].previous) {
+            thread->slot[class].previous->next = depot->empty;
+            depot->empty = thread->slot[class].previous;
+        }
+        depot->exchanges++;
+    }
+    pthread_mutex_unlock(&depot->lock);
+
+    if (full == NULL) {
+        return -1;
+    }
+    thread->slot[class].previous = thread->slot[class].loaded;
+    thread->slot[class].loaded = full;
+
+    return 0;
+}
+
+/**
+ * Swap the loaded and previous magazines of a class, both full or
+ * missing, for an empty one of the depot. The previous one goes to the
+ * depot, drained if it has enough full magazines.
+ * @return 0 if the loaded magazine is empty
+ *        -1 on error, if it failed to allocate a magazine (see errno)
+ */
+static int magazine_unload(magazine_thread *thread, size_t class) {
+    magazine_depot *depot = &thread->cache->depot[class];
+    magazine *previous = thread->slot[class].previous;
+    magazine *empty = NULL;
+
+    pthread_mutex_lock(&depot->lock);
+    empty = depot->empty;
+    if (empty) {
+        depot->empty = empty->next;
+    }
+    if (previous && depot->full_count < MAGAZINE_DEPOT_LIMIT) {
+        previous->next = depot->full;
+        depot->full = previous;
+        depot->full_count++;
+        previous = NULL;
+    }
+    depot->exchanges++;
+    pthread_mutex_unlock(&depot->lock);
+
+    /* Drain outside of the lock */
+    if (previous) {
+        magazine_drain(previous);
+        if (empty) {
+            free(previous);
+        }
+        else {
+            empty = previous;
+        }
+    }
+    if (empty == NULL) {
+        empty = malloc(sizeof(*empty));
+    }
+
+    thread->slot[class].previous = thread->slot[class].loaded;
+    thread->slot[class].loaded = empty;
+    if (empty == NULL) {
+        return -1;
+    }
+    empty->count = 0;
+
+    return 0;
+}
+
+magazine_cache *magazine_create() {
+    magazine_cache *cache = calloc(1, sizeof(*cache));
+    int error;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    error = pthread_key_create(&cache->key, magazine_thread_exit);
+    if (error) {
+        free(cache);
+        errno = error;
+        return NULL;
+    }
+    for (size_t class = 0; class < MAGAZINE_CLASSES; class++) {
+        error = pthread_mutex_init(&cache->depot[class].lock, NULL);
+        if (error) {
+            while (class--) {
+                pthread_mutex_destroy(&cache->depot[class].lock);
+            }
+            pthread_key_delete(cache->key);
+            free(cache);
+            errno = error;
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+void magazine_delete(magazine_cache *cache) {
+    assert(cache);
+
+    magazine_flush(cache);
+    pthread_key_delete(cache->key);
+
+    for (size_t class = 0; class < MAGAZINE_CLASSES; class++) {
+        magazine_depot *depot = &cache->depot[class];
+
+        while (depot->full) {
+            magazine *full = depot->full;
+
+            depot->full = full->next;
+            magazine_drain(full);
+            free(full);
+        }
+        while (depot->empty) {
+            magazine *empty = depot->empty;
+
+            depot->empty = empty->next;
+            free(empty);
+        }
+        pthread_mutex_destroy(&depot->lock);
+    }
+
+    free(cache);
+}
+
+void *magazine_alloc(magazine_cache *cache, size_t size) {
+    magazine_thread *thread = NULL;
+    magazine *loaded = NULL;
+    size_t class;
+
+    assert(cache);
+
+    if (size > MAGAZINE_MAX_SIZE) {
+        return malloc(size);
+    }
+
+    class = magazine_class(size);
+    thread = magazine_thread_get(cache);
+    if (thread == NULL) {
+        return malloc(magazine_class_size(class));
+    }
+
+    loaded = thread->slot[class].loaded;
+    if (loaded == NULL || loaded->count == 0) {
+        magazine *previous = thread->slot[class].previous;
+
+        if (previous && previous->count) {
+            thread->slot[class].previous = loaded;
+            thread->slot[class].loaded = previous;
+        }
+        else if (magazine_refill(thread, class) == -1) {
+            return malloc(magazine_class_size(class));
+        }
+        loaded = thread->slot[class].loaded;
+    }
+
+    return loaded->round[--loaded->count];
+}
+
+void magazine_free(magazine_cache *cache, void *ptr, size_t size) {
+    magazine_thread *thread = NULL;
+    magazine *loaded = NULL;
+    size_t class;
+
+    assert(cache);
+
+    if (ptr == NULL || size > MAGAZINE_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    class = magazine_class(size);
+    thread = magazine_thread_get(cache);
+    if (thread == NULL) {
+        free(ptr);
+        return;
+    }
+
+    loaded = thread->slot[class].loaded;
+    if (loaded == NULL || loaded->count == MAGAZINE_ROUNDS) {
+        magazine *previous = thread->slot[class].previous;
+
+        if (previous && previous->count < MAGAZINE_ROUNDS) {
+            thread->slot[class].previous = loaded;
+            thread->slot[class].loaded = previous;
+        }
+        else if (magazine_unload(thread, class) == -1) {
+            free(ptr);
+            return;
+        }
+        loaded = thread->slot[class].loaded;
+    }
+
+    loaded->round[loaded->count++] = ptr;
+}
+
+void *magazine_realloc(magazine_cache *cache, void *ptr, size_t old_size,
+                       size_t size) {
+    void *new_ptr = NULL;
+
+    assert(cache);
+
+    if (ptr == NULL) {
+        return magazine_alloc(cache, size);
+    }
+    if (old_size > MAGAZINE_MAX_SIZE && size > MAGAZINE_MAX_SIZE) {
+        return realloc(ptr, size);
+    }
+    if (old_size <= MAGAZINE_MAX_SIZE && size <= MAGAZINE_MAX_SIZE
+        && magazine_class(old_size) == magazine_class(size)) {
+        return ptr;
+    }
+
+    /*
+     * A block is never smaller than its class, so one which can't be
+     * shrunk is kept and later cached in the smaller class
+     */
+    new_ptr = magazine_alloc(cache, size);
+    if (new_ptr == NULL) {
+        return size < old_size ? ptr : NULL;
+    }
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    magazine_free(cache, ptr, old_size);
+
+    return new_ptr;
+}
+
+void magazine_flush(magazine_cache *cache) {
+    magazine_thread *thread = NULL;
+
+    assert(cache);
+
+    thread = pthread_getspecific(cache->key);
+    if (thread) {
+        pthread_setspecific(cache->key, NULL);
+        magazine_thread_flush(thread);
+    }
+}
+
+static void *magazine_allocator_allocate(void *context, size_t size) {
+    return magazine_alloc(context, size);
+}
+
+static void *magazine_allocator_reallocate(void *context, void *ptr,
+                                           size_t old_size, size_t size) {
+    return magazine_realloc(context, ptr, old_size, size);
+}
+
+static void magazine_allocator_release(void *context, void *ptr,
+                                       size_t size) {
+    magazine_free(context, ptr, size);
+}
+
+allocator magazine_allocator(magazine_cache *cache) {
+    allocator hooks = { magazine_allocator_allocate,
+                        magazine_allocator_reallocate,
+                        magazine_allocator_release, cache };
+
+    assert(cache);
+
+    return hooks;
+}
+
+#ifdef WITH_TEST
+Test(Magazine, classes) {
+    cr_assert(magazine_class(1) == 0);
+    cr_assert(magazine_class(16) == 0);
+    cr_assert(magazine_class(17) == 1);
+    cr_assert(magazine_class(64) == 2);
+    cr_assert(magazine_class(MAGAZINE_MAX_SIZE) == MAGAZINE_CLASSES - 1);
+    cr_assert(magazine_class_size(MAGAZINE_CLASSES - 1) == MAGAZINE_MAX_SIZE);
+}
+
+Test(Magazine, depot_exchanges) {
+    magazine_cache *cache = magazine_create();
+    void *block[10 * MAGAZINE_ROUNDS];
+    size_t class = magazine_class(sizeof(int) * 10);
+
+    cr_assert(cache);
+
+    /* Frees fill magazines, handed to the depot a whole one at a time */
+    for (size_t i = 0; i < 10 * MAGAZINE_ROUNDS; i++) {
+        block[i] = magazine_alloc(cache, sizeof(int) * 10);
+        cr_assert(block[i]);
+    }
+    cr_assert(cache->depot[class].exchanges == 0);
+    for (size_t i = 0; i < 10 * MAGAZINE_ROUNDS; i++) {
+        magazine_free(cache, block[i], sizeof(int) * 10);
+    }
+    cr_assert(cache->depot[class].exchanges == 10);
+    cr_assert(cache->depot[class].full_count == 8);
+
+    /* Blocks come back last freed first, refilled from the depot */
+    cr_assert(magazine_alloc(cache, 40) == block[10 * MAGAZINE_ROUNDS - 1]);
+    for (size_t i = 1; i < 10 * MAGAZINE_ROUNDS; i++) {
+        cr_assert(magazine_alloc(cache, sizeof(int) * 10));
+    }
+    cr_assert(cache->depot[class].exchanges == 18);
+    cr_assert(cache->depot[class].full_count == 0);
+    for (size_t i = 0; i < 10 * MAGAZINE_ROUNDS; i++) {
+        magazine_free(cache, block[i], sizeof(int) * 10);
+    }
+
+    /* Resizing within a class keeps the block */
+    void *ptr = magazine_alloc(cache, 20);
+    cr_assert(magazine_realloc(cache, ptr, 20, 30) == ptr);
+    ptr = magazine_realloc(cache, ptr, 30, 2 * MAGAZINE_MAX_SIZE);
+    cr_assert(ptr);
+    ptr = magazine_realloc(cache, ptr, 2 * MAGAZINE_MAX_SIZE, 100);
+    cr_assert(ptr);
+    magazine_free(cache, ptr, 100);
+
+    magazine_delete(cache);
+}
+
+#define MAGAZINE_TEST_THREADS 4
+#define MAGAZINE_TEST_ROUNDS 2000
+
+static void *magazine_test_worker(void *arg) {
+    (void)arg;
+
+    for (int i = 0; i < MAGAZINE_TEST_ROUNDS; i++) {
+        arraylist *list = arraylist_create();
+        stack *stack = stack_create();
+
+        for (int j = 0; j < 40; j++) {
+            arraylist_insert_last(list, j);
+            stack_insert(stack, j);
+        }
+        if (list->element[39] != 39 || stack_head(stack) != 39) {
+            return arg;
+        }
+        arraylist_delete(list);
+        stack_delete(stack);
+    }
+
+    return NULL;
+}
+
+Test(Magazine, container_hooks) {
+    magazine_cache *cache = magazine_create();
+    allocator hooks = magazine_allocator(cache);
+    pthread_t thread[MAGAZINE_TEST_THREADS];
+
+    allocator_set(&hooks);
+    for (size_t i = 0; i < MAGAZINE_TEST_THREADS; i++) {
+        cr_assert(pthread_create(&thread[i], NULL, magazine_test_worker,
+                                 (void *)1) == 0);
+    }
+    for (size_t i = 0; i < MAGAZINE_TEST_THREADS; i++) {
+        void *result = (void *)1;
+
+        pthread_join(thread[i], &result);
+        cr_assert(result == NULL);
+    }
+    allocator_set(NULL);
+
+    magazine_delete(cache);
+}
+#endif
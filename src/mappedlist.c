@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "woofi/mappedlist.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static const capacity_policy mappedlist_default_policy = CAPACITY_POLICY_DEFAULT;
+
+/**
+ * Check that a mapped file holds a list this build can read
+ * @param header the header at the start of the mapping
+ * @param size the size of the mapping
+ * @return 1 if the header is valid
+ *         0 otherwise
+ */
+static int mappedlist_valid(const mappedlist_header *header, size_t size) {
+    if (header->magic != MAPPEDLIST_MAGIC
+        || header->version != MAPPEDLIST_VERSION
+        || header->element_size != sizeof(int)) {
+        return 0;
+    }
+
+    if (header->count > header->length
+        || header->length > (size - MAPPEDLIST_HEADER_SIZE) / sizeof(int)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+arraylist *mappedlist_open(const char *path) {
+    arraylist *list = NULL;
+    struct mappedlist *mapping = NULL;
+    mappedlist_header *header = NULL;
+    struct stat st;
+    int fresh = 0;
+    int fd;
+
+    assert(path);
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) == -1) {
+        goto error;
+    }
+
+    if (st.st_size == 0) {
+        st.st_size = MAPPEDLIST_HEADER_SIZE
+            + INITIALI_ARRAYLIST_SIZE * sizeof(int);
+        if (ftruncate(fd, st.st_size) == -1) {
+            goto error;
+        }
+        fresh = 1;
+    }
+    else if ((size_t)st.st_size < MAPPEDLIST_HEADER_SIZE) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    header = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        header = NULL;
+        goto error;
+    }
+
+    if (fresh) {
+        header->magic = MAPPEDLIST_MAGIC;
+        header->version = MAPPEDLIST_VERSION;
+        header->element_size = sizeof(int);
+        header->count = 0;
+        header->length = INITIALI_ARRAYLIST_SIZE;
+    }
+    else if (!mappedlist_valid(header, st.st_size)) {
+        errno = EINVAL;
+        goto error;
+    }
+
+    list = malloc(sizeof(*list));
+    mapping = malloc(sizeof(*mapping));
+    if (list == NULL || mapping == NULL) {
+        goto error;
+    }
+
+    mapping->fd = fd;
+    mapping->header = header;
+    mapping->size = st.st_size;
+
+    list->count = header->count;
+    list->length = header->length;
+    list->element = (int *)((char *)header + MAPPEDLIST_HEADER_SIZE);
+    list->mapping = mapping;
+    list->policy = mappedlist_default_policy;
+
+    return list;
+
+error:
+    free(list);
+    free(mapping);
+    if (header) {
+        munmap(header, st.st_size);
+    }
+    close(fd);
+    return NULL;
+}
+
+int mappedlist_sync(arraylist *list) {
+    assert(list);
+    assert(list->mapping);
+
+    struct mappedlist *mapping = list->mapping;
+
+    mapping->header->count = list->count;
+    mapping->header->length = list->length;
+
+    return msync(mapping->header, mapping->size, MS_SYNC);
+}
+
+void mappedlist_close(arraylist *list) {
+    assert(list);
+    assert(list->mapping);
+
+    struct mappedlist *mapping = list->mapping;
+
+    mappedlist_sync(list);
+    munmap(mapping->header, mapping->size);
+    close(mapping->fd);
+
+    free(mapping);
+    free(list);
+}
+
+int mappedlist_resize(arraylist *list, size_t length) {
+    assert(list);
+    assert(list->mapping);
+
+    struct mappedlist *mapping = list->mapping;
+    size_t size = MAPPEDLIST_HEADER_SIZE + length * sizeof(int);
+    void *map;
+
+    if (length < list->count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ftruncate(mapping->fd, size) == -1) {
+        return -1;
+    }
+
+#ifdef __linux__
+    map = mremap(mapping->header, mapping->size, size, MREMAP_MAYMOVE);
+#else
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping->fd, 0);
+    if (map != MAP_FAILED) {
+        munmap(mapping->header, mapping->size);
+    }
+#endif
+    if (map == MAP_FAILED) {
+        /* The file stays larger than the mapping, the header still holds
+         * the old length so it is reopened with the old capacity */
+        return -1;
+    }
+
+    mapping->header = map;
+    mapping->size = size;
+    mapping->header->length = length;
+
+    list->length = length;
+    list->element = (int *)((char *)map + MAPPEDLIST_HEADER_SIZE);
+
+    return 0;
+}
+
+#ifdef WITH_TEST
+Test(MappedList, create) {
+    char path[] = "/tmp/woofi-mappedlist-XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+    close(fd);
+
+    arraylist *list = mappedlist_open(path);
+    cr_assert(list);
+    cr_assert(arraylist_is_empty(list));
+    cr_assert(list->length == INITIALI_ARRAYLIST_SIZE);
+
+    arraylist_delete(list);
+    unlink(path);
+}
+
+Test(MappedList, reopen) {
+    char path[] = "/tmp/woofi-mappedlist-XXXXXX";
+    int found = 0;
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+    close(fd);
+
+    arraylist *list = mappedlist_open(path);
+    for (int i = 0; i < 10000; i++) {
+        cr_assert(arraylist_insert_last(list, i) == 0);
+    }
+    cr_assert(list->length >= 10000);
+    arraylist_insert_front(list, -1);
+    arraylist_delete(list);
+
+    list = mappedlist_open(path);
+    cr_assert(list);
+    cr_assert(arraylist_count(list) == 10001);
+    cr_assert(arraylist_get(list, 0, &found) == -1);
+    cr_assert(found);
+    cr_assert(arraylist_get(list, 10000, &found) == 9999);
+    cr_assert(found);
+
+    mappedlist_close(list);
+    unlink(path);
+}
+
+Test(MappedList, sync) {
+    char path[] = "/tmp/woofi-mappedlist-XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+    close(fd);
+
+    arraylist *list = mappedlist_open(path);
+    arraylist_insert_last(list, 42);
+    arraylist_insert_last(list, 24);
+    cr_assert(list->mapping->header->count == 0);
+    cr_assert(mappedlist_sync(list) == 0);
+    cr_assert(list->mapping->header->count == 2);
+
+    arraylist_delete(list);
+    unlink(path);
+}
+
+Test(MappedList, invalid) {
+    char path[] = "/tmp/woofi-mappedlist-XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+    cr_assert(write(fd, "not a list, not a list, not a list, not a list, "
+                    "not a list, not a list", 70) == 70);
+    close(fd);
+
+    cr_assert(mappedlist_open(path) == NULL);
+    cr_assert(errno == EINVAL);
+
+    unlink(path);
+}
+#endif
@@ -0,0 +1,240 @@
+#include <assert.h>
+#include <errno.h>
+
+#include "woofi/allocator.h"
+#include "woofi/minmaxstack.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#define MINMAXSTACK_INITIAL_SIZE 100
+
+static const capacity_policy minmaxstack_default_policy = CAPACITY_POLICY_DEFAULT;
+
+minmaxstack *minmaxstack_create() {
+    minmaxstack *stack = NULL;
+
+    stack = allocator_malloc(sizeof(*stack));
+    if (stack == NULL) {
+        return NULL;
+    }
+
+    stack->size = MINMAXSTACK_INITIAL_SIZE;
+    stack->head = 0;
+    stack->policy = minmaxstack_default_policy;
+    stack->element = allocator_malloc(stack->size * sizeof(*stack->element));
+    if (stack->element == NULL) {
+        int error = errno;
+        allocator_free(stack, sizeof(*stack));
+        errno = error;
+        return NULL;
+    }
+
+    return stack;
+}
+
+void minmaxstack_delete(minmaxstack *stack) {
+    assert(stack);
+
+    allocator_free(stack->element, stack->size * sizeof(*stack->element));
+    allocator_free(stack, sizeof(*stack));
+}
+
+/**
+ * Change the capacity of the stack
+ * @param stack a non null pointer to a stack
+ * @param size the new capacity, at least the number of elements
+ * @return 0 if the stack was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int minmaxstack_resize(minmaxstack *stack, size_t size) {
+    minmaxstack_entry *new_elements = allocator_realloc(
+        stack->element, stack->size * sizeof(*stack->element),
+        size * sizeof(*stack->element));
+    if (new_elements == NULL) {
+        return -1;
+    }
+
+    stack->element = new_elements;
+    stack->size = size;
+
+    return 0;
+}
+
+int minmaxstack_set_policy(minmaxstack *stack, const capacity_policy *policy) {
+    assert(stack);
+
+    if (!capacity_policy_valid(policy)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stack->policy = *policy;
+
+    return 0;
+}
+
+int minmaxstack_reserve(minmaxstack *stack, size_t size) {
+    assert(stack);
+
+    if (size <= stack->size) {
+        return 0;
+    }
+
+    return minmaxstack_resize(stack, size);
+}
+
+int minmaxstack_shrink_to_fit(minmaxstack *stack) {
+    assert(stack);
+
+    size_t size = stack->head ? stack->head : 1;
+    if (size >= stack->size) {
+        return 0;
+    }
+
+    return minmaxstack_resize(stack, size);
+}
+
+int minmaxstack_is_empty(const minmaxstack *stack) {
+    assert(stack);
+
+    return stack->head == 0;
+}
+
+size_t minmaxstack_count(const minmaxstack *stack) {
+    assert(stack);
+
+    return stack->head;
+}
+
+int minmaxstack_insert(minmaxstack *stack, int value) {
+    minmaxstack_entry *entry = NULL;
+
+    assert(stack);
+
+    if (stack->head == stack->size
+        && minmaxstack_resize(stack, capacity_grow(&stack->policy, stack->size,
+                                                   stack->head + 1)) == -1) {
+        return 0;
+    }
+
+    entry = &stack->element[stack->head];
+    entry->value = value;
+    if (stack->head) {
+        const minmaxstack_entry *below = entry - 1;
+
+        entry->sum = below->sum + value;
+        entry->min = value < below->min ? value : below->min;
+        entry->max = value > below->max ? value : below->max;
+    }
+    else {
+        entry->sum = value;
+        entry->min = value;
+        entry->max = value;
+    }
+    stack->head++;
+
+    return 1;
+}
+
+int minmaxstack_remove(minmaxstack *stack) {
+    assert(stack);
+
+    if (minmaxstack_is_empty(stack)) {
+        return 0;
+    }
+    stack->head--;
+
+    size_t size = capacity_shrink(&stack->policy, stack->size, stack->head);
+    if (size < stack->size) {
+        minmaxstack_resize(stack, size);
+    }
+
+    return 1;
+}
+
+int minmaxstack_head(const minmaxstack *stack) {
+    assert(stack);
+    assert(stack->head);
+
+    return stack->element[stack->head - 1].value;
+}
+
+int minmaxstack_min(const minmaxstack *stack) {
+    assert(stack);
+    assert(stack->head);
+
+    return stack->element[stack->head - 1].min;
+}
+
+int minmaxstack_max(const minmaxstack *stack) {
+    assert(stack);
+    assert(stack->head);
+
+    return stack->element[stack->head - 1].max;
+}
+
+int64_t minmaxstack_sum(const minmaxstack *stack) {
+    assert(stack);
+
+    return stack->head ? stack->element[stack->head - 1].sum : 0;
+}
+
+#ifdef WITH_TEST
+Test(MinMaxStack, backtrack) {
+    minmaxstack *stack = minmaxstack_create();
+    int values[] = { 5, 7, 3, 9, 3, -2, 8 };
+
+    cr_assert(stack);
+    cr_assert(minmaxstack_is_empty(stack));
+    cr_assert(minmaxstack_sum(stack) == 0);
+    cr_assert_not(minmaxstack_remove(stack));
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++) {
+        cr_assert(minmaxstack_insert(stack, values[i]));
+    }
+    cr_assert(minmaxstack_head(stack) == 8);
+    cr_assert(minmaxstack_min(stack) == -2);
+    cr_assert(minmaxstack_max(stack) == 9);
+    cr_assert(minmaxstack_sum(stack) == 33);
+
+    /* Unwinding restores the aggregates of each depth */
+    cr_assert(minmaxstack_remove(stack) && minmaxstack_remove(stack));
+    cr_assert(minmaxstack_min(stack) == 3 && minmaxstack_max(stack) == 9);
+    cr_assert(minmaxstack_remove(stack) && minmaxstack_remove(stack));
+    cr_assert(minmaxstack_min(stack) == 3 && minmaxstack_max(stack) == 7);
+    cr_assert(minmaxstack_remove(stack));
+    cr_assert(minmaxstack_min(stack) == 5 && minmaxstack_max(stack) == 7);
+    cr_assert(minmaxstack_sum(stack) == 12);
+    cr_assert(minmaxstack_insert(stack, 6));
+    cr_assert(minmaxstack_min(stack) == 5 && minmaxstack_max(stack) == 7);
+
+    minmaxstack_delete(stack);
+}
+
+Test(MinMaxStack, grow_shrink) {
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+    minmaxstack *stack = minmaxstack_create();
+
+    cr_assert(minmaxstack_shrink_to_fit(stack) == 0);
+    cr_assert(stack->size == 1);
+    cr_assert(minmaxstack_set_policy(stack, &policy) == 0);
+    for (int i = 0; i < 1000; i++) {
+        cr_assert(minmaxstack_insert(stack, 500 - i));
+    }
+    cr_assert(minmaxstack_count(stack) == 1000);
+    cr_assert(stack->size == 1024);
+    cr_assert(minmaxstack_min(stack) == -499 && minmaxstack_max(stack) == 500);
+
+    for (int i = 0; i < 995; i++) {
+        minmaxstack_remove(stack);
+    }
+    cr_assert(stack->size == 100);
+    cr_assert(minmaxstack_min(stack) == 496 && minmaxstack_max(stack) == 500);
+    cr_assert(minmaxstack_sum(stack) == 2490);
+    cr_assert(minmaxstack_shrink_to_fit(stack) == 0);
+    cr_assert(stack->size == 5);
+
+    minmaxstack_delete(stack);
+}
+#endif
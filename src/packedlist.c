@@ -0,0 +1,525 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/packedlist.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#if defined(__SSE2__) && !defined(WOOFI_NO_SSE2)
+# define PACKEDLIST_SSE2
+# include <emmintrin.h>
+#endif
+
+#define PACKEDLIST_LANES 4
+#define PACKEDLIST_VECTORS (PACKEDLIST_BLOCK / PACKEDLIST_LANES)
+
+static inline unsigned packedlist_bits(uint32_t value) {
+    return value ? 32 - __builtin_clz(value) : 0;
+}
+
+static inline uint32_t packedlist_mask(unsigned bits) {
+    return bits == 32 ? UINT32_MAX : ((uint32_t)1 << bits) - 1;
+}
+
+/**
+ * Store value i of a block on bits bits. Value i is number i / 4 of
+ * lane i % 4, the words of a lane being every fourth word.
+ */
+static void packedlist_pack(uint32_t *word, unsigned bits, size_t i,
+                            uint32_t value) {
+    size_t lane = i % PACKEDLIST_LANES;
+    size_t position = (i / PACKEDLIST_LANES) * bits;
+    size_t k = position / 32;
+    unsigned shift = position % 32;
+
+    word[k * PACKEDLIST_LANES + lane] |= value << shift;
+    if (shift + bits > 32) {
+        word[(k + 1) * PACKEDLIST_LANES + lane] |= value >> (32 - shift);
+    }
+}
+
+static uint32_t packedlist_unpack_one(const uint32_t *word, unsigned bits,
+                                      size_t i) {
+    size_t lane = i % PACKEDLIST_LANES;
+    size_t position = (i / PACKEDLIST_LANES) * bits;
+    size_t k = position / 32;
+    unsigned shift = position % 32;
+    uint32_t value;
+
+    /* A block of equal values has no words */
+    if (bits == 0) {
+        return 0;
+    }
+
+    value = word[k * PACKEDLIST_LANES + lane] >> shift;
+    if (shift + bits > 32) {
+        value |= word[(k + 1) * PACKEDLIST_LANES + lane] << (32 - shift);
+    }
+
+    return value & packedlist_mask(bits);
+}
+
+#if !defined(PACKEDLIST_SSE2) || defined(WITH_TEST)
+/**
+ * Unpack the first vectors groups of 4 values of a block and add them
+ * to reference, either each (frame of reference) or as a running sum
+ * (delta).
+ */
+static void packedlist_unpack_scalar(const uint32_t *word, unsigned bits,
+                                     int delta, uint32_t reference,
+                                     uint32_t *out, size_t vectors) {
+    uint32_t sum = reference;
+
+    for (size_t i = 0; i < vectors * PACKEDLIST_LANES; i++) {
+        uint32_t value = packedlist_unpack_one(word, bits, i);
+
+        if (delta) {
+            sum += value;
+            out[i] = sum;
+        } else {
+            out[i] = reference + value;
+        }
+    }
+}
+#endif
+
+#ifdef PACKEDLIST_SSE2
+/*
+ * The 4 lanes are unpacked together: vector j holds values 4j to 4j + 3,
+ * in order, so deltas are summed with two shifted adds per vector.
+ */
+static void packedlist_unpack_sse2(const uint32_t *word, unsigned bits,
+                                   int delta, uint32_t reference,
+                                   uint32_t *out, size_t vectors) {
+    const __m128i mask = _mm_set1_epi32((int)packedlist_mask(bits));
+    __m128i base = _mm_set1_epi32((int)reference);
+
+    for (size_t j = 0; j < vectors; j++) {
+        size_t position = j * bits;
+        size_t k = position / 32;
+        unsigned shift = position % 32;
+        __m128i value = _mm_setzero_si128();
+
+        if (bits) {
+            value = _mm_srl_epi32(
+                _mm_loadu_si128((const __m128i *)(word + k * PACKEDLIST_LANES)),
+                _mm_cvtsi32_si128(shift));
+            if (shift + bits > 32) {
+                __m128i next = _mm_loadu_si128(
+                    (const __m128i *)(word + (k + 1) * PACKEDLIST_LANES));
+
+                value = _mm_or_si128(value, _mm_sll_epi32(
+                    next, _mm_cvtsi32_si128(32 - shift)));
+            }
+            value = _mm_and_si128(value, mask);
+        }
+
+        if (delta) {
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+            value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+            value = _mm_add_epi32(value, base);
+            base = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3));
+        } else {
+            value = _mm_add_epi32(value, base);
+        }
+        _mm_storeu_si128((__m128i *)(out + j * PACKEDLIST_LANES), value);
+    }
+}
+#endif
+
+static void packedlist_unpack(const packedlist *list,
+                              const packedlist_block *block, uint32_t *out,
+                              size_t vectors) {
+    const uint32_t *word = list->word + block->offset;
+
+#ifdef PACKEDLIST_SSE2
+    packedlist_unpack_sse2(word, block->bits, block->delta,
+                           (uint32_t)block->minimum, out, vectors);
+#else
+    packedlist_unpack_scalar(word, block->bits, block->delta,
+                             (uint32_t)block->minimum, out, vectors);
+#endif
+}
+
+static inline size_t packedlist_block_count(const packedlist *list,
+                                            size_t block) {
+    size_t first = block * PACKEDLIST_BLOCK;
+
+    return list->count - first < PACKEDLIST_BLOCK
+        ? list->count - first : PACKEDLIST_BLOCK;
+}
+
+/**
+ * Choose the encoding of a block and fill its skip index entry
+ */
+static void packedlist_describe(const int *value, size_t count,
+                                packedlist_block *block) {
+    uint32_t largest_delta = 0;
+    int sorted = 1;
+
+    block->minimum = value[0];
+    block->maximum = value[0];
+    for (size_t i = 1; i < count; i++) {
+        if (value[i] < block->minimum) {
+            block->minimum = value[i];
+        }
+        if (value[i] > block->maximum) {
+            block->maximum = value[i];
+        }
+        if (value[i] < value[i - 1]) {
+            sorted = 0;
+        } else if ((uint32_t)value[i] - (uint32_t)value[i - 1]
+                   > largest_delta) {
+            largest_delta = (uint32_t)value[i] - (uint32_t)value[i - 1];
+        }
+    }
+
+    block->bits = packedlist_bits((uint32_t)block->maximum
+                                  - (uint32_t)block->minimum);
+    block->delta = 0;
+    block->sorted = sorted;
+    if (sorted && packedlist_bits(largest_delta) < block->bits) {
+        block->bits = packedlist_bits(largest_delta);
+        block->delta = 1;
+    }
+}
+
+packedlist *packedlist_from_arraylist(const arraylist *list) {
+    packedlist *packed = NULL;
+    size_t words = 0;
+
+    assert(list);
+
+    packed = calloc(1, sizeof(*packed));
+    if (packed == NULL) {
+        return NULL;
+    }
+
+    packed->count = list->count;
+    packed->blocks = (list->count + PACKEDLIST_BLOCK - 1) / PACKEDLIST_BLOCK;
+    packed->sorted = 1;
+    packed->block = malloc((packed->blocks ? packed->blocks : 1)
+                           * sizeof(*(packed->block)));
+    if (packed->block == NULL) {
+        packedlist_delete(packed);
+        return NULL;
+    }
+
+    /* Sizes first so the words are allocated once */
+    for (size_t b = 0; b < packed->blocks; b++) {
+        const int *value = list->element + b * PACKEDLIST_BLOCK;
+        size_t count = packedlist_block_count(packed, b);
+
+        packedlist_describe(value, count, &packed->block[b]);
+        packed->block[b].offset = words;
+        words += (size_t)packed->block[b].bits * PACKEDLIST_LANES;
+        if (!packed->block[b].sorted || (b > 0 && value[0] < value[-1])) {
+            packed->sorted = 0;
+        }
+    }
+
+    packed->word = calloc(words ? words : 1, sizeof(*(packed->word)));
+    if (packed->word == NULL) {
+        packedlist_delete(packed);
+        return NULL;
+    }
+
+    for (size_t b = 0; b < packed->blocks; b++) {
+        const packedlist_block *block = &packed->block[b];
+        const int *value = list->element + b * PACKEDLIST_BLOCK;
+        size_t count = packedlist_block_count(packed, b);
+
+        if (block->bits == 0) {
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t previous = i ? (uint32_t)value[i - 1]
+                                  : (uint32_t)block->minimum;
+            uint32_t base = block->delta ? previous
+                                         : (uint32_t)block->minimum;
+
+            packedlist_pack(packed->word + block->offset, block->bits, i,
+                            (uint32_t)value[i] - base);
+        }
+    }
+
+    return packed;
+}
+
+void packedlist_delete(packedlist *list) {
+    assert(list);
+
+    free(list->block);
+    free(list->word);
+    free(list);
+}
+
+size_t packedlist_count(const packedlist *list) {
+    assert(list);
+    return list->count;
+}
+
+size_t packedlist_size_in_bytes(const packedlist *list) {
+    size_t words = 0;
+
+    assert(list);
+
+    if (list->blocks) {
+        const packedlist_block *last = &list->block[list->blocks - 1];
+
+        words = last->offset + (size_t)last->bits * PACKEDLIST_LANES;
+    }
+
+    return sizeof(*list) + list->blocks * sizeof(*(list->block))
+        + words * sizeof(*(list->word));
+}
+
+size_t packedlist_decode(const packedlist *list, size_t block, int *out) {
+    uint32_t value[PACKEDLIST_BLOCK];
+    size_t count;
+
+    assert(list);
+    assert(block < list->blocks);
+    assert(out);
+
+    count = packedlist_block_count(list, block);
+    packedlist_unpack(list, &list->block[block], value,
+                      (count + PACKEDLIST_LANES - 1) / PACKEDLIST_LANES);
+    memcpy(out, value, count * sizeof(*out));
+
+    return count;
+}
+
+int packedlist_get(const packedlist *list, size_t index, int *found) {
+    const packedlist_block *block;
+    uint32_t value[PACKEDLIST_BLOCK];
+    size_t i;
+
+    assert(list);
+    assert(found);
+
+    if (index >= list->count) {
+        *found = 0;
+        return 0;
+    }
+
+    *found = 1;
+    block = &list->block[index / PACKEDLIST_BLOCK];
+    i = index % PACKEDLIST_BLOCK;
+    if (!block->delta) {
+        return (int)((uint32_t)block->minimum + packedlist_unpack_one(
+            list->word + block->offset, block->bits, i));
+    }
+
+    /* Deltas are summed up to the vector holding the value */
+    packedlist_unpack(list, block, value, i / PACKEDLIST_LANES + 1);
+    return (int)value[i];
+}
+
+int packedlist_contains(const packedlist *list, int value) {
+    int decoded[PACKEDLIST_BLOCK];
+
+    assert(list);
+
+    if (list->sorted) {
+        size_t low = 0;
+        size_t high = list->blocks;
+        size_t count;
+
+        /* First block which may hold value */
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+
+            if (list->block[middle].maximum < value) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == list->blocks || list->block[low].minimum > value) {
+            return 0;
+        }
+
+        count = packedlist_decode(list, low, decoded);
+        high = count;
+        low = 0;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+
+            if (decoded[middle] < value) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low < count && decoded[low] == value;
+    }
+
+    for (size_t b = 0; b < list->blocks; b++) {
+        if (value < list->block[b].minimum || value > list->block[b].maximum) {
+            continue;
+        }
+
+        size_t count = packedlist_decode(list, b, decoded);
+        for (size_t i = 0; i < count; i++) {
+            if (decoded[i] == value) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+arraylist *packedlist_to_arraylist(const packedlist *list) {
+    arraylist *result = NULL;
+
+    assert(list);
+
+    result = arraylist_create();
+    if (result == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(result, list->count) == -1) {
+        int error = errno;
+        arraylist_delete(result);
+        errno = error;
+        return NULL;
+    }
+
+    for (size_t b = 0; b < list->blocks; b++) {
+        result->count += packedlist_decode(list, b,
+                                           result->element + result->count);
+    }
+
+    return result;
+}
+
+#ifdef WITH_TEST
+static arraylist *packedlist_test_list(size_t count, int sorted) {
+    arraylist *list = arraylist_create();
+    uint32_t seed = 42;
+    int value = -5000;
+
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        value += (seed >> 16) % 50;
+        /* A few values out of order */
+        if (!sorted && i % 97 == 0) {
+            arraylist_insert_last(list, value - 1000);
+        } else {
+            arraylist_insert_last(list, value);
+        }
+    }
+
+    return list;
+}
+
+Test(Packedlist, round_trip) {
+    size_t sizes[] = { 0, 1, 127, 128, 129, 1000 };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int sorted = 0; sorted < 2; sorted++) {
+            arraylist *list = packedlist_test_list(sizes[s], sorted);
+            packedlist *packed = packedlist_from_arraylist(list);
+            arraylist *copy = NULL;
+            int found = 0;
+
+            cr_assert(packed);
+            cr_assert(packedlist_count(packed) == sizes[s]);
+            cr_assert(packed->sorted == (sorted || sizes[s] < 2));
+            for (size_t i = 0; i < list->count; i++) {
+                cr_assert(packedlist_get(packed, i, &found)
+                          == list->element[i]);
+                cr_assert(found);
+            }
+            packedlist_get(packed, list->count, &found);
+            cr_assert_not(found);
+
+            copy = packedlist_to_arraylist(packed);
+            cr_assert(copy->count == list->count);
+            cr_assert(memcmp(copy->element, list->element,
+                             list->count * sizeof(int)) == 0);
+
+            arraylist_delete(copy);
+            packedlist_delete(packed);
+            arraylist_delete(list);
+        }
+    }
+}
+
+Test(Packedlist, contains) {
+    for (int sorted = 0; sorted < 2; sorted++) {
+        arraylist *list = packedlist_test_list(5000, sorted);
+        packedlist *packed = packedlist_from_arraylist(list);
+
+        for (int value = -7000; value < 130000; value += 7) {
+            cr_assert(packedlist_contains(packed, value)
+                      == arraylist_contains(list, value));
+        }
+
+        packedlist_delete(packed);
+        arraylist_delete(list);
+    }
+}
+
+Test(Packedlist, encodings) {
+    arraylist *list = arraylist_create();
+    packedlist *packed = NULL;
+    int found = 0;
+
+    /* Sorted and dense: 1 bit deltas */
+    for (int i = 0; i < 1024; i++) {
+        arraylist_insert_last(list, 1000000 + i);
+    }
+    packed = packedlist_from_arraylist(list);
+    cr_assert(packed->block[0].delta);
+    cr_assert(packed->block[0].bits == 1);
+    cr_assert(packedlist_size_in_bytes(packed) < 1024);
+    packedlist_delete(packed);
+
+    /* Full range needs 32 bits */
+    arraylist_insert_last(list, INT_MIN);
+    arraylist_insert_last(list, INT_MAX);
+    arraylist_insert_last(list, 0);
+    packed = packedlist_from_arraylist(list);
+    cr_assert(packed->block[8].bits == 32);
+    cr_assert_not(packed->block[8].delta);
+    cr_assert(packedlist_get(packed, 1024, &found) == INT_MIN);
+    cr_assert(packedlist_get(packed, 1025, &found) == INT_MAX);
+    cr_assert(packedlist_contains(packed, INT_MIN));
+    cr_assert(packedlist_contains(packed, INT_MAX));
+    cr_assert_not(packedlist_contains(packed, 1));
+    packedlist_delete(packed);
+
+    arraylist_delete(list);
+}
+
+#ifdef PACKEDLIST_SSE2
+Test(Packedlist, sse2_matches_scalar) {
+    uint32_t word[PACKEDLIST_LANES * 32];
+    uint32_t scalar[PACKEDLIST_BLOCK];
+    uint32_t vector[PACKEDLIST_BLOCK];
+    uint32_t seed = 3;
+
+    for (size_t i = 0; i < PACKEDLIST_LANES * 32; i++) {
+        seed = seed * 1103515245 + 12345;
+        word[i] = seed;
+    }
+
+    for (unsigned bits = 0; bits <= 32; bits++) {
+        for (int delta = 0; delta < 2; delta++) {
+            packedlist_unpack_scalar(word, bits, delta, 17, scalar,
+                                     PACKEDLIST_VECTORS);
+            packedlist_unpack_sse2(word, bits, delta, 17, vector,
+                                   PACKEDLIST_VECTORS);
+            cr_assert(memcmp(scalar, vector, sizeof(scalar)) == 0);
+        }
+    }
+}
+#endif
+#endif
@@ -0,0 +1,474 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/parallel.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#define PARALLEL_RADIX_BITS 8
+#define PARALLEL_RADIX_SIZE (1 << PARALLEL_RADIX_BITS)
+#define PARALLEL_RADIX_PASSES (32 / PARALLEL_RADIX_BITS)
+
+/* Partial result of a chunk, alone on its cache line */
+typedef struct {
+    int value;
+    char pad[PARALLEL_CACHE_LINE - sizeof(int)];
+} parallel_partial;
+
+typedef struct {
+    const int *base;
+    int *element;
+    int *buffer;
+    size_t count;
+    size_t chunks;
+    size_t width;
+    size_t parts;
+    parallel_map_fn map;
+    parallel_reduce_fn reduce;
+    parallel_for_each_fn for_each;
+    void *ctx;
+    int identity;
+    parallel_partial *partial;
+} parallel_job;
+
+/**
+ * Move an index back to the first element of its cache line
+ * @param base the start of the array
+ * @param index the index to align
+ * @return the aligned index
+ */
+static size_t parallel_align(const int *base, size_t index) {
+    const size_t per_line = PARALLEL_CACHE_LINE / sizeof(int);
+    size_t offset = (uintptr_t)base % PARALLEL_CACHE_LINE / sizeof(int);
+    size_t aligned = (index + offset) / per_line * per_line;
+
+    return aligned > offset ? aligned - offset : 0;
+}
+
+/**
+ * Get the index of the first element of a chunk
+ * @param job the job being run
+ * @param chunk the chunk index, chunks for the end of the list
+ * @return the index of the first element of the chunk
+ */
+static size_t parallel_bound(const parallel_job *job, size_t chunk) {
+    if (chunk == 0) {
+        return 0;
+    }
+    if (chunk >= job->chunks) {
+        return job->count;
+    }
+
+    size_t index = job->count / job->chunks * chunk
+        + job->count % job->chunks * chunk / job->chunks;
+
+    return parallel_align(job->base, index);
+}
+
+/**
+ * Get the number of chunks to split a list in
+ * @param pool the pool running the job
+ * @param count the number of elements
+ * @return the number of chunks
+ */
+static size_t parallel_chunks(const threadpool *pool, size_t count) {
+    if (count < PARALLEL_MIN_COUNT || threadpool_size(pool) == 1) {
+        return 1;
+    }
+
+    return threadpool_size(pool) * PARALLEL_CHUNKS_PER_THREAD;
+}
+
+/**
+ * LSD radix sort of a range, using buffer as scratch space of the same size.
+ * Passes where every element has the same digit are skipped.
+ * @param element the range to sort
+ * @param buffer scratch space of the same size
+ * @param count the number of elements
+ */
+static void parallel_radix_sort(int *element, int *buffer, size_t count) {
+    size_t histogram[PARALLEL_RADIX_PASSES][PARALLEL_RADIX_SIZE];
+    uint32_t *src = (uint32_t *)element;
+    uint32_t *dst = (uint32_t *)buffer;
+
+    memset(histogram, 0, sizeof(histogram));
+    for (size_t i = 0; i < count; ++i) {
+        /* Flip the sign bit so negative values sort first */
+        uint32_t key = src[i] ^ 0x80000000u;
+        for (int pass = 0; pass < PARALLEL_RADIX_PASSES; ++pass) {
+            histogram[pass][(key >> (pass * PARALLEL_RADIX_BITS))
+                            & (PARALLEL_RADIX_SIZE - 1)]++;
+        }
+    }
+
+    for (int pass = 0; pass < PARALLEL_RADIX_PASSES; ++pass) {
+        int shift = pass * PARALLEL_RADIX_BITS;
+        size_t *offset = histogram[pass];
+        size_t total = 0;
+
+        if (count == 0
+            || offset[((src[0] ^ 0x80000000u) >> shift)
+                      & (PARALLEL_RADIX_SIZE - 1)] == count) {
+            continue;
+        }
+
+        for (int digit = 0; digit < PARALLEL_RADIX_SIZE; ++digit) {
+            size_t n = offset[digit];
+            offset[digit] = total;
+            total += n;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t key = src[i] ^ 0x80000000u;
+            dst[offset[(key >> shift) & (PARALLEL_RADIX_SIZE - 1)]++] = src[i];
+        }
+
+        uint32_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != (uint32_t *)element) {
+        memcpy(element, src, count * sizeof(*element));
+    }
+}
+
+/**
+ * Find how many elements of a come first in the first k elements of the
+ * stable merge of a and b
+ * @return the number of elements taken from a
+ */
+static size_t parallel_corank(size_t k, const int *a, size_t a_count,
+                              const int *b, size_t b_count) {
+    size_t low = k > b_count ? k - b_count : 0;
+    size_t high = k < a_count ? k : a_count;
+
+    for (;;) {
+        size_t i = low + (high - low) / 2;
+        size_t j = k - i;
+
+        if (i > 0 && j < b_count && a[i - 1] > b[j]) {
+            high = i - 1;
+        }
+        else if (j > 0 && i < a_count && b[j - 1] >= a[i]) {
+            low = i + 1;
+        }
+        else {
+            return i;
+        }
+    }
+}
+
+static void parallel_sort_chunk(void *ctx, size_t chunk) {
+    parallel_job *job = ctx;
+    size_t begin = parallel_bound(job, chunk);
+    size_t end = parallel_bound(job, chunk + 1);
+
+    parallel_radix_sort(job->element + begin, job->buffer + begin,
+                        end - begin);
+}
+
+/**
+ * Merge one part of a pair of sorted runs from job->element into
+ * job->buffer. Each pair of runs is merged by job->parts tasks writing
+ * consecutive, cache line aligned, ranges of the output.
+ */
+static void parallel_merge_part(void *ctx, size_t task) {
+    parallel_job *job = ctx;
+    size_t pair = task / job->parts;
+    size_t part = task % job->parts;
+    size_t low = parallel_bound(job, pair * 2 * job->width);
+    size_t middle = parallel_bound(job, (pair * 2 + 1) * job->width);
+    size_t high = parallel_bound(job, (pair * 2 + 2) * job->width);
+    const int *a = job->element + low;
+    const int *b = job->element + middle;
+    size_t a_count = middle - low;
+    size_t b_count = high - middle;
+    size_t total = high - low;
+
+    size_t first = low + total / job->parts * part
+        + total % job->parts * part / job->parts;
+    size_t last = low + total / job->parts * (part + 1)
+        + total % job->parts * (part + 1) / job->parts;
+    if (part > 0) {
+        first = parallel_align(job->buffer, first);
+        first = first > low ? first : low;
+    }
+    if (part + 1 < job->parts) {
+        last = parallel_align(job->buffer, last);
+        last = last > low ? last : low;
+    }
+    if (last <= first) {
+        return;
+    }
+
+    size_t i = parallel_corank(first - low, a, a_count, b, b_count);
+    size_t i_end = parallel_corank(last - low, a, a_count, b, b_count);
+    size_t j = first - low - i;
+    size_t j_end = last - low - i_end;
+    int *out = job->buffer + first;
+
+    while (i < i_end && j < j_end) {
+        *out++ = b[j] < a[i] ? b[j++] : a[i++];
+    }
+    while (i < i_end) {
+        *out++ = a[i++];
+    }
+    while (j < j_end) {
+        *out++ = b[j++];
+    }
+}
+
+int arraylist_par_sort(arraylist *list, threadpool *pool) {
+    parallel_job job;
+
+    assert(list);
+    assert(pool);
+
+    if (list->count < 2) {
+        return 0;
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.base = list->element;
+    job.element = list->element;
+    job.count = list->count;
+    job.buffer = malloc(job.count * sizeof(*(job.buffer)));
+    if (job.buffer == NULL) {
+        return -1;
+    }
+
+    /* A power of 4 chunks takes an even number of merge rounds, so the
+     * sorted list ends up back in the list storage */
+    size_t wanted = parallel_chunks(pool, job.count);
+    job.chunks = 1;
+    while (job.chunks < wanted) {
+        job.chunks *= 4;
+    }
+
+    threadpool_run(pool, parallel_sort_chunk, &job, job.chunks);
+
+    size_t tasks = threadpool_size(pool) * PARALLEL_CHUNKS_PER_THREAD;
+    for (job.width = 1; job.width < job.chunks; job.width *= 2) {
+        size_t pairs = job.chunks / (2 * job.width);
+
+        job.parts = tasks > pairs ? tasks / pairs : 1;
+        threadpool_run(pool, parallel_merge_part, &job, pairs * job.parts);
+
+        /* Chunk bounds are still aligned on job.base, the list storage */
+        int *swap = job.element;
+        job.element = job.buffer;
+        job.buffer = swap;
+    }
+
+    assert(job.element == list->element);
+    free(job.buffer);
+
+    return 0;
+}
+
+static void parallel_reduce_chunk(void *ctx, size_t chunk) {
+    parallel_job *job = ctx;
+    size_t end = parallel_bound(job, chunk + 1);
+    int value = job->identity;
+
+    for (size_t i = parallel_bound(job, chunk); i < end; ++i) {
+        value = job->reduce(value, job->element[i]);
+    }
+
+    job->partial[chunk].value = value;
+}
+
+int arraylist_par_reduce(const arraylist *list, threadpool *pool,
+                         parallel_reduce_fn reduce, int identity) {
+    parallel_partial single;
+    parallel_job job;
+
+    assert(list);
+    assert(pool);
+    assert(reduce);
+
+    memset(&job, 0, sizeof(job));
+    job.base = list->element;
+    job.element = list->element;
+    job.count = list->count;
+    job.chunks = parallel_chunks(pool, job.count);
+    job.reduce = reduce;
+    job.identity = identity;
+    /* Aligned, so each partial result really is alone on its line */
+    if (posix_memalign((void **)&job.partial, PARALLEL_CACHE_LINE,
+                       job.chunks * sizeof(*(job.partial))) != 0) {
+        /* Without room for the partial results, reduce on this thread */
+        job.chunks = 1;
+        job.partial = &single;
+        parallel_reduce_chunk(&job, 0);
+    }
+    else {
+        threadpool_run(pool, parallel_reduce_chunk, &job, job.chunks);
+    }
+
+    int value = identity;
+    for (size_t chunk = 0; chunk < job.chunks; ++chunk) {
+        value = reduce(value, job.partial[chunk].value);
+    }
+    if (job.partial != &single) {
+        free(job.partial);
+    }
+
+    return value;
+}
+
+static void parallel_map_chunk(void *ctx, size_t chunk) {
+    parallel_job *job = ctx;
+    size_t end = parallel_bound(job, chunk + 1);
+
+    for (size_t i = parallel_bound(job, chunk); i < end; ++i) {
+        job->element[i] = job->map(job->element[i]);
+    }
+}
+
+void arraylist_par_map(arraylist *list, threadpool *pool,
+                       parallel_map_fn map) {
+    parallel_job job;
+
+    assert(list);
+    assert(pool);
+    assert(map);
+
+    memset(&job, 0, sizeof(job));
+    job.base = list->element;
+    job.element = list->element;
+    job.count = list->count;
+    job.chunks = parallel_chunks(pool, job.count);
+    job.map = map;
+
+    threadpool_run(pool, parallel_map_chunk, &job, job.chunks);
+}
+
+static void parallel_for_each_chunk(void *ctx, size_t chunk) {
+    parallel_job *job = ctx;
+    size_t end = parallel_bound(job, chunk + 1);
+
+    for (size_t i = parallel_bound(job, chunk); i < end; ++i) {
+        job->for_each(job->ctx, i, job->element[i]);
+    }
+}
+
+void arraylist_par_for_each(const arraylist *list, threadpool *pool,
+                            parallel_for_each_fn fn, void *ctx) {
+    parallel_job job;
+
+    assert(list);
+    assert(pool);
+    assert(fn);
+
+    memset(&job, 0, sizeof(job));
+    job.base = list->element;
+    job.element = list->element;
+    job.count = list->count;
+    job.chunks = parallel_chunks(pool, job.count);
+    job.for_each = fn;
+    job.ctx = ctx;
+
+    threadpool_run(pool, parallel_for_each_chunk, &job, job.chunks);
+}
+
+#ifdef WITH_TEST
+static int parallel_test_sum(int a, int b) {
+    return a + b;
+}
+
+static int parallel_test_max(int a, int b) {
+    return a > b ? a : b;
+}
+
+static int parallel_test_double(int value) {
+    return value * 2;
+}
+
+static void parallel_test_mark(void *ctx, size_t index, int value) {
+    char *marks = ctx;
+
+    marks[index] = value == (int)index;
+}
+
+Test(Parallel, sort) {
+    size_t sizes[] = { 0, 1, 2, 100, PARALLEL_MIN_COUNT, 100003 };
+    threadpool *pool = threadpool_create(4);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        arraylist *list = arraylist_create();
+        long long sum = 0;
+        long long sorted_sum = 0;
+
+        srand(s);
+        for (size_t i = 0; i < sizes[s]; i++) {
+            int value = rand() - RAND_MAX / 2;
+            if (i % 7 == 0) {
+                value %= 16;
+            }
+            arraylist_insert_last(list, value);
+            sum += value;
+        }
+
+        cr_assert(arraylist_par_sort(list, pool) == 0);
+        for (size_t i = 0; i < sizes[s]; i++) {
+            sorted_sum += arraylist_fast_get(list, i);
+            if (i > 0) {
+                cr_assert(arraylist_fast_get(list, i - 1)
+                          <= arraylist_fast_get(list, i));
+            }
+        }
+        cr_assert(sum == sorted_sum);
+
+        arraylist_delete(list);
+    }
+
+    threadpool_delete(pool);
+}
+
+Test(Parallel, reduce_map) {
+    threadpool *pool = threadpool_create(3);
+    arraylist *list = arraylist_create();
+
+    cr_assert(arraylist_par_reduce(list, pool, parallel_test_sum, 0) == 0);
+
+    for (int i = 0; i < 50000; i++) {
+        arraylist_insert_last(list, i % 1000);
+    }
+    cr_assert(arraylist_par_reduce(list, pool, parallel_test_sum, 0)
+              == 50 * 999 * 1000 / 2);
+    cr_assert(arraylist_par_reduce(list, pool, parallel_test_max, 0) == 999);
+
+    arraylist_par_map(list, pool, parallel_test_double);
+    cr_assert(arraylist_fast_get(list, 1001) == 2);
+    cr_assert(arraylist_par_reduce(list, pool, parallel_test_max, 0) == 1998);
+
+    arraylist_delete(list);
+    threadpool_delete(pool);
+}
+
+Test(Parallel, for_each) {
+    threadpool *pool = threadpool_create(4);
+    arraylist *list = arraylist_create();
+    char *marks = calloc(30000, 1);
+
+    for (int i = 0; i < 30000; i++) {
+        arraylist_insert_last(list, i);
+    }
+    arraylist_par_for_each(list, pool, parallel_test_mark, marks);
+    for (int i = 0; i < 30000; i++) {
+        cr_assert(marks[i] == 1);
+    }
+
+    free(marks);
+    arraylist_delete(list);
+    threadpool_delete(pool);
+}
+#endif
@@ -0,0 +1,666 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/pipeline.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static uint64_t pipeline_elapsed_ns(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000ULL
+        + now.tv_nsec - start->tv_nsec;
+}
+
+/**
+ * Get a batch from the free batches or allocate one
+ * @return a batch or NULL on error (see errno)
+ */
+static pipeline_batch *pipeline_batch_get(pipeline *pipeline) {
+    pipeline_batch *batch = NULL;
+
+    pthread_mutex_lock(&pipeline->pool_lock);
+    batch = pipeline->pool;
+    if (batch) {
+        pipeline->pool = batch->next;
+    }
+    pthread_mutex_unlock(&pipeline->pool_lock);
+
+    if (batch == NULL) {
+        batch = malloc(sizeof(*batch) + pipeline->batch * sizeof(int));
+    }
+    if (batch) {
+        batch->count = 0;
+    }
+
+    return batch;
+}
+
+static void pipeline_batch_put(pipeline *pipeline, pipeline_batch *batch) {
+    pthread_mutex_lock(&pipeline->pool_lock);
+    batch->next = pipeline->pool;
+    pipeline->pool = batch;
+    pthread_mutex_unlock(&pipeline->pool_lock);
+}
+
+static int pipeline_ring_init(pipeline_ring *ring, size_t size,
+                              size_t producers, int ordered) {
+    memset(ring, 0, sizeof(*ring));
+    ring->slot = calloc(size, sizeof(*ring->slot));
+    if (ring->slot == NULL) {
+        return -1;
+    }
+    ring->size = size;
+    ring->producers = producers;
+    ring->ordered = ordered;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->not_empty, NULL);
+    pthread_cond_init(&ring->not_full, NULL);
+
+    return 0;
+}
+
+static void pipeline_ring_destroy(pipeline_ring *ring) {
+    pthread_cond_destroy(&ring->not_full);
+    pthread_cond_destroy(&ring->not_empty);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring->slot);
+}
+
+/**
+ * Queue a batch, waiting for room and, on an ordered ring, for every
+ * batch with a lower ticket. An empty batch only takes its turn.
+ * @param ring a non null pointer to a ring
+ * @param batch the batch, its ticket is its order on an ordered ring
+ * @param stall_ns a pointer to add the time spent waiting to
+ * @return 0 if the batch was queued, the ring owns it if not empty
+ *        -1 if the ring was aborted
+ */
+static int pipeline_ring_push(pipeline_ring *ring, pipeline_batch *batch,
+                              uint64_t *stall_ns) {
+    struct timespec start;
+    int waited = 0;
+
+    if (!ring->ordered && batch->count == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    while (!ring->aborted
+           && ((batch->count && ring->count == ring->size)
+               || (ring->ordered && ring->pushed != batch->ticket))) {
+        if (!waited) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            waited = 1;
+        }
+        pthread_cond_wait(&ring->not_full, &ring->lock);
+    }
+    if (ring->aborted) {
+        pthread_mutex_unlock(&ring->lock);
+        return -1;
+    }
+
+    if (batch->count) {
+        ring->slot[(ring->head + ring->count) % ring->size] = batch;
+        ring->count++;
+        ring->pushes++;
+        ring->depth_sum += ring->count;
+        if (ring->count > ring->max_depth) {
+            ring->max_depth = ring->count;
+        }
+        pthread_cond_signal(&ring->not_empty);
+    }
+    if (ring->ordered) {
+        /* The next ticket may be waiting behind others */
+        ring->pushed++;
+        pthread_cond_broadcast(&ring->not_full);
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    if (waited && stall_ns) {
+        *stall_ns += pipeline_elapsed_ns(&start);
+    }
+
+    return 0;
+}
+
+/**
+ * Take the oldest batch, tagged with its ticket, waiting while producers
+ * are left
+ * @param ring a non null pointer to a ring
+ * @return a batch or NULL once the ring is empty without producers
+ */
+static pipeline_batch *pipeline_ring_pop(pipeline_ring *ring) {
+    pipeline_batch *batch = NULL;
+
+    pthread_mutex_lock(&ring->lock);
+    while (ring->count == 0 && ring->producers && !ring->aborted) {
+        pthread_cond_wait(&ring->not_empty, &ring->lock);
+    }
+    if (ring->count && !ring->aborted) {
+        batch = ring->slot[ring->head];
+        batch->ticket = ring->popped++;
+        ring->head = (ring->head + 1) % ring->size;
+        ring->count--;
+        if (ring->ordered) {
+            pthread_cond_broadcast(&ring->not_full);
+        }
+        else {
+            pthread_cond_signal(&ring->not_full);
+        }
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    return batch;
+}
+
+/**
+ * A producer of the ring is done, the last one wakes the consumers
+ */
+static void pipeline_ring_done(pipeline_ring *ring) {
+    pthread_mutex_lock(&ring->lock);
+    ring->producers--;
+    if (ring->producers == 0) {
+        pthread_cond_broadcast(&ring->not_empty);
+    }
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/**
+ * Wake and stop every thread waiting on the rings
+ */
+static void pipeline_abort(pipeline *pipeline) {
+    for (size_t i = 0; i <= pipeline->stages; i++) {
+        pipeline_ring *ring = &pipeline->ring[i];
+
+        pthread_mutex_lock(&ring->lock);
+        ring->aborted = 1;
+        pthread_cond_broadcast(&ring->not_empty);
+        pthread_cond_broadcast(&ring->not_full);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+static void *pipeline_worker(void *arg) {
+    pipeline_stage *stage = arg;
+    pipeline *pipeline = stage->pipeline;
+    pipeline_batch *input = NULL;
+
+    while ((input = pipeline_ring_pop(stage->input))) {
+        pipeline_batch *output = pipeline_batch_get(pipeline);
+        struct timespec start;
+        uint64_t stall_ns = 0;
+        size_t count;
+
+        if (output == NULL) {
+            pipeline_batch_put(pipeline, input);
+            pipeline_abort(pipeline);
+            break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        output->count = stage->fn(stage->ctx, input->value, input->count,
+                                  output->value);
+        __atomic_fetch_add(&stage->counters.busy_ns,
+                           pipeline_elapsed_ns(&start), __ATOMIC_RELAXED);
+        assert(output->count <= pipeline->batch);
+
+        __atomic_fetch_add(&stage->counters.batches, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stage->counters.values_in, input->count,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stage->counters.values_out, output->count,
+                           __ATOMIC_RELAXED);
+
+        /* Once queued, the batch belongs to the next stage */
+        count = output->count;
+        output->ticket = input->ticket;
+        pipeline_batch_put(pipeline, input);
+        if (pipeline_ring_push(stage->output, output, &stall_ns) == -1) {
+            pipeline_batch_put(pipeline, output);
+            break;
+        }
+        if (count == 0) {
+            pipeline_batch_put(pipeline, output);
+        }
+        if (stall_ns) {
+            __atomic_fetch_add(&stage->counters.stall_ns, stall_ns,
+                               __ATOMIC_RELAXED);
+        }
+    }
+
+    pipeline_ring_done(stage->output);
+    return NULL;
+}
+
+pipeline *pipeline_create(size_t batch, size_t capacity) {
+    pipeline *pipeline = NULL;
+
+    if (batch == 0 || capacity == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pipeline = calloc(1, sizeof(*pipeline));
+    if (pipeline == NULL) {
+        return NULL;
+    }
+    pipeline->batch = batch;
+    pipeline->capacity = capacity;
+    pthread_mutex_init(&pipeline->pool_lock, NULL);
+
+    return pipeline;
+}
+
+void pipeline_delete(pipeline *pipeline) {
+    assert(pipeline);
+
+    if (pipeline->running) {
+        pipeline_batch *batch = NULL;
+
+        if (!pipeline->closed && pipeline_close(pipeline) == -1) {
+            pipeline_abort(pipeline);
+        }
+        while ((batch = pipeline_ring_pop(&pipeline->ring[pipeline->stages]))) {
+            pipeline_batch_put(pipeline, batch);
+        }
+    }
+
+    for (size_t i = 0; i < pipeline->stages; i++) {
+        for (size_t j = 0; j < pipeline->stage[i].started; j++) {
+            pthread_join(pipeline->stage[i].thread[j], NULL);
+        }
+        free(pipeline->stage[i].thread);
+    }
+    if (pipeline->ring) {
+        for (size_t i = 0; i <= pipeline->stages; i++) {
+            pipeline_ring *ring = &pipeline->ring[i];
+
+            /* Left behind by an aborted pipeline */
+            for (; ring->count; ring->count--) {
+                free(ring->slot[ring->head]);
+                ring->head = (ring->head + 1) % ring->size;
+            }
+            pipeline_ring_destroy(ring);
+        }
+    }
+
+    free(pipeline->pending);
+    free(pipeline->draining);
+    while (pipeline->pool) {
+        pipeline_batch *batch = pipeline->pool;
+
+        pipeline->pool = batch->next;
+        free(batch);
+    }
+    pthread_mutex_destroy(&pipeline->pool_lock);
+    free(pipeline->ring);
+    free(pipeline->stage);
+    free(pipeline);
+}
+
+int pipeline_add_stage(pipeline *pipeline, pipeline_fn fn, void *ctx,
+                       size_t workers, int ordered) {
+    pipeline_stage *stage = NULL;
+
+    assert(pipeline);
+    assert(fn);
+
+    if (pipeline->ring || workers == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    stage = realloc(pipeline->stage,
+                    (pipeline->stages + 1) * sizeof(*pipeline->stage));
+    if (stage == NULL) {
+        return -1;
+    }
+    pipeline->stage = stage;
+
+    stage = &pipeline->stage[pipeline->stages++];
+    memset(stage, 0, sizeof(*stage));
+    stage->pipeline = pipeline;
+    stage->fn = fn;
+    stage->ctx = ctx;
+    stage->workers = workers;
+    stage->ordered = ordered;
+
+    return 0;
+}
+
+int pipeline_start(pipeline *pipeline) {
+    size_t i;
+    int error;
+
+    assert(pipeline);
+
+    if (pipeline->ring) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pipeline->ring = calloc(pipeline->stages + 1, sizeof(*pipeline->ring));
+    if (pipeline->ring == NULL) {
+        return -1;
+    }
+
+    /* Ring i feeds stage i, the caller feeds the first one */
+    for (i = 0; i <= pipeline->stages; i++) {
+        size_t producers = i ? pipeline->stage[i - 1].workers : 1;
+        int ordered = i ? pipeline->stage[i - 1].ordered : 0;
+
+        if (pipeline_ring_init(&pipeline->ring[i], pipeline->capacity,
+                               producers, ordered) == -1) {
+            error = errno;
+            while (i--) {
+                pipeline_ring_destroy(&pipeline->ring[i]);
+            }
+            free(pipeline->ring);
+            pipeline->ring = NULL;
+            errno = error;
+            return -1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &pipeline->start);
+    for (i = 0; i < pipeline->stages; i++) {
+        pipeline_stage *stage = &pipeline->stage[i];
+
+        stage->input = &pipeline->ring[i];
+        stage->output = &pipeline->ring[i + 1];
+        stage->thread = calloc(stage->workers, sizeof(*stage->thread));
+        if (stage->thread == NULL) {
+            error = ENOMEM;
+            goto error;
+        }
+        for (size_t j = 0; j < stage->workers; j++) {
+            error = pthread_create(&stage->thread[j], NULL, pipeline_worker,
+                                   stage);
+            if (error) {
+                goto error;
+            }
+            stage->started++;
+        }
+    }
+    pipeline->running = 1;
+
+    return 0;
+
+error:
+    pipeline_abort(pipeline);
+    errno = error;
+    return -1;
+}
+
+int pipeline_push(pipeline *pipeline, const int *values, size_t count) {
+    assert(pipeline);
+    assert(values || count == 0);
+
+    if (!pipeline->running || pipeline->closed) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    while (count) {
+        size_t room;
+
+        if (pipeline->pending == NULL) {
+            pipeline->pending = pipeline_batch_get(pipeline);
+            if (pipeline->pending == NULL) {
+                return -1;
+            }
+        }
+
+        room = pipeline->batch - pipeline->pending->count;
+        if (room > count) {
+            room = count;
+        }
+        memcpy(pipeline->pending->value + pipeline->pending->count, values,
+               room * sizeof(int));
+        pipeline->pending->count += room;
+        values += room;
+        count -= room;
+
+        if (pipeline->pending->count == pipeline->batch) {
+            if (pipeline_ring_push(&pipeline->ring[0], pipeline->pending,
+                                   NULL) == -1) {
+                errno = ECANCELED;
+                return -1;
+            }
+            pipeline->pending = NULL;
+        }
+    }
+
+    return 0;
+}
+
+int pipeline_close(pipeline *pipeline) {
+    assert(pipeline);
+
+    if (!pipeline->running || pipeline->closed) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (pipeline->pending && pipeline->pending->count) {
+        if (pipeline_ring_push(&pipeline->ring[0], pipeline->pending,
+                               NULL) == -1) {
+            errno = ECANCELED;
+            return -1;
+        }
+        pipeline->pending = NULL;
+    }
+    pipeline->closed = 1;
+    pipeline_ring_done(&pipeline->ring[0]);
+
+    return 0;
+}
+
+size_t pipeline_pop(pipeline *pipeline, int *values, size_t count) {
+    size_t taken = 0;
+
+    assert(pipeline);
+    assert(values || count == 0);
+
+    if (!pipeline->running) {
+        return 0;
+    }
+
+    while (taken < count) {
+        size_t length;
+
+        /* Only wait for a batch when nothing was taken yet */
+        if (pipeline->draining == NULL) {
+            if (taken) {
+                break;
+            }
+            pipeline->draining = pipeline_ring_pop(
+                &pipeline->ring[pipeline->stages]);
+            if (pipeline->draining == NULL) {
+                break;
+            }
+            pipeline->drained = 0;
+        }
+
+        length = pipeline->draining->count - pipeline->drained;
+        if (length > count - taken) {
+            length = count - taken;
+        }
+        memcpy(values + taken, pipeline->draining->value + pipeline->drained,
+               length * sizeof(int));
+        pipeline->drained += length;
+        taken += length;
+
+        if (pipeline->drained == pipeline->draining->count) {
+            pipeline_batch_put(pipeline, pipeline->draining);
+            pipeline->draining = NULL;
+        }
+    }
+
+    return taken;
+}
+
+int pipeline_stats(pipeline *pipeline, size_t stage,
+                   pipeline_stage_stats *stats) {
+    pipeline_counters *counters = NULL;
+    double seconds;
+
+    assert(pipeline);
+    assert(stats);
+
+    if (stage >= pipeline->stages) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    counters = &pipeline->stage[stage].counters;
+    stats->batches = __atomic_load_n(&counters->batches, __ATOMIC_RELAXED);
+    stats->values_in = __atomic_load_n(&counters->values_in,
+                                       __ATOMIC_RELAXED);
+    stats->values_out = __atomic_load_n(&counters->values_out,
+                                        __ATOMIC_RELAXED);
+    stats->busy_seconds = __atomic_load_n(&counters->busy_ns,
+                                          __ATOMIC_RELAXED) / 1e9;
+    stats->stall_seconds = __atomic_load_n(&counters->stall_ns,
+                                           __ATOMIC_RELAXED) / 1e9;
+
+    if (pipeline->ring) {
+        pipeline_ring *ring = &pipeline->ring[stage];
+
+        seconds = pipeline_elapsed_ns(&pipeline->start) / 1e9;
+        if (seconds > 0) {
+            stats->values_per_second = stats->values_in / seconds;
+        }
+
+        pthread_mutex_lock(&ring->lock);
+        stats->depth = ring->count;
+        stats->max_depth = ring->max_depth;
+        if (ring->pushes) {
+            stats->mean_depth = (double)ring->depth_sum / ring->pushes;
+        }
+        pthread_mutex_unlock(&ring->lock);
+    }
+
+    return 0;
+}
+
+#ifdef WITH_TEST
+static size_t pipeline_test_square(void *ctx, const int *input,
+                                   size_t count, int *output) {
+    (void)ctx;
+
+    for (size_t i = 0; i < count; i++) {
+        output[i] = input[i] * input[i];
+    }
+    return count;
+}
+
+static size_t pipeline_test_even(void *ctx, const int *input, size_t count,
+                                 int *output) {
+    size_t kept = 0;
+
+    (void)ctx;
+    for (size_t i = 0; i < count; i++) {
+        if (input[i] % 2 == 0) {
+            output[kept++] = input[i];
+        }
+    }
+    return kept;
+}
+
+static size_t pipeline_test_sum(void *ctx, const int *input, size_t count,
+                                int *output) {
+    long sum = 0;
+
+    (void)output;
+    for (size_t i = 0; i < count; i++) {
+        sum += input[i];
+    }
+    __atomic_fetch_add((long *)ctx, sum, __ATOMIC_RELAXED);
+    return 0;
+}
+
+Test(Pipeline, ordered) {
+    pipeline *pipeline = pipeline_create(64, 4);
+    pipeline_stage_stats stats;
+    int values[1000];
+    int expected = 0;
+    size_t count;
+
+    cr_assert(pipeline);
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_square, NULL, 4,
+                                 1) == 0);
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_even, NULL, 3,
+                                 1) == 0);
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_even, NULL, 0,
+                                 1) == -1);
+    cr_assert(pipeline_start(pipeline) == 0);
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_even, NULL, 1,
+                                 1) == -1);
+
+    /* Popping while pushing, or the rings would fill up */
+    for (int i = 0; i < 10000; i += 100) {
+        for (int j = 0; j < 100; j++) {
+            values[j] = i + j;
+        }
+        cr_assert(pipeline_push(pipeline, values, 100) == 0);
+        while (expected < i - 200
+               && (count = pipeline_pop(pipeline, values, 100))) {
+            for (size_t j = 0; j < count; j++, expected += 2) {
+                cr_assert(values[j] == expected * expected);
+            }
+        }
+    }
+    cr_assert(pipeline_close(pipeline) == 0);
+    cr_assert(pipeline_push(pipeline, values, 1) == -1);
+    while ((count = pipeline_pop(pipeline, values, 1000))) {
+        for (size_t j = 0; j < count; j++, expected += 2) {
+            cr_assert(values[j] == expected * expected);
+        }
+    }
+    cr_assert(expected == 10000);
+
+    cr_assert(pipeline_stats(pipeline, 0, &stats) == 0);
+    cr_assert(stats.values_in == 10000 && stats.values_out == 10000);
+    cr_assert(stats.batches == (10000 + 63) / 64);
+    cr_assert(stats.max_depth <= 4);
+    cr_assert(pipeline_stats(pipeline, 1, &stats) == 0);
+    cr_assert(stats.values_out == 5000);
+    cr_assert(pipeline_stats(pipeline, 2, &stats) == -1);
+
+    pipeline_delete(pipeline);
+}
+
+Test(Pipeline, unordered_sink) {
+    pipeline *pipeline = pipeline_create(16, 2);
+    int values[100];
+    long sum = 0;
+
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_even, NULL, 3,
+                                 0) == 0);
+    cr_assert(pipeline_add_stage(pipeline, pipeline_test_sum, &sum, 2,
+                                 0) == 0);
+    cr_assert(pipeline_start(pipeline) == 0);
+
+    for (int i = 0; i < 10000; i += 100) {
+        for (int j = 0; j < 100; j++) {
+            values[j] = i + j;
+        }
+        cr_assert(pipeline_push(pipeline, values, 100) == 0);
+    }
+    cr_assert(pipeline_close(pipeline) == 0);
+
+    /* Nothing comes out of a sink, popping waits for the end */
+    cr_assert(pipeline_pop(pipeline, values, 100) == 0);
+    cr_assert(sum == 2 * 4999L * 5000 / 2);
+
+    pipeline_delete(pipeline);
+}
+#endif
@@ -0,0 +1,738 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/pvector.h"
+#ifdef WITH_TEST
+# include <pthread.h>
+# include <criterion/criterion.h>
+#endif
+
+#define PVECTOR_MASK (PVECTOR_WIDTH - 1)
+/* Nodes an edit may need: one per level, a new root and a new tail */
+#define PVECTOR_POOL_SIZE (64 / PVECTOR_BITS + 3)
+
+/* Last transient id handed out, ids are never reused */
+static uint64_t pvector_edits = 0;
+
+/*
+ * Nodes an edit needs are allocated before the vector is changed, so an
+ * edit either fails untouched or cannot fail. A node whose other owners
+ * went away meanwhile is edited in place, leaving its copy unused.
+ */
+typedef struct {
+    pvector_node *node[PVECTOR_POOL_SIZE];
+    size_t count;
+} pvector_pool;
+
+static void pvector_pool_free(pvector_pool *pool) {
+    while (pool->count) {
+        free(pool->node[--pool->count]);
+    }
+}
+
+static int pvector_pool_fill(pvector_pool *pool, size_t count, uint64_t edit) {
+    assert(count <= PVECTOR_POOL_SIZE);
+
+    pool->count = 0;
+    while (pool->count < count) {
+        pvector_node *node = calloc(1, sizeof(*node));
+
+        if (node == NULL) {
+            int error = errno;
+            pvector_pool_free(pool);
+            errno = error;
+            return -1;
+        }
+        node->refs = 1;
+        node->edit = edit;
+        pool->node[pool->count++] = node;
+    }
+
+    return 0;
+}
+
+static pvector_node *pvector_pool_take(pvector_pool *pool) {
+    assert(pool->count > 0);
+    return pool->node[--pool->count];
+}
+
+static inline void pvector_retain(pvector_node *node) {
+    if (node) {
+        __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Drop a reference to a node, freeing it and releasing its children
+ * when it was the last one
+ * @param node the node, can be NULL
+ * @param level 0 for a leaf, the shift of its children otherwise
+ */
+static void pvector_release(pvector_node *node, unsigned level) {
+    if (node == NULL || __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    if (level > 0) {
+        for (size_t i = 0; i < PVECTOR_WIDTH; i++) {
+            pvector_release(node->slot.child[i], level - PVECTOR_BITS);
+        }
+    }
+    free(node);
+}
+
+/**
+ * Check if a transient may change a node in place: it created the node,
+ * or holds the only path to it so nobody else can reach it
+ */
+static inline int pvector_owned(const pvector *vector,
+                                const pvector_node *node) {
+    return node && (node->edit == vector->edit
+                    || __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE) == 1);
+}
+
+/**
+ * Make the node in slot editable by the transient, copying it from the
+ * pool if it is shared, or taking a new one if slot is empty
+ * @return the node now in slot
+ */
+static pvector_node *pvector_edit(pvector *vector, pvector_pool *pool,
+                                  pvector_node **slot, unsigned level) {
+    pvector_node *node = *slot;
+    pvector_node *copy = NULL;
+
+    if (pvector_owned(vector, node)) {
+        return node;
+    }
+
+    copy = pvector_pool_take(pool);
+    if (node) {
+        memcpy(&copy->slot, &node->slot, sizeof(copy->slot));
+        for (size_t i = 0; level > 0 && i < PVECTOR_WIDTH; i++) {
+            pvector_retain(copy->slot.child[i]);
+        }
+        pvector_release(node, level);
+    }
+    *slot = copy;
+
+    return copy;
+}
+
+/**
+ * Count the nodes pvector_edit needs on the path from the root to index,
+ * down to level stop. Below the first node not owned every node is
+ * either copied or created.
+ */
+static size_t pvector_path_cost(const pvector *vector, size_t index,
+                                unsigned stop) {
+    const pvector_node *node = vector->root;
+
+    for (unsigned level = vector->shift; ; level -= PVECTOR_BITS) {
+        if (!pvector_owned(vector, node)) {
+            return (level - stop) / PVECTOR_BITS + 1;
+        }
+        if (level == stop) {
+            return 0;
+        }
+        node = node->slot.child[(index >> level) & PVECTOR_MASK];
+    }
+}
+
+static inline size_t pvector_tail_offset(const pvector *vector) {
+    return vector->count < PVECTOR_WIDTH
+        ? 0 : ((vector->count - 1) >> PVECTOR_BITS) << PVECTOR_BITS;
+}
+
+static const pvector_node *pvector_leaf(const pvector *vector, size_t index) {
+    const pvector_node *node = vector->root;
+
+    if (index >= pvector_tail_offset(vector)) {
+        return vector->tail;
+    }
+    for (unsigned level = vector->shift; level > 0; level -= PVECTOR_BITS) {
+        node = node->slot.child[(index >> level) & PVECTOR_MASK];
+    }
+
+    return node;
+}
+
+static uint64_t pvector_new_edit() {
+    return __atomic_add_fetch(&pvector_edits, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Create another handle on the nodes of a vector
+ * @param edit the transient id of the handle, 0 for a persistent one
+ */
+static pvector *pvector_clone(const pvector *vector, uint64_t edit) {
+    pvector *copy = malloc(sizeof(*copy));
+
+    if (copy == NULL) {
+        return NULL;
+    }
+
+    *copy = *vector;
+    copy->edit = edit;
+    pvector_retain(copy->root);
+    pvector_retain(copy->tail);
+
+    return copy;
+}
+
+/**
+ * Turn a transient used to build a new version into that version
+ * @param rc the result of the edit, the transient is deleted on error
+ */
+static pvector *pvector_freeze(pvector *vector, int rc) {
+    if (rc == -1) {
+        int error = errno;
+        pvector_delete(vector);
+        errno = error;
+        return NULL;
+    }
+
+    vector->edit = 0;
+    return vector;
+}
+
+pvector *pvector_create() {
+    pvector *vector = calloc(1, sizeof(*vector));
+
+    if (vector == NULL) {
+        return NULL;
+    }
+    vector->shift = PVECTOR_BITS;
+
+    return vector;
+}
+
+void pvector_delete(pvector *vector) {
+    assert(vector);
+
+    pvector_release(vector->root, vector->shift);
+    pvector_release(vector->tail, 0);
+    free(vector);
+}
+
+pvector *pvector_from_arraylist(const arraylist *list) {
+    pvector *vector = NULL;
+    int rc = 0;
+
+    assert(list);
+
+    vector = pvector_create();
+    if (vector == NULL) {
+        return NULL;
+    }
+
+    vector->edit = pvector_new_edit();
+    for (size_t i = 0; rc == 0 && i < list->count; i++) {
+        rc = pvector_transient_push(vector, list->element[i]);
+    }
+
+    return pvector_freeze(vector, rc);
+}
+
+arraylist *pvector_to_arraylist(const pvector *vector) {
+    arraylist *list = NULL;
+
+    assert(vector);
+
+    list = arraylist_create();
+    if (list == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(list, vector->count) == -1) {
+        int error = errno;
+        arraylist_delete(list);
+        errno = error;
+        return NULL;
+    }
+
+    for (size_t i = 0; i < vector->count; i += PVECTOR_WIDTH) {
+        size_t count = vector->count - i < PVECTOR_WIDTH
+            ? vector->count - i : PVECTOR_WIDTH;
+
+        memcpy(list->element + i, pvector_leaf(vector, i)->slot.value,
+               count * sizeof(int));
+    }
+    list->count = vector->count;
+
+    return list;
+}
+
+pvector *pvector_snapshot(const pvector *vector) {
+    assert(vector);
+    assert(vector->edit == 0);
+
+    return pvector_clone(vector, 0);
+}
+
+size_t pvector_count(const pvector *vector) {
+    assert(vector);
+
+    return vector->count;
+}
+
+int pvector_fast_get(const pvector *vector, size_t index) {
+    assert(vector);
+    assert(index < vector->count);
+
+    return pvector_leaf(vector, index)->slot.value[index & PVECTOR_MASK];
+}
+
+int pvector_get(const pvector *vector, size_t index, int *found) {
+    assert(vector);
+
+    if (index >= vector->count) {
+        if (found) {
+            *found = 0;
+        }
+        return 0;
+    }
+
+    if (found) {
+        *found = 1;
+    }
+
+    return pvector_leaf(vector, index)->slot.value[index & PVECTOR_MASK];
+}
+
+int pvector_for_each(const pvector *vector, pvector_fn fn, void *ctx) {
+    assert(vector);
+    assert(fn);
+
+    for (size_t i = 0; i < vector->count; i += PVECTOR_WIDTH) {
+        const pvector_node *leaf = pvector_leaf(vector, i);
+        size_t count = vector->count - i < PVECTOR_WIDTH
+            ? vector->count - i : PVECTOR_WIDTH;
+
+        for (size_t j = 0; j < count; j++) {
+            int rc = fn(ctx, leaf->slot.value[j]);
+
+            if (rc) {
+                return rc;
+            }
+        }
+    }
+
+    return 0;
+}
+
+pvector *pvector_push(const pvector *vector, int value) {
+    pvector *result = NULL;
+
+    assert(vector);
+    assert(vector->edit == 0);
+
+    result = pvector_clone(vector, pvector_new_edit());
+    if (result == NULL) {
+        return NULL;
+    }
+
+    return pvector_freeze(result, pvector_transient_push(result, value));
+}
+
+pvector *pvector_set(const pvector *vector, size_t index, int value) {
+    pvector *result = NULL;
+
+    assert(vector);
+    assert(vector->edit == 0);
+
+    result = pvector_clone(vector, pvector_new_edit());
+    if (result == NULL) {
+        return NULL;
+    }
+
+    return pvector_freeze(result,
+                          pvector_transient_set(result, index, value));
+}
+
+pvector *pvector_pop(const pvector *vector) {
+    pvector *result = NULL;
+
+    assert(vector);
+    assert(vector->edit == 0);
+
+    result = pvector_clone(vector, pvector_new_edit());
+    if (result == NULL) {
+        return NULL;
+    }
+
+    return pvector_freeze(result, pvector_transient_pop(result));
+}
+
+pvector *pvector_transient(const pvector *vector) {
+    assert(vector);
+    assert(vector->edit == 0);
+
+    return pvector_clone(vector, pvector_new_edit());
+}
+
+void pvector_persistent(pvector *vector) {
+    assert(vector);
+
+    vector->edit = 0;
+}
+
+int pvector_transient_push(pvector *vector, int value) {
+    pvector_pool pool;
+    pvector_node **slot = NULL;
+    size_t tail_count;
+    size_t cost;
+    int overflow;
+
+    assert(vector);
+    assert(vector->edit);
+
+    tail_count = vector->count - pvector_tail_offset(vector);
+    if (tail_count < PVECTOR_WIDTH) {
+        if (pvector_pool_fill(&pool, !pvector_owned(vector, vector->tail),
+                              vector->edit) == -1) {
+            return -1;
+        }
+        pvector_edit(vector, &pool, &vector->tail, 0)->slot.value[tail_count]
+            = value;
+        pvector_pool_free(&pool);
+        vector->count++;
+        return 0;
+    }
+
+    /* The full tail moves into the trie, under a new root if it is full */
+    overflow = (vector->count >> PVECTOR_BITS)
+        > ((size_t)1 << vector->shift);
+    cost = overflow ? 2 + vector->shift / PVECTOR_BITS
+        : 1 + pvector_path_cost(vector, vector->count - 1, PVECTOR_BITS);
+    if (pvector_pool_fill(&pool, cost, vector->edit) == -1) {
+        return -1;
+    }
+
+    if (overflow) {
+        pvector_node *root = pvector_pool_take(&pool);
+
+        root->slot.child[0] = vector->root;
+        vector->root = root;
+        vector->shift += PVECTOR_BITS;
+    }
+
+    slot = &vector->root;
+    for (unsigned level = vector->shift; ; level -= PVECTOR_BITS) {
+        pvector_node *node = pvector_edit(vector, &pool, slot, level);
+
+        slot = &node->slot.child[((vector->count - 1) >> level)
+                                 & PVECTOR_MASK];
+        if (level == PVECTOR_BITS) {
+            break;
+        }
+    }
+    *slot = vector->tail;
+
+    vector->tail = pvector_pool_take(&pool);
+    vector->tail->slot.value[0] = value;
+    vector->count++;
+    pvector_pool_free(&pool);
+
+    return 0;
+}
+
+int pvector_transient_set(pvector *vector, size_t index, int value) {
+    pvector_pool pool;
+    pvector_node **slot = &vector->root;
+
+    assert(vector);
+    assert(vector->edit);
+
+    if (index >= vector->count) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (index >= pvector_tail_offset(vector)) {
+        if (pvector_pool_fill(&pool, !pvector_owned(vector, vector->tail),
+                              vector->edit) == -1) {
+            return -1;
+        }
+        pvector_edit(vector, &pool, &vector->tail, 0)
+            ->slot.value[index & PVECTOR_MASK] = value;
+        pvector_pool_free(&pool);
+        return 0;
+    }
+
+    if (pvector_pool_fill(&pool, pvector_path_cost(vector, index, 0),
+                          vector->edit) == -1) {
+        return -1;
+    }
+    for (unsigned level = vector->shift; ; level -= PVECTOR_BITS) {
+        pvector_node *node = pvector_edit(vector, &pool, slot, level);
+
+        if (level == 0) {
+            node->slot.value[index & PVECTOR_MASK] = value;
+            break;
+        }
+        slot = &node->slot.child[(index >> level) & PVECTOR_MASK];
+    }
+    pvector_pool_free(&pool);
+
+    return 0;
+}
+
+/**
+ * Remove the last leaf of the trie, and the nodes left empty
+ */
+static void pvector_pop_tail(pvector *vector, pvector_pool *pool,
+                             pvector_node **slot, unsigned level) {
+    size_t index = ((vector->count - 2) >> level) & PVECTOR_MASK;
+    pvector_node *node = pvector_edit(vector, pool, slot, level);
+
+    if (level > PVECTOR_BITS) {
+        pvector_pop_tail(vector, pool, &node->slot.child[index],
+                         level - PVECTOR_BITS);
+    } else {
+        pvector_release(node->slot.child[index], 0);
+        node->slot.child[index] = NULL;
+    }
+
+    if (index == 0 && node->slot.child[0] == NULL) {
+        pvector_release(node, level);
+        *slot = NULL;
+    }
+}
+
+int pvector_transient_pop(pvector *vector) {
+    pvector_pool pool;
+    pvector_node *tail = NULL;
+
+    assert(vector);
+    assert(vector->edit);
+
+    if (vector->count == 0) {
+        return 0;
+    }
+
+    /* Values past the count are ignored, the tail is left as it is */
+    if (vector->count - pvector_tail_offset(vector) > 1) {
+        vector->count--;
+        return 1;
+    }
+    if (vector->count == 1) {
+        pvector_release(vector->tail, 0);
+        vector->tail = NULL;
+        vector->count = 0;
+        return 1;
+    }
+
+    /* The tail is emptied, the last leaf of the trie replaces it */
+    if (pvector_pool_fill(&pool, pvector_path_cost(vector, vector->count - 2,
+                                                   PVECTOR_BITS),
+                          vector->edit) == -1) {
+        return -1;
+    }
+    tail = (pvector_node *)pvector_leaf(vector, vector->count - 2);
+    pvector_retain(tail);
+    pvector_pop_tail(vector, &pool, &vector->root, vector->shift);
+
+    if (vector->shift > PVECTOR_BITS
+        && vector->root->slot.child[1] == NULL) {
+        pvector_node *root = vector->root;
+
+        vector->root = root->slot.child[0];
+        root->slot.child[0] = NULL;
+        pvector_release(root, vector->shift);
+        vector->shift -= PVECTOR_BITS;
+    }
+
+    pvector_release(vector->tail, 0);
+    vector->tail = tail;
+    vector->count--;
+    pvector_pool_free(&pool);
+
+    return 1;
+}
+
+#ifdef WITH_TEST
+static void pvector_test_check(const pvector *vector, int offset) {
+    cr_assert(vector);
+    for (size_t i = 0; i < vector->count; i++) {
+        cr_assert(pvector_fast_get(vector, i) == (int)i + offset);
+    }
+}
+
+Test(Pvector, push_versions) {
+    pvector *versions[4] = { NULL };
+    size_t counts[4] = { 0, 32, 1057, 40000 };
+    pvector *vector = pvector_create();
+    int found = 0;
+
+    cr_assert(vector);
+    for (size_t i = 0, v = 0; i <= 40000; i++) {
+        if (v < 4 && i == counts[v]) {
+            versions[v++] = pvector_snapshot(vector);
+        }
+        if (i < 40000) {
+            pvector *next = pvector_push(vector, i);
+
+            cr_assert(next);
+            pvector_delete(vector);
+            vector = next;
+        }
+    }
+    cr_assert(vector->shift == 15);
+
+    /* Older versions are unchanged by later pushes */
+    for (size_t v = 0; v < 4; v++) {
+        cr_assert(pvector_count(versions[v]) == counts[v]);
+        pvector_test_check(versions[v], 0);
+    }
+    cr_assert(pvector_get(vector, 39999, &found) == 39999);
+    cr_assert(found);
+    pvector_get(vector, 40000, &found);
+    cr_assert_not(found);
+
+    for (size_t v = 0; v < 4; v++) {
+        pvector_delete(versions[v]);
+    }
+    pvector_delete(vector);
+}
+
+Test(Pvector, set_pop) {
+    arraylist *list = arraylist_create();
+
+    for (int i = 0; i < 33000; i++) {
+        arraylist_insert_last(list, i);
+    }
+    pvector *base = pvector_from_arraylist(list);
+    pvector *vector = pvector_snapshot(base);
+
+    for (size_t i = 0; i < 33000; i += 7) {
+        pvector *next = pvector_set(vector, i, -1);
+
+        cr_assert(next);
+        pvector_delete(vector);
+        vector = next;
+    }
+    cr_assert(pvector_set(vector, 33000, 0) == NULL);
+    cr_assert(errno == EINVAL);
+    for (size_t i = 0; i < 33000; i++) {
+        cr_assert(pvector_fast_get(vector, i) == (i % 7 ? (int)i : -1));
+    }
+
+    /* Popping every value collapses the trie back to a tail */
+    while (pvector_count(vector) > 0) {
+        size_t count = pvector_count(vector);
+        pvector *next = pvector_pop(vector);
+
+        cr_assert(next);
+        cr_assert(pvector_count(next) == count - 1);
+        if (count > 1) {
+            cr_assert(pvector_fast_get(next, count - 2)
+                      == ((count - 2) % 7 ? (int)count - 2 : -1));
+        }
+        pvector_delete(vector);
+        vector = next;
+    }
+    cr_assert(vector->root == NULL);
+    cr_assert(vector->shift == PVECTOR_BITS);
+    pvector_test_check(base, 0);
+
+    pvector_delete(vector);
+    pvector_delete(base);
+    arraylist_delete(list);
+}
+
+static int pvector_test_sum(void *ctx, int value) {
+    *(long *)ctx += value;
+    return 0;
+}
+
+Test(Pvector, transient) {
+    pvector *base = pvector_create();
+    pvector *vector = pvector_transient(base);
+    long sum = 0;
+
+    for (int i = 0; i < 5000; i++) {
+        cr_assert(pvector_transient_push(vector, i) == 0);
+    }
+    pvector_persistent(vector);
+    pvector *first = pvector_snapshot(vector);
+    pvector_delete(vector);
+
+    /* Batch edits copy each shared node once, then edit it in place */
+    vector = pvector_transient(first);
+    for (int i = 0; i < 5000; i++) {
+        cr_assert(pvector_transient_set(vector, i, i + 1) == 0);
+    }
+    for (int i = 0; i < 1000; i++) {
+        cr_assert(pvector_transient_pop(vector) == 1);
+    }
+    for (int i = 4000; i < 6000; i++) {
+        cr_assert(pvector_transient_push(vector, i + 1) == 0);
+    }
+    pvector_persistent(vector);
+
+    cr_assert(pvector_count(vector) == 6000);
+    pvector_test_check(vector, 1);
+    cr_assert(pvector_count(first) == 5000);
+    pvector_test_check(first, 0);
+    cr_assert(pvector_for_each(first, pvector_test_sum, &sum) == 0);
+    cr_assert(sum == 4999L * 5000 / 2);
+
+    arraylist *list = pvector_to_arraylist(vector);
+    cr_assert(list->count == 6000);
+    cr_assert(list->element[5999] == 6000);
+
+    arraylist_delete(list);
+    pvector_delete(vector);
+    pvector_delete(first);
+    pvector_delete(base);
+}
+
+static void *pvector_test_reader(void *snapshot) {
+    pvector *vector = snapshot;
+    size_t count = pvector_count(vector);
+
+    /* Version n holds 0 to n - 1 with its last value negated */
+    for (size_t i = 0; i < count; i++) {
+        int expected = i + 1 == count ? -(int)i : (int)i;
+
+        if (pvector_fast_get(vector, i) != expected) {
+            return vector;
+        }
+    }
+    pvector_delete(vector);
+
+    return NULL;
+}
+
+Test(Pvector, concurrent_readers) {
+    pthread_t reader[64];
+    pvector *vector = pvector_create();
+
+    /* The writer keeps editing while readers check their snapshot */
+    for (int i = 0; i < 64 * 100; i++) {
+        if (i > 0) {
+            pvector *fixed = pvector_set(vector, i - 1, i - 1);
+            pvector_delete(vector);
+            vector = fixed;
+        }
+        pvector *pushed = pvector_push(vector, -i);
+        pvector_delete(vector);
+        vector = pushed;
+
+        if (i % 100 == 99) {
+            cr_assert(pthread_create(&reader[i / 100], NULL,
+                                     pvector_test_reader,
+                                     pvector_snapshot(vector)) == 0);
+        }
+    }
+
+    for (int i = 0; i < 64; i++) {
+        void *failed = NULL;
+
+        pthread_join(reader[i], &failed);
+        cr_assert(failed == NULL);
+    }
+    pvector_delete(vector);
+}
+#endif
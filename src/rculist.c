@@ -0,0 +1,321 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/rculist.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+static rculist_version *rculist_version_create(size_t count) {
+    rculist_version *version = NULL;
+
+    version = malloc(sizeof(*version) + count * sizeof(version->element[0]));
+    if (version == NULL) {
+        return NULL;
+    }
+    version->count = count;
+
+    return version;
+}
+
+/**
+ * Publish a version and retire the previous one.
+ * The writer lock must be held.
+ */
+static void rculist_replace(rculist *list, rculist_version *version) {
+    rculist_version *old = list->current;
+
+    __atomic_store_n(&list->current, version, __ATOMIC_RELEASE);
+
+    /* Without memory to retire it, wait for the readers of old instead */
+    if (epoch_retire(list->domain, old, free) == -1) {
+        epoch_synchronize(list->domain);
+        free(old);
+    }
+    epoch_reclaim(list->domain);
+}
+
+rculist *rculist_create(epoch_domain *domain) {
+    rculist *list = NULL;
+    int error;
+
+    assert(domain);
+
+    list = malloc(sizeof(*list));
+    if (list == NULL) {
+        return NULL;
+    }
+
+    list->domain = domain;
+    list->current = rculist_version_create(0);
+    if (list->current == NULL) {
+        free(list);
+        return NULL;
+    }
+
+    error = pthread_mutex_init(&list->lock, NULL);
+    if (error) {
+        free(list->current);
+        free(list);
+        errno = error;
+        return NULL;
+    }
+
+    return list;
+}
+
+void rculist_delete(rculist *list) {
+    assert(list);
+
+    pthread_mutex_destroy(&list->lock);
+    free(list->current);
+    free(list);
+}
+
+const rculist_version *rculist_read(const rculist *list) {
+    assert(list);
+
+    return __atomic_load_n(&list->current, __ATOMIC_ACQUIRE);
+}
+
+int rculist_get(const rculist *list, epoch_record *record, size_t index,
+                int *found) {
+    const rculist_version *version = NULL;
+    int value = 0;
+
+    assert(list);
+    assert(record);
+
+    epoch_enter(list->domain, record);
+    version = rculist_read(list);
+    if (index < version->count) {
+        value = version->element[index];
+    }
+    if (found) {
+        *found = index < version->count;
+    }
+    epoch_exit(record);
+
+    return value;
+}
+
+int rculist_contains(const rculist *list, epoch_record *record, int value) {
+    const rculist_version *version = NULL;
+    int found = 0;
+
+    assert(list);
+    assert(record);
+
+    epoch_enter(list->domain, record);
+    version = rculist_read(list);
+    for (size_t i = 0; i < version->count && !found; i++) {
+        found = version->element[i] == value;
+    }
+    epoch_exit(record);
+
+    return found;
+}
+
+int rculist_publish(rculist *list, const arraylist *values) {
+    rculist_version *version = NULL;
+
+    assert(list);
+    assert(values);
+
+    version = rculist_version_create(values->count);
+    if (version == NULL) {
+        return -1;
+    }
+    memcpy(version->element, values->element,
+           values->count * sizeof(version->element[0]));
+
+    pthread_mutex_lock(&list->lock);
+    rculist_replace(list, version);
+    pthread_mutex_unlock(&list->lock);
+
+    return 0;
+}
+
+int rculist_insert_last(rculist *list, int value) {
+    rculist_version *version = NULL;
+    const rculist_version *current = NULL;
+
+    assert(list);
+
+    pthread_mutex_lock(&list->lock);
+    current = list->current;
+    version = rculist_version_create(current->count + 1);
+    if (version == NULL) {
+        pthread_mutex_unlock(&list->lock);
+        return -1;
+    }
+    memcpy(version->element, current->element,
+           current->count * sizeof(version->element[0]));
+    version->element[current->count] = value;
+
+    rculist_replace(list, version);
+    pthread_mutex_unlock(&list->lock);
+
+    return 0;
+}
+
+int rculist_set(rculist *list, size_t index, int value) {
+    rculist_version *version = NULL;
+    const rculist_version *current = NULL;
+
+    assert(list);
+
+    pthread_mutex_lock(&list->lock);
+    current = list->current;
+    if (index >= current->count) {
+        pthread_mutex_unlock(&list->lock);
+        errno = EINVAL;
+        return -1;
+    }
+    version = rculist_version_create(current->count);
+    if (version == NULL) {
+        pthread_mutex_unlock(&list->lock);
+        return -1;
+    }
+    memcpy(version->element, current->element,
+           current->count * sizeof(version->element[0]));
+    version->element[index] = value;
+
+    rculist_replace(list, version);
+    pthread_mutex_unlock(&list->lock);
+
+    return 0;
+}
+
+int rculist_remove_at(rculist *list, size_t index) {
+    rculist_version *version = NULL;
+    const rculist_version *current = NULL;
+
+    assert(list);
+
+    pthread_mutex_lock(&list->lock);
+    current = list->current;
+    if (current->count == 0) {
+        pthread_mutex_unlock(&list->lock);
+        return 0;
+    }
+    if (index >= current->count) {
+        index = current->count - 1;
+    }
+    version = rculist_version_create(current->count - 1);
+    if (version == NULL) {
+        pthread_mutex_unlock(&list->lock);
+        return -1;
+    }
+    memcpy(version->element, current->element,
+           index * sizeof(version->element[0]));
+    memcpy(version->element + index, current->element + index + 1,
+           (current->count - index - 1) * sizeof(version->element[0]));
+
+    rculist_replace(list, version);
+    pthread_mutex_unlock(&list->lock);
+
+    return 1;
+}
+
+#ifdef WITH_TEST
+Test(Rculist, writes) {
+    epoch_domain *domain = epoch_create();
+    epoch_record *record = epoch_register(domain);
+    rculist *list = rculist_create(domain);
+    arraylist *values = arraylist_create();
+    int found = 0;
+
+    for (int i = 0; i < 10; i++) {
+        arraylist_insert_last(values, i);
+    }
+    cr_assert(rculist_publish(list, values) == 0);
+    cr_assert(rculist_insert_last(list, 10) == 0);
+    cr_assert(rculist_set(list, 0, -1) == 0);
+    cr_assert(rculist_set(list, 11, 0) == -1);
+    cr_assert(errno == EINVAL);
+    cr_assert(rculist_remove_at(list, 5) == 1);
+
+    cr_assert(rculist_get(list, record, 0, &found) == -1);
+    cr_assert(found);
+    cr_assert(rculist_get(list, record, 5, &found) == 6);
+    cr_assert(rculist_get(list, record, 9, &found) == 10);
+    rculist_get(list, record, 10, &found);
+    cr_assert_not(found);
+    cr_assert(rculist_contains(list, record, 10));
+    cr_assert_not(rculist_contains(list, record, 5));
+
+    /* A pinned reader keeps its version while writers go on */
+    epoch_enter(domain, record);
+    const rculist_version *version = rculist_read(list);
+    for (int i = 0; i < 100; i++) {
+        rculist_insert_last(list, 100 + i);
+    }
+    cr_assert(version->count == 10);
+    cr_assert(version->element[9] == 10);
+    cr_assert(domain->pending >= 100);
+    epoch_exit(record);
+
+    epoch_synchronize(domain);
+    cr_assert(domain->pending == 0);
+
+    rculist_delete(list);
+    arraylist_delete(values);
+    epoch_unregister(domain, record);
+    epoch_delete(domain);
+}
+
+typedef struct {
+    rculist *list;
+    int stop;
+} rculist_test_state;
+
+static void *rculist_test_reader(void *arg) {
+    rculist_test_state *state = arg;
+    epoch_record *record = epoch_register(state->list->domain);
+    void *failed = NULL;
+
+    /* Every version holds 0 to count - 1 */
+    while (!__atomic_load_n(&state->stop, __ATOMIC_ACQUIRE) && !failed) {
+        epoch_enter(state->list->domain, record);
+        const rculist_version *version = rculist_read(state->list);
+        for (size_t i = 0; i < version->count; i++) {
+            if (version->element[i] != (int)i) {
+                failed = arg;
+            }
+        }
+        epoch_exit(record);
+    }
+
+    epoch_unregister(state->list->domain, record);
+    return failed;
+}
+
+Test(Rculist, concurrent_readers) {
+    epoch_domain *domain = epoch_create();
+    rculist_test_state state = { rculist_create(domain), 0 };
+    pthread_t reader[4];
+
+    for (int i = 0; i < 4; i++) {
+        cr_assert(pthread_create(&reader[i], NULL, rculist_test_reader,
+                                 &state) == 0);
+    }
+    for (int i = 0; i < 2000; i++) {
+        cr_assert(rculist_insert_last(state.list, i) == 0);
+    }
+    __atomic_store_n(&state.stop, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < 4; i++) {
+        void *failed = NULL;
+
+        pthread_join(reader[i], &failed);
+        cr_assert(failed == NULL);
+    }
+
+    rculist_delete(state.list);
+    epoch_delete(domain);
+}
+#endif
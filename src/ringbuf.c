@@ -0,0 +1,266 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "woofi/allocator.h"
+#include "woofi/ringbuf.h"
+#ifdef WITH_TEST
+# include <sys/socket.h>
+# include <criterion/criterion.h>
+#endif
+
+ringbuf *ringbuf_create(size_t capacity) {
+    ringbuf *ring = NULL;
+
+    if (capacity == 0 || capacity == SIZE_MAX) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ring = allocator_malloc(sizeof(*ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->size = capacity + 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->element = allocator_malloc(ring->size);
+    if (ring->element == NULL) {
+        int error = errno;
+        allocator_free(ring, sizeof(*ring));
+        errno = error;
+        return NULL;
+    }
+
+    return ring;
+}
+
+void ringbuf_delete(ringbuf *ring) {
+    assert(ring);
+
+    allocator_free(ring->element, ring->size);
+    allocator_free(ring, sizeof(*ring));
+}
+
+size_t ringbuf_count(const ringbuf *ring) {
+    assert(ring);
+
+    if (ring->tail < ring->head) {
+        return ring->size - (ring->head - ring->tail);
+    }
+
+    return ring->tail - ring->head;
+}
+
+size_t ringbuf_space(const ringbuf *ring) {
+    return ring->size - 1 - ringbuf_count(ring);
+}
+
+int ringbuf_is_empty(const ringbuf *ring) {
+    assert(ring);
+
+    return ring->tail == ring->head;
+}
+
+size_t ringbuf_peek(const ringbuf *ring, struct iovec iov[2]) {
+    size_t count = ringbuf_count(ring);
+    size_t first = ring->size - ring->head;
+
+    assert(iov);
+
+    if (first > count) {
+        first = count;
+    }
+    iov[0].iov_base = ring->element + ring->head;
+    iov[0].iov_len = first;
+    iov[1].iov_base = ring->element;
+    iov[1].iov_len = count - first;
+
+    return count;
+}
+
+void ringbuf_consume(ringbuf *ring, size_t count) {
+    assert(count <= ringbuf_count(ring));
+
+    ring->head += count;
+    if (ring->head >= ring->size) {
+        ring->head -= ring->size;
+    }
+
+    /* Keep the free bytes in one segment when nothing is left */
+    if (ring->head == ring->tail) {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+}
+
+size_t ringbuf_reserve(ringbuf *ring, struct iovec iov[2]) {
+    size_t space = ringbuf_space(ring);
+    size_t first = ring->size - ring->tail;
+
+    assert(iov);
+
+    if (first > space) {
+        first = space;
+    }
+    iov[0].iov_base = ring->element + ring->tail;
+    iov[0].iov_len = first;
+    iov[1].iov_base = ring->element;
+    iov[1].iov_len = space - first;
+
+    return space;
+}
+
+void ringbuf_commit(ringbuf *ring, size_t count) {
+    assert(count <= ringbuf_space(ring));
+
+    ring->tail += count;
+    if (ring->tail >= ring->size) {
+        ring->tail -= ring->size;
+    }
+}
+
+size_t ringbuf_write(ringbuf *ring, const void *data, size_t count) {
+    struct iovec iov[2];
+    size_t space = ringbuf_reserve(ring, iov);
+
+    assert(data || count == 0);
+
+    if (count > space) {
+        count = space;
+    }
+    if (count <= iov[0].iov_len) {
+        memcpy(iov[0].iov_base, data, count);
+    }
+    else {
+        memcpy(iov[0].iov_base, data, iov[0].iov_len);
+        memcpy(iov[1].iov_base, (const char *)data + iov[0].iov_len,
+               count - iov[0].iov_len);
+    }
+    ringbuf_commit(ring, count);
+
+    return count;
+}
+
+size_t ringbuf_read(ringbuf *ring, void *data, size_t count) {
+    struct iovec iov[2];
+    size_t used = ringbuf_peek(ring, iov);
+
+    assert(data || count == 0);
+
+    if (count > used) {
+        count = used;
+    }
+    if (count <= iov[0].iov_len) {
+        memcpy(data, iov[0].iov_base, count);
+    }
+    else {
+        memcpy(data, iov[0].iov_base, iov[0].iov_len);
+        memcpy((char *)data + iov[0].iov_len, iov[1].iov_base,
+               count - iov[0].iov_len);
+    }
+    ringbuf_consume(ring, count);
+
+    return count;
+}
+
+ssize_t ringbuf_read_fd(ringbuf *ring, int fd) {
+    struct iovec iov[2];
+    ssize_t rc;
+
+    if (ringbuf_reserve(ring, iov) == 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    rc = readv(fd, iov, iov[1].iov_len ? 2 : 1);
+    if (rc > 0) {
+        ringbuf_commit(ring, rc);
+    }
+
+    return rc;
+}
+
+ssize_t ringbuf_write_fd(ringbuf *ring, int fd) {
+    struct iovec iov[2];
+    ssize_t rc;
+
+    if (ringbuf_peek(ring, iov) == 0) {
+        return 0;
+    }
+
+    rc = writev(fd, iov, iov[1].iov_len ? 2 : 1);
+    if (rc > 0) {
+        ringbuf_consume(ring, rc);
+    }
+
+    return rc;
+}
+
+#ifdef WITH_TEST
+Test(Ringbuf, segments) {
+    ringbuf *ring = ringbuf_create(8);
+    struct iovec iov[2];
+    char out[8];
+
+    cr_assert(ring);
+    cr_assert(ringbuf_is_empty(ring));
+    cr_assert(ringbuf_write(ring, "abcdef", 6) == 6);
+    cr_assert(ringbuf_read(ring, out, 4) == 4);
+    cr_assert(memcmp(out, "abcd", 4) == 0);
+
+    /* The free bytes wrap around the end of the storage */
+    cr_assert(ringbuf_reserve(ring, iov) == 6);
+    cr_assert(iov[0].iov_len == 3 && iov[1].iov_len == 3);
+    cr_assert(ringbuf_write(ring, "ghijklmn", 8) == 6);
+    cr_assert(ringbuf_space(ring) == 0);
+    cr_assert(ringbuf_count(ring) == 8);
+
+    cr_assert(ringbuf_peek(ring, iov) == 8);
+    cr_assert(iov[0].iov_len == 5 && iov[1].iov_len == 3);
+    cr_assert(memcmp(iov[0].iov_base, "efghi", 5) == 0);
+    cr_assert(memcmp(iov[1].iov_base, "jkl", 3) == 0);
+    ringbuf_consume(ring, 6);
+    cr_assert(ringbuf_read(ring, out, 8) == 2);
+    cr_assert(memcmp(out, "kl", 2) == 0);
+
+    /* An empty ring buffer starts over in one segment */
+    cr_assert(ringbuf_reserve(ring, iov) == 8);
+    cr_assert(iov[0].iov_len == 8 && iov[1].iov_len == 0);
+
+    ringbuf_delete(ring);
+}
+
+Test(Ringbuf, fd) {
+    ringbuf *ring = ringbuf_create(100);
+    char buffer[200];
+    int fd[2];
+
+    cr_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == 0);
+    for (int i = 0; i < 200; i++) {
+        buffer[i] = i;
+    }
+
+    /* Moves the data to the end of the storage */
+    ringbuf_write(ring, buffer, 90);
+    ringbuf_read(ring, buffer + 100, 85);
+    cr_assert(write(fd[0], buffer, 150) == 150);
+    cr_assert(ringbuf_read_fd(ring, fd[1]) == 95);
+    cr_assert(ringbuf_read_fd(ring, fd[1]) == -1);
+    cr_assert(errno == ENOBUFS);
+
+    cr_assert(ringbuf_write_fd(ring, fd[1]) == 100);
+    cr_assert(ringbuf_is_empty(ring));
+    cr_assert(read(fd[0], buffer + 100, 100) == 100);
+    cr_assert(memcmp(buffer + 105, buffer, 95) == 0);
+
+    close(fd[0]);
+    close(fd[1]);
+    ringbuf_delete(ring);
+}
+#endif
@@ -0,0 +1,1218 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "woofi/bitset.h"
+#include "woofi/roaring.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#define ROARING_BITMAP_BYTES (ROARING_BITMAP_WORDS * sizeof(uint64_t))
+
+static const capacity_policy roaring_policy = CAPACITY_POLICY_DEFAULT;
+
+/**
+ * Free the storage of a container
+ */
+static void roaring_container_free(roaring_container *container) {
+    switch (container->type) {
+    case ROARING_BITMAP:
+        free(container->data.bitmap);
+        break;
+    case ROARING_RUN:
+        free(container->data.run);
+        break;
+    default:
+        free(container->data.array);
+        break;
+    }
+}
+
+static size_t roaring_container_bytes(const roaring_container *container) {
+    switch (container->type) {
+    case ROARING_BITMAP:
+        return ROARING_BITMAP_BYTES;
+    case ROARING_RUN:
+        return container->capacity * sizeof(roaring_run);
+    default:
+        return container->capacity * sizeof(uint16_t);
+    }
+}
+
+static inline void roaring_bitmap_set_range(uint64_t *bitmap, uint32_t first,
+                                            uint32_t last) {
+    for (uint32_t word = first / 64; word <= last / 64; word++) {
+        uint64_t mask = ~(uint64_t)0;
+
+        if (word == first / 64) {
+            mask &= ~(uint64_t)0 << (first % 64);
+        }
+        if (word == last / 64) {
+            mask &= ~(uint64_t)0 >> (63 - last % 64);
+        }
+        bitmap[word] |= mask;
+    }
+}
+
+/**
+ * Count the runs of consecutive values of an array or bitmap container
+ */
+static uint32_t roaring_container_runs(const roaring_container *container) {
+    uint32_t runs = 0;
+
+    if (container->type == ROARING_RUN) {
+        return container->length;
+    }
+
+    if (container->type == ROARING_ARRAY) {
+        for (uint32_t i = 0; i < container->length; i++) {
+            if (i == 0 || container->data.array[i]
+                          != container->data.array[i - 1] + 1) {
+                runs++;
+            }
+        }
+        return runs;
+    }
+
+    /* A run starts at every set bit whose previous bit is clear */
+    uint64_t carry = 0;
+    for (size_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+        uint64_t word = container->data.bitmap[i];
+
+        runs += __builtin_popcountll(word & ~(word << 1 | carry));
+        carry = word >> 63;
+    }
+
+    return runs;
+}
+
+/**
+ * Replace the storage of a container by a bitmap
+ * @return 0 if the container was converted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int roaring_container_to_bitmap(roaring_container *container) {
+    uint64_t *bitmap = calloc(ROARING_BITMAP_WORDS, sizeof(*bitmap));
+
+    if (bitmap == NULL) {
+        return -1;
+    }
+
+    if (container->type == ROARING_RUN) {
+        for (uint32_t i = 0; i < container->length; i++) {
+            roaring_run run = container->data.run[i];
+
+            roaring_bitmap_set_range(bitmap, run.start,
+                                     (uint32_t)run.start + run.length);
+        }
+    } else {
+        for (uint32_t i = 0; i < container->length; i++) {
+            uint16_t low = container->data.array[i];
+
+            bitmap[low / 64] |= (uint64_t)1 << (low % 64);
+        }
+    }
+
+    roaring_container_free(container);
+    container->type = ROARING_BITMAP;
+    container->data.bitmap = bitmap;
+    container->length = ROARING_BITMAP_WORDS;
+    container->capacity = ROARING_BITMAP_WORDS;
+
+    return 0;
+}
+
+/**
+ * Replace the storage of a container by a sorted array
+ * @return 0 if the container was converted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int roaring_container_to_array(roaring_container *container) {
+    uint16_t *array = malloc((container->cardinality ? container->cardinality
+                                                     : 1) * sizeof(*array));
+    uint32_t length = 0;
+
+    if (array == NULL) {
+        return -1;
+    }
+
+    if (container->type == ROARING_RUN) {
+        for (uint32_t i = 0; i < container->length; i++) {
+            roaring_run run = container->data.run[i];
+
+            for (uint32_t low = run.start; low <= run.start + run.length;
+                 low++) {
+                array[length++] = low;
+            }
+        }
+    } else {
+        for (uint32_t word = 0; word < ROARING_BITMAP_WORDS; word++) {
+            uint64_t bits = container->data.bitmap[word];
+
+            while (bits) {
+                array[length++] = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    roaring_container_free(container);
+    container->type = ROARING_ARRAY;
+    container->data.array = array;
+    container->length = length;
+    container->capacity = container->cardinality ? container->cardinality : 1;
+
+    return 0;
+}
+
+/**
+ * Replace the storage of a container by runs
+ * @return 0 if the container was converted
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int roaring_container_to_runs(roaring_container *container,
+                                     uint32_t runs) {
+    roaring_run *run = malloc((runs ? runs : 1) * sizeof(*run));
+    uint32_t length = 0;
+    int32_t previous = -2;
+
+    if (run == NULL) {
+        return -1;
+    }
+
+    /* Extend the last run or start a new one for every value */
+    if (container->type == ROARING_ARRAY) {
+        for (uint32_t i = 0; i < container->length; i++) {
+            int32_t low = container->data.array[i];
+
+            if (low == previous + 1) {
+                run[length - 1].length++;
+            } else {
+                run[length].start = low;
+                run[length].length = 0;
+                length++;
+            }
+            previous = low;
+        }
+    } else {
+        for (uint32_t word = 0; word < ROARING_BITMAP_WORDS; word++) {
+            uint64_t bits = container->data.bitmap[word];
+
+            while (bits) {
+                int32_t low = word * 64 + __builtin_ctzll(bits);
+
+                if (low == previous + 1) {
+                    run[length - 1].length++;
+                } else {
+                    run[length].start = low;
+                    run[length].length = 0;
+                    length++;
+                }
+                previous = low;
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    roaring_container_free(container);
+    container->type = ROARING_RUN;
+    container->data.run = run;
+    container->length = length;
+    container->capacity = runs ? runs : 1;
+
+    return 0;
+}
+
+/**
+ * Give a container the smallest of its three encodings
+ * @return 0 if the container was encoded
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int roaring_container_encode(roaring_container *container) {
+    size_t runs = roaring_container_runs(container);
+    size_t run_bytes = runs * sizeof(roaring_run);
+    size_t array_bytes = container->cardinality <= ROARING_ARRAY_MAX
+        ? container->cardinality * sizeof(uint16_t) : SIZE_MAX;
+
+    if (run_bytes < array_bytes && run_bytes < ROARING_BITMAP_BYTES) {
+        return container->type == ROARING_RUN
+            ? 0 : roaring_container_to_runs(container, runs);
+    }
+    if (array_bytes <= ROARING_BITMAP_BYTES) {
+        return container->type == ROARING_ARRAY
+            ? 0 : roaring_container_to_array(container);
+    }
+
+    return container->type == ROARING_BITMAP
+        ? 0 : roaring_container_to_bitmap(container);
+}
+
+/**
+ * Turn a run container into an array or a bitmap
+ */
+static int roaring_container_decode(roaring_container *container) {
+    if (container->type != ROARING_RUN) {
+        return 0;
+    }
+
+    return container->cardinality <= ROARING_ARRAY_MAX
+        ? roaring_container_to_array(container)
+        : roaring_container_to_bitmap(container);
+}
+
+/**
+ * Find the first value of a sorted array not below low
+ */
+static uint32_t roaring_array_search(const uint16_t *array, uint32_t length,
+                                     uint16_t low) {
+    uint32_t first = 0;
+
+    while (length > 0) {
+        uint32_t half = length / 2;
+
+        if (array[first + half] < low) {
+            first += half + 1;
+            length -= half + 1;
+        } else {
+            length = half;
+        }
+    }
+
+    return first;
+}
+
+static int roaring_container_contains(const roaring_container *container,
+                                      uint16_t low) {
+    uint32_t first = 0;
+    uint32_t length = container->length;
+
+    switch (container->type) {
+    case ROARING_BITMAP:
+        return container->data.bitmap[low / 64] >> (low % 64) & 1;
+    case ROARING_RUN:
+        /* Last run starting at or before low */
+        while (length > 0) {
+            uint32_t half = length / 2;
+
+            if (container->data.run[first + half].start <= low) {
+                first += half + 1;
+                length -= half + 1;
+            } else {
+                length = half;
+            }
+        }
+        return first > 0 && low <= (uint32_t)container->data.run[first - 1].start
+                                    + container->data.run[first - 1].length;
+    default:
+        first = roaring_array_search(container->data.array,
+                                     container->length, low);
+        return first < container->length
+            && container->data.array[first] == low;
+    }
+}
+
+/**
+ * Find the container of a key
+ * @param index where to store the position of the container, or where
+ *        to insert it
+ * @return 1 if the container exists
+ *         0 otherwise
+ */
+static int roaring_find(const roaring *set, uint16_t key, size_t *index) {
+    size_t first = 0;
+    size_t length = set->count;
+
+    while (length > 0) {
+        size_t half = length / 2;
+
+        if (set->container[first + half].key < key) {
+            first += half + 1;
+            length -= half + 1;
+        } else {
+            length = half;
+        }
+    }
+
+    *index = first;
+    return first < set->count && set->container[first].key == key;
+}
+
+/**
+ * Make room for count containers
+ */
+static int roaring_reserve(roaring *set, size_t count) {
+    roaring_container *container = NULL;
+    size_t size = 0;
+
+    if (count <= set->size) {
+        return 0;
+    }
+
+    size = capacity_grow(&roaring_policy, set->size, count);
+    container = realloc(set->container, size * sizeof(*container));
+    if (container == NULL) {
+        return -1;
+    }
+
+    set->container = container;
+    set->size = size;
+
+    return 0;
+}
+
+/**
+ * Insert an empty array container at index
+ */
+static roaring_container *roaring_insert(roaring *set, size_t index,
+                                         uint16_t key) {
+    roaring_container *container = NULL;
+
+    if (roaring_reserve(set, set->count + 1) != 0) {
+        return NULL;
+    }
+
+    memmove(set->container + index + 1, set->container + index,
+            (set->count - index) * sizeof(*container));
+    set->count++;
+
+    container = &set->container[index];
+    memset(container, 0, sizeof(*container));
+    container->key = key;
+    container->type = ROARING_ARRAY;
+
+    return container;
+}
+
+static void roaring_erase(roaring *set, size_t index) {
+    roaring_container_free(&set->container[index]);
+    memmove(set->container + index, set->container + index + 1,
+            (set->count - index - 1) * sizeof(*(set->container)));
+    set->count--;
+}
+
+roaring *roaring_create() {
+    return calloc(1, sizeof(roaring));
+}
+
+void roaring_delete(roaring *set) {
+    assert(set);
+
+    for (size_t i = 0; i < set->count; i++) {
+        roaring_container_free(&set->container[i]);
+    }
+    free(set->container);
+    free(set);
+}
+
+static int roaring_compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+roaring *roaring_from_arraylist(const arraylist *list) {
+    roaring *set = NULL;
+    uint32_t *value = NULL;
+    size_t count = 0;
+    int sorted = 1;
+
+    assert(list);
+
+    count = list->count;
+    value = malloc((count ? count : 1) * sizeof(*value));
+    if (value == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (list->element[i] < 0) {
+            free(value);
+            errno = EINVAL;
+            return NULL;
+        }
+        value[i] = list->element[i];
+        sorted &= i == 0 || value[i - 1] <= value[i];
+    }
+    if (!sorted) {
+        qsort(value, count, sizeof(*value), roaring_compare);
+    }
+
+    set = roaring_create();
+    if (set == NULL) {
+        free(value);
+        return NULL;
+    }
+
+    for (size_t first = 0; first < count;) {
+        uint16_t key = value[first] >> 16;
+        roaring_container *container = NULL;
+        uint16_t *array = NULL;
+        size_t last = first;
+
+        while (last < count && value[last] >> 16 == key) {
+            last++;
+        }
+
+        /* Built as an array of the distinct values, then encoded */
+        array = malloc((last - first) * sizeof(*array));
+        container = array ? roaring_insert(set, set->count, key) : NULL;
+        if (container == NULL) {
+            free(array);
+            free(value);
+            roaring_delete(set);
+            return NULL;
+        }
+        for (size_t i = first; i < last; i++) {
+            if (i == first || value[i] != value[i - 1]) {
+                array[container->length++] = value[i] & 0xffff;
+            }
+        }
+        container->data.array = array;
+        container->cardinality = container->length;
+        container->capacity = last - first;
+
+        if (roaring_container_encode(container) != 0) {
+            free(value);
+            roaring_delete(set);
+            return NULL;
+        }
+
+        first = last;
+    }
+
+    free(value);
+
+    return set;
+}
+
+static int roaring_append(void *ctx, uint32_t value) {
+    arraylist *list = ctx;
+
+    list->element[list->count++] = value;
+
+    return 0;
+}
+
+arraylist *roaring_to_arraylist(const roaring *set) {
+    arraylist *list = NULL;
+    uint64_t count = 0;
+
+    assert(set);
+
+    if (set->count > 0 && set->container[set->count - 1].key > INT_MAX >> 16) {
+        errno = ERANGE;
+        return NULL;
+    }
+
+    count = roaring_cardinality(set);
+    list = arraylist_create();
+    if (list == NULL) {
+        return NULL;
+    }
+    if (arraylist_reserve(list, count) != 0) {
+        arraylist_delete(list);
+        return NULL;
+    }
+
+    roaring_for_each(set, roaring_append, list);
+
+    return list;
+}
+
+int roaring_add(roaring *set, uint32_t value) {
+    roaring_container *container = NULL;
+    uint16_t low = value & 0xffff;
+    size_t index = 0;
+
+    assert(set);
+
+    if (roaring_find(set, value >> 16, &index)) {
+        container = &set->container[index];
+        if (roaring_container_contains(container, low)) {
+            return 0;
+        }
+        if (roaring_container_decode(container) != 0) {
+            return -1;
+        }
+    } else {
+        container = roaring_insert(set, index, value >> 16);
+        if (container == NULL) {
+            return -1;
+        }
+    }
+
+    if (container->type == ROARING_ARRAY
+        && container->cardinality == ROARING_ARRAY_MAX
+        && roaring_container_to_bitmap(container) != 0) {
+        return -1;
+    }
+
+    if (container->type == ROARING_BITMAP) {
+        container->data.bitmap[low / 64] |= (uint64_t)1 << (low % 64);
+        container->cardinality++;
+        return 0;
+    }
+
+    if (container->length == container->capacity) {
+        size_t capacity = capacity_grow(&roaring_policy, container->capacity,
+                                        container->length + 1);
+        uint16_t *array = NULL;
+
+        if (capacity > ROARING_ARRAY_MAX) {
+            capacity = ROARING_ARRAY_MAX;
+        }
+        array = realloc(container->data.array, capacity * sizeof(*array));
+        if (array == NULL) {
+            if (container->cardinality == 0) {
+                roaring_erase(set, index);
+            }
+            return -1;
+        }
+        container->data.array = array;
+        container->capacity = capacity;
+    }
+
+    uint32_t at = roaring_array_search(container->data.array,
+                                       container->length, low);
+    memmove(container->data.array + at + 1, container->data.array + at,
+            (container->length - at) * sizeof(uint16_t));
+    container->data.array[at] = low;
+    container->length++;
+    container->cardinality++;
+
+    return 0;
+}
+
+int roaring_remove(roaring *set, uint32_t value) {
+    roaring_container *container = NULL;
+    uint16_t low = value & 0xffff;
+    size_t index = 0;
+
+    assert(set);
+
+    if (!roaring_find(set, value >> 16, &index)
+        || !roaring_container_contains(&set->container[index], low)) {
+        return 0;
+    }
+
+    container = &set->container[index];
+    if (container->cardinality == 1) {
+        roaring_erase(set, index);
+        return 1;
+    }
+    if (roaring_container_decode(container) != 0) {
+        return -1;
+    }
+
+    container->cardinality--;
+    if (container->type == ROARING_BITMAP) {
+        container->data.bitmap[low / 64] &= ~((uint64_t)1 << (low % 64));
+
+        /* Keeps the bitmap if the array can't be allocated */
+        if (container->cardinality <= ROARING_ARRAY_MAX) {
+            roaring_container_to_array(container);
+        }
+        return 1;
+    }
+
+    uint32_t at = roaring_array_search(container->data.array,
+                                       container->length, low);
+    memmove(container->data.array + at, container->data.array + at + 1,
+            (container->length - at - 1) * sizeof(uint16_t));
+    container->length--;
+
+    return 1;
+}
+
+int roaring_contains(const roaring *set, uint32_t value) {
+    size_t index = 0;
+
+    assert(set);
+
+    return roaring_find(set, value >> 16, &index)
+        && roaring_container_contains(&set->container[index], value & 0xffff);
+}
+
+uint64_t roaring_cardinality(const roaring *set) {
+    uint64_t cardinality = 0;
+
+    assert(set);
+
+    for (size_t i = 0; i < set->count; i++) {
+        cardinality += set->container[i].cardinality;
+    }
+
+    return cardinality;
+}
+
+size_t roaring_size_in_bytes(const roaring *set) {
+    size_t size = 0;
+
+    assert(set);
+
+    size = sizeof(*set) + set->size * sizeof(*(set->container));
+    for (size_t i = 0; i < set->count; i++) {
+        size += roaring_container_bytes(&set->container[i]);
+    }
+
+    return size;
+}
+
+int roaring_optimize(roaring *set) {
+    assert(set);
+
+    for (size_t i = 0; i < set->count; i++) {
+        if (roaring_container_encode(&set->container[i]) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copy a container with its encoding
+ * @return 0 if the container was copied
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int roaring_container_copy(const roaring_container *container,
+                                  roaring_container *copy) {
+    size_t bytes = roaring_container_bytes(container);
+
+    *copy = *container;
+    copy->data.array = malloc(bytes ? bytes : 1);
+    if (copy->data.array == NULL) {
+        return -1;
+    }
+    memcpy(copy->data.array, container->data.array, bytes);
+
+    return 0;
+}
+
+/**
+ * Compute the union of two array or bitmap containers
+ */
+static int roaring_container_or(const roaring_container *a,
+                                const roaring_container *b,
+                                roaring_container *result) {
+    memset(result, 0, sizeof(*result));
+    result->key = a->key;
+
+    if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY
+        && a->cardinality + b->cardinality <= ROARING_ARRAY_MAX) {
+        uint16_t *array = malloc((a->length + b->length + 1)
+                                 * sizeof(*array));
+        uint32_t i = 0, j = 0, length = 0;
+
+        if (array == NULL) {
+            return -1;
+        }
+        while (i < a->length || j < b->length) {
+            if (j == b->length || (i < a->length
+                                   && a->data.array[i] < b->data.array[j])) {
+                array[length++] = a->data.array[i++];
+            } else if (i == a->length
+                       || b->data.array[j] < a->data.array[i]) {
+                array[length++] = b->data.array[j++];
+            } else {
+                array[length++] = a->data.array[i++];
+                j++;
+            }
+        }
+
+        result->type = ROARING_ARRAY;
+        result->data.array = array;
+        result->length = length;
+        result->cardinality = length;
+        result->capacity = a->length + b->length + 1;
+        return 0;
+    }
+
+    uint64_t *bitmap = calloc(ROARING_BITMAP_WORDS, sizeof(*bitmap));
+    if (bitmap == NULL) {
+        return -1;
+    }
+    result->type = ROARING_BITMAP;
+    result->data.bitmap = bitmap;
+    result->length = ROARING_BITMAP_WORDS;
+    result->capacity = ROARING_BITMAP_WORDS;
+
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        result->cardinality = bitset_words_op(bitmap, a->data.bitmap,
+                                              b->data.bitmap,
+                                              ROARING_BITMAP_WORDS,
+                                              BITSET_OR);
+        return 0;
+    }
+
+    const roaring_container *operands[2] = { a, b };
+    for (int k = 0; k < 2; k++) {
+        const roaring_container *operand = operands[k];
+
+        if (operand->type == ROARING_BITMAP) {
+            memcpy(bitmap, operand->data.bitmap, ROARING_BITMAP_BYTES);
+        }
+    }
+    for (int k = 0; k < 2; k++) {
+        const roaring_container *operand = operands[k];
+
+        for (uint32_t i = 0; operand->type == ROARING_ARRAY
+                             && i < operand->length; i++) {
+            uint16_t low = operand->data.array[i];
+
+            bitmap[low / 64] |= (uint64_t)1 << (low % 64);
+        }
+    }
+    result->cardinality = bitset_words_popcount(bitmap, ROARING_BITMAP_WORDS);
+
+    /* Two arrays with common values may fit an array after all */
+    if (result->cardinality <= ROARING_ARRAY_MAX) {
+        return roaring_container_to_array(result);
+    }
+
+    return 0;
+}
+
+/**
+ * Compute the intersection of two array or bitmap containers
+ */
+static int roaring_container_and(const roaring_container *a,
+                                 const roaring_container *b,
+                                 roaring_container *result) {
+    memset(result, 0, sizeof(*result));
+    result->key = a->key;
+
+    if (a->type == ROARING_BITMAP && b->type == ROARING_BITMAP) {
+        uint64_t *bitmap = malloc(ROARING_BITMAP_BYTES);
+
+        if (bitmap == NULL) {
+            return -1;
+        }
+        result->type = ROARING_BITMAP;
+        result->data.bitmap = bitmap;
+        result->length = ROARING_BITMAP_WORDS;
+        result->capacity = ROARING_BITMAP_WORDS;
+        result->cardinality = bitset_words_op(bitmap, a->data.bitmap,
+                                              b->data.bitmap,
+                                              ROARING_BITMAP_WORDS,
+                                              BITSET_AND);
+        if (result->cardinality <= ROARING_ARRAY_MAX) {
+            return roaring_container_to_array(result);
+        }
+        return 0;
+    }
+
+    /* An array is involved: the result is an array no larger than it */
+    if (a->type == ROARING_BITMAP) {
+        const roaring_container *swap = a;
+        a = b;
+        b = swap;
+    }
+
+    uint16_t *array = malloc((a->length ? a->length : 1) * sizeof(*array));
+    uint32_t length = 0;
+
+    if (array == NULL) {
+        return -1;
+    }
+
+    if (b->type == ROARING_BITMAP) {
+        for (uint32_t i = 0; i < a->length; i++) {
+            uint16_t low = a->data.array[i];
+
+            if (b->data.bitmap[low / 64] >> (low % 64) & 1) {
+                array[length++] = low;
+            }
+        }
+    } else {
+        uint32_t i = 0, j = 0;
+
+        while (i < a->length && j < b->length) {
+            if (a->data.array[i] < b->data.array[j]) {
+                i++;
+            } else if (b->data.array[j] < a->data.array[i]) {
+                j++;
+            } else {
+                array[length++] = a->data.array[i];
+                i++;
+                j++;
+            }
+        }
+    }
+
+    result->type = ROARING_ARRAY;
+    result->data.array = array;
+    result->length = length;
+    result->cardinality = length;
+    result->capacity = a->length ? a->length : 1;
+
+    return 0;
+}
+
+typedef int (*roaring_container_op)(const roaring_container *a,
+                                    const roaring_container *b,
+                                    roaring_container *result);
+
+/**
+ * Apply an operation on two containers of the same key, decoding runs
+ * first
+ */
+static int roaring_combine(const roaring_container *a,
+                           const roaring_container *b,
+                           roaring_container *result,
+                           roaring_container_op op) {
+    roaring_container decoded[2];
+    int rc = 0;
+
+    if (a->type == ROARING_RUN) {
+        if (roaring_container_copy(a, &decoded[0]) != 0) {
+            return -1;
+        }
+        if (roaring_container_decode(&decoded[0]) != 0) {
+            roaring_container_free(&decoded[0]);
+            return -1;
+        }
+        a = &decoded[0];
+    }
+    if (b->type == ROARING_RUN) {
+        if (roaring_container_copy(b, &decoded[1]) != 0
+            || roaring_container_decode(&decoded[1]) != 0) {
+            roaring_container_free(&decoded[1]);
+            if (a == &decoded[0]) {
+                roaring_container_free(&decoded[0]);
+            }
+            return -1;
+        }
+        b = &decoded[1];
+    }
+
+    rc = op(a, b, result);
+
+    if (a == &decoded[0]) {
+        roaring_container_free(&decoded[0]);
+    }
+    if (b == &decoded[1]) {
+        roaring_container_free(&decoded[1]);
+    }
+
+    return rc;
+}
+
+roaring *roaring_or(const roaring *a, const roaring *b) {
+    roaring *set = NULL;
+    size_t i = 0, j = 0;
+
+    assert(a);
+    assert(b);
+
+    set = roaring_create();
+    if (set == NULL || roaring_reserve(set, a->count + b->count) != 0) {
+        free(set);
+        return NULL;
+    }
+
+    while (i < a->count || j < b->count) {
+        roaring_container *result = &set->container[set->count];
+        int rc = 0;
+
+        if (j == b->count || (i < a->count
+                              && a->container[i].key < b->container[j].key)) {
+            rc = roaring_container_copy(&a->container[i++], result);
+        } else if (i == a->count
+                   || b->container[j].key < a->container[i].key) {
+            rc = roaring_container_copy(&b->container[j++], result);
+        } else {
+            rc = roaring_combine(&a->container[i++], &b->container[j++],
+                                 result, roaring_container_or);
+        }
+
+        if (rc != 0) {
+            roaring_delete(set);
+            return NULL;
+        }
+        set->count++;
+    }
+
+    return set;
+}
+
+roaring *roaring_and(const roaring *a, const roaring *b) {
+    roaring *set = NULL;
+    size_t i = 0, j = 0;
+
+    assert(a);
+    assert(b);
+
+    set = roaring_create();
+    if (set == NULL || roaring_reserve(set, a->count < b->count
+                                            ? a->count : b->count) != 0) {
+        free(set);
+        return NULL;
+    }
+
+    while (i < a->count && j < b->count) {
+        roaring_container *result = &set->container[set->count];
+
+        if (a->container[i].key < b->container[j].key) {
+            i++;
+            continue;
+        }
+        if (b->container[j].key < a->container[i].key) {
+            j++;
+            continue;
+        }
+
+        if (roaring_combine(&a->container[i++], &b->container[j++],
+                            result, roaring_container_and) != 0) {
+            roaring_delete(set);
+            return NULL;
+        }
+        if (result->cardinality == 0) {
+            roaring_container_free(result);
+        } else {
+            set->count++;
+        }
+    }
+
+    return set;
+}
+
+int roaring_for_each(const roaring *set, roaring_fn fn, void *ctx) {
+    assert(set);
+    assert(fn);
+
+    for (size_t i = 0; i < set->count; i++) {
+        const roaring_container *container = &set->container[i];
+        uint32_t high = (uint32_t)container->key << 16;
+        int rc = 0;
+
+        switch (container->type) {
+        case ROARING_BITMAP:
+            for (uint32_t word = 0; word < ROARING_BITMAP_WORDS; word++) {
+                uint64_t bits = container->data.bitmap[word];
+
+                while (bits) {
+                    rc = fn(ctx, high | (word * 64 + __builtin_ctzll(bits)));
+                    if (rc) {
+                        return rc;
+                    }
+                    bits &= bits - 1;
+                }
+            }
+            break;
+        case ROARING_RUN:
+            for (uint32_t r = 0; r < container->length; r++) {
+                roaring_run run = container->data.run[r];
+
+                for (uint32_t low = run.start; low <= run.start + run.length;
+                     low++) {
+                    rc = fn(ctx, high | low);
+                    if (rc) {
+                        return rc;
+                    }
+                }
+            }
+            break;
+        default:
+            for (uint32_t k = 0; k < container->length; k++) {
+                rc = fn(ctx, high | container->data.array[k]);
+                if (rc) {
+                    return rc;
+                }
+            }
+            break;
+        }
+    }
+
+    return 0;
+}
+
+#ifdef WITH_TEST
+static arraylist *roaring_test_list(int first, int last, int step) {
+    arraylist *list = arraylist_create();
+
+    for (int value = first; value < last; value += step) {
+        arraylist_insert_last(list, value);
+    }
+
+    return list;
+}
+
+static int roaring_test_check(roaring *set) {
+    uint64_t cardinality = 0;
+
+    for (size_t i = 0; i < set->count; i++) {
+        const roaring_container *container = &set->container[i];
+        uint64_t count = 0;
+
+        if (i > 0 && set->container[i - 1].key >= container->key) {
+            return 0;
+        }
+        switch (container->type) {
+        case ROARING_BITMAP:
+            count = bitset_words_popcount(container->data.bitmap,
+                                          ROARING_BITMAP_WORDS);
+            break;
+        case ROARING_RUN:
+            for (uint32_t r = 0; r < container->length; r++) {
+                count += container->data.run[r].length + 1;
+            }
+            break;
+        default:
+            count = container->length;
+            break;
+        }
+        if (count != container->cardinality || count == 0) {
+            return 0;
+        }
+        cardinality += count;
+    }
+
+    return cardinality == roaring_cardinality(set);
+}
+
+Test(Roaring, add_remove) {
+    roaring *set = roaring_create();
+
+    cr_assert(set);
+    cr_assert_not(roaring_contains(set, 5));
+
+    /* Crosses the array to bitmap threshold both ways */
+    for (uint32_t i = 0; i < 5000; i++) {
+        cr_assert(roaring_add(set, 70000 + i * 3) == 0);
+    }
+    cr_assert(roaring_add(set, 70000) == 0);
+    cr_assert(roaring_add(set, 7) == 0);
+    cr_assert(roaring_cardinality(set) == 5001);
+    cr_assert(set->count == 2);
+    cr_assert(set->container[1].type == ROARING_BITMAP);
+    cr_assert(roaring_test_check(set));
+
+    cr_assert(roaring_contains(set, 70003));
+    cr_assert_not(roaring_contains(set, 70004));
+    cr_assert(roaring_remove(set, 70004) == 0);
+
+    for (uint32_t i = 0; i < 2000; i++) {
+        cr_assert(roaring_remove(set, 70000 + i * 3) == 1);
+    }
+    cr_assert(set->container[1].type == ROARING_ARRAY);
+    cr_assert(roaring_remove(set, 7) == 1);
+    cr_assert(set->count == 1);
+    cr_assert(roaring_test_check(set));
+
+    roaring_delete(set);
+}
+
+Test(Roaring, encodings) {
+    arraylist *dense = roaring_test_list(0, 200000, 1);
+    arraylist *sparse = roaring_test_list(0, 2000000, 1000);
+    arraylist *half = roaring_test_list(0, 65536, 2);
+    arraylist *back = NULL;
+    roaring *set = NULL;
+
+    set = roaring_from_arraylist(dense);
+    cr_assert(set);
+    cr_assert(set->count == 4);
+    cr_assert(set->container[0].type == ROARING_RUN);
+    cr_assert(roaring_size_in_bytes(set) < 200);
+    cr_assert(roaring_cardinality(set) == 200000);
+    cr_assert(roaring_contains(set, 199999));
+    cr_assert_not(roaring_contains(set, 200000));
+    cr_assert(roaring_test_check(set));
+
+    /* Adding to runs decodes them, roaring_optimize encodes them back */
+    cr_assert(roaring_add(set, 200001) == 0);
+    cr_assert(set->container[3].type == ROARING_ARRAY);
+    cr_assert(roaring_optimize(set) == 0);
+    cr_assert(set->container[3].type == ROARING_RUN);
+    cr_assert(set->container[3].length == 2);
+    cr_assert(roaring_remove(set, 100) == 1);
+    cr_assert(roaring_test_check(set));
+    roaring_delete(set);
+
+    set = roaring_from_arraylist(sparse);
+    cr_assert(set->container[0].type == ROARING_ARRAY);
+    back = roaring_to_arraylist(set);
+    cr_assert(arraylist_count(back) == arraylist_count(sparse));
+    for (size_t i = 0; i < sparse->count; i++) {
+        cr_assert(back->element[i] == sparse->element[i]);
+    }
+    arraylist_delete(back);
+    roaring_delete(set);
+
+    set = roaring_from_arraylist(half);
+    cr_assert(set->container[0].type == ROARING_BITMAP);
+    cr_assert(roaring_size_in_bytes(set) < ROARING_BITMAP_BYTES + 100);
+    roaring_delete(set);
+
+    arraylist_insert_last(half, -3);
+    cr_assert(roaring_from_arraylist(half) == NULL);
+    cr_assert(errno == EINVAL);
+
+    arraylist_delete(dense);
+    arraylist_delete(sparse);
+    arraylist_delete(half);
+}
+
+Test(Roaring, or_and) {
+    /* Multiples of 3 and 5 over dense, sparse and run containers */
+    arraylist *threes = roaring_test_list(0, 300000, 3);
+    arraylist *fives = roaring_test_list(0, 500000, 5);
+    arraylist *run = roaring_test_list(100000, 400000, 1);
+    roaring *a = roaring_from_arraylist(threes);
+    roaring *b = roaring_from_arraylist(fives);
+    roaring *c = roaring_from_arraylist(run);
+    roaring *result = NULL;
+
+    result = roaring_or(a, b);
+    cr_assert(roaring_cardinality(result) == 100000 + 100000 - 20000);
+    cr_assert(roaring_contains(result, 499995));
+    cr_assert(roaring_test_check(result));
+    roaring_delete(result);
+
+    result = roaring_and(a, b);
+    cr_assert(roaring_cardinality(result) == 20000);
+    cr_assert(roaring_contains(result, 15) && !roaring_contains(result, 5));
+    cr_assert(roaring_test_check(result));
+    roaring_delete(result);
+
+    result = roaring_and(a, c);
+    cr_assert(roaring_cardinality(result) == 200000 / 3);
+    cr_assert(roaring_test_check(result));
+    roaring_delete(result);
+
+    result = roaring_or(b, c);
+    cr_assert(roaring_cardinality(result) == 300000 + 20000 + 20000);
+    cr_assert(roaring_test_check(result));
+    roaring_delete(result);
+
+    roaring_delete(a);
+    roaring_delete(b);
+    roaring_delete(c);
+    arraylist_delete(threes);
+    arraylist_delete(fives);
+    arraylist_delete(run);
+}
+
+static int roaring_test_stop(void *ctx, uint32_t value) {
+    uint32_t *seen = ctx;
+
+    *seen = value;
+    return value >= 1000 ? 2 : 0;
+}
+
+Test(Roaring, for_each) {
+    arraylist *list = roaring_test_list(990, 1010, 1);
+    roaring *set = roaring_from_arraylist(list);
+    uint32_t seen = 0;
+
+    cr_assert(roaring_for_each(set, roaring_test_stop, &seen) == 2);
+    cr_assert(seen == 1000);
+
+    roaring_delete(set);
+    arraylist_delete(list);
+}
+#endif
@@ -0,0 +1,852 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "woofi/serial.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+/*
+ * Fletcher sums are reduced modulo 2^32 - 1 every SERIAL_CHECKSUM_BLOCK
+ * words, the largest block for which b cannot overflow 64 bits.
+ */
+#define SERIAL_CHECKSUM_MODULO 0xffffffffu
+#define SERIAL_CHECKSUM_BLOCK 32768
+
+typedef struct {
+    uint64_t a;
+    uint64_t b;
+} serial_checksum;
+
+/**
+ * Add 32 bits words to a Fletcher-64 checksum
+ * @param sum a non null pointer to the checksum
+ * @param data the words to add
+ * @param count the number of words
+ */
+static void serial_checksum_update(serial_checksum *sum,
+                                   const uint32_t *data, size_t count) {
+    uint64_t a = sum->a;
+    uint64_t b = sum->b;
+
+    while (count > 0) {
+        size_t block = count < SERIAL_CHECKSUM_BLOCK
+            ? count : SERIAL_CHECKSUM_BLOCK;
+
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= SERIAL_CHECKSUM_MODULO;
+        b %= SERIAL_CHECKSUM_MODULO;
+
+        data += block;
+        count -= block;
+    }
+
+    sum->a = a;
+    sum->b = b;
+}
+
+static uint64_t serial_checksum_value(const serial_checksum *sum) {
+    return (sum->b << 32) | sum->a;
+}
+
+/**
+ * Add a header to a Fletcher-64 checksum
+ * @param sum a non null pointer to the checksum
+ * @param header the header to add
+ */
+static void serial_checksum_header(serial_checksum *sum,
+                                   const serial_header *header) {
+    uint32_t words[sizeof(*header) / sizeof(uint32_t)];
+
+    memcpy(words, header, sizeof(words));
+    serial_checksum_update(sum, words, sizeof(words) / sizeof(*words));
+}
+
+/**
+ * Write the whole buffer to the sink, retrying on partial writes
+ * @return 0 if everything was written
+ *        -1 on error (see errno)
+ */
+static int serial_write_all(const serial_sink *sink,
+                            const void *buffer, size_t size) {
+    const char *data = buffer;
+
+    while (size > 0) {
+        ssize_t written = sink->write
+            ? sink->write(sink->ctx, data, size)
+            : write(sink->fd, data, size);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        /* Retrying a sink which takes nothing would never end */
+        if (written == 0) {
+            errno = EIO;
+            return -1;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+/**
+ * Fill the whole buffer from the source, retrying on partial reads
+ * @return 0 if the buffer was filled
+ *        -1 on error (see errno), EBADMSG if the stream ended first
+ */
+static int serial_read_all(const serial_source *source,
+                           void *buffer, size_t size) {
+    char *data = buffer;
+
+    while (size > 0) {
+        ssize_t got = source->read
+            ? source->read(source->ctx, data, size)
+            : read(source->fd, data, size);
+
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (got == 0) {
+            errno = EBADMSG;
+            return -1;
+        }
+
+        data += got;
+        size -= got;
+    }
+
+    return 0;
+}
+
+/**
+ * Write a container made of up to two segments of elements
+ * @return 0 if the container was written
+ *        -1 on error (see errno)
+ */
+static int serial_write(const serial_sink *sink, serial_type type,
+                        uint64_t capacity,
+                        const int *first, size_t first_count,
+                        const int *second, size_t second_count) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+    uint64_t checksum;
+
+    assert(sink);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = SERIAL_MAGIC;
+    header.version = SERIAL_VERSION;
+    header.type = type;
+    header.count = first_count + second_count;
+    header.capacity = capacity;
+
+    serial_checksum_header(&sum, &header);
+    serial_checksum_update(&sum, (const uint32_t *)first, first_count);
+    serial_checksum_update(&sum, (const uint32_t *)second, second_count);
+    checksum = serial_checksum_value(&sum);
+
+    if (serial_write_all(sink, &header, sizeof(header)) == -1
+        || serial_write_all(sink, first, first_count * sizeof(int)) == -1
+        || serial_write_all(sink, second, second_count * sizeof(int)) == -1
+        || serial_write_all(sink, &checksum, sizeof(checksum)) == -1) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Read and check the header of a container
+ * @return 0 if the header is valid for the requested type
+ *        -1 on error (see errno)
+ */
+static int serial_read_header(const serial_source *source, serial_type type,
+                              serial_header *header, serial_checksum *sum) {
+    assert(source);
+
+    if (serial_read_all(source, header, sizeof(*header)) == -1) {
+        return -1;
+    }
+
+    if (header->magic != SERIAL_MAGIC
+        || header->version != SERIAL_VERSION
+        || header->type != type
+        || header->count >= SIZE_MAX / sizeof(int)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    serial_checksum_header(sum, header);
+
+    return 0;
+}
+
+/**
+ * Read the elements of a container in place and check the checksum
+ * @return 0 if the elements were read
+ *        -1 on error (see errno)
+ */
+static int serial_read_elements(const serial_source *source,
+                                serial_checksum *sum,
+                                int *element, size_t count) {
+    uint64_t checksum;
+
+    if (serial_read_all(source, element, count * sizeof(int)) == -1
+        || serial_read_all(source, &checksum, sizeof(checksum)) == -1) {
+        return -1;
+    }
+
+    serial_checksum_update(sum, (const uint32_t *)element, count);
+    if (checksum != serial_checksum_value(sum)) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+int serial_write_arraylist(const serial_sink *sink, const arraylist *list) {
+    assert(list);
+
+    return serial_write(sink, SERIAL_ARRAYLIST, list->length,
+                        list->element, list->count, NULL, 0);
+}
+
+int serial_write_stack(const serial_sink *sink, const stack *stack) {
+    assert(stack);
+
+    return serial_write(sink, SERIAL_STACK, stack->size,
+                        stack->element, stack->head, NULL, 0);
+}
+
+int serial_write_circularqueue(const serial_sink *sink,
+                               const circularqueue *queue) {
+    assert(queue);
+
+    if (queue->tail < queue->head) {
+        return serial_write(sink, SERIAL_CIRCULARQUEUE, queue->requested_size,
+                            queue->element + queue->head,
+                            queue->size - queue->head,
+                            queue->element, queue->tail);
+    }
+
+    return serial_write(sink, SERIAL_CIRCULARQUEUE, queue->requested_size,
+                        queue->element + queue->head,
+                        queue->tail - queue->head, NULL, 0);
+}
+
+arraylist *serial_read_arraylist(const serial_source *source) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+
+    if (serial_read_header(source, SERIAL_ARRAYLIST, &header, &sum) == -1) {
+        return NULL;
+    }
+
+    arraylist *list = arraylist_create();
+    if (list == NULL) {
+        return NULL;
+    }
+
+    if (arraylist_reserve(list, header.count) == -1
+        || serial_read_elements(source, &sum, list->element,
+                                header.count) == -1) {
+        int error = errno;
+        arraylist_delete(list);
+        errno = error;
+        return NULL;
+    }
+    list->count = header.count;
+
+    return list;
+}
+
+stack *serial_read_stack(const serial_source *source) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+
+    if (serial_read_header(source, SERIAL_STACK, &header, &sum) == -1) {
+        return NULL;
+    }
+
+    stack *stack = stack_create();
+    if (stack == NULL) {
+        return NULL;
+    }
+
+    if (stack_reserve(stack, header.count) == -1
+        || serial_read_elements(source, &sum, stack->element,
+                                header.count) == -1) {
+        int error = errno;
+        stack_delete(stack);
+        errno = error;
+        return NULL;
+    }
+    stack->head = header.count;
+
+    return stack;
+}
+
+circularqueue *serial_read_circularqueue(const serial_source *source) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+
+    if (serial_read_header(source, SERIAL_CIRCULARQUEUE,
+                           &header, &sum) == -1) {
+        return NULL;
+    }
+    if (header.capacity != 0 && header.count >= header.capacity) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    circularqueue *queue = circularqueue_create(header.capacity);
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    if (circularqueue_reserve(queue, header.count) == -1
+        || serial_read_elements(source, &sum, queue->element,
+                                header.count) == -1) {
+        int error = errno;
+        circularqueue_delete(queue);
+        errno = error;
+        return NULL;
+    }
+    queue->head = 0;
+    queue->tail = header.count;
+
+    return queue;
+}
+
+/* Key and type, cardinality and length words before a container's data */
+#define SERIAL_ROARING_DESCRIPTOR 3
+/* Data words of the largest container, a bitmap */
+#define SERIAL_ROARING_MAX_WORDS (ROARING_BITMAP_WORDS * 2)
+/* Run containers are only used when smaller than a bitmap */
+#define SERIAL_ROARING_MAX_RUNS \
+    (ROARING_BITMAP_WORDS * sizeof(uint64_t) / sizeof(roaring_run))
+
+/**
+ * Number of 32 bits words holding the data of a roaring container
+ */
+static size_t serial_roaring_words(uint16_t type, uint32_t length) {
+    switch (type) {
+    case ROARING_BITMAP:
+        return ROARING_BITMAP_WORDS * 2;
+    case ROARING_RUN:
+        return length;
+    default:
+        return (length + 1) / 2;
+    }
+}
+
+int serial_write_roaring(const serial_sink *sink, const roaring *set) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+    uint32_t *buffer = NULL;
+    uint64_t checksum;
+    int rc = 0;
+
+    assert(sink);
+    assert(set);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = SERIAL_MAGIC;
+    header.version = SERIAL_VERSION;
+    header.type = SERIAL_ROARING;
+    header.capacity = set->count;
+    for (size_t i = 0; i < set->count; i++) {
+        header.count += SERIAL_ROARING_DESCRIPTOR
+            + serial_roaring_words(set->container[i].type,
+                                   set->container[i].length);
+    }
+
+    buffer = malloc((SERIAL_ROARING_DESCRIPTOR + SERIAL_ROARING_MAX_WORDS)
+                    * sizeof(*buffer));
+    if (buffer == NULL) {
+        return -1;
+    }
+
+    serial_checksum_header(&sum, &header);
+    rc = serial_write_all(sink, &header, sizeof(header));
+
+    /* Each container is staged in buffer as 32 bits words */
+    for (size_t i = 0; rc == 0 && i < set->count; i++) {
+        const roaring_container *container = &set->container[i];
+        size_t words = serial_roaring_words(container->type,
+                                            container->length);
+        size_t bytes = container->type == ROARING_ARRAY
+            ? container->length * sizeof(uint16_t) : words * sizeof(uint32_t);
+
+        buffer[0] = container->key | (uint32_t)container->type << 16;
+        buffer[1] = container->cardinality;
+        buffer[2] = container->length;
+        buffer[SERIAL_ROARING_DESCRIPTOR + words - 1] = 0;
+        memcpy(buffer + SERIAL_ROARING_DESCRIPTOR, container->data.array,
+               bytes);
+
+        serial_checksum_update(&sum, buffer,
+                               SERIAL_ROARING_DESCRIPTOR + words);
+        rc = serial_write_all(sink, buffer, (SERIAL_ROARING_DESCRIPTOR + words)
+                                            * sizeof(*buffer));
+    }
+
+    if (rc == 0) {
+        checksum = serial_checksum_value(&sum);
+        rc = serial_write_all(sink, &checksum, sizeof(checksum));
+    }
+
+    int error = errno;
+    free(buffer);
+    errno = error;
+
+    return rc;
+}
+
+/**
+ * Check that the data of a roaring container matches its cardinality
+ * @return 1 if the container is well formed
+ *         0 otherwise
+ */
+static int serial_roaring_valid(const roaring_container *container) {
+    uint64_t count = 0;
+
+    switch (container->type) {
+    case ROARING_BITMAP:
+        for (size_t i = 0; i < ROARING_BITMAP_WORDS; i++) {
+            count += __builtin_popcountll(container->data.bitmap[i]);
+        }
+        break;
+    case ROARING_RUN:
+        for (uint32_t i = 0; i < container->length; i++) {
+            roaring_run run = container->data.run[i];
+
+            if ((uint32_t)run.start + run.length > UINT16_MAX
+                || (i > 0 && run.start <= container->data.run[i - 1].start
+                                          + container->data.run[i - 1].length
+                                          + 1)) {
+                return 0;
+            }
+            count += run.length + 1;
+        }
+        break;
+    default:
+        for (uint32_t i = 1; i < container->length; i++) {
+            if (container->data.array[i] <= container->data.array[i - 1]) {
+                return 0;
+            }
+        }
+        count = container->length;
+        break;
+    }
+
+    return count == container->cardinality;
+}
+
+/**
+ * Read the next container of a roaring set
+ * @param buffer room for the largest container
+ * @param words the number of words read so far, updated
+ * @param limit the number of words announced by the header
+ * @return 0 if the container was read
+ *        -1 on error (see errno)
+ */
+static int serial_read_roaring_container(const serial_source *source,
+                                         serial_checksum *sum,
+                                         uint32_t *buffer,
+                                         roaring_container *container,
+                                         uint64_t *words, uint64_t limit) {
+    uint16_t type = 0;
+    uint32_t length = 0;
+    size_t count = 0;
+    size_t bytes = 0;
+
+    if (serial_read_all(source, buffer, SERIAL_ROARING_DESCRIPTOR
+                                        * sizeof(*buffer)) == -1) {
+        return -1;
+    }
+
+    memset(container, 0, sizeof(*container));
+    type = buffer[0] >> 16;
+    length = buffer[2];
+    container->key = buffer[0] & 0xffff;
+    container->type = type;
+    container->cardinality = buffer[1];
+    container->length = length;
+
+    if (container->cardinality == 0 || container->cardinality > 65536
+        || (type == ROARING_ARRAY && (length != container->cardinality
+                                      || length > ROARING_ARRAY_MAX))
+        || (type == ROARING_BITMAP && length != ROARING_BITMAP_WORDS)
+        || (type == ROARING_RUN && length == 0)
+        || type < ROARING_ARRAY || type > ROARING_RUN) {
+        errno = EBADMSG;
+        return -1;
+    }
+    /* More runs would not fit in the buffer */
+    if (type == ROARING_RUN && length >= SERIAL_ROARING_MAX_RUNS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    count = serial_roaring_words(type, length);
+    *words += SERIAL_ROARING_DESCRIPTOR + count;
+    if (*words > limit) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (serial_read_all(source, buffer + SERIAL_ROARING_DESCRIPTOR,
+                        count * sizeof(*buffer)) == -1) {
+        return -1;
+    }
+    serial_checksum_update(sum, buffer, SERIAL_ROARING_DESCRIPTOR + count);
+
+    bytes = type == ROARING_ARRAY ? length * sizeof(uint16_t)
+                                  : count * sizeof(uint32_t);
+    container->capacity = type == ROARING_RUN ? length
+        : type == ROARING_BITMAP ? ROARING_BITMAP_WORDS : length;
+    container->data.array = malloc(bytes);
+    if (container->data.array == NULL) {
+        return -1;
+    }
+    memcpy(container->data.array, buffer + SERIAL_ROARING_DESCRIPTOR, bytes);
+
+    if (!serial_roaring_valid(container)) {
+        free(container->data.array);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+roaring *serial_read_roaring(const serial_source *source) {
+    serial_checksum sum = { 0, 0 };
+    serial_header header;
+    uint32_t *buffer = NULL;
+    uint64_t words = 0;
+    uint64_t checksum;
+    int rc = 0;
+
+    if (serial_read_header(source, SERIAL_ROARING, &header, &sum) == -1) {
+        return NULL;
+    }
+    if (header.capacity > 65536) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    roaring *set = roaring_create();
+    if (set == NULL) {
+        return NULL;
+    }
+
+    buffer = malloc((SERIAL_ROARING_DESCRIPTOR + SERIAL_ROARING_MAX_WORDS)
+                    * sizeof(*buffer));
+    set->container = malloc((header.capacity ? header.capacity : 1)
+                            * sizeof(*(set->container)));
+    if (buffer == NULL || set->container == NULL) {
+        rc = -1;
+    }
+    set->size = header.capacity;
+
+    for (size_t i = 0; rc == 0 && i < header.capacity; i++) {
+        roaring_container *container = &set->container[i];
+
+        rc = serial_read_roaring_container(source, &sum, buffer, container,
+                                           &words, header.count);
+        if (rc == 0) {
+            set->count++;
+            if (i > 0 && container->key <= container[-1].key) {
+                errno = EBADMSG;
+                rc = -1;
+            }
+        }
+    }
+
+    if (rc == 0 && words != header.count) {
+        errno = EBADMSG;
+        rc = -1;
+    }
+    if (rc == 0) {
+        rc = serial_read_all(source, &checksum, sizeof(checksum));
+    }
+    if (rc == 0 && checksum != serial_checksum_value(&sum)) {
+        errno = EBADMSG;
+        rc = -1;
+    }
+
+    int error = errno;
+    free(buffer);
+    if (rc == -1) {
+        roaring_delete(set);
+        errno = error;
+        return NULL;
+    }
+
+    return set;
+}
+
+#ifdef WITH_TEST
+typedef struct {
+    char *data;
+    size_t size;
+    size_t length;
+    size_t offset;
+} serial_test_buffer;
+
+static ssize_t serial_test_write(void *ctx, const void *buffer, size_t size) {
+    serial_test_buffer *memory = ctx;
+
+    if (memory->length + size > memory->size) {
+        memory->size = (memory->length + size) * 2;
+        memory->data = realloc(memory->data, memory->size);
+    }
+    memcpy(memory->data + memory->length, buffer, size);
+    memory->length += size;
+
+    return size;
+}
+
+/* Return at most 7 bytes at once to exercise partial reads */
+static ssize_t serial_test_read(void *ctx, void *buffer, size_t size) {
+    serial_test_buffer *memory = ctx;
+    size_t left = memory->length - memory->offset;
+
+    if (size > left) {
+        size = left;
+    }
+    if (size > 7) {
+        size = 7;
+    }
+    memcpy(buffer, memory->data + memory->offset, size);
+    memory->offset += size;
+
+    return size;
+}
+
+static ssize_t serial_test_stall(void *ctx, const void *buffer, size_t size) {
+    (void)ctx;
+    (void)buffer;
+    (void)size;
+
+    return 0;
+}
+
+Test(Serial, arraylist) {
+    serial_test_buffer memory = { NULL, 0, 0, 0 };
+    serial_sink sink = { -1, serial_test_write, &memory };
+    serial_source source = { -1, serial_test_read, &memory };
+    arraylist *list = arraylist_create();
+
+    for (int i = 0; i < 1000; i++) {
+        arraylist_insert_last(list, i * 3);
+    }
+    cr_assert(serial_write_arraylist(&sink, list) == 0);
+    cr_assert(memory.length == sizeof(serial_header) + 1000 * sizeof(int) + 8);
+
+    arraylist *copy = serial_read_arraylist(&source);
+    cr_assert(copy);
+    cr_assert(arraylist_count(copy) == 1000);
+    for (int i = 0; i < 1000; i++) {
+        cr_assert(arraylist_fast_get(copy, i) == i * 3);
+    }
+
+    arraylist_delete(copy);
+    arraylist_delete(list);
+    free(memory.data);
+}
+
+Test(Serial, stack) {
+    serial_test_buffer memory = { NULL, 0, 0, 0 };
+    serial_sink sink = { -1, serial_test_write, &memory };
+    serial_source source = { -1, serial_test_read, &memory };
+    stack *original = stack_create();
+
+    stack_insert(original, 42);
+    stack_insert(original, 24);
+    cr_assert(serial_write_stack(&sink, original) == 0);
+
+    stack *copy = serial_read_stack(&source);
+    cr_assert(copy);
+    cr_assert(stack_count(copy) == 2);
+    cr_assert(stack_head(copy) == 24);
+    stack_remove(copy);
+    cr_assert(stack_head(copy) == 42);
+
+    stack_delete(copy);
+    stack_delete(original);
+    free(memory.data);
+}
+
+Test(Serial, circularqueue_wrapped) {
+    serial_test_buffer memory = { NULL, 0, 0, 0 };
+    serial_sink sink = { -1, serial_test_write, &memory };
+    serial_source source = { -1, serial_test_read, &memory };
+    circularqueue *queue = circularqueue_create(10);
+
+    for (int i = 0; i < 8; i++) {
+        circularqueue_insert(queue, i);
+    }
+    for (int i = 0; i < 6; i++) {
+        circularqueue_remove(queue);
+    }
+    for (int i = 8; i < 14; i++) {
+        circularqueue_insert(queue, i);
+    }
+    cr_assert(queue->tail < queue->head);
+    cr_assert(serial_write_circularqueue(&sink, queue) == 0);
+
+    circularqueue *copy = serial_read_circularqueue(&source);
+    cr_assert(copy);
+    cr_assert(copy->requested_size == 10);
+    cr_assert(circularqueue_count(copy) == 8);
+    for (int i = 6; i < 14; i++) {
+        cr_assert(circularqueue_head(copy) == i);
+        circularqueue_remove(copy);
+    }
+
+    circularqueue_delete(copy);
+    circularqueue_delete(queue);
+    free(memory.data);
+}
+
+Test(Serial, fd) {
+    char path[] = "/tmp/woofi-serial-XXXXXX";
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+    serial_sink sink = { fd, NULL, NULL };
+    serial_source source = { fd, NULL, NULL };
+    arraylist *list = arraylist_create();
+
+    for (int i = 0; i < 100000; i++) {
+        arraylist_insert_last(list, -i);
+    }
+    cr_assert(serial_write_arraylist(&sink, list) == 0);
+    cr_assert(serial_write_arraylist(&sink, list) == 0);
+    lseek(fd, 0, SEEK_SET);
+
+    for (int n = 0; n < 2; n++) {
+        arraylist *copy = serial_read_arraylist(&source);
+        cr_assert(copy);
+        cr_assert(arraylist_count(copy) == 100000);
+        cr_assert(arraylist_fast_get(copy, 99999) == -99999);
+        arraylist_delete(copy);
+    }
+
+    arraylist_delete(list);
+    close(fd);
+    unlink(path);
+}
+
+Test(Serial, stalled_sink) {
+    serial_sink sink = { -1, serial_test_stall, NULL };
+    stack *stack = stack_create();
+
+    stack_insert(stack, 42);
+    cr_assert(serial_write_stack(&sink, stack) == -1);
+    cr_assert(errno == EIO);
+
+    stack_delete(stack);
+}
+
+Test(Serial, corrupted) {
+    serial_test_buffer memory = { NULL, 0, 0, 0 };
+    serial_sink sink = { -1, serial_test_write, &memory };
+    serial_source source = { -1, serial_test_read, &memory };
+    arraylist *list = arraylist_create();
+
+    arraylist_insert_last(list, 42);
+    arraylist_insert_last(list, 24);
+    serial_write_arraylist(&sink, list);
+
+    memory.data[sizeof(serial_header)] ^= 1;
+    cr_assert(serial_read_arraylist(&source) == NULL);
+    cr_assert(errno == EBADMSG);
+
+    memory.offset = 0;
+    cr_assert(serial_read_stack(&source) == NULL);
+    cr_assert(errno == EINVAL);
+
+    memory.offset = 0;
+    memory.length -= 4;
+    memory.data[sizeof(serial_header)] ^= 1;
+    cr_assert(serial_read_arraylist(&source) == NULL);
+    cr_assert(errno == EBADMSG);
+
+    arraylist_delete(list);
+    free(memory.data);
+}
+
+Test(Serial, roaring) {
+    serial_test_buffer memory = { NULL, 0, 0, 0 };
+    serial_sink sink = { -1, serial_test_write, &memory };
+    serial_source source = { -1, serial_test_read, &memory };
+    arraylist *list = arraylist_create();
+    roaring *set = NULL;
+
+    /* Run, bitmap and odd sized array containers */
+    for (int i = 0; i < 70000; i++) {
+        arraylist_insert_last(list, i);
+    }
+    for (int i = 0; i < 10000; i++) {
+        arraylist_insert_last(list, 131072 + i * 3);
+    }
+    for (int i = 0; i < 11; i++) {
+        arraylist_insert_last(list, 262144 + i * 7);
+    }
+    set = roaring_from_arraylist(list);
+    cr_assert(set->count == 4);
+    cr_assert(serial_write_roaring(&sink, set) == 0);
+
+    roaring *copy = serial_read_roaring(&source);
+    cr_assert(copy);
+    cr_assert(copy->count == 4);
+    cr_assert(roaring_cardinality(copy) == 80011);
+    for (size_t i = 0; i < list->count; i++) {
+        cr_assert(roaring_contains(copy, list->element[i]));
+    }
+    cr_assert_not(roaring_contains(copy, 131073));
+    for (size_t i = 0; i < 4; i++) {
+        cr_assert(copy->container[i].type == set->container[i].type);
+    }
+
+    /* Any flipped byte is detected */
+    memory.offset = 0;
+    memory.data[sizeof(serial_header) + 8] ^= 1;
+    cr_assert(serial_read_roaring(&source) == NULL);
+    cr_assert(errno == EBADMSG);
+
+    /* A run container larger than a bitmap is refused before reading it */
+    uint32_t runs = 4000;
+    memory.offset = 0;
+    cr_assert(set->container[0].type == ROARING_RUN);
+    memcpy(memory.data + sizeof(serial_header) + 8, &runs, sizeof(runs));
+    cr_assert(serial_read_roaring(&source) == NULL);
+    cr_assert(errno == EINVAL);
+
+    roaring_delete(copy);
+    roaring_delete(set);
+    arraylist_delete(list);
+    free(memory.data);
+}
+#endif
@@ -0,0 +1,496 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "woofi/shmqueue.h"
+#ifdef WITH_TEST
+# include <signal.h>
+# include <stdio.h>
+# include <sys/wait.h>
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Check that a segment holds a queue this build can use
+ * @param header the header at the start of the mapping
+ * @param length the size of the mapping
+ * @return 1 if the header is valid
+ *         0 otherwise
+ */
+static int shmqueue_valid(const shmqueue_header *header, size_t length) {
+    if (header->magic != SHMQUEUE_MAGIC
+        || header->version != SHMQUEUE_VERSION
+        || header->element_size != sizeof(int)) {
+        return 0;
+    }
+
+    if (header->size == 0 || (header->size & (header->size - 1))
+        || header->size > (length - sizeof(*header)) / sizeof(int)
+        || header->tail - header->head > header->size) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Map a segment and create the handle on it
+ * @return A pointer to a queue or NULL on error (see errno), the header
+ *         is not checked
+ */
+static shmqueue *shmqueue_map(int fd, size_t length) {
+    shmqueue *queue = malloc(sizeof(*queue));
+    void *map = NULL;
+
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        int error = errno;
+        free(queue);
+        errno = error;
+        return NULL;
+    }
+
+    queue->header = map;
+    queue->element = (int *)((char *)map + sizeof(shmqueue_header));
+    queue->length = length;
+
+    return queue;
+}
+
+/**
+ * Cache the positions and the mask once the header is known to be valid
+ */
+static void shmqueue_load(shmqueue *queue) {
+    queue->mask = queue->header->size - 1;
+    queue->cached_head = __atomic_load_n(&queue->header->head,
+                                         __ATOMIC_ACQUIRE);
+    queue->cached_tail = __atomic_load_n(&queue->header->tail,
+                                         __ATOMIC_ACQUIRE);
+}
+
+shmqueue *shmqueue_create(const char *name, size_t size) {
+    shmqueue *queue = NULL;
+    size_t slots = 1;
+    size_t length;
+    int fd;
+
+    assert(name);
+
+    if (size == 0 || size > (SIZE_MAX - sizeof(shmqueue_header))
+                            / sizeof(int) / 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+    while (slots < size) {
+        slots <<= 1;
+    }
+    length = sizeof(shmqueue_header) + slots * sizeof(int);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (ftruncate(fd, length) == -1 || !(queue = shmqueue_map(fd, length))) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = error;
+        return NULL;
+    }
+    close(fd);
+
+    /* The segment is zeroed, only the constants are left */
+    queue->header->size = slots;
+    queue->header->element_size = sizeof(int);
+    queue->header->version = SHMQUEUE_VERSION;
+    __atomic_store_n(&queue->header->magic, SHMQUEUE_MAGIC, __ATOMIC_RELEASE);
+    shmqueue_load(queue);
+
+    return queue;
+}
+
+shmqueue *shmqueue_attach(const char *name) {
+    shmqueue *queue = NULL;
+    struct stat st;
+    int fd;
+
+    assert(name);
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(shmqueue_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    queue = shmqueue_map(fd, st.st_size);
+    close(fd);
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (__atomic_load_n(&queue->header->magic, __ATOMIC_ACQUIRE)
+            != SHMQUEUE_MAGIC
+        || !shmqueue_valid(queue->header, queue->length)) {
+        shmqueue_detach(queue);
+        errno = EINVAL;
+        return NULL;
+    }
+    shmqueue_load(queue);
+
+    return queue;
+}
+
+void shmqueue_detach(shmqueue *queue) {
+    assert(queue);
+
+    munmap(queue->header, queue->length);
+    free(queue);
+}
+
+int shmqueue_unlink(const char *name) {
+    assert(name);
+
+    return shm_unlink(name);
+}
+
+/**
+ * Wake the other side if it sleeps on a futex. The position was
+ * published with a seq_cst store, so either the sleeper sees it or this
+ * sees the sleeper.
+ */
+static void shmqueue_signal(uint32_t *futex, uint32_t *waiting) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_add(futex, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+size_t shmqueue_insert_range(shmqueue *queue, const int *values,
+                             size_t count) {
+    shmqueue_header *header = NULL;
+    uint64_t tail;
+    size_t offset;
+    size_t first;
+
+    assert(queue);
+    assert(values || count == 0);
+
+    header = queue->header;
+    tail = __atomic_load_n(&header->tail, __ATOMIC_RELAXED);
+    if (tail - queue->cached_head + count > header->size) {
+        queue->cached_head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+        if (tail - queue->cached_head + count > header->size) {
+            count = header->size - (tail - queue->cached_head);
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    offset = tail & queue->mask;
+    first = header->size - offset < count ? header->size - offset : count;
+    memcpy(queue->element + offset, values, first * sizeof(int));
+    memcpy(queue->element, values + first, (count - first) * sizeof(int));
+
+    __atomic_store_n(&header->tail, tail + count, __ATOMIC_SEQ_CST);
+    shmqueue_signal(&header->readable, &header->consumer_waiting);
+
+    return count;
+}
+
+int shmqueue_insert(shmqueue *queue, int value) {
+    if (shmqueue_insert_range(queue, &value, 1) == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return 0;
+}
+
+size_t shmqueue_remove_range(shmqueue *queue, int *values, size_t count) {
+    shmqueue_header *header = NULL;
+    uint64_t head;
+    size_t offset;
+    size_t first;
+
+    assert(queue);
+    assert(values || count == 0);
+
+    header = queue->header;
+    head = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+    if (queue->cached_tail - head < count) {
+        queue->cached_tail = __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE);
+        if (queue->cached_tail - head < count) {
+            count = queue->cached_tail - head;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    offset = head & queue->mask;
+    first = header->size - offset < count ? header->size - offset : count;
+    memcpy(values, queue->element + offset, first * sizeof(int));
+    memcpy(values + first, queue->element, (count - first) * sizeof(int));
+
+    __atomic_store_n(&header->head, head + count, __ATOMIC_SEQ_CST);
+    shmqueue_signal(&header->writable, &header->producer_waiting);
+
+    return count;
+}
+
+int shmqueue_remove(shmqueue *queue, int *value) {
+    assert(value);
+
+    if (shmqueue_remove_range(queue, value, 1) == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Check from a waiting side if it can go on, reading the position of
+ * the other side after its own waiting flag
+ */
+static int shmqueue_ready(const shmqueue *queue, int producer) {
+    const shmqueue_header *header = queue->header;
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_SEQ_CST);
+    uint64_t tail = __atomic_load_n(&header->tail, __ATOMIC_SEQ_CST);
+
+    return producer ? tail - head < header->size : tail != head;
+}
+
+/**
+ * Sleep on the futex of a side until it can go on
+ * @param queue a non null pointer to a queue
+ * @param producer 1 to wait for a free slot, 0 to wait for a value
+ * @param timeout the maximum time to wait in milliseconds, forever if
+ *  negative
+ * @return 0 if the side can go on
+ *        -1 on error (see errno), ETIMEDOUT or EINTR
+ */
+static int shmqueue_wait(shmqueue *queue, int producer, int timeout) {
+    shmqueue_header *header = queue->header;
+    uint32_t *futex = producer ? &header->writable : &header->readable;
+    uint32_t *waiting = producer ? &header->producer_waiting
+                                 : &header->consumer_waiting;
+    struct timespec deadline;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    for (;;) {
+        uint32_t seen = __atomic_load_n(futex, __ATOMIC_ACQUIRE);
+        struct timespec remaining;
+        long rc;
+
+        if (shmqueue_ready(queue, producer)) {
+            return 0;
+        }
+        __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+        if (shmqueue_ready(queue, producer)) {
+            __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+            return 0;
+        }
+
+        if (timeout >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+            remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (remaining.tv_nsec < 0) {
+                remaining.tv_sec--;
+                remaining.tv_nsec += 1000000000L;
+            }
+            if (remaining.tv_sec < 0) {
+                __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+                errno = ETIMEDOUT;
+                return -1;
+            }
+        }
+
+        /* Returns at once if the other side signaled since seen */
+        rc = syscall(SYS_futex, futex, FUTEX_WAIT, seen,
+                     timeout >= 0 ? &remaining : NULL, NULL, 0);
+        __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+        if (rc == -1 && errno != EAGAIN && errno != ETIMEDOUT) {
+            return -1;
+        }
+    }
+}
+
+int shmqueue_wait_readable(shmqueue *queue, int timeout) {
+    assert(queue);
+
+    return shmqueue_wait(queue, 0, timeout);
+}
+
+int shmqueue_wait_writable(shmqueue *queue, int timeout) {
+    assert(queue);
+
+    return shmqueue_wait(queue, 1, timeout);
+}
+
+size_t shmqueue_count(const shmqueue *queue) {
+    uint64_t head;
+    uint64_t tail;
+
+    assert(queue);
+
+    /* The tail never falls behind a head read first */
+    head = __atomic_load_n(&queue->header->head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&queue->header->tail, __ATOMIC_ACQUIRE);
+
+    return tail - head;
+}
+
+#ifdef WITH_TEST
+static void shmqueue_test_name(char *name, size_t size, const char *test) {
+    snprintf(name, size, "/woofi-%s-%ld", test, (long)getpid());
+}
+
+Test(Shmqueue, wrap) {
+    char name[64];
+    int values[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    int out[8];
+    int value = 0;
+
+    shmqueue_test_name(name, sizeof(name), "wrap");
+    shm_unlink(name);
+
+    shmqueue *producer = shmqueue_create(name, 5);
+    cr_assert(producer);
+    cr_assert(producer->header->size == 8);
+    cr_assert(shmqueue_create(name, 5) == NULL);
+    cr_assert(errno == EEXIST);
+    shmqueue *consumer = shmqueue_attach(name);
+    cr_assert(consumer);
+    cr_assert(consumer->header != producer->header);
+
+    cr_assert(shmqueue_remove(consumer, &value) == -1);
+    cr_assert(errno == EAGAIN);
+    cr_assert(shmqueue_wait_readable(consumer, 0) == -1);
+    cr_assert(errno == ETIMEDOUT);
+
+    cr_assert(shmqueue_insert_range(producer, values, 6) == 6);
+    cr_assert(shmqueue_remove_range(consumer, out, 4) == 4);
+    cr_assert(out[3] == 3);
+    /* Wraps around the end of the slots */
+    cr_assert(shmqueue_insert_range(producer, values, 8) == 6);
+    cr_assert(shmqueue_insert(producer, 9) == -1);
+    cr_assert(errno == EAGAIN);
+    cr_assert(shmqueue_wait_writable(producer, 0) == -1);
+    cr_assert(shmqueue_count(consumer) == 8);
+    cr_assert(shmqueue_wait_readable(consumer, 0) == 0);
+
+    cr_assert(shmqueue_remove_range(consumer, out, 8) == 8);
+    cr_assert(out[0] == 4 && out[1] == 5);
+    for (int i = 0; i < 6; i++) {
+        cr_assert(out[2 + i] == i);
+    }
+    cr_assert(shmqueue_insert(producer, 9) == 0);
+    cr_assert(shmqueue_remove(consumer, &value) == 0);
+    cr_assert(value == 9);
+
+    shmqueue_detach(consumer);
+    shmqueue_detach(producer);
+    cr_assert(shmqueue_unlink(name) == 0);
+    cr_assert(shmqueue_attach(name) == NULL);
+}
+
+#define SHMQUEUE_TEST_VALUES 200000
+
+Test(Shmqueue, processes) {
+    char name[64];
+    int values[100];
+    int expected = 0;
+    int status;
+    pid_t child;
+
+    shmqueue_test_name(name, sizeof(name), "processes");
+    shm_unlink(name);
+
+    shmqueue *consumer = shmqueue_create(name, 64);
+    cr_assert(consumer);
+
+    child = fork();
+    cr_assert(child != -1);
+    if (child == 0) {
+        shmqueue *producer = shmqueue_attach(name);
+        int next = 0;
+
+        if (producer == NULL) {
+            _exit(EXIT_FAILURE);
+        }
+        while (next < SHMQUEUE_TEST_VALUES) {
+            size_t count = 0;
+
+            for (int i = 0; i < 100; i++) {
+                values[i] = next + i;
+            }
+            while (count < 100) {
+                if (shmqueue_wait_writable(producer, 5000) == -1) {
+                    _exit(EXIT_FAILURE);
+                }
+                count += shmqueue_insert_range(producer, values + count,
+                                               100 - count);
+            }
+            next += 100;
+        }
+        shmqueue_detach(producer);
+        _exit(EXIT_SUCCESS);
+    }
+
+    while (expected < SHMQUEUE_TEST_VALUES) {
+        size_t count;
+
+        if (shmqueue_wait_readable(consumer, 5000) == -1) {
+            kill(child, SIGKILL);
+            break;
+        }
+        count = shmqueue_remove_range(consumer, values, 100);
+        for (size_t i = 0; i < count; i++) {
+            cr_assert(values[i] == expected + (int)i);
+        }
+        expected += count;
+    }
+
+    cr_assert(waitpid(child, &status, 0) == child);
+    cr_assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    cr_assert(expected == SHMQUEUE_TEST_VALUES);
+
+    shmqueue_detach(consumer);
+    shmqueue_unlink(name);
+}
+#endif
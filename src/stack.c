@@ -1,23 +1,30 @@
 #include <stdio.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "woofi/allocator.h"
 #include "woofi/stack.h"
+#include "woofi/histogram.h"
 #ifdef WITH_TEST
 # include <criterion/criterion.h>
 #endif
 
+static const capacity_policy stack_default_policy = CAPACITY_POLICY_DEFAULT;
+
 stack *stack_create() {
     stack *stack = NULL;
 
-    stack = malloc(sizeof(*stack));
+    stack = allocator_malloc(sizeof(*stack));
     if(stack == NULL) {
         return NULL;
     }
 
     stack->size = INITIAL_STACK_SIZE;
     stack->head = 0;
-    stack->element = calloc(stack->size, sizeof(*(stack->element)));
+    stack->policy = stack_default_policy;
+    stack->element = allocator_calloc(stack->size, sizeof(*(stack->element)));
 
     return stack;
 }
@@ -25,8 +32,29 @@ stack *stack_create() {
 void stack_delete(stack *stack) {
     assert(stack);
 
-    free(stack->element);
-    free(stack);
+    allocator_free(stack->element, stack->size * sizeof(*(stack->element)));
+    allocator_free(stack, sizeof(*stack));
+}
+
+/**
+ * Change the capacity of the stack
+ * @param stack a non null pointer to a stack
+ * @param size the new capacity, at least the number of elements
+ * @return 0 if the stack was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int stack_resize(stack *stack, size_t size) {
+    int *new_elements = allocator_realloc(stack->element,
+                                          stack->size * sizeof(*(stack->element)),
+                                          size * sizeof(*(stack->element)));
+    if (new_elements == NULL) {
+        return -1;
+    }
+
+    stack->element = new_elements;
+    stack->size = size;
+
+    return 0;
 }
 
 static int stack_grow(stack *stack) {
@@ -34,19 +62,61 @@ static int stack_grow(stack *stack) {
         return -1;
     }
 
-    stack->size = stack->size + stack->size / 2;
+    return stack_resize(stack, capacity_grow(&stack->policy, stack->size,
+                                             stack->head + 1));
+}
 
-    int *new_elements = realloc(stack->element, stack->size* sizeof(*(stack->element)));
-    if (new_elements == NULL) {
+int stack_set_policy(stack *stack, const capacity_policy *policy) {
+    assert(stack);
+
+    if (!capacity_policy_valid(policy)) {
+        errno = EINVAL;
         return -1;
     }
-    else {
-        stack->element = new_elements;
-    }
+
+    stack->policy = *policy;
 
     return 0;
 }
 
+int stack_reserve(stack *stack, size_t size) {
+    assert(stack);
+
+    if (size <= stack->size) {
+        return 0;
+    }
+
+    return stack_resize(stack, size);
+}
+
+int stack_shrink_to_fit(stack *stack) {
+    assert(stack);
+
+    size_t size = stack->head ? stack->head : 1;
+    if (size >= stack->size) {
+        return 0;
+    }
+
+    return stack_resize(stack, size);
+}
+
+void stack_print(const stack *stack) {
+    stack_fwrite(stack, stdout, TEXTIO_LIST);
+}
+
+int stack_write(const stack *stack, int fd, textio_format format) {
+    assert(stack);
+
+    return textio_write_ints(fd, format, stack->element, stack->head, NULL, 0);
+}
+
+int stack_fwrite(const stack *stack, FILE *file, textio_format format) {
+    assert(stack);
+
+    return textio_fwrite_ints(file, format, stack->element, stack->head,
+                              NULL, 0);
+}
+
 int stack_is_empty(const stack *stack) {
     assert(stack);
 
@@ -59,35 +129,49 @@ size_t stack_count(const stack *stack) {
 
 int stack_insert(stack *stack, int value) {
     assert(stack);
+    HISTOGRAM_START(HISTOGRAM_STACK_INSERT);
 
     int rc = 0;
 
     if (stack->head == stack->size) {
         rc = stack_grow(stack);
         if(rc == -1) {
+            HISTOGRAM_STOP();
             return 0;
         }
     }
 
-    stack->head++;
     stack->element[stack->head] = value;
+    stack->head++;
 
+    HISTOGRAM_STOP();
     return 1;
 }
 
 int stack_remove(stack *stack) {
     assert(stack);
+    HISTOGRAM_START(HISTOGRAM_STACK_REMOVE);
 
     if(stack_is_empty(stack)) {
+        HISTOGRAM_STOP();
         return 0;
     }
     stack->head--;
 
+    size_t size = capacity_shrink(&stack->policy, stack->size, stack->head);
+    if (size < stack->size) {
+        stack_resize(stack, size);
+    }
+
+    HISTOGRAM_STOP();
     return 1;
 }
 
 int stack_head(const stack *stack) {
-    return stack->element[stack->head];
+    assert(stack);
+    assert(stack->head);
+
+    return stack->element[stack->head - 1];
 }
 
 #ifdef WITH_TEST
@@ -149,6 +233,22 @@ Test(Stack, remove) {
     stack_delete(stack);
 }
 
+Test(Stack, fwrite) {
+    char out[32] = { 0 };
+    FILE *file = tmpfile();
+    stack *stack = stack_create();
+
+    stack_insert(stack, 42);
+    stack_insert(stack, -24);
+    cr_assert(stack_fwrite(stack, file, TEXTIO_LIST) == 0);
+    rewind(file);
+    cr_assert(fread(out, 1, sizeof(out) - 1, file) == 12);
+    cr_assert(strcmp(out, "[42, -24, ]\n") == 0);
+
+    stack_delete(stack);
+    fclose(file);
+}
+
 Test(Stack, grow) {
     int rc = 0;
     stack *stack = stack_create();
@@ -183,4 +283,27 @@ Test(Stack, shit_load) {
     stack_delete(stack);
 }
 
+Test(Stack, reserve_shrink) {
+    capacity_policy policy = CAPACITY_POLICY_SHRINK;
+    stack *stack = stack_create();
+
+    cr_assert(stack_reserve(stack, 1000) == 0);
+    cr_assert(stack->size == 1000);
+    cr_assert(stack_shrink_to_fit(stack) == 0);
+    cr_assert(stack->size == 1);
+
+    cr_assert(stack_set_policy(stack, &policy) == 0);
+    for (int i = 0; i < 1000; i++) {
+        stack_insert(stack, i);
+    }
+    cr_assert(stack->size == 1024);
+    for (int i = 0; i < 995; i++) {
+        stack_remove(stack);
+    }
+    cr_assert(stack->size == 100);
+    cr_assert(stack_head(stack) == 4);
+
+    stack_delete(stack);
+}
+
 #endif
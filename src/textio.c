@@ -0,0 +1,388 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "woofi/textio.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+/* Longest formatted value and separator: "-2147483648, " */
+#define TEXTIO_MAX_VALUE 16
+#define TEXTIO_BATCH_SIZE 1024
+
+typedef struct {
+    int fd;
+    FILE *file;
+    size_t length;
+    char *data;
+} textio_buffer;
+
+static const char textio_digits[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Write the buffered text to the file descriptor or the stream
+ * @return 0 if the buffer was written
+ *        -1 on error (see errno)
+ */
+static int textio_flush(textio_buffer *buffer) {
+    const char *data = buffer->data;
+    size_t size = buffer->length;
+
+    buffer->length = 0;
+
+    if (buffer->file) {
+        return fwrite(data, 1, size, buffer->file) == size ? 0 : -1;
+    }
+
+    while (size > 0) {
+        ssize_t written = write(buffer->fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        /* Retrying a descriptor which takes nothing would never end */
+        if (written == 0) {
+            errno = EIO;
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+
+    return 0;
+}
+
+/**
+ * Format a value in decimal, two digits at a time
+ * @param out where to write, at least 11 chars
+ * @param value the value to format
+ * @return a pointer after the last written char
+ */
+static char *textio_format_int(char *out, int value) {
+    unsigned int left = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    char digits[10];
+    char *start = digits + sizeof(digits);
+
+    while (left >= 100) {
+        unsigned int pair = (left % 100) * 2;
+        left /= 100;
+        *--start = textio_digits[pair + 1];
+        *--start = textio_digits[pair];
+    }
+    if (left >= 10) {
+        *--start = textio_digits[left * 2 + 1];
+        *--start = textio_digits[left * 2];
+    }
+    else {
+        *--start = '0' + left;
+    }
+
+    if (value < 0) {
+        *out++ = '-';
+    }
+
+    size_t length = digits + sizeof(digits) - start;
+    memcpy(out, start, length);
+
+    return out + length;
+}
+
+/**
+ * Format a segment of values in the buffer, flushing it when full
+ * @return 0 if the values were formatted
+ *        -1 on error (see errno)
+ */
+static int textio_format_segment(textio_buffer *buffer, textio_format format,
+                                 const int *values, size_t count, int first) {
+    for (size_t i = 0; i < count; ++i) {
+        if (buffer->length + TEXTIO_MAX_VALUE > TEXTIO_BUFFER_SIZE) {
+            if (textio_flush(buffer) == -1) {
+                return -1;
+            }
+        }
+
+        char *out = buffer->data + buffer->length;
+        if (format == TEXTIO_CSV && !(first && i == 0)) {
+            *out++ = ',';
+        }
+        out = textio_format_int(out, values[i]);
+        if (format == TEXTIO_LIST) {
+            *out++ = ',';
+            *out++ = ' ';
+        }
+        else if (format == TEXTIO_LINES) {
+            *out++ = '\n';
+        }
+        buffer->length = out - buffer->data;
+    }
+
+    return 0;
+}
+
+/**
+ * Format both segments of values with the opening and closing text of the
+ * format, then flush the buffer
+ * @return 0 if the values were written
+ *        -1 on error (see errno)
+ */
+static int textio_format_all(textio_buffer *buffer, textio_format format,
+                             const int *first, size_t first_count,
+                             const int *second, size_t second_count) {
+    int rc = 0;
+
+    buffer->data = malloc(TEXTIO_BUFFER_SIZE);
+    if (buffer->data == NULL) {
+        return -1;
+    }
+    buffer->length = 0;
+
+    if (format == TEXTIO_LIST) {
+        buffer->data[buffer->length++] = '[';
+    }
+
+    rc = textio_format_segment(buffer, format, first, first_count, 1);
+    if (rc == 0) {
+        rc = textio_format_segment(buffer, format, second, second_count,
+                                   first_count == 0);
+    }
+
+    if (rc == 0) {
+        /* The segments always leave TEXTIO_MAX_VALUE bytes free */
+        if (format == TEXTIO_LIST) {
+            buffer->data[buffer->length++] = ']';
+            buffer->data[buffer->length++] = '\n';
+        }
+        else if (format == TEXTIO_CSV) {
+            buffer->data[buffer->length++] = '\n';
+        }
+        rc = textio_flush(buffer);
+    }
+
+    free(buffer->data);
+
+    return rc;
+}
+
+int textio_write_ints(int fd, textio_format format,
+                      const int *first, size_t first_count,
+                      const int *second, size_t second_count) {
+    textio_buffer buffer;
+
+    buffer.fd = fd;
+    buffer.file = NULL;
+
+    return textio_format_all(&buffer, format, first, first_count,
+                             second, second_count);
+}
+
+int textio_fwrite_ints(FILE *file, textio_format format,
+                       const int *first, size_t first_count,
+                       const int *second, size_t second_count) {
+    textio_buffer buffer;
+
+    assert(file);
+
+    buffer.fd = -1;
+    buffer.file = file;
+
+    return textio_format_all(&buffer, format, first, first_count,
+                             second, second_count);
+}
+
+ssize_t textio_read_ints(int fd, textio_emit_fn emit, void *ctx) {
+    int batch[TEXTIO_BATCH_SIZE];
+    size_t batched = 0;
+    ssize_t total = 0;
+    long long value = 0;
+    int in_value = 0;
+    int negative = 0;
+    int rc = 0;
+
+    assert(emit);
+
+    char *data = malloc(TEXTIO_BUFFER_SIZE);
+    if (data == NULL) {
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t got = read(fd, data, TEXTIO_BUFFER_SIZE);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -1;
+            break;
+        }
+
+        /* A NUL past the end of file closes the last value */
+        if (got == 0) {
+            data[0] = '\0';
+            got = 1;
+            rc = 1;
+        }
+
+        for (ssize_t i = 0; i < got; ++i) {
+            unsigned int digit = (unsigned char)data[i] - '0';
+
+            if (digit < 10) {
+                value = value * 10 + digit;
+                in_value = 1;
+                if (value > (long long)INT_MAX + negative) {
+                    errno = ERANGE;
+                    rc = -1;
+                    break;
+                }
+                continue;
+            }
+
+            if (in_value) {
+                batch[batched++] = negative ? (int)-value : (int)value;
+                total++;
+                value = 0;
+                in_value = 0;
+
+                if (batched == TEXTIO_BATCH_SIZE) {
+                    if (emit(ctx, batch, batched) == -1) {
+                        rc = -1;
+                        break;
+                    }
+                    batched = 0;
+                }
+            }
+            negative = data[i] == '-';
+        }
+
+        if (rc != 0) {
+            break;
+        }
+    }
+
+    if (rc == 1 && batched > 0 && emit(ctx, batch, batched) == -1) {
+        rc = -1;
+    }
+
+    free(data);
+
+    return rc == -1 ? -1 : total;
+}
+
+#ifdef WITH_TEST
+static int textio_test_emit(void *ctx, const int *values, size_t count) {
+    int *sum = ctx;
+
+    for (size_t i = 0; i < count; ++i) {
+        *sum += values[i];
+    }
+
+    return 0;
+}
+
+static void textio_test_read(int fd, char *out, size_t size) {
+    lseek(fd, 0, SEEK_SET);
+    ssize_t got = read(fd, out, size - 1);
+    out[got < 0 ? 0 : got] = '\0';
+}
+
+Test(TextIO, format_int) {
+    char out[16];
+
+    *textio_format_int(out, 0) = '\0';
+    cr_assert(strcmp(out, "0") == 0);
+    *textio_format_int(out, 7) = '\0';
+    cr_assert(strcmp(out, "7") == 0);
+    *textio_format_int(out, -42) = '\0';
+    cr_assert(strcmp(out, "-42") == 0);
+    *textio_format_int(out, 100) = '\0';
+    cr_assert(strcmp(out, "100") == 0);
+    *textio_format_int(out, INT_MAX) = '\0';
+    cr_assert(strcmp(out, "2147483647") == 0);
+    *textio_format_int(out, INT_MIN) = '\0';
+    cr_assert(strcmp(out, "-2147483648") == 0);
+}
+
+Test(TextIO, formats) {
+    char path[] = "/tmp/woofi-textio-XXXXXX";
+    char out[64];
+    int first[] = { 1, -2 };
+    int second[] = { 30 };
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+
+    cr_assert(textio_write_ints(fd, TEXTIO_LIST, first, 2, second, 1) == 0);
+    textio_test_read(fd, out, sizeof(out));
+    cr_assert(strcmp(out, "[1, -2, 30, ]\n") == 0);
+
+    cr_assert(ftruncate(fd, 0) == 0);
+    lseek(fd, 0, SEEK_SET);
+    cr_assert(textio_write_ints(fd, TEXTIO_CSV, NULL, 0, first, 2) == 0);
+    textio_test_read(fd, out, sizeof(out));
+    cr_assert(strcmp(out, "1,-2\n") == 0);
+
+    cr_assert(ftruncate(fd, 0) == 0);
+    lseek(fd, 0, SEEK_SET);
+    cr_assert(textio_write_ints(fd, TEXTIO_LINES, first, 2, NULL, 0) == 0);
+    textio_test_read(fd, out, sizeof(out));
+    cr_assert(strcmp(out, "1\n-2\n") == 0);
+
+    close(fd);
+    unlink(path);
+}
+
+Test(TextIO, roundtrip) {
+    char path[] = "/tmp/woofi-textio-XXXXXX";
+    int *values = malloc(100000 * sizeof(*values));
+    int expected = 0;
+    int sum = 0;
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+
+    for (int i = 0; i < 100000; i++) {
+        values[i] = i % 2 ? i : -i;
+        expected += values[i];
+    }
+    cr_assert(textio_write_ints(fd, TEXTIO_LIST, values, 100000, NULL, 0) == 0);
+    lseek(fd, 0, SEEK_SET);
+
+    cr_assert(textio_read_ints(fd, textio_test_emit, &sum) == 100000);
+    cr_assert(sum == expected);
+
+    free(values);
+    close(fd);
+    unlink(path);
+}
+
+Test(TextIO, range) {
+    char path[] = "/tmp/woofi-textio-XXXXXX";
+    int sum = 0;
+    int fd = mkstemp(path);
+    cr_assert(fd != -1);
+
+    cr_assert(write(fd, "-2147483648 12 2147483648", 25) == 25);
+    lseek(fd, 0, SEEK_SET);
+    cr_assert(textio_read_ints(fd, textio_test_emit, &sum) == -1);
+    cr_assert(errno == ERANGE);
+
+    close(fd);
+    unlink(path);
+}
+#endif
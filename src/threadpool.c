@@ -0,0 +1,540 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "woofi/threadpool.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+/* Number of tasks threadpool_run queues at once */
+#define THREADPOOL_BATCH 64
+/* Size of a queue on its first push */
+#define THREADPOOL_QUEUE_SIZE 16
+
+/* Pool the current thread works for, and the index of its queue */
+static __thread threadpool *threadpool_current = NULL;
+static __thread size_t threadpool_current_index = 0;
+
+static size_t threadpool_self(const threadpool *pool) {
+    return threadpool_current == pool ? threadpool_current_index : 0;
+}
+
+static void threadpool_queue_init(threadpool_queue *queue) {
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->entry = NULL;
+    queue->size = 0;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->count = 0;
+}
+
+static void threadpool_queue_destroy(threadpool_queue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->entry);
+}
+
+/**
+ * Make room for count more entries, keeping them in order.
+ * Called with the queue lock held.
+ * @param queue a non null pointer to a queue
+ * @param count the number of entries to add
+ * @return 0 if there is enough room
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int threadpool_queue_reserve(threadpool_queue *queue, size_t count) {
+    size_t used = queue->count;
+    size_t size = queue->size ? queue->size : THREADPOOL_QUEUE_SIZE;
+    threadpool_entry *entry = NULL;
+
+    if (queue->size - used >= count) {
+        return 0;
+    }
+
+    while (size - used < count) {
+        if (size > SIZE_MAX / 2 / sizeof(*entry)) {
+            errno = ENOMEM;
+            return -1;
+        }
+        size *= 2;
+    }
+
+    entry = malloc(size * sizeof(*entry));
+    if (entry == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < used; i++) {
+        entry[i] = queue->entry[(queue->head + i) & (queue->size - 1)];
+    }
+
+    free(queue->entry);
+    queue->entry = entry;
+    queue->size = size;
+    queue->head = 0;
+    queue->tail = used;
+
+    return 0;
+}
+
+/**
+ * Take the newest entry of a queue, for its owner
+ * @return 1 if an entry was taken
+ *         0 if the queue is empty
+ */
+static int threadpool_queue_pop(threadpool_queue *queue,
+                                threadpool_entry *entry) {
+    int taken = 0;
+
+    /* Skip the lock when the queue is obviously empty */
+    if (__atomic_load_n(&queue->count, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        queue->tail = (queue->tail - 1) & (queue->size - 1);
+        *entry = queue->entry[queue->tail];
+        __atomic_store_n(&queue->count, queue->count - 1, __ATOMIC_RELAXED);
+        taken = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return taken;
+}
+
+/**
+ * Take the oldest entry of a queue, for the other threads
+ * @return 1 if an entry was taken
+ *         0 if the queue is empty
+ */
+static int threadpool_queue_steal(threadpool_queue *queue,
+                                  threadpool_entry *entry) {
+    int taken = 0;
+
+    if (__atomic_load_n(&queue->count, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        *entry = queue->entry[queue->head];
+        queue->head = (queue->head + 1) & (queue->size - 1);
+        __atomic_store_n(&queue->count, queue->count - 1, __ATOMIC_RELAXED);
+        taken = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return taken;
+}
+
+/**
+ * Wake sleeping threads after tasks were queued
+ * @param pool a non null pointer to a pool
+ * @param count the number of tasks queued
+ */
+static void threadpool_wake(threadpool *pool, size_t count) {
+    if (__atomic_load_n(&pool->idle, __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (count > 1) {
+        pthread_cond_broadcast(&pool->wake);
+    } else {
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Run one queued task: from the queue of the current thread first, then
+ * from the injection queue, then stolen from another worker
+ * @param pool a non null pointer to a pool
+ * @return 1 if a task was run
+ *         0 if no task was found
+ */
+static int threadpool_run_one(threadpool *pool) {
+    size_t self = threadpool_self(pool);
+    threadpool_entry entry;
+    int found = threadpool_queue_pop(&pool->queue[self], &entry);
+
+    if (!found && self != 0) {
+        found = threadpool_queue_steal(&pool->queue[0], &entry);
+    }
+    for (size_t i = 1; !found && i < pool->size; i++) {
+        size_t victim = (self + i) % pool->size;
+
+        if (victim != 0) {
+            found = threadpool_queue_steal(&pool->queue[victim], &entry);
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+
+    __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    entry.task.fn(entry.task.ctx, entry.task.index);
+
+    /* The group may be freed as soon as its last task returned */
+    if (__atomic_sub_fetch(&entry.group->pending, 1, __ATOMIC_SEQ_CST) == 0
+        && __atomic_load_n(&pool->idle, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return 1;
+}
+
+static void *threadpool_worker(void *arg) {
+    threadpool *pool = arg;
+
+    threadpool_current = pool;
+    threadpool_current_index = __atomic_add_fetch(&pool->started, 1,
+                                                  __ATOMIC_SEQ_CST);
+
+    for (;;) {
+        if (threadpool_run_one(pool)) {
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (pool->stop && __atomic_load_n(&pool->queued,
+                                          __ATOMIC_SEQ_CST) == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        __atomic_add_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        while (!pool->stop && __atomic_load_n(&pool->queued,
+                                              __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Stop the started threads and free the pool
+ * @param pool a non null pointer to a pool
+ * @param started the number of threads started
+ */
+static void threadpool_stop(threadpool *pool, size_t started) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i <= started; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    /* Without workers, the tasks left are run by the caller */
+    while (threadpool_run_one(pool)) {
+    }
+
+    for (size_t i = 0; i < pool->size; ++i) {
+        threadpool_queue_destroy(&pool->queue[i]);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool);
+}
+
+threadpool *threadpool_create(size_t size) {
+    threadpool *pool = NULL;
+
+    if (size == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        size = online > 0 ? online : 1;
+    }
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->threads = calloc(size, sizeof(*(pool->threads)));
+    pool->queue = calloc(size, sizeof(*(pool->queue)));
+    if (pool->threads == NULL || pool->queue == NULL) {
+        free(pool->queue);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+
+    pool->size = size;
+    for (size_t i = 0; i < size; ++i) {
+        threadpool_queue_init(&pool->queue[i]);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    for (size_t i = 1; i < size; ++i) {
+        int rc = pthread_create(&pool->threads[i], NULL,
+                                threadpool_worker, pool);
+        if (rc != 0) {
+            threadpool_stop(pool, i - 1);
+            errno = rc;
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void threadpool_delete(threadpool *pool) {
+    assert(pool);
+
+    threadpool_stop(pool, pool->size - 1);
+}
+
+size_t threadpool_size(const threadpool *pool) {
+    assert(pool);
+
+    return pool->size;
+}
+
+int threadpool_submit(threadpool *pool, threadpool_group *group,
+                      threadpool_fn fn, void *ctx) {
+    threadpool_task task = { fn, ctx, 0 };
+
+    return threadpool_submit_batch(pool, group, &task, 1);
+}
+
+int threadpool_submit_batch(threadpool *pool, threadpool_group *group,
+                            const threadpool_task *tasks, size_t count) {
+    threadpool_queue *queue = NULL;
+
+    assert(pool);
+    assert(tasks || count == 0);
+
+    if (count == 0) {
+        return 0;
+    }
+    if (group == NULL) {
+        group = &pool->group;
+    }
+
+    /* Counted before being visible so the counters never underflow */
+    __atomic_add_fetch(&group->pending, count, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&pool->queued, count, __ATOMIC_SEQ_CST);
+
+    queue = &pool->queue[threadpool_self(pool)];
+    pthread_mutex_lock(&queue->lock);
+    if (threadpool_queue_reserve(queue, count) != 0) {
+        pthread_mutex_unlock(&queue->lock);
+        __atomic_sub_fetch(&pool->queued, count, __ATOMIC_SEQ_CST);
+        __atomic_sub_fetch(&group->pending, count, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        assert(tasks[i].fn);
+
+        queue->entry[queue->tail].task = tasks[i];
+        queue->entry[queue->tail].group = group;
+        queue->tail = (queue->tail + 1) & (queue->size - 1);
+    }
+    __atomic_store_n(&queue->count, queue->count + count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->lock);
+
+    threadpool_wake(pool, count);
+
+    return 0;
+}
+
+void threadpool_wait(threadpool *pool, threadpool_group *group) {
+    assert(pool);
+
+    if (group == NULL) {
+        group = &pool->group;
+    }
+
+    while (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0) {
+        if (threadpool_run_one(pool)) {
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0
+               && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->idle, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void threadpool_run(threadpool *pool, threadpool_fn fn, void *ctx,
+                    size_t count) {
+    threadpool_group group = { 0 };
+    threadpool_task batch[THREADPOOL_BATCH];
+    size_t index = 0;
+
+    assert(pool);
+    assert(fn);
+
+    if (count <= 1 || pool->size == 1) {
+        for (; index < count; index++) {
+            fn(ctx, index);
+        }
+        return;
+    }
+
+    while (index < count) {
+        size_t length = count - index;
+
+        if (length > THREADPOOL_BATCH) {
+            length = THREADPOOL_BATCH;
+        }
+        for (size_t i = 0; i < length; i++) {
+            batch[i].fn = fn;
+            batch[i].ctx = ctx;
+            batch[i].index = index + i;
+        }
+        if (threadpool_submit_batch(pool, &group, batch, length) != 0) {
+            break;
+        }
+        index += length;
+    }
+
+    /* Tasks that could not be queued run on the calling thread */
+    for (; index < count; index++) {
+        fn(ctx, index);
+    }
+
+    threadpool_wait(pool, &group);
+}
+
+#ifdef WITH_TEST
+static void threadpool_test_square(void *ctx, size_t index) {
+    size_t *values = ctx;
+
+    values[index] = index * index;
+}
+
+static void threadpool_test_count(void *ctx, size_t index) {
+    size_t *counter = ctx;
+
+    __atomic_add_fetch(counter, index + 1, __ATOMIC_SEQ_CST);
+}
+
+typedef struct {
+    threadpool *pool;
+    size_t counter;
+} threadpool_test_nested;
+
+static void threadpool_test_spawn(void *ctx, size_t index) {
+    threadpool_test_nested *nested = ctx;
+    size_t values[100] = { 0 };
+
+    /* Inner jobs go to the local queue of the worker */
+    threadpool_run(nested->pool, threadpool_test_square, values, 100);
+    for (size_t i = 0; i < 100; i++) {
+        if (values[i] == i * i) {
+            __atomic_add_fetch(&nested->counter, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+    (void)index;
+}
+
+Test(ThreadPool, create) {
+    threadpool *pool = threadpool_create(4);
+
+    cr_assert(pool);
+    cr_assert(threadpool_size(pool) == 4);
+
+    threadpool_delete(pool);
+
+    pool = threadpool_create(0);
+    cr_assert(pool);
+    cr_assert(threadpool_size(pool) >= 1);
+
+    threadpool_delete(pool);
+}
+
+Test(ThreadPool, run) {
+    size_t values[1000] = { 0 };
+    threadpool *pool = threadpool_create(4);
+
+    for (int round = 0; round < 100; round++) {
+        threadpool_run(pool, threadpool_test_square, values, 1000);
+        for (size_t i = 0; i < 1000; i++) {
+            cr_assert(values[i] == i * i);
+            values[i] = 0;
+        }
+    }
+
+    threadpool_run(pool, threadpool_test_square, values, 0);
+
+    threadpool_delete(pool);
+}
+
+Test(ThreadPool, submit_wait) {
+    size_t counter = 0;
+    threadpool_group group = { 0 };
+    threadpool_task tasks[50];
+    threadpool *pool = threadpool_create(3);
+
+    for (size_t i = 0; i < 100; i++) {
+        cr_assert(threadpool_submit(pool, &group, threadpool_test_count,
+                                    &counter) == 0);
+    }
+    threadpool_wait(pool, &group);
+    cr_assert(counter == 100);
+    cr_assert(group.pending == 0);
+
+    for (size_t i = 0; i < 50; i++) {
+        tasks[i].fn = threadpool_test_count;
+        tasks[i].ctx = &counter;
+        tasks[i].index = i;
+    }
+    cr_assert(threadpool_submit_batch(pool, NULL, tasks, 50) == 0);
+    threadpool_wait(pool, NULL);
+    cr_assert(counter == 100 + 50 * 51 / 2);
+
+    cr_assert(threadpool_submit_batch(pool, NULL, tasks, 0) == 0);
+    threadpool_wait(pool, NULL);
+
+    threadpool_delete(pool);
+}
+
+Test(ThreadPool, nested) {
+    threadpool_test_nested nested = { NULL, 0 };
+
+    nested.pool = threadpool_create(4);
+    threadpool_run(nested.pool, threadpool_test_spawn, &nested, 20);
+    cr_assert(nested.counter == 20 * 100);
+    threadpool_delete(nested.pool);
+
+    /* A single thread runs everything while waiting */
+    nested.pool = threadpool_create(1);
+    nested.counter = 0;
+    threadpool_run(nested.pool, threadpool_test_spawn, &nested, 5);
+    cr_assert(nested.counter == 5 * 100);
+    threadpool_delete(nested.pool);
+}
+
+Test(ThreadPool, delete_pending) {
+    size_t counter = 0;
+    threadpool *pool = threadpool_create(1);
+
+    for (size_t i = 0; i < 10; i++) {
+        cr_assert(threadpool_submit(pool, NULL, threadpool_test_count,
+                                    &counter) == 0);
+    }
+    threadpool_delete(pool);
+    cr_assert(counter == 10);
+}
+#endif
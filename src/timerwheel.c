@@ -0,0 +1,502 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#include "woofi/timerwheel.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+#define TIMERWHEEL_MASK (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_INITIAL_TIMERS 64
+
+enum {
+    TIMERWHEEL_FREE,
+    TIMERWHEEL_PENDING,
+    TIMERWHEEL_CANCELLED
+};
+
+static const capacity_policy timerwheel_policy = CAPACITY_POLICY_DEFAULT;
+
+timerwheel *timerwheel_create(uint64_t now) {
+    timerwheel *wheel = NULL;
+
+    wheel = calloc(1, sizeof(*wheel));
+    if (wheel == NULL) {
+        return NULL;
+    }
+
+    wheel->now = now;
+    wheel->free = -1;
+
+    return wheel;
+}
+
+void timerwheel_delete(timerwheel *wheel) {
+    assert(wheel);
+
+    for (size_t level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        for (size_t i = 0; i < TIMERWHEEL_SLOTS; i++) {
+            if (wheel->slot[level][i]) {
+                circularqueue_delete(wheel->slot[level][i]);
+            }
+        }
+    }
+    free(wheel->timer);
+    free(wheel);
+}
+
+size_t timerwheel_count(const timerwheel *wheel) {
+    assert(wheel);
+
+    return wheel->count;
+}
+
+/**
+ * Take an entry from the free list or the end of the timer table
+ * @return the index of the entry
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int timerwheel_alloc(timerwheel *wheel) {
+    int index = wheel->free;
+
+    if (index >= 0) {
+        wheel->free = wheel->timer[index].next_free;
+        return index;
+    }
+
+    if (wheel->used == (size_t)INT_MAX) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (wheel->used == wheel->size) {
+        size_t size = capacity_grow(&timerwheel_policy, wheel->size,
+                                    wheel->size ? wheel->size + 1
+                                                : TIMERWHEEL_INITIAL_TIMERS);
+        timerwheel_entry *timer = NULL;
+
+        if (size > (size_t)INT_MAX) {
+            size = INT_MAX;
+        }
+        timer = realloc(wheel->timer, size * sizeof(*timer));
+        if (timer == NULL) {
+            return -1;
+        }
+        wheel->timer = timer;
+        wheel->size = size;
+    }
+
+    wheel->timer[wheel->used].generation = 0;
+    return wheel->used++;
+}
+
+/**
+ * Give an entry back, invalidating its handle
+ */
+static void timerwheel_release(timerwheel *wheel, int index) {
+    timerwheel_entry *entry = &wheel->timer[index];
+
+    entry->state = TIMERWHEEL_FREE;
+    entry->next_free = wheel->free;
+    wheel->free = index;
+}
+
+static inline timerwheel_timer timerwheel_handle(const timerwheel *wheel,
+                                                 int index) {
+    return (uint64_t)wheel->timer[index].generation << 32 | (uint32_t)index;
+}
+
+/**
+ * Queue a timer in the slot of its deadline, the wheel being at tick now
+ * @return 0 if the timer was queued
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int timerwheel_place(timerwheel *wheel, int index, uint64_t now) {
+    uint64_t deadline = wheel->timer[index].deadline;
+    size_t level = 0;
+    size_t slot = 0;
+
+    if (deadline - now >= TIMERWHEEL_RANGE) {
+        deadline = now + TIMERWHEEL_RANGE - 1;
+    }
+
+    /* Lowest level whose current span holds the deadline */
+    while (level < TIMERWHEEL_LEVELS - 1
+           && deadline >> (TIMERWHEEL_BITS * (level + 1))
+              != now >> (TIMERWHEEL_BITS * (level + 1))) {
+        level++;
+    }
+    slot = (deadline >> (TIMERWHEEL_BITS * level)) & TIMERWHEEL_MASK;
+
+    if (wheel->slot[level][slot] == NULL) {
+        wheel->slot[level][slot] = circularqueue_create(0);
+        if (wheel->slot[level][slot] == NULL) {
+            return -1;
+        }
+    }
+    if (!circularqueue_insert(wheel->slot[level][slot], index)) {
+        return -1;
+    }
+
+    wheel->occupied[level][slot / 64] |= (uint64_t)1 << (slot % 64);
+    return 0;
+}
+
+timerwheel_timer timerwheel_schedule(timerwheel *wheel, uint64_t delay,
+                                     timerwheel_fn fn, void *ctx) {
+    timerwheel_entry *entry = NULL;
+    int index = 0;
+
+    assert(wheel);
+    assert(fn);
+
+    index = timerwheel_alloc(wheel);
+    if (index < 0) {
+        return 0;
+    }
+
+    entry = &wheel->timer[index];
+    entry->deadline = wheel->now + (delay ? delay : 1);
+    if (entry->deadline < wheel->now) {
+        entry->deadline = UINT64_MAX;
+    }
+    entry->fn = fn;
+    entry->ctx = ctx;
+    entry->state = TIMERWHEEL_PENDING;
+    entry->generation++;
+    if (entry->generation == 0) {
+        entry->generation = 1;
+    }
+
+    if (timerwheel_place(wheel, index, wheel->now) != 0) {
+        timerwheel_release(wheel, index);
+        return 0;
+    }
+
+    wheel->count++;
+    wheel->queued++;
+
+    return timerwheel_handle(wheel, index);
+}
+
+int timerwheel_cancel(timerwheel *wheel, timerwheel_timer timer) {
+    uint32_t index = (uint32_t)timer;
+    timerwheel_entry *entry = NULL;
+
+    assert(wheel);
+
+    if (index >= wheel->used) {
+        return 0;
+    }
+
+    entry = &wheel->timer[index];
+    if (entry->state != TIMERWHEEL_PENDING
+        || entry->generation != (uint32_t)(timer >> 32)) {
+        return 0;
+    }
+
+    /* The entry is released when the wheel reaches its slot */
+    entry->state = TIMERWHEEL_CANCELLED;
+    wheel->count--;
+
+    return 1;
+}
+
+/**
+ * Empty a slot, expiring or placing again each of its timers
+ * @param wheel a non null pointer to a wheel
+ * @param level the level of the slot
+ * @param slot the index of the slot in its level
+ * @param now the tick being processed
+ * @return the number of expired timers
+ */
+static size_t timerwheel_drain(timerwheel *wheel, size_t level, size_t slot,
+                               uint64_t now) {
+    circularqueue *queue = wheel->slot[level][slot];
+    size_t expired = 0;
+
+    if (queue == NULL) {
+        return 0;
+    }
+
+    /* Timers added while draining are not part of this batch */
+    for (size_t n = circularqueue_count(queue); n > 0; n--) {
+        int index = circularqueue_head(queue);
+        timerwheel_entry *entry = &wheel->timer[index];
+
+        circularqueue_remove(queue);
+
+        if (entry->state == TIMERWHEEL_CANCELLED) {
+            timerwheel_release(wheel, index);
+            wheel->queued--;
+        } else if (entry->deadline <= now) {
+            timerwheel_fn fn = entry->fn;
+            void *ctx = entry->ctx;
+            timerwheel_timer timer = timerwheel_handle(wheel, index);
+
+            /* Released first so the callback can reuse the entry */
+            timerwheel_release(wheel, index);
+            wheel->queued--;
+            wheel->count--;
+            expired++;
+            fn(ctx, timer);
+        } else if (timerwheel_place(wheel, index, now) != 0) {
+            /* Out of memory, the timer is placed again one turn later */
+            circularqueue_insert(queue, index);
+        }
+    }
+
+    if (circularqueue_is_empty(queue)) {
+        wheel->occupied[level][slot / 64] &= ~((uint64_t)1 << (slot % 64));
+    }
+
+    return expired;
+}
+
+/**
+ * Find the first used slot of a level from first
+ * @return the index of the slot or TIMERWHEEL_SLOTS if there is none
+ */
+static size_t timerwheel_next_slot(const timerwheel *wheel, size_t level,
+                                   size_t first) {
+    const uint64_t *occupied = wheel->occupied[level];
+
+    for (size_t word = first / 64; word < TIMERWHEEL_SLOTS / 64; word++) {
+        uint64_t bits = occupied[word];
+
+        if (word == first / 64) {
+            bits &= ~(uint64_t)0 << (first % 64);
+        }
+        if (bits) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+    }
+
+    return TIMERWHEEL_SLOTS;
+}
+
+/**
+ * Find the next tick after tick at which the wheel reaches a used slot
+ * @return the tick, UINT64_MAX if there is none
+ */
+static uint64_t timerwheel_next_tick(const timerwheel *wheel, uint64_t tick) {
+    uint64_t next = UINT64_MAX;
+
+    for (size_t level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        size_t shift = TIMERWHEEL_BITS * level;
+        uint64_t turn = (uint64_t)1 << (shift + TIMERWHEEL_BITS);
+        uint64_t base = tick & ~(turn - 1);
+        size_t slot = timerwheel_next_slot(wheel, level,
+                                           ((tick >> shift) & TIMERWHEEL_MASK)
+                                           + 1);
+        uint64_t candidate = 0;
+
+        /* Otherwise the first used slot of the next turn */
+        if (slot == TIMERWHEEL_SLOTS) {
+            slot = timerwheel_next_slot(wheel, level, 0);
+            if (slot == TIMERWHEEL_SLOTS) {
+                continue;
+            }
+            base += turn;
+            if (base < turn) {
+                continue;
+            }
+        }
+
+        candidate = base | (uint64_t)slot << shift;
+        if (candidate < next) {
+            next = candidate;
+        }
+    }
+
+    return next;
+}
+
+size_t timerwheel_advance(timerwheel *wheel, uint64_t now) {
+    size_t expired = 0;
+
+    assert(wheel);
+
+    while (wheel->now < now) {
+        uint64_t tick = wheel->now + 1;
+
+        if (wheel->queued == 0) {
+            wheel->now = now;
+            break;
+        }
+
+        /* Callbacks schedule relative to the tick being processed */
+        wheel->now = tick;
+
+        /* Bring the timers of the higher levels down, top level first */
+        for (size_t level = TIMERWHEEL_LEVELS - 1; level > 0; level--) {
+            uint64_t span = (uint64_t)1 << (TIMERWHEEL_BITS * level);
+
+            if ((tick & (span - 1)) == 0) {
+                expired += timerwheel_drain(wheel, level,
+                                            (tick / span) & TIMERWHEEL_MASK,
+                                            tick);
+            }
+        }
+
+        expired += timerwheel_drain(wheel, 0, tick & TIMERWHEEL_MASK, tick);
+
+        /* Skip the ticks reaching only empty slots */
+        uint64_t next = timerwheel_next_tick(wheel, tick);
+        if (next - 1 > tick) {
+            wheel->now = next - 1 < now ? next - 1 : now;
+        }
+    }
+
+    return expired;
+}
+
+#ifdef WITH_TEST
+typedef struct {
+    timerwheel *wheel;
+    uint64_t fired[64];
+    size_t count;
+} timerwheel_test_log;
+
+static void timerwheel_test_fire(void *ctx, timerwheel_timer timer) {
+    timerwheel_test_log *log = ctx;
+
+    log->fired[log->count++] = log->wheel->now;
+    (void)timer;
+}
+
+static void timerwheel_test_again(void *ctx, timerwheel_timer timer) {
+    timerwheel_test_log *log = ctx;
+
+    timerwheel_test_fire(ctx, timer);
+    if (log->count < 5) {
+        cr_assert(timerwheel_schedule(log->wheel, 10, timerwheel_test_again,
+                                      log));
+    }
+}
+
+typedef struct {
+    timerwheel *wheel;
+    uint64_t deadline;
+    int fired;
+} timerwheel_test_timer;
+
+static void timerwheel_test_check(void *ctx, timerwheel_timer timer) {
+    timerwheel_test_timer *test = ctx;
+
+    test->fired += test->wheel->now == test->deadline;
+    (void)timer;
+}
+
+Test(TimerWheel, expire) {
+    timerwheel_test_log log = { 0 };
+    uint64_t delays[] = { 1, 5, 255, 256, 257, 70000, 16777217, 5000000000 };
+
+    log.wheel = timerwheel_create(1000);
+    cr_assert(log.wheel);
+
+    for (size_t i = 0; i < sizeof(delays) / sizeof(*delays); i++) {
+        cr_assert(timerwheel_schedule(log.wheel, delays[i],
+                                      timerwheel_test_fire, &log));
+    }
+    cr_assert(timerwheel_count(log.wheel) == 8);
+
+    cr_assert(timerwheel_advance(log.wheel, 1000) == 0);
+    cr_assert(timerwheel_advance(log.wheel, 1005) == 2);
+    cr_assert(log.fired[0] == 1001 && log.fired[1] == 1005);
+
+    cr_assert(timerwheel_advance(log.wheel, 1000 + 16777217) == 5);
+    cr_assert(log.fired[2] == 1255 && log.fired[3] == 1256);
+    cr_assert(log.fired[4] == 1257 && log.fired[5] == 71000);
+    cr_assert(log.fired[6] == 1000 + 16777217);
+
+    cr_assert(timerwheel_advance(log.wheel, 1000 + 5000000000 - 1) == 0);
+    cr_assert(timerwheel_count(log.wheel) == 1);
+    cr_assert(timerwheel_advance(log.wheel, UINT64_MAX / 2) == 1);
+    cr_assert(log.fired[7] == 1000 + 5000000000);
+    cr_assert(timerwheel_count(log.wheel) == 0);
+
+    timerwheel_delete(log.wheel);
+}
+
+Test(TimerWheel, cancel) {
+    timerwheel_test_log log = { 0 };
+    timerwheel_timer timers[10];
+
+    log.wheel = timerwheel_create(0);
+    for (size_t i = 0; i < 10; i++) {
+        timers[i] = timerwheel_schedule(log.wheel, 100, timerwheel_test_fire,
+                                        &log);
+        cr_assert(timers[i]);
+    }
+
+    for (size_t i = 0; i < 10; i += 2) {
+        cr_assert(timerwheel_cancel(log.wheel, timers[i]));
+        cr_assert_not(timerwheel_cancel(log.wheel, timers[i]));
+    }
+    cr_assert(timerwheel_count(log.wheel) == 5);
+    cr_assert_not(timerwheel_cancel(log.wheel, 0));
+
+    cr_assert(timerwheel_advance(log.wheel, 100) == 5);
+    cr_assert_not(timerwheel_cancel(log.wheel, timers[1]));
+    cr_assert(log.wheel->queued == 0);
+
+    /* Released entries are reused with a new handle */
+    cr_assert(timerwheel_schedule(log.wheel, 1, timerwheel_test_fire, &log)
+              != timers[8]);
+
+    timerwheel_delete(log.wheel);
+}
+
+Test(TimerWheel, reschedule) {
+    timerwheel_test_log log = { 0 };
+
+    log.wheel = timerwheel_create(250);
+    cr_assert(timerwheel_schedule(log.wheel, 3, timerwheel_test_again, &log));
+
+    cr_assert(timerwheel_advance(log.wheel, 10000) == 5);
+    for (size_t i = 0; i < 5; i++) {
+        cr_assert(log.fired[i] == 253 + 10 * i);
+    }
+    cr_assert(timerwheel_count(log.wheel) == 0);
+
+    timerwheel_delete(log.wheel);
+}
+
+Test(TimerWheel, random) {
+    static timerwheel_test_timer tests[4000];
+    timerwheel_timer timers[4000];
+    timerwheel *wheel = timerwheel_create(12345);
+    uint64_t seed = 42;
+
+    for (size_t i = 0; i < 4000; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t delay = (seed >> 33) % (i < 3000 ? 70000 : 20000000);
+
+        tests[i].wheel = wheel;
+        tests[i].deadline = 12345 + (delay ? delay : 1);
+        timers[i] = timerwheel_schedule(wheel, delay, timerwheel_test_check,
+                                        &tests[i]);
+        cr_assert(timers[i]);
+    }
+    for (size_t i = 0; i < 4000; i += 3) {
+        cr_assert(timerwheel_cancel(wheel, timers[i]));
+    }
+
+    /* Advance by uneven steps */
+    for (uint64_t now = 12345; now < 12345 + 20000000; now += 977) {
+        timerwheel_advance(wheel, now);
+    }
+    timerwheel_advance(wheel, 12345 + 20000000);
+
+    for (size_t i = 0; i < 4000; i++) {
+        cr_assert(tests[i].fired == (i % 3 != 0));
+    }
+    cr_assert(timerwheel_count(wheel) == 0);
+    cr_assert(wheel->queued == 0);
+
+    timerwheel_delete(wheel);
+}
+#endif
@@ -0,0 +1,355 @@
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "woofi/allocator.h"
+#include "woofi/window.h"
+#ifdef WITH_TEST
+# include <criterion/criterion.h>
+#endif
+
+/**
+ * Move the samples and both queues to storage of another capacity
+ * @param window a non null pointer to a window
+ * @param capacity the new capacity, a power of two above the count
+ * @return 0 if the window was resized
+ *        -1 on error, if it failed to allocate requested memory (see errno)
+ */
+static int window_resize(window *window, size_t capacity) {
+    window_sample *sample = NULL;
+    uint64_t *min_queue = NULL;
+    uint64_t *max_queue = NULL;
+    size_t mask = capacity - 1;
+    int error;
+
+    sample = allocator_malloc(capacity * sizeof(*sample));
+    min_queue = allocator_malloc(capacity * sizeof(*min_queue));
+    max_queue = allocator_malloc(capacity * sizeof(*max_queue));
+    if (sample == NULL || min_queue == NULL || max_queue == NULL) {
+        error = errno;
+        allocator_free(sample, capacity * sizeof(*sample));
+        allocator_free(min_queue, capacity * sizeof(*min_queue));
+        allocator_free(max_queue, capacity * sizeof(*max_queue));
+        errno = error;
+        return -1;
+    }
+
+    /* Slots follow the sequences, which keep their values */
+    for (uint64_t i = window->first; i < window->next; i++) {
+        sample[i & mask] = window->sample[i & window->mask];
+    }
+    for (uint64_t i = window->min_head; i < window->min_tail; i++) {
+        min_queue[i & mask] = window->min_queue[i & window->mask];
+    }
+    for (uint64_t i = window->max_head; i < window->max_tail; i++) {
+        max_queue[i & mask] = window->max_queue[i & window->mask];
+    }
+
+    allocator_free(window->sample, window->capacity * sizeof(*sample));
+    allocator_free(window->min_queue, window->capacity * sizeof(*min_queue));
+    allocator_free(window->max_queue, window->capacity * sizeof(*max_queue));
+    window->sample = sample;
+    window->min_queue = min_queue;
+    window->max_queue = max_queue;
+    window->capacity = capacity;
+    window->mask = mask;
+
+    return 0;
+}
+
+static window *window_create(size_t capacity, size_t length, uint64_t span) {
+    window *window = NULL;
+    size_t slots = WINDOW_MIN_CAPACITY;
+
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    window = allocator_calloc(1, sizeof(*window));
+    if (window == NULL) {
+        return NULL;
+    }
+    window->length = length;
+    window->span = span;
+
+    if (window_resize(window, slots) == -1) {
+        int error = errno;
+        allocator_free(window, sizeof(*window));
+        errno = error;
+        return NULL;
+    }
+
+    return window;
+}
+
+window *window_create_count(size_t length) {
+    if (length == 0 || length > SIZE_MAX / 2 / sizeof(window_sample)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return window_create(length, length, 0);
+}
+
+window *window_create_time(uint64_t span) {
+    if (span == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return window_create(WINDOW_MIN_CAPACITY, 0, span);
+}
+
+void window_delete(window *window) {
+    assert(window);
+
+    allocator_free(window->sample, window->capacity * sizeof(*window->sample));
+    allocator_free(window->min_queue,
+                   window->capacity * sizeof(*window->min_queue));
+    allocator_free(window->max_queue,
+                   window->capacity * sizeof(*window->max_queue));
+    allocator_free(window, sizeof(*window));
+}
+
+/**
+ * Drop the oldest sample from the sums and from the heads of the queues
+ * it may still lead
+ */
+static void window_evict_one(window *window) {
+    const window_sample *oldest = &window->sample[window->first & window->mask];
+
+    window->sum -= oldest->value;
+    window->sum_squares -= (uint64_t)((int64_t)oldest->value * oldest->value);
+
+    if (window->min_queue[window->min_head & window->mask] == window->first) {
+        window->min_head++;
+    }
+    if (window->max_queue[window->max_head & window->mask] == window->first) {
+        window->max_head++;
+    }
+    window->first++;
+}
+
+int window_push(window *window, int value, uint64_t time) {
+    assert(window);
+
+    if (window->length) {
+        if (window_count(window) == window->length) {
+            window_evict_one(window);
+        }
+    }
+    else {
+        if (!window_is_empty(window)
+            && time < window->sample[(window->next - 1) & window->mask].time) {
+            errno = EINVAL;
+            return -1;
+        }
+        window_evict(window, time);
+        if (window_count(window) == window->capacity
+            && window_resize(window, window->capacity * 2) == -1) {
+            return -1;
+        }
+    }
+
+    /* A new sample outlives the older ones it beats */
+    while (window->min_tail > window->min_head
+           && window->sample[window->min_queue[(window->min_tail - 1)
+                                               & window->mask]
+                             & window->mask].value >= value) {
+        window->min_tail--;
+    }
+    window->min_queue[window->min_tail++ & window->mask] = window->next;
+
+    while (window->max_tail > window->max_head
+           && window->sample[window->max_queue[(window->max_tail - 1)
+                                               & window->mask]
+                             & window->mask].value <= value) {
+        window->max_tail--;
+    }
+    window->max_queue[window->max_tail++ & window->mask] = window->next;
+
+    window->sample[window->next & window->mask].value = value;
+    window->sample[window->next & window->mask].time = time;
+    window->next++;
+    window->sum += value;
+    window->sum_squares += (uint64_t)((int64_t)value * value);
+
+    return 0;
+}
+
+size_t window_evict(window *window, uint64_t now) {
+    size_t evicted = 0;
+
+    assert(window);
+
+    if (window->length) {
+        return 0;
+    }
+
+    while (window->first < window->next) {
+        uint64_t time = window->sample[window->first & window->mask].time;
+
+        if (now < time || now - time < window->span) {
+            break;
+        }
+        window_evict_one(window);
+        evicted++;
+    }
+
+    return evicted;
+}
+
+void window_clear(window *window) {
+    assert(window);
+
+    window->first = window->next;
+    window->min_head = window->min_tail;
+    window->max_head = window->max_tail;
+    window->sum = 0;
+    window->sum_squares = 0;
+}
+
+size_t window_count(const window *window) {
+    assert(window);
+
+    return window->next - window->first;
+}
+
+int window_is_empty(const window *window) {
+    assert(window);
+
+    return window->next == window->first;
+}
+
+int window_min(const window *window) {
+    assert(window);
+    assert(!window_is_empty(window));
+
+    return window->sample[window->min_queue[window->min_head & window->mask]
+                          & window->mask].value;
+}
+
+int window_max(const window *window) {
+    assert(window);
+    assert(!window_is_empty(window));
+
+    return window->sample[window->max_queue[window->max_head & window->mask]
+                          & window->mask].value;
+}
+
+int64_t window_sum(const window *window) {
+    assert(window);
+
+    return window->sum;
+}
+
+double window_mean(const window *window) {
+    size_t count = window_count(window);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    return (double)window->sum / count;
+}
+
+double window_variance(const window *window) {
+    size_t count = window_count(window);
+    unsigned __int128 spread;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    /* n * sum(x^2) - sum(x)^2, exact and never negative */
+    spread = count * window->sum_squares
+        - (unsigned __int128)((__int128)window->sum * window->sum);
+    return (double)spread / ((double)count * count);
+}
+
+#ifdef WITH_TEST
+Test(Window, count) {
+    window *window = window_create_count(3);
+    int values[] = { 5, 1, 4, 2, 8, 8, 3, -7, 6 };
+    int minimum[] = { 5, 1, 1, 1, 2, 2, 3, -7, -7 };
+    int maximum[] = { 5, 5, 5, 4, 8, 8, 8, 8, 6 };
+
+    cr_assert(window);
+    cr_assert(window_create_count(0) == NULL);
+    cr_assert(window_is_empty(window));
+    cr_assert(window_mean(window) == 0);
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++) {
+        cr_assert(window_push(window, values[i], 0) == 0);
+        cr_assert(window_min(window) == minimum[i]);
+        cr_assert(window_max(window) == maximum[i]);
+    }
+    cr_assert(window_count(window) == 3);
+    cr_assert(window_sum(window) == 2);
+    cr_assert(window_variance(window) > 30.88
+              && window_variance(window) < 30.89);
+
+    window_clear(window);
+    cr_assert(window_is_empty(window));
+    cr_assert(window_push(window, 9, 0) == 0);
+    cr_assert(window_min(window) == 9 && window_max(window) == 9);
+    cr_assert(window_variance(window) == 0);
+
+    window_delete(window);
+}
+
+Test(Window, variance_offset) {
+    window *window = window_create_count(1000);
+    double mean = 0;
+    double expected = 0;
+    double variance;
+
+    /* A large offset cancels out of running sums of doubles */
+    for (int i = 0; i < 200000; i++) {
+        cr_assert(window_push(window, 1000000000 + i * 5 % 7, 0) == 0);
+    }
+    for (int i = 199000; i < 200000; i++) {
+        mean += i * 5 % 7;
+    }
+    mean /= 1000;
+    for (int i = 199000; i < 200000; i++) {
+        expected += (i * 5 % 7 - mean) * (i * 5 % 7 - mean);
+    }
+    expected /= 1000;
+
+    variance = window_variance(window);
+    cr_assert(expected > 3.9);
+    cr_assert(variance > expected - 1e-9 && variance < expected + 1e-9);
+    cr_assert(window_mean(window) == 1000000000 + mean);
+
+    window_delete(window);
+}
+
+Test(Window, time) {
+    window *window = window_create_time(10);
+
+    cr_assert(window);
+    /* Growing past the initial capacity keeps the queues in order */
+    for (int i = 0; i < 100; i++) {
+        cr_assert(window_push(window, i % 7 == 0 ? -i : i, i / 10) == 0);
+    }
+    cr_assert(window_count(window) == 100);
+    cr_assert(window->capacity == 128);
+    cr_assert(window_min(window) == -98);
+    cr_assert(window_max(window) == 99);
+
+    cr_assert(window_push(window, 0, 8) == -1);
+    cr_assert(errno == EINVAL);
+
+    /* Samples of times 0 to 4 are gone at time 14 */
+    cr_assert(window_evict(window, 14) == 50);
+    cr_assert(window_min(window) == -98 && window_max(window) == 99);
+    cr_assert(window_push(window, 1000, 19) == 0);
+    cr_assert(window_count(window) == 1);
+    cr_assert(window_sum(window) == 1000 && window_mean(window) == 1000);
+    cr_assert(window_evict(window, 29) == 1);
+    cr_assert(window_is_empty(window));
+
+    window_delete(window);
+}
+#endif